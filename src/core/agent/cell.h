@@ -266,27 +266,6 @@ class Cell : public Agent {
     // There is also a computation of the torque (only applied
     // by the daughter neurites), stored in rotationForce.
 
-    // TODO(roman) : There might be a problem, in the sense that the biology
-    // is not applied if the total Force is smaller than adherence.
-    // Once, I should look at this more carefully.
-
-    // fixme why? copying
-    const auto& tf = GetTractorForce();
-
-    // the 3 types of movement that can occur
-    // bool biological_translation = false;
-    bool physical_translation = false;
-    // bool physical_rotation = false;
-
-    real_t h = dt;
-    Real3 movement_at_next_step{0, 0, 0};
-
-    // BIOLOGY :
-    // 0) Start with tractor force : What the biology defined as active
-    // movement------------
-    movement_at_next_step += tf * h;
-
-    // PHYSICS
     // the physics force to move the point mass
     Real3 translation_force_on_point_mass{0, 0, 0};
 
@@ -316,13 +295,44 @@ class Cell : public Agent {
               translation_force_on_point_mass[2] += neighbor_force[2];
             }
           });
-      ctxt->ForEachNeighbor(calculate_neighbor_forces, *this, squared_radius);
+      ctxt->ForEachNeighborInInteractionRange(
+          calculate_neighbor_forces, *this, squared_radius,
+          force->GetSphereInteractionMargin());
 
       if (non_zero_neighbor_forces > 1) {
         SetStaticnessNextTimestep(false);
       }
     }
 
+    return CalculateDisplacementFromForce(translation_force_on_point_mass, dt);
+  }
+
+  /// Computes the displacement of this cell for the next time step given the
+  /// sum of all neighbor forces acting on its point mass.\n
+  /// Used by `CalculateDisplacement` and by operations that calculate the
+  /// neighbor forces themselves (e.g. `MechanicalForcesOpSymmetric`).
+  Real3 CalculateDisplacementFromForce(
+      const Real3& translation_force_on_point_mass, real_t dt) const {
+    // TODO(roman) : There might be a problem, in the sense that the biology
+    // is not applied if the total Force is smaller than adherence.
+    // Once, I should look at this more carefully.
+
+    // fixme why? copying
+    const auto& tf = GetTractorForce();
+
+    // the 3 types of movement that can occur
+    // bool biological_translation = false;
+    bool physical_translation = false;
+    // bool physical_rotation = false;
+
+    real_t h = dt;
+    Real3 movement_at_next_step{0, 0, 0};
+
+    // BIOLOGY :
+    // 0) Start with tractor force : What the biology defined as active
+    // movement------------
+    movement_at_next_step += tf * h;
+
     // 4) PhysicalBonds
     // How the physics influences the next displacement
     real_t norm_of_force = std::sqrt(translation_force_on_point_mass *
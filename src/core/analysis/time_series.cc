@@ -14,7 +14,10 @@
 
 #include "core/analysis/time_series.h"
 #include <TBufferJSON.h>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <limits>
 #include "core/analysis/reduce.h"
 #include "core/scheduler.h"
 #include "core/simulation.h"
@@ -293,11 +296,30 @@ TimeSeries::TimeSeries(const TimeSeries& other) : data_(other.data_) {}
 
 // -----------------------------------------------------------------------------
 TimeSeries::TimeSeries(TimeSeries&& other) noexcept
-    : data_(std::move(other.data_)) {}
+    : data_(std::move(other.data_)),
+      fused_reduction_(other.fused_reduction_),
+      stream_directory_(std::move(other.stream_directory_)),
+      stream_chunk_size_(other.stream_chunk_size_),
+      streamed_entries_(std::move(other.streamed_entries_)) {
+  other.DisableStreaming();
+}
+
+// -----------------------------------------------------------------------------
+TimeSeries::~TimeSeries() { Flush(); }
 
 // -----------------------------------------------------------------------------
 TimeSeries& TimeSeries::operator=(TimeSeries&& other) noexcept {
+  if (this == &other) {
+    return *this;
+  }
+  // Write the remaining data points of this object before they are replaced
+  Flush();
   data_ = std::move(other.data_);
+  fused_reduction_ = other.fused_reduction_;
+  stream_directory_ = std::move(other.stream_directory_);
+  stream_chunk_size_ = other.stream_chunk_size_;
+  streamed_entries_ = std::move(other.streamed_entries_);
+  other.DisableStreaming();
   return *this;
 }
 
@@ -378,7 +400,9 @@ void TimeSeries::Update() {
       if (result_data.y_reducer_collector == nullptr) {
         continue;
       }
-      result_data.y_reducer_collector->Reset();
+      if (!fused_reduction_) {
+        result_data.y_reducer_collector->Reset();
+      }
       reducers.push_back(
           std::make_pair(result_data.y_reducer_collector, entry.first));
       if (result_data.xcollector == nullptr) {
@@ -389,13 +413,17 @@ void TimeSeries::Update() {
       }
     }
 
-    //   execute reducers
-    auto execute_reducers = L2F([&](Agent* agent) {
-      for (auto& el : reducers) {
-        (*el.first)(agent);
-      }
-    });
-    sim->GetResourceManager()->ForEachAgentParallel(execute_reducers);
+    //   execute reducers, unless they have already been executed during the
+    //   agent operations
+    if (!fused_reduction_) {
+      auto execute_reducers = L2F([&](Agent* agent) {
+        for (auto& el : reducers) {
+          (*el.first)(agent);
+        }
+      });
+      sim->GetResourceManager()->ForEachAgentParallel(execute_reducers);
+    }
+    fused_reduction_ = false;
     for (auto& el : reducers) {
       data_[el.second].y_values.push_back(el.first->GetResult());
     }
@@ -415,7 +443,92 @@ void TimeSeries::Update() {
         result_data.x_values.push_back(result_data.xcollector(sim));
       }
     }
+
+    // Write full chunks to disk. The most recent data point stays in memory
+    // such that function collectors can still access it.
+    if (!stream_directory_.empty()) {
+      for (auto& entry : data_) {
+        auto& result_data = entry.second;
+        bool collected = result_data.y_reducer_collector != nullptr ||
+                         result_data.ycollector != nullptr;
+        if (collected && result_data.x_values.size() >= stream_chunk_size_) {
+          WriteChunk(entry.first, &result_data,
+                     result_data.x_values.size() - 1);
+        }
+      }
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------
+std::vector<Reducer<real_t>*> TimeSeries::StartFusedReduction() {
+  std::vector<Reducer<real_t>*> reducers;
+  for (auto& entry : data_) {
+    auto* reducer = entry.second.y_reducer_collector;
+    if (reducer != nullptr) {
+      reducer->Reset();
+      reducers.push_back(reducer);
+    }
+  }
+  fused_reduction_ = true;
+  return reducers;
+}
+
+// -----------------------------------------------------------------------------
+void TimeSeries::StreamToDisk(const std::string& directory,
+                              uint64_t chunk_size) {
+  stream_directory_ = directory;
+  stream_chunk_size_ = std::max(chunk_size, uint64_t{1});
+}
+
+// -----------------------------------------------------------------------------
+void TimeSeries::Flush() {
+  if (stream_directory_.empty()) {
+    return;
+  }
+  for (auto& entry : data_) {
+    auto& result_data = entry.second;
+    if (result_data.y_reducer_collector != nullptr ||
+        result_data.ycollector != nullptr) {
+      WriteChunk(entry.first, &result_data, result_data.x_values.size());
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------
+void TimeSeries::DisableStreaming() {
+  stream_directory_.clear();
+  stream_chunk_size_ = 0;
+  streamed_entries_.clear();
+}
+
+// -----------------------------------------------------------------------------
+void TimeSeries::WriteChunk(const std::string& id, Data* data,
+                            uint64_t count) {
+  count = std::min({count, static_cast<uint64_t>(data->x_values.size()),
+                    static_cast<uint64_t>(data->y_values.size())});
+  if (count == 0) {
+    return;
+  }
+  auto filename = Concat(stream_directory_, "/", id, ".csv");
+  // Existing files are overwritten by the first chunk
+  bool first_chunk = streamed_entries_.count(id) == 0;
+  std::ofstream ofs(filename, first_chunk ? std::ios::trunc : std::ios::app);
+  if (!ofs) {
+    Log::Warning("TimeSeries::WriteChunk", "Could not open ", filename,
+                 ". Data points remain in memory.");
+    return;
+  }
+  if (first_chunk) {
+    ofs << "x,y\n";
+    streamed_entries_.insert(id);
+  }
+  ofs << std::setprecision(std::numeric_limits<real_t>::max_digits10);
+  for (uint64_t i = 0; i < count; ++i) {
+    ofs << data->x_values[i] << "," << data->y_values[i] << "\n";
   }
+  data->x_values.erase(data->x_values.begin(), data->x_values.begin() + count);
+  data->y_values.erase(data->y_values.begin(), data->y_values.begin() + count);
 }
 
 // -----------------------------------------------------------------------------
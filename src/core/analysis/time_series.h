@@ -16,6 +16,7 @@
 
 #include <functional>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include "core/analysis/reduce.h"
 #include "core/real_t.h"
@@ -192,8 +193,14 @@ class TimeSeries {
 
   TimeSeries();
   TimeSeries(const TimeSeries& other);
+  /// Takes over the streaming state of `other` (see `StreamToDisk`).
+  /// `other` no longer streams to disk.
   TimeSeries(TimeSeries&& other) noexcept;
+  /// Writes the remaining data points to disk if `StreamToDisk` was called.
+  ~TimeSeries();
 
+  /// Flushes the data points of this object and takes over the streaming
+  /// state of `other`.
   TimeSeries& operator=(TimeSeries&& other) noexcept;
   TimeSeries& operator=(const TimeSeries& other);
 
@@ -276,6 +283,28 @@ class TimeSeries {
   /// Adds a new data point to all time series with a collector.
   void Update();
 
+  /// Resets all reducer collectors and returns them. The caller executes
+  /// them for each agent, and the next call to `Update` uses their results
+  /// instead of iterating over all agents again.\n
+  /// Used by the scheduler to execute the reducers during the agent
+  /// operations (see `Param::fuse_time_series_reducers`).
+  std::vector<Reducer<real_t>*> StartFusedReduction();
+
+  /// Streams the data points of entries with a collector to disk, instead of
+  /// keeping them in memory for the whole simulation. Once an entry has
+  /// `chunk_size` data points, all but the most recent one are appended to
+  /// `<directory>/<id>.csv` and removed from memory. Thus, `GetXValues` and
+  /// `GetYValues` only return the data points that have not been written yet.
+  /// Entries without a collector are not affected.
+  /// \code
+  /// ts->StreamToDisk(simulation.GetOutputDir(), 1000);
+  /// \endcode
+  void StreamToDisk(const std::string& directory, uint64_t chunk_size = 1000);
+
+  /// Writes all data points of entries with a collector to disk and removes
+  /// them from memory. Has no effect if `StreamToDisk` has not been called.
+  void Flush();
+
   /// Returns whether a times series with given id exists in this object.
   bool Contains(const std::string& id) const;
   uint64_t Size() const;
@@ -295,6 +324,22 @@ class TimeSeries {
 
  private:
   std::unordered_map<std::string, Data> data_;
+  /// True if the reducer collectors have been executed since the last call
+  /// to `Update` (see `StartFusedReduction`)
+  bool fused_reduction_ = false;  //!
+  /// Output directory of streamed entries. Empty if streaming is disabled.
+  std::string stream_directory_;  //!
+  uint64_t stream_chunk_size_ = 0;  //!
+  /// Entries whose file has been created
+  std::unordered_set<std::string> streamed_entries_;  //!
+
+  /// Resets the streaming state, e.g. of a moved-from object, such that
+  /// `Flush` has no effect.
+  void DisableStreaming();
+
+  /// Appends the first `count` data points of `id` to its file and removes
+  /// them from memory.
+  void WriteChunk(const std::string& id, Data* data, uint64_t count);
 
   BDM_CLASS_DEF_NV(TimeSeries, 1);
 };
@@ -52,7 +52,7 @@ class AgentFlatIdxMap {
     offset_.resize(num_numa_nodes);
     offset_[0] = 0;
     for (int nn = 1; nn < num_numa_nodes; nn++) {
-      offset_[nn] = offset_[nn - 1] + rm->GetNumAgents(nn - 1);
+      offset_[nn] = offset_[nn - 1] + rm->GetAgentContainerSize(nn - 1);
     }
   }
 
@@ -51,7 +51,7 @@ class AgentVector {
     auto* sim = Simulation::GetActive();
     auto* rm = sim->GetResourceManager();
     for (int n = 0; n < thread_info_->GetNumaNodes(); n++) {
-      auto num_agents = rm->GetNumAgents(n);
+      auto num_agents = rm->GetAgentContainerSize(n);
       if (data_[n].capacity() < num_agents) {
         data_[n].reserve(num_agents * 1.5);
       }
@@ -0,0 +1,250 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN & University of Surrey for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+// See the NOTICE file distributed with this work for additional information
+// regarding copyright ownership.
+//
+// -----------------------------------------------------------------------------
+
+#include "core/diffusion/adi_grid.h"
+
+namespace bdm {
+
+void ADIGrid::DiffuseWithClosedEdge(real_t dt) {
+  DiffuseImplicitly(BoundaryConditionType::kClosedBoundaries, dt);
+}
+
+void ADIGrid::DiffuseWithOpenEdge(real_t dt) {
+  DiffuseImplicitly(BoundaryConditionType::kOpenBoundaries, dt);
+}
+
+void ADIGrid::DiffuseWithDirichlet(real_t dt) {
+  DiffuseImplicitly(BoundaryConditionType::kDirichlet, dt);
+}
+
+void ADIGrid::DiffuseWithNeumann(real_t dt) {
+  DiffuseImplicitly(BoundaryConditionType::kNeumann, dt);
+}
+
+void ADIGrid::DiffuseWithPeriodic(real_t dt) {
+  DiffuseImplicitly(BoundaryConditionType::kPeriodic, dt);
+}
+
+void ADIGrid::DiffuseImplicitly(BoundaryConditionType bc_type, real_t dt) {
+  if (bc_type == BoundaryConditionType::kDirichlet) {
+    ApplyDirichletBoundary();
+  }
+  for (int axis = 0; axis < 3; axis++) {
+    SolveAxis(axis, bc_type, dt);
+  }
+}
+
+void ADIGrid::SolveAxis(int axis, BoundaryConditionType bc_type, real_t dt) {
+  const size_t nx = num_boxes_axis_[0];
+  const size_t ny = num_boxes_axis_[1];
+  const size_t nz = num_boxes_axis_[2];
+  const size_t nxy = nx * ny;
+  const size_t n = num_boxes_axis_[axis];
+
+  const bool fixed_boundary =
+      bc_type == BoundaryConditionType::kClosedBoundaries ||
+      bc_type == BoundaryConditionType::kDirichlet;
+  const bool neumann = bc_type == BoundaryConditionType::kNeumann;
+  const bool periodic = bc_type == BoundaryConditionType::kPeriodic;
+
+  const real_t d = 1 - dc_[0];
+  const real_t r = d * dt / (box_length_ * box_length_);
+  // The decay is integrated in the step along x
+  const real_t decay = axis == 0 ? mu_ * dt : 0;
+
+  // Coefficients of the tridiagonal system: lower diagonal (a), diagonal (b)
+  // and upper diagonal (c). Open boundaries assume zero concentration outside
+  // of the grid.
+  std::vector<real_t> a(n, -r);
+  std::vector<real_t> b(n, 1 + 2 * r + decay);
+  std::vector<real_t> c(n, -r);
+  a[0] = 0;
+  c[n - 1] = 0;
+  if (fixed_boundary) {
+    // Boxes on the boundary keep their value
+    b[0] = 1;
+    c[0] = 0;
+    b[n - 1] = 1;
+    a[n - 1] = 0;
+  } else if (neumann) {
+    // Boxes on the boundary have one neighbor less along this axis. The flux
+    // through the boundary is added to the right-hand side.
+    b[0] -= r;
+    b[n - 1] -= r;
+  } else if (periodic && n == 1) {
+    b[0] = 1 + decay;
+  }
+
+  // For periodic boundaries, the corners of the cyclic system are removed
+  // with the Sherman-Morrison formula: A = A' + u * v^T with
+  // u = (gamma, 0, ..., 0, alpha) and v = (1, 0, ..., 0, beta / gamma).
+  const bool cyclic = periodic && n > 1;
+  const real_t alpha = -r;
+  const real_t beta = -r;
+  const real_t gamma = -b[0];
+  if (cyclic) {
+    b[0] -= gamma;
+    b[n - 1] -= alpha * beta / gamma;
+  }
+
+  // Factorization of the Thomas algorithm, which is the same for all lines
+  std::vector<real_t> inv(n);
+  std::vector<real_t> cp(n);
+  inv[0] = 1 / b[0];
+  cp[0] = c[0] * inv[0];
+  for (size_t i = 1; i < n; i++) {
+    inv[i] = 1 / (b[i] - a[i] * cp[i - 1]);
+    cp[i] = c[i] * inv[i];
+  }
+
+  // Solves A' x = rhs in place for `count` lines. Element i of line j is
+  // stored at line[j + i * stride].
+  auto thomas = [&](real_t* line, size_t stride, size_t count) {
+    for (size_t j = 0; j < count; j++) {
+      line[j] *= inv[0];
+    }
+    for (size_t i = 1; i < n; i++) {
+      real_t* __restrict cur = line + i * stride;
+      const real_t* __restrict prev = cur - stride;
+#pragma omp simd
+      for (size_t j = 0; j < count; j++) {
+        cur[j] = (cur[j] - a[i] * prev[j]) * inv[i];
+      }
+    }
+    for (size_t i = n - 1; i > 0; i--) {
+      real_t* __restrict cur = line + (i - 1) * stride;
+      const real_t* __restrict next = cur + stride;
+#pragma omp simd
+      for (size_t j = 0; j < count; j++) {
+        cur[j] -= cp[i - 1] * next[j];
+      }
+    }
+  };
+
+  // Solution of A' z = u for the Sherman-Morrison correction
+  std::vector<real_t> z(n, 0);
+  real_t correction_factor = 0;
+  if (cyclic) {
+    z[0] = gamma;
+    z[n - 1] = alpha;
+    thomas(z.data(), 1, 1);
+    correction_factor = 1 / (1 + z[0] + beta * z[n - 1] / gamma);
+  }
+
+  // Solves A x = rhs in place, see `thomas`
+  auto solve = [&](real_t* line, size_t stride, size_t count) {
+    thomas(line, stride, count);
+    if (cyclic) {
+      for (size_t j = 0; j < count; j++) {
+        real_t f = (line[j] + beta * line[j + (n - 1) * stride] / gamma) *
+                   correction_factor;
+        for (size_t i = 0; i < n; i++) {
+          line[j + i * stride] -= f * z[i];
+        }
+      }
+    }
+  };
+
+  // Adds the flux through the boundary for Neumann boundaries to the first
+  // and last box of the line starting at box (x, y, z)
+  const real_t flux_factor = -r * box_length_;
+  auto add_flux = [&](real_t* line, size_t stride, size_t x, size_t y,
+                      size_t z) {
+    std::array<size_t, 3> first = {x, y, z};
+    std::array<size_t, 3> last = first;
+    last[axis] = n - 1;
+    line[0] += flux_factor * EvaluateBoundary(first[0], first[1], first[2]);
+    line[(n - 1) * stride] +=
+        flux_factor * EvaluateBoundary(last[0], last[1], last[2]);
+  };
+
+  // Lines that lie on the boundary keep their values for closed and Dirichlet
+  // boundaries
+  const size_t x_begin = fixed_boundary ? 1 : 0;
+  const size_t x_end = fixed_boundary ? nx - 1 : nx;
+  const size_t y_begin = fixed_boundary ? 1 : 0;
+  const size_t y_end = fixed_boundary ? ny - 1 : ny;
+  const size_t z_begin = fixed_boundary ? 1 : 0;
+  const size_t z_end = fixed_boundary ? nz - 1 : nz;
+  real_t* c1 = c1_.data();
+
+  if (axis == 0) {
+    // Lines along x are contiguous
+#pragma omp parallel for collapse(2) schedule(static)
+    for (size_t z = z_begin; z < z_end; z++) {
+      for (size_t y = y_begin; y < y_end; y++) {
+        real_t* line = c1 + y * nx + z * nxy;
+        if (neumann) {
+          add_flux(line, 1, 0, y, z);
+        }
+        solve(line, 1, 1);
+      }
+    }
+  } else if (axis == 1) {
+    // All lines along y of a plane are solved together
+#pragma omp parallel for schedule(static)
+    for (size_t z = z_begin; z < z_end; z++) {
+      real_t* line = c1 + z * nxy + x_begin;
+      if (neumann) {
+        for (size_t x = x_begin; x < x_end; x++) {
+          add_flux(line + x - x_begin, nx, x, 0, z);
+        }
+      }
+      solve(line, nx, x_end - x_begin);
+    }
+  } else {
+    // All lines along z with the same y coordinate are solved together
+#pragma omp parallel for schedule(static)
+    for (size_t y = y_begin; y < y_end; y++) {
+      real_t* line = c1 + y * nx + x_begin;
+      if (neumann) {
+        for (size_t x = x_begin; x < x_end; x++) {
+          add_flux(line + x - x_begin, nxy, x, y, 0);
+        }
+      }
+      solve(line, nxy, x_end - x_begin);
+    }
+  }
+}
+
+void ADIGrid::ApplyDirichletBoundary() {
+  const size_t nx = num_boxes_axis_[0];
+  const size_t ny = num_boxes_axis_[1];
+  const size_t nz = num_boxes_axis_[2];
+
+#pragma omp parallel for collapse(2) schedule(static)
+  for (size_t z = 0; z < nz; z++) {
+    for (size_t y = 0; y < ny; y++) {
+      const size_t row = y * nx + z * nx * ny;
+      if (y == 0 || y == ny - 1 || z == 0 || z == nz - 1) {
+        for (size_t x = 0; x < nx; x++) {
+          c1_[row + x] = EvaluateBoundary(x, y, z);
+        }
+      } else {
+        c1_[row] = EvaluateBoundary(0, y, z);
+        c1_[row + nx - 1] = EvaluateBoundary(nx - 1, y, z);
+      }
+    }
+  }
+}
+
+real_t ADIGrid::EvaluateBoundary(size_t x, size_t y, size_t z) const {
+  real_t real_x = grid_dimensions_[0] + x * box_length_;
+  real_t real_y = grid_dimensions_[2] + y * box_length_;
+  real_t real_z = grid_dimensions_[4] + z * box_length_;
+  return boundary_condition_->Evaluate(real_x, real_y, real_z,
+                                       GetSimulatedTime());
+}
+
+}  // namespace bdm
@@ -0,0 +1,86 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN & University of Surrey for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+// See the NOTICE file distributed with this work for additional information
+// regarding copyright ownership.
+//
+// -----------------------------------------------------------------------------
+
+#ifndef CORE_DIFFUSION_ADI_GRID_H_
+#define CORE_DIFFUSION_ADI_GRID_H_
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "core/diffusion/diffusion_grid.h"
+
+namespace bdm {
+
+/** @brief Continuum model for the 3D heat equation with exponential decay
+           \f$ \partial_t u = \nabla D \nabla u - \mu u \f$, integrated with an
+           implicit alternating direction scheme.
+
+  Each time step is split into three one-dimensional steps along x, y and z
+  (locally one-dimensional splitting). Each of them is integrated with the
+  backward (implicit) Euler method, which requires the solution of one
+  tridiagonal system per grid line. The systems are solved with the Thomas
+  algorithm (cyclic systems for periodic boundaries with the Sherman-Morrison
+  formula), and the lines of a direction are solved in parallel. The decay is
+  integrated implicitly in the step along x.
+
+  In contrast to `EulerGrid`, the scheme is unconditionally stable, such that
+  the time step is not limited by the box length. The error scales linearly
+  with the time step and quadratically with the box length. Open boundaries
+  assume zero concentration outside of the grid. Select it with
+  `Param::diffusion_method = "adi"`.
+
+  Further information:
+    - <a href="https://doi.org/10.1093/bioinformatics/btv730">
+      Ghaffarizadeh et al., BioFVM: an efficient, parallelized diffusive
+      transport solver for 3-D biological simulations, 2016</a>
+*/
+class ADIGrid : public DiffusionGrid {
+ public:
+  ADIGrid() = default;
+  ADIGrid(int substance_id, std::string substance_name, real_t dc, real_t mu,
+          int resolution = 10)
+      : DiffusionGrid(substance_id, std::move(substance_name), dc, mu,
+                      resolution) {}
+
+  void DiffuseWithClosedEdge(real_t dt) override;
+  void DiffuseWithOpenEdge(real_t dt) override;
+  void DiffuseWithDirichlet(real_t dt) override;
+  void DiffuseWithNeumann(real_t dt) override;
+  void DiffuseWithPeriodic(real_t dt) override;
+
+ private:
+  /// The implicit scheme is unconditionally stable. Thus, there is no
+  /// restriction on `dt`.
+  void ParametersCheck(real_t dt) override {}
+
+  /// Integrates the grid by `dt` with one implicit step along each axis.
+  void DiffuseImplicitly(BoundaryConditionType bc_type, real_t dt);
+
+  /// Solves the tridiagonal systems of all lines along `axis` in place.
+  void SolveAxis(int axis, BoundaryConditionType bc_type, real_t dt);
+
+  /// Sets the boxes on the boundary to the value of the Dirichlet boundary
+  /// condition.
+  void ApplyDirichletBoundary();
+
+  /// Returns the value of the boundary condition at box (x, y, z).
+  real_t EvaluateBoundary(size_t x, size_t y, size_t z) const;
+
+  BDM_CLASS_DEF_OVERRIDE(ADIGrid, 1);
+};
+
+}  // namespace bdm
+
+#endif  // CORE_DIFFUSION_ADI_GRID_H_
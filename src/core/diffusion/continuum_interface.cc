@@ -20,14 +20,30 @@
 namespace bdm {
 
 void Continuum::IntegrateTimeAsynchronously(real_t dt) {
+  int n_steps{0};
+  real_t step{0};
+  GetIntegrationSteps(dt, &n_steps, &step);
+  // Simulate for the appropriate number of time steps
+  MultiStep(step, n_steps);
+  FinishIntegration(dt, n_steps);
+}
+
+void Continuum::MultiStep(real_t dt, int n_steps) {
+  for (int i = 0; i < n_steps; i++) {
+    Step(dt);
+  }
+}
+
+void Continuum::GetIntegrationSteps(real_t dt, int *n_steps,
+                                    real_t *step) const {
   if (time_step_ != std::numeric_limits<real_t>::max()) {
-    // Update the total time to simulate
-    time_to_simulate_ += dt;
+    // Compute the total time to simulate
+    real_t time_to_simulate = time_to_simulate_ + dt;
     // Compute the number of time steps to simulate
-    auto n_steps = static_cast<int>(std::floor(time_to_simulate_ / time_step_));
+    *n_steps = static_cast<int>(std::floor(time_to_simulate / time_step_));
     // Treat numerical instabilities. E.g. if time_to_simulate_ = 0.19999999999
     // and time_step_ = 0.1, n_steps = 1, but we want n_steps = 2.
-    double left_over = time_to_simulate_ - (n_steps + 1) * time_step_;
+    double left_over = time_to_simulate - (*n_steps + 1) * time_step_;
     double absolute_tolerance = 0;
     if (sizeof(real_t) == 8) {
       // for double precision
@@ -37,20 +53,25 @@ void Continuum::IntegrateTimeAsynchronously(real_t dt) {
       absolute_tolerance = 1e-8;
     }
     if (left_over < 0 && left_over > -absolute_tolerance) {
-      n_steps++;
-    }
-    // Simulate for the appropriate number of time steps
-    for (int i = 0; i < n_steps; i++) {
-      Step(time_step_);
+      (*n_steps)++;
     }
+    *step = time_step_;
+  } else {
+    // If time_step_ is not set, we simply forward the time step to the Step
+    // method.
+    *n_steps = 1;
+    *step = dt;
+  }
+}
+
+void Continuum::FinishIntegration(real_t dt, int n_steps) {
+  if (time_step_ != std::numeric_limits<real_t>::max()) {
     // Update the total simulated time
     simulated_time_ += n_steps * time_step_;
     // Keep track of time that has not been simulated yet
+    time_to_simulate_ += dt;
     time_to_simulate_ -= n_steps * time_step_;
   } else {
-    // If time_step_ is not set, we simply forward the time step to the Step
-    // method.
-    Step(dt);
     simulated_time_ += dt;
   }
 }
@@ -107,6 +107,22 @@ class Continuum {
   /// Returns the time step for the continuum.
   real_t GetTimeStep() const;
 
+ protected:
+  /// Determines the number of calls to `Step` (`n_steps`) and their time step
+  /// (`step`) that are required to integrate the continuum by `dt`. Does not
+  /// modify the continuum. Allows implementations to integrate several continua
+  /// together (see `EulerGrid::IntegrateTimeFused`).
+  void GetIntegrationSteps(real_t dt, int *n_steps, real_t *step) const;
+
+  /// Updates the simulated time after the continuum has been integrated by
+  /// `dt` with the steps returned by `GetIntegrationSteps`.
+  void FinishIntegration(real_t dt, int n_steps);
+
+  /// Calls `Step` `n_steps` times with time step `dt`. Implementations may
+  /// override this method to advance several time steps at once (see
+  /// `EulerGrid::MultiStep`), but must produce the same result.
+  virtual void MultiStep(real_t dt, int n_steps);
+
  private:
   /// Name of the continuum.
   std::string continuum_name_ = "";
@@ -12,6 +12,7 @@
 //
 // -----------------------------------------------------------------------------
 
+#include <unistd.h>
 #include <algorithm>
 #include <mutex>
 
@@ -19,6 +20,9 @@
 #include "core/environment/environment.h"
 #include "core/simulation.h"
 #include "core/util/log.h"
+#include "core/util/numa.h"
+#include "core/util/partition.h"
+#include "core/util/thread_info.h"
 
 namespace bdm {
 
@@ -81,21 +85,30 @@ void DiffusionGrid::Initialize() {
                "')");
   }
 
-  // Get neighbor grid dimensions
-  auto* env = Simulation::GetActive()->GetEnvironment();
-  auto bounds = env->GetDimensionThresholds();
+  if (!custom_domain_) {
+    // Get neighbor grid dimensions
+    auto* env = Simulation::GetActive()->GetEnvironment();
+    auto bounds = env->GetDimensionThresholds();
+    grid_dimensions_ = {bounds[0], bounds[1], bounds[0],
+                        bounds[1], bounds[0], bounds[1]};
+  }
 
-  grid_dimensions_ = {bounds[0], bounds[1]};
-  if (bounds[0] > bounds[1]) {
-    Log::Fatal("DiffusionGrid::Initialize",
-               "The grid dimensions are not correct. Lower bound is greater",
-               " than upper bound. (substance '", GetContinuumName(), "')");
+  int32_t max_length = 0;
+  for (int i = 0; i < 3; i++) {
+    if (grid_dimensions_[2 * i] > grid_dimensions_[2 * i + 1]) {
+      Log::Fatal("DiffusionGrid::Initialize",
+                 "The grid dimensions are not correct. Lower bound is greater",
+                 " than upper bound. (substance '", GetContinuumName(), "')");
+    }
+    int32_t length = grid_dimensions_[2 * i + 1] - grid_dimensions_[2 * i];
+    max_length = std::max(max_length, length);
   }
 
+  // The boxes are cubic. The resolution determines the number of boxes along
+  // the longest axis.
   auto adjusted_res =
       resolution_ == 1 ? 2 : resolution_;  // avoid division by 0
-  box_length_ = (grid_dimensions_[1] - grid_dimensions_[0]) /
-                static_cast<real_t>(adjusted_res);
+  box_length_ = max_length / static_cast<real_t>(adjusted_res);
 
   // Check if box length is not too small
   if (box_length_ <= 1e-13) {
@@ -106,14 +119,23 @@ void DiffusionGrid::Initialize() {
   }
 
   box_volume_ = box_length_ * box_length_ * box_length_;
-  parity_ = resolution_ % 2;
-  total_num_boxes_ = resolution_ * resolution_ * resolution_;
+  for (int i = 0; i < 3; i++) {
+    // Shorter axes are covered with the smallest number of boxes that spans
+    // their length (integer arithmetic to avoid rounding errors), but with at
+    // least two boxes, such that each box has a neighbor along each axis.
+    size_t length = grid_dimensions_[2 * i + 1] - grid_dimensions_[2 * i];
+    size_t num_boxes = (length * adjusted_res + max_length - 1) / max_length;
+    num_boxes_axis_[i] = std::min(resolution_, std::max(size_t{2}, num_boxes));
+  }
+  total_num_boxes_ =
+      num_boxes_axis_[0] * num_boxes_axis_[1] * num_boxes_axis_[2];
 
   // Allocate memory for the concentration and gradient arrays
   locks_.resize(total_num_boxes_);
   c1_.resize(total_num_boxes_);
   c2_.resize(total_num_boxes_);
   gradients_.resize(total_num_boxes_);
+  PlaceSlabsOnNumaNodes();
 
   // Print Info
   initialized_ = true;
@@ -154,45 +176,57 @@ void DiffusionGrid::Diffuse(real_t dt) {
 }
 
 void DiffusionGrid::Update() {
+  // A domain set with SetDomain does not follow the environment
+  if (custom_domain_) {
+    return;
+  }
+
   // Get neighbor grid dimensions
   auto* env = Simulation::GetActive()->GetEnvironment();
   auto bounds = env->GetDimensionThresholds();
   // Update the grid dimensions such that each dimension ranges from
   // {bounds[0] - bounds[1]}
-  grid_dimensions_ = {bounds[0], bounds[1]};
+  grid_dimensions_ = {bounds[0], bounds[1], bounds[0],
+                      bounds[1], bounds[0], bounds[1]};
+
+  // Store the old number of boxes along each axis for comparison
+  auto old_num_boxes = num_boxes_axis_;
+  bool grown = false;
 
-  // If the grid is not perfectly divisible along each dimension by the
-  // box length, extend the grid so that it is
   int dimension_length = bounds[1] - bounds[0];
-  for (int i = 0; i < 1; i++) {
+  for (int i = 0; i < 3; i++) {
+    // If the grid is not perfectly divisible along each dimension by the
+    // box length, extend the grid so that it is
     int r = fmod(dimension_length, box_length_);
     if (r > 1e-9) {
       // std::abs for the case that box_length_ > dimension_length
       grid_dimensions_[2 * i + 1] += (box_length_ - r);
     }
-  }
-
-  // Calculate new_dimension_length and new_resolution
-  int new_dimension_length = grid_dimensions_[1] - grid_dimensions_[0];
-  size_t new_resolution = std::ceil(new_dimension_length / box_length_);
-
-  if (new_resolution > resolution_) {
-    // Store the old number of boxes along each axis for comparison
-    size_t tmp_resolution = resolution_;
-
-    // Set new resolution
-    resolution_ = new_resolution;
 
-    // We need to maintain the parity of the number of boxes along each
-    // dimension, otherwise copying of the substances to the increases grid
-    // will not be symmetrically done; resulting in shifting of boxes
-    // We add a box in the negative direction, because the only way the parity
-    // could have changed is because of adding a box in the positive direction
-    // (due to the grid not being perfectly divisible; see above)
-    if (resolution_ % 2 != parity_) {
-      grid_dimensions_[0] -= box_length_;
-      resolution_++;
+    // Calculate new_dimension_length and new number of boxes
+    int new_dimension_length =
+        grid_dimensions_[2 * i + 1] - grid_dimensions_[2 * i];
+    size_t new_num_boxes = std::ceil(new_dimension_length / box_length_);
+
+    if (new_num_boxes > num_boxes_axis_[i]) {
+      // We need to maintain the parity of the number of boxes along each
+      // dimension, otherwise copying of the substances to the increases grid
+      // will not be symmetrically done; resulting in shifting of boxes
+      // We add a box in the negative direction, because the only way the
+      // parity could have changed is because of adding a box in the positive
+      // direction (due to the grid not being perfectly divisible; see above)
+      if (new_num_boxes % 2 != num_boxes_axis_[i] % 2) {
+        grid_dimensions_[2 * i] -= box_length_;
+        new_num_boxes++;
+      }
+      num_boxes_axis_[i] = new_num_boxes;
+      grown = true;
     }
+  }
+
+  if (grown) {
+    resolution_ = *std::max_element(num_boxes_axis_.begin(),
+                                    num_boxes_axis_.end());
 
     // Temporarily save previous grid data
     auto tmp_c1 = c1_;
@@ -202,20 +236,23 @@ void DiffusionGrid::Update() {
     c2_.clear();
     gradients_.clear();
 
-    total_num_boxes_ = resolution_ * resolution_ * resolution_;
+    total_num_boxes_ =
+        num_boxes_axis_[0] * num_boxes_axis_[1] * num_boxes_axis_[2];
 
-    CopyOldData(tmp_c1, tmp_gradients, tmp_resolution);
+    CopyOldData(tmp_c1, tmp_gradients, old_num_boxes);
   }
 }
 
 void DiffusionGrid::CopyOldData(
     const ParallelResizeVector<real_t>& old_c1,
-    const ParallelResizeVector<Real3>& old_gradients, size_t old_resolution) {
+    const ParallelResizeVector<Real3>& old_gradients,
+    const std::array<size_t, 3>& old_num_boxes) {
   // Allocate more memory for the grid data arrays
   locks_.resize(total_num_boxes_);
   c1_.resize(total_num_boxes_);
   c2_.resize(total_num_boxes_);
   gradients_.resize(total_num_boxes_);
+  PlaceSlabsOnNumaNodes();
 
   Log::Warning(
       "DiffusionGrid::CopyOldData",
@@ -227,20 +264,24 @@ void DiffusionGrid::CopyOldData(
       "grid values are mostly zero this is likely to work fine. Evaluate your "
       "results carefully.");
 
-  auto incr_num_boxes = resolution_ - old_resolution;
-  int off_dim = incr_num_boxes / 2;
+  std::array<size_t, 3> off_dim;
+  for (int i = 0; i < 3; i++) {
+    off_dim[i] = (num_boxes_axis_[i] - old_num_boxes[i]) / 2;
+  }
 
-  int num_box_xy = resolution_ * resolution_;
-  int old_box_xy = old_resolution * old_resolution;
-  int new_origin = off_dim * num_box_xy + off_dim * resolution_ + off_dim;
-  for (size_t k = 0; k < old_resolution; k++) {
-    int offset = new_origin + k * num_box_xy;
-    for (size_t j = 0; j < old_resolution; j++) {
+  size_t num_box_x = num_boxes_axis_[0];
+  size_t num_box_xy = num_boxes_axis_[0] * num_boxes_axis_[1];
+  size_t old_box_xy = old_num_boxes[0] * old_num_boxes[1];
+  size_t new_origin =
+      off_dim[2] * num_box_xy + off_dim[1] * num_box_x + off_dim[0];
+  for (size_t k = 0; k < old_num_boxes[2]; k++) {
+    size_t offset = new_origin + k * num_box_xy;
+    for (size_t j = 0; j < old_num_boxes[1]; j++) {
       if (j != 0) {
-        offset += resolution_;
+        offset += num_box_x;
       }
-      for (size_t i = 0; i < old_resolution; i++) {
-        auto idx = k * old_box_xy + j * old_resolution + i;
+      for (size_t i = 0; i < old_num_boxes[0]; i++) {
+        auto idx = k * old_box_xy + j * old_num_boxes[0] + i;
         c1_[offset + i] = old_c1[idx];
         gradients_[offset + i] = old_gradients[idx];
       }
@@ -250,6 +291,82 @@ void DiffusionGrid::CopyOldData(
   // equivalent once we introduce non-zero halos.
 }
 
+void DiffusionGrid::GetNumaSlab(int numa_node, size_t* start,
+                                size_t* end) const {
+  auto* tinfo = ThreadInfo::GetInstance();
+  const size_t num_rows = num_boxes_axis_[1] * num_boxes_axis_[2];
+  const size_t max_threads = tinfo->GetMaxThreads();
+  size_t threads_before = 0;
+  for (int n = 0; n < numa_node; n++) {
+    threads_before += tinfo->GetThreadsInNumaNode(n);
+  }
+  size_t threads = tinfo->GetThreadsInNumaNode(numa_node);
+  *start = num_rows * threads_before / max_threads;
+  *end = num_rows * (threads_before + threads) / max_threads;
+}
+
+void DiffusionGrid::GetThreadRows(size_t* start, size_t* end) const {
+  auto* tinfo = ThreadInfo::GetInstance();
+  const int num_threads = omp_get_num_threads();
+  if (num_threads != tinfo->GetMaxThreads()) {
+    // Not all threads participate. Distribute the rows evenly.
+    const size_t num_rows = num_boxes_axis_[1] * num_boxes_axis_[2];
+    Partition(num_rows, num_threads, omp_get_thread_num(), start, end);
+    return;
+  }
+  size_t slab_start = 0;
+  size_t slab_end = 0;
+  GetNumaSlab(tinfo->GetMyNumaNode(), &slab_start, &slab_end);
+  Partition(slab_end - slab_start,
+            tinfo->GetThreadsInNumaNode(tinfo->GetMyNumaNode()),
+            tinfo->GetMyNumaThreadId(), start, end);
+  *start = std::min(*start + slab_start, slab_end);
+  *end = std::min(*end + slab_start, slab_end);
+}
+
+void DiffusionGrid::PlaceSlabsOnNumaNodes() {
+  const int numa_nodes = ThreadInfo::GetInstance()->GetNumaNodes();
+  if (numa_nodes == 1 || total_num_boxes_ == 0) {
+    return;
+  }
+  static const uintptr_t kPageSize = sysconf(_SC_PAGESIZE);
+  const size_t nx = num_boxes_axis_[0];
+  // Moves each page of `data` to the node of the slab that contains the
+  // first byte of the page.
+  auto move_pages = [&](auto* data) {
+    std::vector<void*> pages;
+    std::vector<int> nodes;
+    for (int n = 0; n < numa_nodes; n++) {
+      size_t start = 0;
+      size_t end = 0;
+      GetNumaSlab(n, &start, &end);
+      if (start == end) {
+        continue;
+      }
+      auto first = reinterpret_cast<uintptr_t>(data + start * nx);
+      auto last = reinterpret_cast<uintptr_t>(data + end * nx);
+      auto page = first / kPageSize * kPageSize;
+      if (start != 0 && page != first) {
+        page += kPageSize;
+      }
+      for (; page < last; page += kPageSize) {
+        pages.push_back(reinterpret_cast<void*>(page));
+        nodes.push_back(n);
+      }
+    }
+    if (pages.empty()) {
+      return;
+    }
+    std::vector<int> status(pages.size());
+    numa_move_pages(0, pages.size(), pages.data(), nodes.data(),
+                    status.data(), MPOL_MF_MOVE);
+  };
+  move_pages(c1_.data());
+  move_pages(c2_.data());
+  move_pages(gradients_.data());
+  move_pages(locks_.data());
+}
+
 void DiffusionGrid::RunInitializers() {
   // If there are no initializers, we don't need to do anything and can return
   // immediately
@@ -259,7 +376,7 @@ void DiffusionGrid::RunInitializers() {
 
   // Define variables for loop bounds & boundary condition check
   const auto kNumBoxes = total_num_boxes_;
-  const auto kGridSize = resolution_;
+  const auto kGridSize = num_boxes_axis_;
   // For certain boudaries, we also need to copy the values to the c2_ array
   const bool kCopyToC2 =
       (bc_type_ == BoundaryConditionType::kDirichlet ||
@@ -276,7 +393,7 @@ void DiffusionGrid::RunInitializers() {
     std::array<real_t, 3> real_coord;
 #pragma omp simd
     for (size_t i = 0; i < 3; i++) {
-      real_coord[i] = grid_dimensions_[0] +
+      real_coord[i] = grid_dimensions_[2 * i] +
                       static_cast<real_t>(box_coord[i]) * box_length_ +
                       box_length_ / 2.0;
     }
@@ -284,9 +401,9 @@ void DiffusionGrid::RunInitializers() {
     // Calculate the value of the substance in the box
     real_t value{0};
     if (bc_type_ == BoundaryConditionType::kDirichlet &&
-        (box_coord[0] == 0 || box_coord[0] == kGridSize - 1 ||
-         box_coord[1] == 0 || box_coord[1] == kGridSize - 1 ||
-         box_coord[2] == 0 || box_coord[2] == kGridSize - 1)) {
+        (box_coord[0] == 0 || box_coord[0] == kGridSize[0] - 1 ||
+         box_coord[1] == 0 || box_coord[1] == kGridSize[1] - 1 ||
+         box_coord[2] == 0 || box_coord[2] == kGridSize[2] - 1)) {
       // Evaluate the boundary condition in case of Dirichlet boundary
       value = boundary_condition_->Evaluate(real_coord[0], real_coord[1],
                                             real_coord[2], 0);
@@ -325,11 +442,19 @@ void DiffusionGrid::CalculateGradient() {
     return;
   }
 
-#pragma omp parallel for collapse(2)
-  for (uint32_t z = 0; z < resolution_; z++) {
-    for (uint32_t y = 0; y < resolution_; y++) {
-      for (uint32_t x = 0; x < resolution_; x++) {
-        size_t idx = x + y * resolution_ + z * resolution_ * resolution_;
+  const size_t nx = num_boxes_axis_[0];
+  const size_t ny = num_boxes_axis_[1];
+  // Each thread processes rows of the slab of its NUMA node
+#pragma omp parallel
+  {
+    size_t start = 0;
+    size_t end = 0;
+    GetThreadRows(&start, &end);
+    for (size_t row = start; row < end; row++) {
+      const auto y = static_cast<uint32_t>(row % ny);
+      const auto z = static_cast<uint32_t>(row / ny);
+      for (uint32_t x = 0; x < nx; x++) {
+        size_t idx = x + y * nx + z * nx * ny;
         const std::array<uint32_t, 3> box_coord = {x, y, z};
         // Get the neighboring boxes
         const auto neighbors = GetNeighboringBoxes(idx, box_coord);
@@ -467,17 +592,17 @@ std::array<uint32_t, 3> DiffusionGrid::GetBoxCoordinates(
   for (size_t i = 0; i < 3; i++) {
 // Check if position is within boundaries
 #ifndef NDEBUG
-    assert((position[i] >= grid_dimensions_[0]) &&
+    assert((position[i] >= grid_dimensions_[2 * i]) &&
            "You tried to get the box coordinates outside the bounds of the "
            "diffusion grid!");
-    assert((position[i] <= grid_dimensions_[1]) &&
+    assert((position[i] <= grid_dimensions_[2 * i + 1]) &&
            "You tried to get the box coordinates outside the bounds of the "
            "diffusion grid!");
 #endif  // NDEBUG
     // Get box coords (Note: conversion to uint32_t should be save for typical
     // grid sizes)
     box_coord[i] = static_cast<uint32_t>(
-        std::floor((position[i] - grid_dimensions_[0]) / box_length_));
+        std::floor((position[i] - grid_dimensions_[2 * i]) / box_length_));
   }
   return box_coord;
 }
@@ -487,17 +612,20 @@ std::array<uint32_t, 3> DiffusionGrid::GetBoxCoordinates(
   // Resolution must be smaller than uint32_t max for the box coordinates to be
   // representable
   assert(resolution_ < std::numeric_limits<uint32_t>::max());
+  const size_t nx = num_boxes_axis_[0];
+  const size_t ny = num_boxes_axis_[1];
   std::array<uint32_t, 3> box_coord;
-  box_coord[0] = static_cast<uint32_t>(idx % resolution_);
-  box_coord[1] = static_cast<uint32_t>((idx / resolution_) % resolution_);
-  box_coord[2] = static_cast<uint32_t>(idx / (resolution_ * resolution_));
+  box_coord[0] = static_cast<uint32_t>(idx % nx);
+  box_coord[1] = static_cast<uint32_t>((idx / nx) % ny);
+  box_coord[2] = static_cast<uint32_t>(idx / (nx * ny));
   return box_coord;
 }
 
 size_t DiffusionGrid::GetBoxIndex(
     const std::array<uint32_t, 3>& box_coord) const {
-  size_t ret = box_coord[2] * resolution_ * resolution_ +
-               box_coord[1] * resolution_ + box_coord[0];
+  const size_t nx = num_boxes_axis_[0];
+  const size_t ny = num_boxes_axis_[1];
+  size_t ret = box_coord[2] * nx * ny + box_coord[1] * nx + box_coord[0];
   return ret;
 }
 
@@ -514,20 +642,30 @@ std::array<size_t, 6> DiffusionGrid::GetNeighboringBoxes(size_t index) const {
 
 std::array<size_t, 6> DiffusionGrid::GetNeighboringBoxes(
     size_t index, const std::array<uint32_t, 3>& box_coord) const {
+  const size_t nx = num_boxes_axis_[0];
+  const size_t ny = num_boxes_axis_[1];
+  const size_t nz = num_boxes_axis_[2];
   std::array<size_t, 6> neighbors;
   neighbors[0] = (box_coord[0] == 0) ? index : index - 1;
-  neighbors[1] = (box_coord[0] == resolution_ - 1) ? index : index + 1;
-  neighbors[2] = (box_coord[1] == 0) ? index : index - resolution_;
-  neighbors[3] =
-      (box_coord[1] == resolution_ - 1) ? index : index + resolution_;
-  neighbors[4] =
-      (box_coord[2] == 0) ? index : index - resolution_ * resolution_;
-  neighbors[5] = (box_coord[2] == resolution_ - 1)
-                     ? index
-                     : index + resolution_ * resolution_;
+  neighbors[1] = (box_coord[0] == nx - 1) ? index : index + 1;
+  neighbors[2] = (box_coord[1] == 0) ? index : index - nx;
+  neighbors[3] = (box_coord[1] == ny - 1) ? index : index + nx;
+  neighbors[4] = (box_coord[2] == 0) ? index : index - nx * ny;
+  neighbors[5] = (box_coord[2] == nz - 1) ? index : index + nx * ny;
   return neighbors;
 }
 
+void DiffusionGrid::SetDomain(const std::array<int32_t, 6>& domain) {
+  if (initialized_) {
+    Log::Fatal("DiffusionGrid::SetDomain",
+               "The domain must be set before the grid is initialized. "
+               "(substance '",
+               GetContinuumName(), "')");
+  }
+  grid_dimensions_ = domain;
+  custom_domain_ = true;
+}
+
 void DiffusionGrid::SetBoundaryCondition(
     std::unique_ptr<BoundaryCondition> bc) {
   boundary_condition_ = std::move(bc);
@@ -571,7 +709,7 @@ void DiffusionGrid::PrintInfo(std::ostream& out) {
   auto domain = GetDimensions();
   auto umin = GetLowerThreshold();
   auto umax = GetUpperThreshold();
-  auto resolution = GetResolution();
+  auto num_boxes_axis = GetNumBoxesArray();
   auto num_boxes = GetNumBoxes();
 
   // Print the info
@@ -584,8 +722,8 @@ void DiffusionGrid::PrintInfo(std::ostream& out) {
   out << "    domain     : "
       << "[" << domain[0] << ", " << domain[1] << "] x [" << domain[2] << ", "
       << domain[3] << "] x [" << domain[4] << ", " << domain[5] << "]\n";
-  out << "    resolution : " << resolution << " x " << resolution << " x "
-      << resolution << "\n";
+  out << "    resolution : " << num_boxes_axis[0] << " x " << num_boxes_axis[1]
+      << " x " << num_boxes_axis[2] << "\n";
   out << "    num boxes  : " << num_boxes << "\n";
   out << "    boundary   : " << BoundaryTypeToString(bc_type_) << "\n";
 };
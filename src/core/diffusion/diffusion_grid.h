@@ -257,13 +257,7 @@ class DiffusionGrid : public ScalarField {
 
   const real_t* GetAllGradients() const { return gradients_.data()->data(); }
 
-  std::array<size_t, 3> GetNumBoxesArray() const {
-    std::array<size_t, 3> ret;
-    ret[0] = resolution_;
-    ret[1] = resolution_;
-    ret[2] = resolution_;
-    return ret;
-  }
+  std::array<size_t, 3> GetNumBoxesArray() const { return num_boxes_axis_; }
 
   size_t GetNumBoxes() const { return total_num_boxes_; }
 
@@ -282,27 +276,29 @@ class DiffusionGrid : public ScalarField {
 
   const int32_t* GetDimensionsPtr() const { return grid_dimensions_.data(); }
 
-  std::array<int32_t, 6> GetDimensions() const {
-    std::array<int32_t, 6> ret;
-    ret[0] = grid_dimensions_[0];
-    ret[1] = grid_dimensions_[1];
-    ret[2] = grid_dimensions_[0];
-    ret[3] = grid_dimensions_[1];
-    ret[4] = grid_dimensions_[0];
-    ret[5] = grid_dimensions_[1];
-    return ret;
-  }
+  std::array<int32_t, 6> GetDimensions() const { return grid_dimensions_; }
 
   std::array<int32_t, 3> GetGridSize() const {
     std::array<int32_t, 3> ret;
     ret[0] = grid_dimensions_[1] - grid_dimensions_[0];
-    ret[1] = grid_dimensions_[1] - grid_dimensions_[0];
-    ret[2] = grid_dimensions_[1] - grid_dimensions_[0];
+    ret[1] = grid_dimensions_[3] - grid_dimensions_[2];
+    ret[2] = grid_dimensions_[5] - grid_dimensions_[4];
     return ret;
   }
 
+  /// Sets the domain of the diffusion grid {xmin, xmax, ymin, ymax, zmin,
+  /// zmax}. By default, the diffusion grid spans the cube given by the
+  /// dimension thresholds of the environment and grows with it. A domain set
+  /// with this method is fixed, such that e.g. flat domains only allocate the
+  /// boxes that they need. The boxes remain cubic: the resolution determines
+  /// the number of boxes along the longest axis. Must be called before the
+  /// grid is initialized.
+  void SetDomain(const std::array<int32_t, 6>& domain);
+
   const std::array<real_t, 7>& GetDiffusionCoefficients() const { return dc_; }
 
+  /// Returns the number of boxes along the longest axis. See
+  /// `GetNumBoxesArray` for the number of boxes along each axis.
   size_t GetResolution() const { return resolution_; }
 
   real_t GetBoxVolume() const { return box_volume_; }
@@ -349,11 +345,14 @@ class DiffusionGrid : public ScalarField {
   void TurnOffGradientCalculation() { precompute_gradients_ = false; }
 
  private:
+  friend class ADIGrid;
   friend class EulerGrid;
   friend class EulerDepletionGrid;
   friend class TestGrid;  // class used for testing (e.g. initialization)
+  friend class SimulationBackup;
 
-  void ParametersCheck(real_t dt);
+  /// Checks if the numerical scheme is stable for the time step `dt`.
+  virtual void ParametersCheck(real_t dt);
 
   /// Copies the concentration and gradients values to the new
   /// (larger) grid. In the 2D case it looks like the following:
@@ -369,7 +368,25 @@ class DiffusionGrid : public ScalarField {
   ///
   void CopyOldData(const ParallelResizeVector<real_t>& old_c1,
                    const ParallelResizeVector<Real3>& old_gradients,
-                   size_t old_resolution);
+                   const std::array<size_t, 3>& old_num_boxes);
+
+  /// Returns the slab of rows [start, end) of `numa_node`. Row `r` contains
+  /// the boxes with y = r % ny and z = r / ny. The rows are distributed
+  /// among the NUMA nodes proportionally to their number of threads. Thus,
+  /// each node owns a contiguous part of the grid data arrays.
+  /// Accesses from agents (e.g. `ChangeConcentrationBy`, `GetValue`) are not
+  /// redirected. They use the slab that contains the agent's position,
+  /// independent of the NUMA node of the calling thread.
+  void GetNumaSlab(int numa_node, size_t* start, size_t* end) const;
+
+  /// Returns the rows [start, end) that the calling thread processes inside
+  /// of a parallel region. Each thread processes a part of the slab of its
+  /// NUMA node (see `GetNumaSlab`).
+  void GetThreadRows(size_t* start, size_t* end) const;
+
+  /// Moves the memory of each slab of the grid data to its NUMA node (see
+  /// `GetNumaSlab`). Has no effect on systems with a single NUMA node.
+  void PlaceSlabsOnNumaNodes();
 
   /// The side length of each box
   real_t box_length_ = 0;
@@ -392,19 +409,21 @@ class DiffusionGrid : public ScalarField {
   std::array<real_t, 7> dc_ = {{0}};
   /// The decay constant
   real_t mu_ = 0;
-  /// The grid dimensions of the diffusion grid (cubic shaped)
-  std::array<int32_t, 2> grid_dimensions_ = {{0}};
-  /// The number of boxes at each axis [x, y, z] (same along each axis)
-  uint64_t num_boxes_axis_ = 0;
+  /// The grid dimensions of the diffusion grid
+  /// {xmin, xmax, ymin, ymax, zmin, zmax}
+  std::array<int32_t, 6> grid_dimensions_ = {{0}};
+  /// The number of boxes at each axis [x, y, z]
+  std::array<size_t, 3> num_boxes_axis_ = {{0}};
   /// The total number of boxes in the diffusion grid
   size_t total_num_boxes_ = 0;
-  /// The resolution of the diffusion grid (i.e. number of boxes along each
-  /// axis)
+  /// The resolution of the diffusion grid (i.e. number of boxes along the
+  /// longest axis)
   size_t resolution_ = 0;
   /// The last timestep `dt` used for the diffusion grid update `Diffuse(dt)`
   real_t last_dt_ = 0.0;
-  /// If false, grid dimensions are even; if true, they are odd
-  bool parity_ = false;
+  /// If true, the domain was set with `SetDomain` and does not follow the
+  /// environment
+  bool custom_domain_ = false;
   /// A list of functions that initialize this diffusion grid
   /// ROOT currently doesn't support IO of std::function
   std::vector<std::function<real_t(real_t, real_t, real_t)>> initializers_ =
@@ -424,7 +443,7 @@ class DiffusionGrid : public ScalarField {
   /// are used but the gradient is only needed for one of them.)
   bool precompute_gradients_ = true;
 
-  BDM_CLASS_DEF_OVERRIDE(DiffusionGrid, 1);
+  BDM_CLASS_DEF_OVERRIDE(DiffusionGrid, 2);
 };
 
 }  // namespace bdm
@@ -36,16 +36,18 @@ void EulerDepletionGrid::ApplyDepletion(real_t dt) {
       continue;
     }
 
-    size_t depleting_boxes =
-        rm->GetDiffusionGrid(binding_substances_[s])->GetNumBoxes();
+    // Both grids must have the same number of boxes along each axis, such
+    // that a box index refers to the same box coordinates in both grids
+    auto depleting_boxes =
+        rm->GetDiffusionGrid(binding_substances_[s])->GetNumBoxesArray();
 
-    if (depleting_boxes != GetNumBoxes()) {
+    if (depleting_boxes != GetNumBoxesArray()) {
       Log::Fatal(
           "EulerDepletionGrid::ApplyDepletion()",
           "The number of voxels of the depleting diffusion grid ",
           rm->GetDiffusionGrid(binding_substances_[s])->GetContinuumName(),
           " differs from that of the depleted one (", GetContinuumName(),
-          "). Check the resolution.");
+          "). Check the resolution and the domain.");
     } else {
       auto* depleting_concentration =
           rm->GetDiffusionGrid(binding_substances_[s])->GetAllConcentrations();
@@ -13,357 +13,540 @@
 // -----------------------------------------------------------------------------
 
 #include "core/diffusion/euler_grid.h"
+#include <algorithm>
+#include <typeinfo>
 #include "core/resource_manager.h"
 #include "core/simulation.h"
 
 namespace bdm {
 
 void EulerGrid::DiffuseWithClosedEdge(real_t dt) {
-  const auto nx = resolution_;
-  const auto ny = resolution_;
-  const auto nz = resolution_;
+  Sweep({this}, BoundaryConditionType::kClosedBoundaries, dt);
+}
 
-  const real_t ibl2 = 1 / (box_length_ * box_length_);
-  const real_t d = 1 - dc_[0];
+void EulerGrid::DiffuseWithOpenEdge(real_t dt) {
+  Sweep({this}, BoundaryConditionType::kOpenBoundaries, dt);
+}
 
-  constexpr size_t YBF = 16;
-#pragma omp parallel for collapse(2)
-  for (size_t yy = 0; yy < ny; yy += YBF) {
-    for (size_t z = 0; z < nz; z++) {
-      size_t ymax = yy + YBF;
-      if (ymax >= ny) {
-        ymax = ny;
-      }
-      for (size_t y = yy; y < ymax; y++) {
-        size_t x{0};
-        size_t c{0};
-        size_t n{0};
-        size_t s{0};
-        size_t b{0};
-        size_t t{0};
-        c = x + y * nx + z * nx * ny;
-#pragma omp simd
-        for (x = 1; x < nx - 1; x++) {
-          ++c;
+void EulerGrid::DiffuseWithDirichlet(real_t dt) {
+  Sweep({this}, BoundaryConditionType::kDirichlet, dt);
+}
 
-          if (y == 0 || y == (ny - 1) || z == 0 || z == (nz - 1)) {
-            continue;
-          }
+void EulerGrid::DiffuseWithNeumann(real_t dt) {
+  Sweep({this}, BoundaryConditionType::kNeumann, dt);
+}
 
-          n = c - nx;
-          s = c + nx;
-          b = c - nx * ny;
-          t = c + nx * ny;
+void EulerGrid::DiffuseWithPeriodic(real_t dt) {
+  Sweep({this}, BoundaryConditionType::kPeriodic, dt);
+}
 
-          c2_[c] = c1_[c] * (1 - mu_ * dt) +
-                   (d * dt * ibl2) *
-                       (c1_[c - 1] - 2 * c1_[c] + c1_[c + 1] + c1_[s] -
-                        2 * c1_[c] + c1_[n] + c1_[b] - 2 * c1_[c] + c1_[t]);
-        }
-      }  // tile ny
-    }    // tile nz
-  }      // block ny
-  c1_.swap(c2_);
+void EulerGrid::IntegrateTimeFused(const std::vector<EulerGrid*>& grids,
+                                   real_t dt) {
+  std::vector<bool> done(grids.size(), false);
+  for (size_t i = 0; i < grids.size(); i++) {
+    if (done[i]) {
+      continue;
+    }
+    int n_steps{0};
+    real_t step{0};
+    grids[i]->GetIntegrationSteps(dt, &n_steps, &step);
+
+    // Collect all grids that can be advanced together with grids[i]
+    std::vector<EulerGrid*> group;
+    for (size_t j = i; j < grids.size(); j++) {
+      auto* grid = grids[j];
+      int grid_n_steps{0};
+      real_t grid_step{0};
+      grid->GetIntegrationSteps(dt, &grid_n_steps, &grid_step);
+      if (!done[j] && typeid(*grid) == typeid(EulerGrid) &&
+          grid->num_boxes_axis_ == grids[i]->num_boxes_axis_ &&
+          grid->bc_type_ == grids[i]->bc_type_ && grid_n_steps == n_steps &&
+          grid_step == step) {
+        group.push_back(grid);
+        done[j] = true;
+      }
+    }
+    if (group.empty()) {
+      // grids[i] is a subclass of EulerGrid
+      grids[i]->IntegrateTimeAsynchronously(dt);
+      done[i] = true;
+      continue;
+    }
+
+    for (int s = 0; s < n_steps; s++) {
+      DiffuseFused(group, step);
+    }
+    for (auto* grid : group) {
+      grid->FinishIntegration(dt, n_steps);
+    }
+  }
 }
 
-void EulerGrid::DiffuseWithOpenEdge(real_t dt) {
-  const auto nx = resolution_;
-  const auto ny = resolution_;
-  const auto nz = resolution_;
+void EulerGrid::DiffuseFused(const std::vector<EulerGrid*>& grids,
+                             real_t dt) {
+  std::vector<EulerGrid*> active_grids;
+  active_grids.reserve(grids.size());
+  for (auto* grid : grids) {
+    // See DiffusionGrid::Diffuse
+    if (grid->IsFixedSubstance()) {
+      continue;
+    }
+    grid->last_dt_ = dt;
+    grid->ParametersCheck(dt);
+    active_grids.push_back(grid);
+  }
+  if (active_grids.empty()) {
+    return;
+  }
+  Sweep(active_grids, active_grids[0]->bc_type_, dt);
+}
 
-  const real_t ibl2 = 1 / (box_length_ * box_length_);
-  const real_t d = 1 - dc_[0];
-  std::array<int, 4> l;
+void EulerGrid::MultiStep(real_t dt, int n_steps) {
+  auto* param = Simulation::GetActive()->GetParam();
+  const int block_size = static_cast<int>(param->diffusion_temporal_blocking);
+  // Subclasses may extend the update of a time step. With periodic boundary
+  // conditions, the first plane depends on the last plane of the previous
+  // step, which prevents a wavefront along z.
+  if (block_size <= 1 || n_steps < 2 || typeid(*this) != typeid(EulerGrid) ||
+      bc_type_ == BoundaryConditionType::kPeriodic || IsFixedSubstance()) {
+    Continuum::MultiStep(dt, n_steps);
+    return;
+  }
+
+  // See DiffusionGrid::Diffuse
+  last_dt_ = dt;
+  ParametersCheck(dt);
+  for (int i = 0; i < n_steps; i += block_size) {
+    DiffuseTemporallyBlocked(dt, std::min(block_size, n_steps - i));
+  }
+}
 
-  constexpr size_t YBF = 16;
-#pragma omp parallel for collapse(2)
-  for (size_t yy = 0; yy < ny; yy += YBF) {
-    for (size_t z = 0; z < nz; z++) {
-      size_t ymax = yy + YBF;
-      if (ymax >= ny) {
-        ymax = ny;
-      }
-      for (size_t y = yy; y < ymax; y++) {
-        size_t x{0};
-        size_t c{0};
-        size_t n{0};
-        size_t s{0};
-        size_t b{0};
-        size_t t{0};
-        c = x + y * nx + z * nx * ny;
-
-        l.fill(1);
-
-        if (y == 0) {
-          n = c;
-          l[0] = 0;
-        } else {
-          n = c - nx;
+void EulerGrid::DiffuseTemporallyBlocked(real_t dt, int num_steps) {
+  const size_t nx = num_boxes_axis_[0];
+  const size_t ny = num_boxes_axis_[1];
+  const size_t nz = num_boxes_axis_[2];
+  const size_t nxy = nx * ny;
+  const size_t k = static_cast<size_t>(num_steps);
+  const bool closed = bc_type_ == BoundaryConditionType::kClosedBoundaries;
+
+  // Intermediate time steps 1 to k - 1 only keep the last four planes
+  constexpr size_t kRingSize = 4;
+  temporal_buffer_.resize((k - 1) * kRingSize * nxy);
+
+  const real_t* c1 = c1_.data();
+  real_t* c2 = c2_.data();
+  real_t* buffer = temporal_buffer_.data();
+  // Returns plane z of time step l
+  auto plane = [&](size_t l, size_t z) -> real_t* {
+    return buffer + ((l - 1) * kRingSize + z % kRingSize) * nxy;
+  };
+  auto input_plane = [&](size_t l, size_t z) -> const real_t* {
+    return l == 0 ? c1 + z * nxy : plane(l, z);
+  };
+
+  // Time step l computes plane z = w - 2 * (l - 1) in wavefront w. Thus, the
+  // planes z - 1, z and z + 1 of time step l - 1 have been computed in one of
+  // the previous wavefronts, and all planes of one wavefront can be computed
+  // in parallel.
+  // The work is not bound to the NUMA slabs of the grid (see
+  // `DiffusionGrid::GetNumaSlab`): a wavefront only contains k planes, which
+  // usually belong to the slab of a single node. Restricting each plane to
+  // the threads of its node would leave the other nodes idle.
+  const size_t num_wavefronts = nz + 2 * (k - 1);
+#pragma omp parallel
+  for (size_t w = 0; w < num_wavefronts; w++) {
+#pragma omp for collapse(2) schedule(static)
+    for (size_t l = 1; l <= k; l++) {
+      for (size_t y = 0; y < ny; y++) {
+        const size_t lag = 2 * (l - 1);
+        if (w < lag || w - lag >= nz) {
+          continue;
         }
-
-        if (y == ny - 1) {
-          s = c;
-          l[1] = 0;
-        } else {
-          s = c + nx;
+        const size_t z = w - lag;
+        const real_t* prev = input_plane(l - 1, z == 0 ? z : z - 1);
+        const real_t* cur = input_plane(l - 1, z);
+        const real_t* next = input_plane(l - 1, z == nz - 1 ? z : z + 1);
+        real_t* out = l == k ? c2 + z * nxy : plane(l, z);
+        DiffuseRow(bc_type_, prev, cur, next, out, y, z, dt);
+
+        // With closed edges, boxes on the boundary are not updated. They keep
+        // the value of the buffer that the time step writes to: c2_ for odd
+        // and c1_ for even time steps. The boundary of the last time step is
+        // fixed after the sweep.
+        if (closed && l != k) {
+          const real_t* src = (l % 2 == 1 ? c2 : c1) + z * nxy + y * nx;
+          real_t* dst = out + y * nx;
+          if (y == 0 || y == ny - 1 || z == 0 || z == nz - 1) {
+            std::copy(src, src + nx, dst);
+          } else {
+            dst[0] = src[0];
+            dst[nx - 1] = src[nx - 1];
+          }
         }
+      }
+    }
+  }
+  c1_.swap(c2_);
 
-        if (z == 0) {
-          b = c;
-          l[2] = 0;
-        } else {
-          b = c - nx * ny;
-        }
+  // Running k steps one by one leaves the boundary of c2_ in c1_ if k is
+  // odd, and the boundary of c1_ if k is even.
+  if (closed && k % 2 == 0) {
+    SwapClosedEdgeBoundary();
+  }
+}
 
-        if (z == nz - 1) {
-          t = c;
-          l[3] = 0;
-        } else {
-          t = c + nx * ny;
+void EulerGrid::SwapClosedEdgeBoundary() {
+  const size_t nx = num_boxes_axis_[0];
+  const size_t ny = num_boxes_axis_[1];
+  const size_t nz = num_boxes_axis_[2];
+#pragma omp parallel for collapse(2)
+  for (size_t z = 0; z < nz; z++) {
+    for (size_t y = 0; y < ny; y++) {
+      const size_t row = y * nx + z * nx * ny;
+      if (y == 0 || y == ny - 1 || z == 0 || z == nz - 1) {
+        for (size_t x = 0; x < nx; x++) {
+          std::swap(c1_[row + x], c2_[row + x]);
         }
+      } else {
+        std::swap(c1_[row], c2_[row]);
+        std::swap(c1_[row + nx - 1], c2_[row + nx - 1]);
+      }
+    }
+  }
+}
 
-        c2_[c] = c1_[c] * (1 - mu_ * dt) +
-                 (d * dt * ibl2) *
-                     (0 - 2 * c1_[c] + c1_[c + 1] + c1_[s] - 2 * c1_[c] +
-                      c1_[n] + c1_[b] - 2 * c1_[c] + c1_[t]);
-#pragma omp simd
-        for (x = 1; x < nx - 1; x++) {
-          ++c;
-          ++n;
-          ++s;
-          ++b;
-          ++t;
-          c2_[c] =
-              c1_[c] * (1 - mu_ * dt) +
-              (d * dt * ibl2) * (c1_[c - 1] - 2 * c1_[c] + c1_[c + 1] +
-                                 l[0] * c1_[s] - 2 * c1_[c] + l[1] * c1_[n] +
-                                 l[2] * c1_[b] - 2 * c1_[c] + l[3] * c1_[t]);
-        }
-        ++c;
-        ++n;
-        ++s;
-        ++b;
-        ++t;
-        c2_[c] = c1_[c] * (1 - mu_ * dt) +
-                 (d * dt * ibl2) *
-                     (c1_[c - 1] - 2 * c1_[c] + 0 + c1_[s] - 2 * c1_[c] +
-                      c1_[n] + c1_[b] - 2 * c1_[c] + c1_[t]);
-      }  // tile ny
-    }    // tile nz
-  }      // block ny
-  c1_.swap(c2_);
+void EulerGrid::Sweep(const std::vector<EulerGrid*>& grids,
+                      BoundaryConditionType bc_type, real_t dt) {
+  const size_t nx = grids[0]->num_boxes_axis_[0];
+  const size_t ny = grids[0]->num_boxes_axis_[1];
+  const size_t nz = grids[0]->num_boxes_axis_[2];
+  const size_t nxy = nx * ny;
+  const bool periodic = bc_type == BoundaryConditionType::kPeriodic;
+
+  // Each thread processes rows of the slab of its NUMA node (see
+  // `DiffusionGrid::GetNumaSlab`). Inside its rows, a thread iterates over
+  // blocks of YBF x ZBF rows. A block of all grids is updated before the next
+  // block is processed. Blocks that cross the boundary of the thread's rows
+  // are clipped.
+  constexpr size_t YBF = 16;
+  constexpr size_t ZBF = 16;
+#pragma omp parallel
+  {
+    size_t start = 0;
+    size_t end = 0;
+    grids[0]->GetThreadRows(&start, &end);
+    const size_t zstart = start / ny;
+    const size_t zend = start == end ? zstart : (end - 1) / ny + 1;
+    for (size_t zz = zstart; zz < zend; zz += ZBF) {
+      for (size_t yy = 0; yy < ny; yy += YBF) {
+        const size_t zmax = std::min(zz + ZBF, zend);
+        const size_t ymax = std::min(yy + YBF, ny);
+        for (auto* grid : grids) {
+          const real_t* c1 = grid->c1_.data();
+          real_t* c2 = grid->c2_.data();
+          for (size_t z = zz; z < zmax; z++) {
+            // Planes outside the grid are replaced by the plane itself, or
+            // wrapped around for periodic boundaries
+            size_t zb = z == 0 ? (periodic ? nz - 1 : z) : z - 1;
+            size_t zt = z == nz - 1 ? (periodic ? 0 : z) : z + 1;
+            // Only the rows of this thread
+            const size_t first_row = z * ny;
+            const size_t ylo =
+                std::max(yy, first_row < start ? start - first_row : 0);
+            const size_t yhi = std::min(ymax, end - first_row);
+            for (size_t y = ylo; y < yhi; y++) {
+              grid->DiffuseRow(bc_type, c1 + zb * nxy, c1 + z * nxy,
+                               c1 + zt * nxy, c2 + z * nxy, y, z, dt);
+            }  // tile ny
+          }    // tile nz
+        }      // grids
+      }        // block ny
+    }          // block nz
+  }
+  for (auto* grid : grids) {
+    grid->c1_.swap(grid->c2_);
+  }
 }
 
-void EulerGrid::DiffuseWithDirichlet(real_t dt) {
-  const auto nx = resolution_;
-  const auto ny = resolution_;
-  const auto nz = resolution_;
+void EulerGrid::DiffuseRow(BoundaryConditionType bc_type, const real_t* prev,
+                           const real_t* cur, const real_t* next, real_t* out,
+                           size_t y, size_t z, real_t dt) {
+  switch (bc_type) {
+    case BoundaryConditionType::kClosedBoundaries:
+      DiffuseRowWithClosedEdge(prev, cur, next, out, y, z, dt);
+      break;
+    case BoundaryConditionType::kOpenBoundaries:
+      DiffuseRowWithOpenEdge(prev, cur, next, out, y, z, dt);
+      break;
+    case BoundaryConditionType::kDirichlet:
+      DiffuseRowWithDirichlet(prev, cur, next, out, y, z, dt);
+      break;
+    case BoundaryConditionType::kNeumann:
+      DiffuseRowWithNeumann(prev, cur, next, out, y, z, dt);
+      break;
+    case BoundaryConditionType::kPeriodic:
+      DiffuseRowWithPeriodic(prev, cur, next, out, y, z, dt);
+      break;
+  }
+}
+
+void EulerGrid::DiffuseRowWithClosedEdge(const real_t* prev, const real_t* cur,
+                                         const real_t* next, real_t* out,
+                                         size_t y, size_t z, real_t dt) {
+  const size_t nx = num_boxes_axis_[0];
+  const size_t ny = num_boxes_axis_[1];
+  const size_t nz = num_boxes_axis_[2];
+
+  // Boxes on the boundary keep their value
+  if (y == 0 || y == (ny - 1) || z == 0 || z == (nz - 1)) {
+    return;
+  }
 
   const real_t ibl2 = 1 / (box_length_ * box_length_);
   const real_t d = 1 - dc_[0];
+  const real_t decay = 1 - mu_ * dt;
+  const real_t factor = d * dt * ibl2;
 
-  const auto sim_time = GetSimulatedTime();
+  const real_t* __restrict c = cur + y * nx;
+  const real_t* __restrict n = c - nx;
+  const real_t* __restrict s = c + nx;
+  const real_t* __restrict b = prev + y * nx;
+  const real_t* __restrict t = next + y * nx;
+  real_t* __restrict o = out + y * nx;
 
-  constexpr size_t YBF = 16;
-#pragma omp parallel for collapse(2)
-  for (size_t yy = 0; yy < ny; yy += YBF) {
-    for (size_t z = 0; z < nz; z++) {
-      size_t ymax = yy + YBF;
-      if (ymax >= ny) {
-        ymax = ny;
-      }
-      for (size_t y = yy; y < ymax; y++) {
-        size_t x{0};
-        size_t c{0};
-        size_t n{0};
-        size_t s{0};
-        size_t b{0};
-        size_t t{0};
-        c = x + y * nx + z * nx * ny;
 #pragma omp simd
-        for (x = 0; x < nx; x++) {
-          if (x == 0 || x == (nx - 1) || y == 0 || y == (ny - 1) || z == 0 ||
-              z == (nz - 1)) {
-            // For all boxes on the boundary, we simply evaluate the boundary
-            real_t real_x = grid_dimensions_[0] + x * box_length_;
-            real_t real_y = grid_dimensions_[0] + y * box_length_;
-            real_t real_z = grid_dimensions_[0] + z * box_length_;
-            c2_[c] =
-                boundary_condition_->Evaluate(real_x, real_y, real_z, sim_time);
-          } else {
-            // For inner boxes, we compute the regular stencil update
-            n = c - nx;
-            s = c + nx;
-            b = c - nx * ny;
-            t = c + nx * ny;
-
-            c2_[c] = c1_[c] * (1 - mu_ * dt) +
-                     (d * dt * ibl2) *
-                         (c1_[c - 1] - 2 * c1_[c] + c1_[c + 1] + c1_[s] -
-                          2 * c1_[c] + c1_[n] + c1_[b] - 2 * c1_[c] + c1_[t]);
-          }
-          ++c;
-        }
-      }  // tile ny
-    }    // tile nz
-  }      // block ny
-  c1_.swap(c2_);
+  for (size_t x = 1; x < nx - 1; x++) {
+    o[x] = c[x] * decay +
+           factor * (c[x - 1] - 2 * c[x] + c[x + 1] + s[x] - 2 * c[x] + n[x] +
+                     b[x] - 2 * c[x] + t[x]);
+  }
 }
 
-void EulerGrid::DiffuseWithNeumann(real_t dt) {
-  const size_t nx = resolution_;
-  const size_t ny = resolution_;
-  const size_t nz = resolution_;
-  const size_t num_boxes = nx * ny * nz;
+void EulerGrid::DiffuseRowWithOpenEdge(const real_t* prev, const real_t* cur,
+                                       const real_t* next, real_t* out,
+                                       size_t y, size_t z, real_t dt) {
+  const size_t nx = num_boxes_axis_[0];
+  const size_t ny = num_boxes_axis_[1];
+  const size_t nz = num_boxes_axis_[2];
 
   const real_t ibl2 = 1 / (box_length_ * box_length_);
   const real_t d = 1 - dc_[0];
+  const real_t decay = 1 - mu_ * dt;
+  const real_t factor = d * dt * ibl2;
+
+  const real_t* __restrict c = cur + y * nx;
+  real_t* __restrict o = out + y * nx;
+
+  // Neighbors outside the grid are replaced by the box itself
+  const real_t* __restrict n = (y == 0) ? c : c - nx;
+  const real_t* __restrict s = (y == ny - 1) ? c : c + nx;
+  const real_t* __restrict b = (z == 0) ? c : prev + y * nx;
+  const real_t* __restrict t = (z == nz - 1) ? c : next + y * nx;
+  const std::array<real_t, 4> l = {
+      {y == 0 ? real_t(0) : real_t(1), y == ny - 1 ? real_t(0) : real_t(1),
+       z == 0 ? real_t(0) : real_t(1), z == nz - 1 ? real_t(0) : real_t(1)}};
+
+  o[0] = c[0] * decay + factor * (0 - 2 * c[0] + c[1] + s[0] - 2 * c[0] +
+                                  n[0] + b[0] - 2 * c[0] + t[0]);
+#pragma omp simd
+  for (size_t x = 1; x < nx - 1; x++) {
+    o[x] = c[x] * decay +
+           factor * (c[x - 1] - 2 * c[x] + c[x + 1] + l[0] * s[x] - 2 * c[x] +
+                     l[1] * n[x] + l[2] * b[x] - 2 * c[x] + l[3] * t[x]);
+  }
+  const size_t x = nx - 1;
+  o[x] = c[x] * decay + factor * (c[x - 1] - 2 * c[x] + 0 + s[x] - 2 * c[x] +
+                                  n[x] + b[x] - 2 * c[x] + t[x]);
+}
+
+void EulerGrid::DiffuseRowWithDirichlet(const real_t* prev, const real_t* cur,
+                                        const real_t* next, real_t* out,
+                                        size_t y, size_t z, real_t dt) {
+  const size_t nx = num_boxes_axis_[0];
+  const size_t ny = num_boxes_axis_[1];
+  const size_t nz = num_boxes_axis_[2];
+
+  const real_t ibl2 = 1 / (box_length_ * box_length_);
+  const real_t d = 1 - dc_[0];
+  const real_t decay = 1 - mu_ * dt;
+  const real_t factor = d * dt * ibl2;
 
   const auto sim_time = GetSimulatedTime();
 
-  constexpr size_t YBF = 16;
-#pragma omp parallel for collapse(2)
-  for (size_t yy = 0; yy < ny; yy += YBF) {
-    for (size_t z = 0; z < nz; z++) {
-      size_t ymax = yy + YBF;
-      if (ymax >= ny) {
-        ymax = ny;
-      }
-      for (size_t y = yy; y < ymax; y++) {
-        size_t x{0};
-        size_t c{0};
-        size_t n{0};
-        size_t s{0};
-        size_t b{0};
-        size_t t{0};
-        c = x + y * nx + z * nx * ny;
+  real_t* __restrict o = out + y * nx;
+
+  // For all boxes on the boundary, we simply evaluate the boundary
+  auto evaluate_boundary = [&](size_t x) {
+    real_t real_x = grid_dimensions_[0] + x * box_length_;
+    real_t real_y = grid_dimensions_[2] + y * box_length_;
+    real_t real_z = grid_dimensions_[4] + z * box_length_;
+    o[x] = boundary_condition_->Evaluate(real_x, real_y, real_z, sim_time);
+  };
+
+  if (y == 0 || y == (ny - 1) || z == 0 || z == (nz - 1)) {
+    for (size_t x = 0; x < nx; x++) {
+      evaluate_boundary(x);
+    }
+    return;
+  }
+
+  evaluate_boundary(0);
+  // For inner boxes, we compute the regular stencil update
+  const real_t* __restrict c = cur + y * nx;
+  const real_t* __restrict n = c - nx;
+  const real_t* __restrict s = c + nx;
+  const real_t* __restrict b = prev + y * nx;
+  const real_t* __restrict t = next + y * nx;
 #pragma omp simd
-        for (x = 0; x < nx; x++) {
-          n = c - nx;
-          s = c + nx;
-          b = c - nx * ny;
-          t = c + nx * ny;
-
-          // Clamp to avoid out of bounds access. Clamped values are initialized
-          // to a wrong value but will be overwritten by the boundary condition
-          // evaluation. All other values are correct.
-          real_t left{c1_[std::clamp(c - 1, size_t{0}, num_boxes - 1)]};
-          real_t right{c1_[std::clamp(c + 1, size_t{0}, num_boxes - 1)]};
-          real_t bottom{c1_[std::clamp(b, size_t{0}, num_boxes - 1)]};
-          real_t top{c1_[std::clamp(t, size_t{0}, num_boxes - 1)]};
-          real_t north{c1_[std::clamp(n, size_t{0}, num_boxes - 1)]};
-          real_t south{c1_[std::clamp(s, size_t{0}, num_boxes - 1)]};
-          real_t center_factor{6.0};
-
-          if (x == 0 || x == (nx - 1) || y == 0 || y == (ny - 1) || z == 0 ||
-              z == (nz - 1)) {
-            real_t real_x = grid_dimensions_[0] + x * box_length_;
-            real_t real_y = grid_dimensions_[0] + y * box_length_;
-            real_t real_z = grid_dimensions_[0] + z * box_length_;
-            real_t boundary_value =
-                -box_length_ *
-                boundary_condition_->Evaluate(real_x, real_y, real_z, sim_time);
-
-            if (x == 0) {
-              left = boundary_value;
-              center_factor -= 1.0;
-            } else if (x == (nx - 1)) {
-              right = boundary_value;
-              center_factor -= 1.0;
-            }
-
-            if (y == 0) {
-              north = boundary_value;
-              center_factor -= 1.0;
-            } else if (y == (ny - 1)) {
-              south = boundary_value;
-              center_factor -= 1.0;
-            }
-
-            if (z == 0) {
-              bottom = boundary_value;
-              center_factor -= 1.0;
-            } else if (z == (nz - 1)) {
-              top = boundary_value;
-              center_factor -= 1.0;
-            }
-          }
+  for (size_t x = 1; x < nx - 1; x++) {
+    o[x] = c[x] * decay +
+           factor * (c[x - 1] - 2 * c[x] + c[x + 1] + s[x] - 2 * c[x] + n[x] +
+                     b[x] - 2 * c[x] + t[x]);
+  }
+  evaluate_boundary(nx - 1);
+}
 
-          c2_[c] = c1_[c] * (1 - mu_ * dt) +
-                   (d * dt * ibl2) * (left + right + south + north + top +
-                                      bottom - center_factor * c1_[c]);
+void EulerGrid::DiffuseRowWithNeumann(const real_t* prev, const real_t* cur,
+                                      const real_t* next, real_t* out,
+                                      size_t y, size_t z, real_t dt) {
+  const size_t nx = num_boxes_axis_[0];
+  const size_t ny = num_boxes_axis_[1];
+  const size_t nz = num_boxes_axis_[2];
 
-          ++c;
-        }
-      }  // tile ny
-    }    // tile nz
-  }      // block ny
-  c1_.swap(c2_);
-}
+  const auto sim_time = GetSimulatedTime();
 
-void EulerGrid::DiffuseWithPeriodic(real_t dt) {
-  const size_t nx = resolution_;
-  const size_t ny = resolution_;
-  const size_t nz = resolution_;
+  if (y == 0 || y == (ny - 1) || z == 0 || z == (nz - 1)) {
+    for (size_t x = 0; x < nx; x++) {
+      DiffuseBoxWithNeumann(prev, cur, next, out, x, y, z, dt, sim_time);
+    }
+    return;
+  }
 
-  const real_t dx = box_length_;
+  const real_t ibl2 = 1 / (box_length_ * box_length_);
   const real_t d = 1 - dc_[0];
+  const real_t decay = 1 - mu_ * dt;
+  const real_t factor = d * dt * ibl2;
 
-  constexpr size_t YBF = 16;
-#pragma omp parallel for collapse(2)
-  for (size_t yy = 0; yy < ny; yy += YBF) {
-    for (size_t z = 0; z < nz; z++) {
-      size_t ymax = yy + YBF;
-      if (ymax >= ny) {
-        ymax = ny;
-      }
-      for (size_t y = yy; y < ymax; y++) {
-        size_t l{0};
-        size_t r{0};
-        size_t n{0};
-        size_t s{0};
-        size_t b{0};
-        size_t t{0};
-        size_t c = y * nx + z * nx * ny;
+  const real_t* __restrict c = cur + y * nx;
+  const real_t* __restrict n = c - nx;
+  const real_t* __restrict s = c + nx;
+  const real_t* __restrict b = prev + y * nx;
+  const real_t* __restrict t = next + y * nx;
+  real_t* __restrict o = out + y * nx;
+
+  DiffuseBoxWithNeumann(prev, cur, next, out, 0, y, z, dt, sim_time);
 #pragma omp simd
-        for (size_t x = 0; x < nx; x++) {
-          l = c - 1;
-          r = c + 1;
-          n = c - nx;
-          s = c + nx;
-          b = c - nx * ny;
-          t = c + nx * ny;
-
-          // Adapt neighbor indices for boundary boxes for periodic boundary
-          if (x == 0) {
-            l = nx - 1 + y * nx + z * nx * ny;
-          } else if (x == (nx - 1)) {
-            r = 0 + y * nx + z * nx * ny;
-          }
+  for (size_t x = 1; x < nx - 1; x++) {
+    o[x] = c[x] * decay + factor * (c[x - 1] + c[x + 1] + s[x] + n[x] + t[x] +
+                                    b[x] - 6.0 * c[x]);
+  }
+  DiffuseBoxWithNeumann(prev, cur, next, out, nx - 1, y, z, dt, sim_time);
+}
 
-          if (y == 0) {
-            n = x + (ny - 1) * nx + z * nx * ny;
-          } else if (y == (ny - 1)) {
-            s = x + 0 * nx + z * nx * ny;
-          }
+void EulerGrid::DiffuseBoxWithNeumann(const real_t* prev, const real_t* cur,
+                                      const real_t* next, real_t* out,
+                                      size_t x, size_t y, size_t z, real_t dt,
+                                      real_t sim_time) {
+  const size_t nx = num_boxes_axis_[0];
+  const size_t ny = num_boxes_axis_[1];
+  const size_t nz = num_boxes_axis_[2];
 
-          if (z == 0) {
-            b = x + y * nx + (nz - 1) * nx * ny;
-          } else if (z == (nz - 1)) {
-            t = x + y * nx + 0 * nx * ny;
-          }
+  const real_t ibl2 = 1 / (box_length_ * box_length_);
+  const real_t d = 1 - dc_[0];
 
-          // Stencil update
-          c2_[c] = c1_[c] * (1 - (mu_ * dt)) +
-                   ((d * dt / (dx * dx)) * (c1_[l] + c1_[r] + c1_[n] + c1_[s] +
-                                            c1_[t] + c1_[b] - 6.0 * c1_[c]));
+  // This function is only called for boxes on the boundary
+  real_t real_x = grid_dimensions_[0] + x * box_length_;
+  real_t real_y = grid_dimensions_[2] + y * box_length_;
+  real_t real_z = grid_dimensions_[4] + z * box_length_;
+  real_t boundary_value =
+      -box_length_ *
+      boundary_condition_->Evaluate(real_x, real_y, real_z, sim_time);
+
+  // Neighbors outside the grid are replaced by the boundary value
+  const size_t c = x + y * nx;
+  real_t center_factor{6.0};
+  real_t left{boundary_value};
+  real_t right{boundary_value};
+  real_t north{boundary_value};
+  real_t south{boundary_value};
+  real_t bottom{boundary_value};
+  real_t top{boundary_value};
+
+  if (x == 0) {
+    center_factor -= 1.0;
+  } else if (x == (nx - 1)) {
+    center_factor -= 1.0;
+  }
+  if (x != 0) {
+    left = cur[c - 1];
+  }
+  if (x != nx - 1) {
+    right = cur[c + 1];
+  }
+
+  if (y == 0) {
+    center_factor -= 1.0;
+  } else if (y == (ny - 1)) {
+    center_factor -= 1.0;
+  }
+  if (y != 0) {
+    north = cur[c - nx];
+  }
+  if (y != ny - 1) {
+    south = cur[c + nx];
+  }
+
+  if (z == 0) {
+    center_factor -= 1.0;
+  } else if (z == (nz - 1)) {
+    center_factor -= 1.0;
+  }
+  if (z != 0) {
+    bottom = prev[c];
+  }
+  if (z != nz - 1) {
+    top = next[c];
+  }
+
+  out[c] = cur[c] * (1 - mu_ * dt) +
+           (d * dt * ibl2) * (left + right + south + north + top + bottom -
+                              center_factor * cur[c]);
+}
 
-          ++c;
-        }
-      }  // tile ny
-    }    // tile nz
-  }      // block ny
-  c1_.swap(c2_);
+void EulerGrid::DiffuseRowWithPeriodic(const real_t* prev, const real_t* cur,
+                                       const real_t* next, real_t* out,
+                                       size_t y, size_t z, real_t dt) {
+  const size_t nx = num_boxes_axis_[0];
+  const size_t ny = num_boxes_axis_[1];
+
+  const real_t dx = box_length_;
+  const real_t d = 1 - dc_[0];
+  const real_t decay = 1 - (mu_ * dt);
+  const real_t factor = d * dt / (dx * dx);
+
+  // Adapt neighbor rows for boundary boxes for periodic boundary. `prev` and
+  // `next` are already wrapped around.
+  const size_t yn = (y == 0) ? ny - 1 : y - 1;
+  const size_t ys = (y == ny - 1) ? 0 : y + 1;
+
+  const real_t* __restrict c = cur + y * nx;
+  const real_t* __restrict n = cur + yn * nx;
+  const real_t* __restrict s = cur + ys * nx;
+  const real_t* __restrict b = prev + y * nx;
+  const real_t* __restrict t = next + y * nx;
+  real_t* __restrict o = out + y * nx;
+
+  // Stencil update
+  o[0] = c[0] * decay + (factor * (c[nx - 1] + c[1] + n[0] + s[0] + t[0] +
+                                   b[0] - 6.0 * c[0]));
+#pragma omp simd
+  for (size_t x = 1; x < nx - 1; x++) {
+    o[x] = c[x] * decay + (factor * (c[x - 1] + c[x + 1] + n[x] + s[x] +
+                                     t[x] + b[x] - 6.0 * c[x]));
+  }
+  const size_t x = nx - 1;
+  o[x] = c[x] * decay + (factor * (c[x - 1] + c[0] + n[x] + s[x] + t[x] +
+                                   b[x] - 6.0 * c[x]));
 }
 
 }  // namespace bdm
@@ -16,6 +16,7 @@
 #define CORE_DIFFUSION_EULER_GRID_H_
 
 #include <utility>
+#include <vector>
 
 #include "core/diffusion/diffusion_grid.h"
 
@@ -54,7 +55,81 @@ class EulerGrid : public DiffusionGrid {
   void DiffuseWithNeumann(real_t dt) override;
   void DiffuseWithPeriodic(real_t dt) override;
 
+  /// Integrates all `grids` by `dt` like `IntegrateTimeAsynchronously`.
+  /// Grids with the same number of boxes along each axis, boundary condition
+  /// type and time steps are advanced together with `DiffuseFused`. Only grids
+  /// of exact type `EulerGrid` are supported, because subclasses may extend
+  /// the update.
+  static void IntegrateTimeFused(const std::vector<EulerGrid*>& grids,
+                                 real_t dt);
+
+  /// Advances all `grids` by `dt` in a single sweep over the grid boxes
+  /// (see `Diffuse`). All grids must have the same number of boxes along each
+  /// axis and the same boundary condition type. Advancing several grids in one
+  /// sweep amortizes the memory traffic and the synchronization between the
+  /// time steps.
+  static void DiffuseFused(const std::vector<EulerGrid*>& grids, real_t dt);
+
+  /// Advances the grid by `n_steps` time steps of length `dt`. If
+  /// `Param::diffusion_temporal_blocking` is larger than one, blocks of that
+  /// many time steps are computed in a single sweep over the grid (see
+  /// `DiffuseTemporallyBlocked`). The result is identical to calling `Step`
+  /// `n_steps` times.
+  void MultiStep(real_t dt, int n_steps) override;
+
  private:
+  /// Intermediate time steps of `DiffuseTemporallyBlocked`. Holds four planes
+  /// per intermediate time step.
+  ParallelResizeVector<real_t> temporal_buffer_ = {};  //!
+
+  /// Advances the grid by `num_steps` time steps in a single sweep along z.
+  /// The planes of the time steps are computed in a wavefront: time step `l`
+  /// trails time step `l - 1` by two planes, such that only the last planes
+  /// of the intermediate time steps need to be kept in memory.
+  /// Not supported for periodic boundary conditions.
+  void DiffuseTemporallyBlocked(real_t dt, int num_steps);
+
+  /// Swaps the values of the boxes on the boundary between c1_ and c2_.
+  void SwapClosedEdgeBoundary();
+
+  /// Computes the stencil update for all `grids` and swaps their buffers.
+  /// The boxes are processed in cache blocks of rows along y and z. All
+  /// grids are updated block by block.
+  static void Sweep(const std::vector<EulerGrid*>& grids,
+                    BoundaryConditionType bc_type, real_t dt);
+
+  /// Computes the stencil update for the boxes in row (y, z) and writes it
+  /// to plane `out`. `prev`, `cur` and `next` point to the planes z - 1, z
+  /// and z + 1 of the previous time step. Planes outside the grid are
+  /// replaced by `cur`, or wrapped around for periodic boundaries.
+  void DiffuseRow(BoundaryConditionType bc_type, const real_t* prev,
+                  const real_t* cur, const real_t* next, real_t* out, size_t y,
+                  size_t z, real_t dt);
+
+  /// Row kernels of `DiffuseRow`. The boundary conditions are resolved per
+  /// row, such that the loop over the inner boxes is free of branches.
+  void DiffuseRowWithClosedEdge(const real_t* prev, const real_t* cur,
+                                const real_t* next, real_t* out, size_t y,
+                                size_t z, real_t dt);
+  void DiffuseRowWithOpenEdge(const real_t* prev, const real_t* cur,
+                              const real_t* next, real_t* out, size_t y,
+                              size_t z, real_t dt);
+  void DiffuseRowWithDirichlet(const real_t* prev, const real_t* cur,
+                               const real_t* next, real_t* out, size_t y,
+                               size_t z, real_t dt);
+  void DiffuseRowWithNeumann(const real_t* prev, const real_t* cur,
+                             const real_t* next, real_t* out, size_t y,
+                             size_t z, real_t dt);
+  void DiffuseRowWithPeriodic(const real_t* prev, const real_t* cur,
+                              const real_t* next, real_t* out, size_t y,
+                              size_t z, real_t dt);
+
+  /// Computes the update of a single box for Neumann boundary conditions.
+  /// Handles boxes on the boundary.
+  void DiffuseBoxWithNeumann(const real_t* prev, const real_t* cur,
+                             const real_t* next, real_t* out, size_t x,
+                             size_t y, size_t z, real_t dt, real_t sim_time);
+
   BDM_CLASS_DEF_OVERRIDE(EulerGrid, 1);
 };
 
@@ -65,6 +65,17 @@ class Environment {
   virtual void ForEachNeighbor(Functor<void, Agent*, real_t>& lambda,
                                const Agent& query, real_t squared_radius) = 0;
 
+  /// Same as `ForEachNeighbor(lambda, query, squared_radius)`, but if `query`
+  /// is a sphere, neighbors that are further away than half the sum of both
+  /// diameters plus `sphere_interaction_margin` may be skipped (see
+  /// `InteractionForce::GetSphereInteractionMargin`). Environments that do
+  /// not keep track of the agent sizes visit all neighbors.
+  virtual void ForEachNeighborInInteractionRange(
+      Functor<void, Agent*, real_t>& lambda, const Agent& query,
+      real_t squared_radius, real_t sphere_interaction_margin) {
+    ForEachNeighbor(lambda, query, squared_radius);
+  }
+
   /// Iterates over all neighbors in an environment that suffices the given
   /// `criteria`. The `criteria` is type-erased to facilitate for different
   /// criteria for different environments. Check the documentation of an
@@ -96,6 +107,14 @@ class Environment {
     return largest_object_size_squared_;
   };
 
+  /// Returns an upper bound for the diameter of all spherical agents in the
+  /// neighborhood of `query`, or infinity if the neighborhood might contain
+  /// non-spherical agents. Environments that do not keep track of this
+  /// information always return infinity.
+  virtual real_t GetLargestAgentSizeInNeighborhood(const Agent& query) const {
+    return Math::kInfinity;
+  }
+
   virtual LoadBalanceInfo* GetLoadBalanceInfo() = 0;
 
   /// This class ensures thread-safety for the case
@@ -0,0 +1,93 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN & University of Surrey for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+// See the NOTICE file distributed with this work for additional information
+// regarding copyright ownership.
+//
+// -----------------------------------------------------------------------------
+
+#include "core/environment/hilbert_order.h"
+#include <morton/morton.h>  // NOLINT
+
+namespace bdm {
+
+// -----------------------------------------------------------------------------
+uint64_t HilbertOrder::Encode(const std::array<uint64_t, 3>& pos,
+                              uint64_t bits) {
+  if (bits == 0) {
+    return 0;
+  }
+  // Convert the coordinates into the transposed Hilbert index
+  auto x = pos;
+  uint64_t m = uint64_t{1} << (bits - 1);
+  // inverse undo excess work
+  for (uint64_t q = m; q > 1; q >>= 1) {
+    uint64_t p = q - 1;
+    for (int i = 0; i < 3; i++) {
+      if (x[i] & q) {
+        x[0] ^= p;
+      } else {
+        uint64_t t = (x[0] ^ x[i]) & p;
+        x[0] ^= t;
+        x[i] ^= t;
+      }
+    }
+  }
+  // gray encode
+  for (int i = 1; i < 3; i++) {
+    x[i] ^= x[i - 1];
+  }
+  uint64_t t = 0;
+  for (uint64_t q = m; q > 1; q >>= 1) {
+    if (x[2] & q) {
+      t ^= q - 1;
+    }
+  }
+  for (int i = 0; i < 3; i++) {
+    x[i] ^= t;
+  }
+  // The bits of the transposed index are interleaved with x[0] as most
+  // significant bit of each triple.
+  return libmorton::morton3D_64_encode(
+      static_cast<uint_fast32_t>(x[2]), static_cast<uint_fast32_t>(x[1]),
+      static_cast<uint_fast32_t>(x[0]));
+}
+
+// -----------------------------------------------------------------------------
+std::array<uint64_t, 3> HilbertOrder::Decode(uint64_t code, uint64_t bits) {
+  if (bits == 0) {
+    return {0, 0, 0};
+  }
+  uint_fast32_t x0, x1, x2;
+  libmorton::morton3D_64_decode(code, x2, x1, x0);
+  std::array<uint64_t, 3> x = {x0, x1, x2};
+  uint64_t n = uint64_t{2} << (bits - 1);
+  // gray decode
+  uint64_t t = x[2] >> 1;
+  for (int i = 2; i > 0; i--) {
+    x[i] ^= x[i - 1];
+  }
+  x[0] ^= t;
+  // undo excess work
+  for (uint64_t q = 2; q != n; q <<= 1) {
+    uint64_t p = q - 1;
+    for (int i = 2; i >= 0; i--) {
+      if (x[i] & q) {
+        x[0] ^= p;
+      } else {
+        t = (x[0] ^ x[i]) & p;
+        x[0] ^= t;
+        x[i] ^= t;
+      }
+    }
+  }
+  return x;
+}
+
+}  // namespace bdm
@@ -0,0 +1,52 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN & University of Surrey for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+// See the NOTICE file distributed with this work for additional information
+// regarding copyright ownership.
+//
+// -----------------------------------------------------------------------------
+
+#ifndef CORE_ENVIRONMENT_HILBERT_ORDER_H_
+#define CORE_ENVIRONMENT_HILBERT_ORDER_H_
+
+#include <array>
+#include "core/environment/morton_order.h"
+
+namespace bdm {
+
+/// Enumerates the boxes of a grid with arbitrary dimensions in the order of
+/// the three dimensional Hilbert curve of the enclosing cube. In contrast to
+/// the Morton curve, consecutive boxes are always face neighbors. Thus, the
+/// curve has no large jumps between octants, which improves the locality of
+/// neighboring agents after they have been sorted along it.\n
+/// The iteration interface is inherited from `MortonOrder`:
+/// `GetMortonCode` and `CallMortonIteratorConsumer` return Hilbert indices,
+/// which can be converted into box coordinates with `Decode`.
+///
+/// Further information:
+///   - <a href="https://doi.org/10.1063/1.1751381">
+///     J. Skilling, Programming the Hilbert curve, 2004</a>
+class HilbertOrder : public MortonOrder {
+ public:
+  std::array<uint64_t, 3> Decode(uint64_t code) const override {
+    return Decode(code, depth_);
+  }
+
+  /// Returns the Hilbert index of box (x, y, z) in a cube with length
+  /// `2^bits`.
+  static uint64_t Encode(const std::array<uint64_t, 3>& pos, uint64_t bits);
+
+  /// Returns the box coordinates of a Hilbert index in a cube with length
+  /// `2^bits`.
+  static std::array<uint64_t, 3> Decode(uint64_t code, uint64_t bits);
+};
+
+}  // namespace bdm
+
+#endif  // CORE_ENVIRONMENT_HILBERT_ORDER_H_
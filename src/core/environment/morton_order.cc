@@ -46,9 +46,8 @@ class Stack {
 struct Aux {
   uint64_t index = 0;
   uint64_t length = 0;
-  uint64_t xpos = 0;
-  uint64_t ypos = 0;
-  uint64_t zpos = 0;
+  /// First code of the parent cube
+  uint64_t code = 0;
 };
 
 // -----------------------------------------------------------------------------
@@ -60,6 +59,7 @@ void MortonOrder::Update(const std::array<uint64_t, 3>& num_boxes_axis) {
                           std::max(num_boxes_axis[1], num_boxes_axis[2]));
   auto max_depth =
       static_cast<uint64_t>(std::ceil(std::log(max_dim) / std::log(2)));
+  depth_ = max_depth;
 
   offset_index_.clear();
   offset_index_.reserve(2048);
@@ -72,7 +72,7 @@ void MortonOrder::Update(const std::array<uint64_t, 3>& num_boxes_axis) {
   auto length = static_cast<uint64_t>(std::pow(2, max_depth - 1));
 
   Stack<Aux> s(max_depth);
-  s.Push({0, length, length, length, length});
+  s.Push({0, length, 0});
 
   uint64_t box_cnt = 0;
   uint64_t offset = 0;
@@ -80,22 +80,17 @@ void MortonOrder::Update(const std::array<uint64_t, 3>& num_boxes_axis) {
 
   while (s.Size() != 0) {
     auto& c = s.Top();
-    // determine borders
-    auto xmax = c.xpos;
-    if (c.index == 1 || c.index == 3 || c.index == 5 || c.index == 7) {
-      xmax += c.length;
-    }
-    auto ymax = c.ypos;
-    if ((c.index > 1 && c.index < 4) || c.index > 5) {
-      ymax += c.length;
-    }
-    auto zmax = c.zpos;
-    if (c.index > 3) {
-      zmax += c.length;
-    }
-    auto xmin = xmax - c.length;
-    auto ymin = ymax - c.length;
-    auto zmin = zmax - c.length;
+    // determine borders. The codes of each subcube are contiguous, such that
+    // the first code of subcube `c.index` lies in its minimum corner region.
+    auto elements = c.length * c.length * c.length;
+    auto code = c.code + c.index * elements;
+    auto pos = Decode(code);
+    auto xmin = pos[0] & ~(c.length - 1);
+    auto ymin = pos[1] & ~(c.length - 1);
+    auto zmin = pos[2] & ~(c.length - 1);
+    auto xmax = xmin + c.length;
+    auto ymax = ymin + c.length;
+    auto zmax = zmin + c.length;
 
     if (max_dimensions[0] >= xmax - 1 && max_dimensions[1] >= ymax - 1 &&
         max_dimensions[2] >= zmax - 1) {
@@ -104,17 +99,14 @@ void MortonOrder::Update(const std::array<uint64_t, 3>& num_boxes_axis) {
         offset_index_.push_back({box_cnt, offset});
         record = false;
       }
-      box_cnt += c.length * c.length * c.length;
+      box_cnt += elements;
     } else if (max_dimensions[0] < xmin || max_dimensions[1] < ymin ||
                max_dimensions[2] < zmin) {
       // empty
       record = true;
-      auto elements = c.length * c.length * c.length;
       offset += elements;
     } else {
-      auto next_length = c.length >> 1;
-      s.Push({0, next_length, xmin + next_length, ymin + next_length,
-              zmin + next_length});
+      s.Push({0, c.length >> 1, code});
       continue;
     }
 
@@ -125,6 +117,14 @@ void MortonOrder::Update(const std::array<uint64_t, 3>& num_boxes_axis) {
   }
 }
 
+// -----------------------------------------------------------------------------
+std::array<uint64_t, 3> MortonOrder::Decode(uint64_t code) const {
+  uint_fast32_t x, y, z;
+  libmorton::morton3D_64_decode(code, x, y, z);
+  return {static_cast<uint64_t>(x), static_cast<uint64_t>(y),
+          static_cast<uint64_t>(z)};
+}
+
 // -----------------------------------------------------------------------------
 template <typename T>
 std::pair<uint64_t, uint64_t> BinarySearch(uint64_t search_val,
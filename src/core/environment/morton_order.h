@@ -24,14 +24,28 @@
 
 namespace bdm {
 
+/// Enumerates the boxes of a grid with arbitrary dimensions in the order of
+/// the Morton curve of the enclosing cube, whose length is a power of two.
+/// Subclasses can replace the curve with another one that visits each
+/// aligned subcube with a power of two length in a contiguous range of codes
+/// (see `HilbertOrder`).
 class MortonOrder {
  public:
+  virtual ~MortonOrder() = default;
+
   void Update(const std::array<uint64_t, 3>& num_boxes_axis);
   /// Runtime O(log(num_boxes))
   uint64_t GetMortonCode(uint64_t box_index) const;
   void CallMortonIteratorConsumer(uint64_t start_index, uint64_t end_index,
                                   Functor<void, Iterator<uint64_t>*>& f) const;
 
+  /// Returns the box coordinates {x, y, z} of the given code.
+  virtual std::array<uint64_t, 3> Decode(uint64_t code) const;
+
+ protected:
+  /// Length of the enclosing cube is `2^depth_`
+  uint64_t depth_ = 0;
+
  private:
   uint64_t num_boxes_;
   std::vector<std::pair<uint64_t, uint64_t>> offset_index_;
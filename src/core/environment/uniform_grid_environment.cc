@@ -13,7 +13,6 @@
 // -----------------------------------------------------------------------------
 
 #include "core/environment/uniform_grid_environment.h"
-#include <morton/morton.h>  // NOLINT
 #include "core/algorithm.h"
 
 namespace bdm {
@@ -32,7 +31,18 @@ void UniformGridEnvironment::LoadBalanceInfoUG::Update() {
     return;
   }
 
-  mo_.Update(grid_->num_boxes_axis_);
+  auto* param = Simulation::GetActive()->GetParam();
+  bool hilbert = param->space_filling_curve == "hilbert";
+  if (!hilbert && param->space_filling_curve != "morton") {
+    Log::Fatal("UniformGridEnvironment::LoadBalanceInfoUG::Update",
+               "Space-filling curve '", param->space_filling_curve,
+               "' is not supported. Please choose 'morton' or 'hilbert'.");
+  }
+  if (!mo_ || (dynamic_cast<HilbertOrder*>(mo_.get()) != nullptr) != hilbert) {
+    mo_ = hilbert ? std::make_unique<HilbertOrder>()
+                  : std::make_unique<MortonOrder>();
+  }
+  mo_->Update(grid_->num_boxes_axis_);
 
   AllocateMemory();
   InitializeVectors();
@@ -62,8 +72,9 @@ void UniformGridEnvironment::LoadBalanceInfoUG::InitializeVectors() {
     auto start = tid * chunk;
     auto end = std::min(grid_->total_num_boxes_, start + chunk);
 
-    InitializeVectorFunctor f(grid_, start, sorted_boxes_, cummulated_agents_);
-    mo_.CallMortonIteratorConsumer(start, end - 1, f);
+    InitializeVectorFunctor f(grid_, *mo_, start, sorted_boxes_,
+                              cummulated_agents_);
+    mo_->CallMortonIteratorConsumer(start, end - 1, f);
   }
 }
 
@@ -111,12 +122,26 @@ struct AgentHandleIterator : public Iterator<AgentHandle> {
 
 void UniformGridEnvironment::UpdateImplementation() {
   auto* rm = Simulation::GetActive()->GetResourceManager();
+  auto* param = Simulation::GetActive()->GetParam();
+
+  if (param->verlet_list_skin > 0 && !VerletListsNeedRebuild()) {
+    // Agents have not moved far enough to invalidate the Verlet lists.
+    // Keep the grid as it is, but refresh the cached positions.
+    if (agent_cache_valid_) {
+      UpdateAgentCache();
+    }
+    has_grown_ = false;
+    return;
+  }
+
+  if (param->uniform_grid_incremental_update && UpdateIncrementally()) {
+    return;
+  }
 
   if (rm->GetNumAgents() != 0) {
     Clear();
     timestamp_++;
 
-    auto* param = Simulation::GetActive()->GetParam();
     if (determine_sim_size_) {
       auto inf = Math::kInfinity;
       std::array<real_t, 6> tmp_dim = {{inf, -inf, inf, -inf, inf, -inf}};
@@ -138,7 +163,9 @@ void UniformGridEnvironment::UpdateImplementation() {
       assert(los > 0 &&
              "The largest object size was found to be 0. Please check if your "
              "cells are correctly initialized.");
-      box_length_ = los;
+      // Enlarge the boxes by the Verlet list skin, such that all agents of a
+      // Verlet list are inside the Moore neighborhood.
+      box_length_ = ceil(GetLargestAgentSize() + param->verlet_list_skin);
     } else if (!is_custom_box_length_ && !determine_sim_size_) {
       Log::Fatal("UniformGridEnvironment",
                  "No box length specified although determine_sim_size_ is "
@@ -199,22 +226,48 @@ void UniformGridEnvironment::UpdateImplementation() {
     successors_.reserve();
 
     // Assign agents to boxes
-    AssignToBoxesFunctor functor(this);
-    rm->ForEachAgentParallel(param->scheduling_batch_size, functor);
+    if (param->uniform_grid_counting_sort) {
+      AssignToBoxesCountingSort();
+    } else {
+      AssignToBoxesFunctor functor(this);
+      rm->ForEachAgentParallel(param->scheduling_batch_size, functor);
+    }
     if (param->bound_space) {
       int min = param->min_bound;
       int max = param->max_bound;
       threshold_dimensions_ = {min, max};
     }
 
+    UpdateSortedAgentData();
+
+    if (param->uniform_grid_incremental_update) {
+      // Remember which agent belongs to which handle to detect added, removed
+      // or reordered agents in UpdateIncrementally
+      agent_uids_.reserve();
+      auto store_uid = L2F([&](Agent* agent, AgentHandle ah) {
+        agent_uids_[ah] = agent->GetUid();
+      });
+      rm->ForEachAgentParallel(param->scheduling_batch_size, store_uid);
+      num_agents_per_numa_.resize(ThreadInfo::GetInstance()->GetNumaNodes());
+      for (size_t n = 0; n < num_agents_per_numa_.size(); ++n) {
+        num_agents_per_numa_[n] = rm->GetAgentContainerSize(n);
+      }
+      num_tombstones_ = rm->GetNumTombstones();
+      incremental_update_ready_ = true;
+    }
+
     if (param->thread_safety_mechanism ==
         Param::ThreadSafetyMechanism::kAutomatic) {
       nb_mutex_builder_->Update();
     }
   } else {
     // There are no agents in this simulation
-    auto* param = Simulation::GetActive()->GetParam();
-
+    incremental_update_ready_ = false;
+    sorted_boxes_valid_ = false;
+    agent_cache_valid_ = false;
+    verlet_lists_valid_ = false;
+    verlet_skin_ = 0;
+    box_max_diameter_valid_ = false;
     bool uninitialized = boxes_.size() == 0;
     if (uninitialized && param->bound_space) {
       // Simulation has never had any agents
@@ -242,6 +295,454 @@ void UniformGridEnvironment::UpdateImplementation() {
   }
 }
 
+// -----------------------------------------------------------------------------
+void UniformGridEnvironment::AssignToBoxesCountingSort() {
+  auto* rm = Simulation::GetActive()->GetResourceManager();
+  auto* param = Simulation::GetActive()->GetParam();
+
+  box_start_.resize(total_num_boxes_ + 1);
+#pragma omp parallel for
+  for (uint64_t i = 0; i <= total_num_boxes_; ++i) {
+    box_start_[i] = 0;
+  }
+  box_ranks_.reserve();
+
+  // (1) Count the agents per box. The number of agents in box i is stored in
+  // box_start_[i + 1]. The returned count is the position inside the box.
+  auto count = L2F([&](Agent* agent, AgentHandle ah) {
+    auto idx = GetBoxIndex(agent->GetPosition());
+    assert(idx <= std::numeric_limits<uint32_t>::max());
+    agent->SetBoxIdx(static_cast<uint32_t>(idx));
+    uint64_t rank;
+#pragma omp atomic capture
+    rank = box_start_[idx + 1]++;
+    box_ranks_[ah] = static_cast<uint32_t>(rank);
+  });
+  rm->ForEachAgentParallel(param->scheduling_batch_size, count);
+
+  // (2) Calculate the start of each box
+  InPlaceParallelPrefixSum(box_start_, total_num_boxes_ + 1);
+
+  // (3) Scatter the agent handles
+  sorted_handles_.resize(rm->GetNumAgents());
+  auto scatter = L2F([&](Agent* agent, AgentHandle ah) {
+    sorted_handles_[box_start_[agent->GetBoxIdx()] + box_ranks_[ah]] = ah;
+  });
+  rm->ForEachAgentParallel(param->scheduling_batch_size, scatter);
+
+  // Set up the linked lists
+#pragma omp parallel for schedule(dynamic, 256)
+  for (uint64_t i = 0; i < total_num_boxes_; ++i) {
+    auto start = box_start_[i];
+    auto end = box_start_[i + 1];
+    if (start == end) {
+      continue;
+    }
+    if (end - start > std::numeric_limits<uint16_t>::max()) {
+      Log::Fatal(
+          "UniformGridEnvironment::AssignToBoxesCountingSort",
+          "Box overflow. You have added too many agents to a single Box.");
+    }
+    auto& box = boxes_[i];
+    box.timestamp_ = timestamp_;
+    box.length_ = static_cast<uint16_t>(end - start);
+    box.start_ = sorted_handles_[start];
+    for (uint64_t j = start + 1; j < end; ++j) {
+      successors_[sorted_handles_[j - 1]] = sorted_handles_[j];
+    }
+  }
+  sorted_boxes_valid_ = true;
+}
+
+// -----------------------------------------------------------------------------
+void UniformGridEnvironment::UpdateSortedAgentData() {
+  auto* param = Simulation::GetActive()->GetParam();
+  bool use_verlet_lists = param->verlet_list_skin > 0;
+  if (!sorted_boxes_valid_ &&
+      (param->uniform_grid_counting_sort || param->cache_agent_positions ||
+       use_verlet_lists)) {
+    SortHandlesByBox();
+  }
+  if (param->cache_agent_positions || use_verlet_lists) {
+    UpdateAgentCache();
+    agent_cache_valid_ = param->cache_agent_positions;
+  }
+  if (use_verlet_lists) {
+    BuildVerletLists(param->verlet_list_skin);
+  }
+  if (param->adaptive_interaction_radius) {
+    UpdateBoxMaxDiameters();
+  }
+}
+
+// -----------------------------------------------------------------------------
+void UniformGridEnvironment::UpdateBoxMaxDiameters() {
+  auto* rm = Simulation::GetActive()->GetResourceManager();
+
+  box_max_diameter_.resize(total_num_boxes_);
+#pragma omp parallel for schedule(dynamic, 256)
+  for (uint64_t i = 0; i < total_num_boxes_; ++i) {
+    real_t max_diameter = 0;
+    for (auto it = boxes_[i].begin(this); !it.IsAtEnd(); ++it) {
+      auto* agent = rm->GetAgent(*it);
+      // The interaction range of non-spherical agents is not determined by
+      // their diameter.
+      if (agent->GetShape() != Shape::kSphere) {
+        max_diameter = Math::kInfinity;
+        break;
+      }
+      max_diameter = std::max(max_diameter, agent->GetDiameter());
+    }
+    box_max_diameter_[i] = max_diameter;
+  }
+  box_max_diameter_valid_ = true;
+}
+
+// -----------------------------------------------------------------------------
+void UniformGridEnvironment::SortHandlesByBox() {
+  auto* rm = Simulation::GetActive()->GetResourceManager();
+
+  // box_start_[i + 1] = number of agents in box i
+  box_start_.resize(total_num_boxes_ + 1);
+  box_start_[0] = 0;
+#pragma omp parallel for
+  for (uint64_t i = 0; i < total_num_boxes_; ++i) {
+    box_start_[i + 1] = boxes_[i].Size(timestamp_);
+  }
+  InPlaceParallelPrefixSum(box_start_, total_num_boxes_ + 1);
+
+  sorted_handles_.resize(rm->GetNumAgents());
+#pragma omp parallel for schedule(dynamic, 256)
+  for (uint64_t i = 0; i < total_num_boxes_; ++i) {
+    auto idx = box_start_[i];
+    for (auto it = boxes_[i].begin(this); !it.IsAtEnd(); ++it) {
+      sorted_handles_[idx++] = *it;
+    }
+  }
+  sorted_boxes_valid_ = true;
+}
+
+// -----------------------------------------------------------------------------
+bool UniformGridEnvironment::UpdateIncrementally() {
+  auto* rm = Simulation::GetActive()->GetResourceManager();
+  auto* param = Simulation::GetActive()->GetParam();
+
+  if (!incremental_update_ready_) {
+    return false;
+  }
+  // Removed agents leave a tombstone in their box
+  if (rm->GetNumTombstones() != num_tombstones_) {
+    return false;
+  }
+  for (size_t n = 0; n < num_agents_per_numa_.size(); ++n) {
+    if (rm->GetAgentContainerSize(n) != num_agents_per_numa_[n]) {
+      return false;
+    }
+  }
+
+  // Agents must stay inside the grid without its padding. Otherwise, the grid
+  // has to grow.
+  std::array<real_t, 6> inner_grid;
+  for (int i = 0; i < 6; i++) {
+    inner_grid[i] = static_cast<real_t>(grid_dimensions_[i]) +
+                    (i % 2 == 0 ? box_length_ : -box_length_);
+  }
+
+  auto max_threads = ThreadInfo::GetInstance()->GetMaxThreads();
+  moved_agents_.resize(max_threads);
+  for (auto& moved_agents : moved_agents_) {
+    moved_agents.clear();
+  }
+
+  // Find agents that changed their box
+  std::atomic<bool> rebuild(false);
+  auto find_moved_agents = L2F([&](Agent* agent, AgentHandle ah) {
+    if (agent->GetUid() != agent_uids_[ah] ||
+        agent->GetDiameter() > largest_object_size_) {
+      rebuild = true;
+      return;
+    }
+    const auto& pos = agent->GetPosition();
+    if (pos[0] < inner_grid[0] || pos[0] >= inner_grid[1] ||
+        pos[1] < inner_grid[2] || pos[1] >= inner_grid[3] ||
+        pos[2] < inner_grid[4] || pos[2] >= inner_grid[5]) {
+      rebuild = true;
+      return;
+    }
+    if (GetBoxIndex(pos) != agent->GetBoxIdx()) {
+      auto tid = ThreadInfo::GetInstance()->GetMyThreadId();
+      moved_agents_[tid].push_back(ah);
+    }
+  });
+  rm->ForEachAgentParallel(param->scheduling_batch_size, find_moved_agents);
+  if (rebuild) {
+    return false;
+  }
+
+  // Remove the moved agents from their previous box. Insertion must not
+  // start before all removals are finished.
+#pragma omp parallel for schedule(dynamic, 1)
+  for (uint64_t t = 0; t < moved_agents_.size(); ++t) {
+    for (auto ah : moved_agents_[t]) {
+      auto* box = GetBoxPointer(rm->GetAgent(ah)->GetBoxIdx());
+      box->RemoveObject(ah, &successors_);
+    }
+  }
+
+  // Insert them into their new box
+#pragma omp parallel for schedule(dynamic, 1)
+  for (uint64_t t = 0; t < moved_agents_.size(); ++t) {
+    for (auto ah : moved_agents_[t]) {
+      auto* agent = rm->GetAgent(ah);
+      auto idx = GetBoxIndex(agent->GetPosition());
+      GetBoxPointer(idx)->AddObject(ah, &successors_, this);
+      agent->SetBoxIdx(static_cast<uint32_t>(idx));
+    }
+  }
+
+  has_grown_ = false;
+  sorted_boxes_valid_ = false;
+  agent_cache_valid_ = false;
+  verlet_lists_valid_ = false;
+  verlet_skin_ = 0;
+  box_max_diameter_valid_ = false;
+  UpdateSortedAgentData();
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+void UniformGridEnvironment::UpdateAgentCache() {
+  auto* rm = Simulation::GetActive()->GetResourceManager();
+  auto num_agents = rm->GetNumAgents();
+
+  sorted_x_.resize(num_agents);
+  sorted_y_.resize(num_agents);
+  sorted_z_.resize(num_agents);
+
+#pragma omp parallel for
+  for (uint64_t i = 0; i < num_agents; ++i) {
+    const auto& pos = rm->GetAgent(sorted_handles_[i])->GetPosition();
+    sorted_x_[i] = pos[0];
+    sorted_y_[i] = pos[1];
+    sorted_z_[i] = pos[2];
+  }
+}
+
+// -----------------------------------------------------------------------------
+void UniformGridEnvironment::BuildVerletLists(real_t skin) {
+  auto* rm = Simulation::GetActive()->GetResourceManager();
+  auto num_agents = sorted_handles_.size();
+
+  // The Verlet lists are collected with a search in the Moore neighborhood.
+  // Therefore, the list radius must not exceed the box length (e.g. if the
+  // box length was set manually).
+  verlet_skin_ = std::min(skin, box_length_ - largest_object_size_);
+  if (verlet_skin_ <= 0) {
+    verlet_skin_ = 0;
+    return;
+  }
+  auto list_radius = largest_object_size_ + verlet_skin_;
+  auto squared_list_radius = list_radius * list_radius;
+
+  // Calls f(k, l, n) for each agent l that is the n-th entry in the Verlet
+  // list of agent k. k and l are indices into the sorted arrays.
+  auto for_each_list_entry = [&](auto&& f) {
+#pragma omp parallel for schedule(dynamic, 64)
+    for (uint64_t i = 0; i < total_num_boxes_; ++i) {
+      if (box_start_[i] == box_start_[i + 1]) {
+        continue;
+      }
+      FixedSizeVector<uint64_t, 27> neighbor_boxes;
+      GetMooreBoxIndices(&neighbor_boxes, i);
+      for (uint64_t k = box_start_[i]; k < box_start_[i + 1]; ++k) {
+        uint64_t n = 0;
+        for (auto nidx : neighbor_boxes) {
+          auto end = box_start_[nidx + 1];
+          for (uint64_t l = box_start_[nidx]; l < end; ++l) {
+            const real_t dx = sorted_x_[l] - sorted_x_[k];
+            const real_t dy = sorted_y_[l] - sorted_y_[k];
+            const real_t dz = sorted_z_[l] - sorted_z_[k];
+            if (dx * dx + dy * dy + dz * dz < squared_list_radius && l != k) {
+              f(k, l, n++);
+            }
+          }
+        }
+      }
+    }
+  };
+
+  // Count the list entries of each agent and calculate the list starts
+  verlet_start_.resize(num_agents + 1);
+#pragma omp parallel for
+  for (uint64_t k = 0; k <= num_agents; ++k) {
+    verlet_start_[k] = 0;
+  }
+  for_each_list_entry([&](uint64_t k, uint64_t l, uint64_t n) {
+    verlet_start_[k + 1] = n + 1;
+  });
+  InPlaceParallelPrefixSum(verlet_start_, num_agents + 1);
+
+  // Fill the lists
+  verlet_neighbors_.resize(verlet_start_[num_agents]);
+  for_each_list_entry([&](uint64_t k, uint64_t l, uint64_t n) {
+    verlet_neighbors_[verlet_start_[k] + n] = static_cast<uint32_t>(l);
+  });
+
+  // The agent cache is refreshed at every update. Keep the positions that
+  // the lists have been built with separately.
+  sorted_uids_.resize(num_agents);
+  verlet_x_.resize(num_agents);
+  verlet_y_.resize(num_agents);
+  verlet_z_.resize(num_agents);
+#pragma omp parallel for
+  for (uint64_t k = 0; k < num_agents; ++k) {
+    sorted_uids_[k] = rm->GetAgent(sorted_handles_[k])->GetUid();
+    verlet_x_[k] = sorted_x_[k];
+    verlet_y_[k] = sorted_y_[k];
+    verlet_z_[k] = sorted_z_[k];
+  }
+  verlet_lists_valid_ = true;
+}
+
+// -----------------------------------------------------------------------------
+bool UniformGridEnvironment::VerletListsNeedRebuild() const {
+  auto* rm = Simulation::GetActive()->GetResourceManager();
+  auto num_agents = sorted_handles_.size();
+  if (!verlet_lists_valid_ || rm->GetNumAgents() != num_agents) {
+    return true;
+  }
+
+  const real_t max_displacement = verlet_skin_ / 2;
+  const real_t max_squared_displacement = max_displacement * max_displacement;
+  bool rebuild = false;
+#pragma omp parallel for reduction(|| : rebuild)
+  for (uint64_t k = 0; k < num_agents; ++k) {
+    auto ah = sorted_handles_[k];
+    // Agents that were added, removed or reordered invalidate the lists
+    if (ah.GetElementIdx() >= rm->GetAgentContainerSize(ah.GetNumaNode())) {
+      rebuild = true;
+      continue;
+    }
+    auto* agent = rm->GetAgent(ah);
+    if (agent == nullptr || agent->GetUid() != sorted_uids_[k] ||
+        agent->GetDiameter() > largest_object_size_) {
+      rebuild = true;
+      continue;
+    }
+    const auto& pos = agent->GetPosition();
+    const real_t dx = pos[0] - verlet_x_[k];
+    const real_t dy = pos[1] - verlet_y_[k];
+    const real_t dz = pos[2] - verlet_z_[k];
+    if (dx * dx + dy * dy + dz * dz > max_squared_displacement) {
+      rebuild = true;
+    }
+  }
+  return rebuild;
+}
+
+// -----------------------------------------------------------------------------
+bool UniformGridEnvironment::ForEachNeighborVerlet(
+    Functor<void, Agent*, real_t>& lambda, const Agent& query,
+    real_t squared_radius) {
+  auto box_idx = query.GetBoxIdx();
+  // Agents that have been created after the last rebuild are not part of the
+  // grid.
+  if (box_idx >= total_num_boxes_) {
+    return false;
+  }
+  auto* rm = Simulation::GetActive()->GetResourceManager();
+
+  // Determine the index of the query agent in the sorted arrays
+  auto k = box_start_[box_idx];
+  auto end = box_start_[box_idx + 1];
+  while (k < end && rm->GetAgent(sorted_handles_[k]) != &query) {
+    ++k;
+  }
+  if (k == end) {
+    return false;
+  }
+
+  const auto& pos = query.GetPosition();
+  for (uint64_t i = verlet_start_[k]; i < verlet_start_[k + 1]; ++i) {
+    auto* neighbor = rm->GetAgent(sorted_handles_[verlet_neighbors_[i]]);
+    auto squared_distance =
+        SquaredEuclideanDistance(pos, neighbor->GetPosition());
+    if (squared_distance < squared_radius) {
+      lambda(neighbor, squared_distance);
+    }
+  }
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+void UniformGridEnvironment::ForEachNeighborSorted(
+    Functor<void, Agent*, real_t>& lambda, const Real3& query_position,
+    real_t squared_radius, size_t box_idx, const Agent* query_agent,
+    real_t interaction_range) {
+  FixedSizeVector<uint64_t, 27> neighbor_boxes;
+  GetMooreBoxIndices(&neighbor_boxes, box_idx);
+  if (box_max_diameter_valid_) {
+    RemoveDistantBoxes(&neighbor_boxes, query_position, squared_radius,
+                       interaction_range);
+  }
+
+  auto* rm = Simulation::GetActive()->GetResourceManager();
+
+  const real_t qx = query_position[0];
+  const real_t qy = query_position[1];
+  const real_t qz = query_position[2];
+
+  const unsigned batch_size = 64;
+  Agent* agents[batch_size] __attribute__((aligned(64)));
+  real_t x[batch_size] __attribute__((aligned(64)));
+  real_t y[batch_size] __attribute__((aligned(64)));
+  real_t z[batch_size] __attribute__((aligned(64)));
+  real_t squared_distance[batch_size] __attribute__((aligned(64)));
+
+  for (auto nidx : neighbor_boxes) {
+    auto end = box_start_[nidx + 1];
+    for (uint64_t offset = box_start_[nidx]; offset < end;
+         offset += batch_size) {
+      uint64_t size = std::min<uint64_t>(batch_size, end - offset);
+      const real_t* bx = x;
+      const real_t* by = y;
+      const real_t* bz = z;
+      if (agent_cache_valid_) {
+        bx = sorted_x_.data() + offset;
+        by = sorted_y_.data() + offset;
+        bz = sorted_z_.data() + offset;
+      } else {
+        for (uint64_t i = 0; i < size; ++i) {
+          agents[i] = rm->GetAgent(sorted_handles_[offset + i]);
+          const auto& pos = agents[i]->GetPosition();
+          x[i] = pos[0];
+          y[i] = pos[1];
+          z[i] = pos[2];
+        }
+      }
+
+#pragma omp simd
+      for (uint64_t i = 0; i < size; ++i) {
+        const real_t dx = bx[i] - qx;
+        const real_t dy = by[i] - qy;
+        const real_t dz = bz[i] - qz;
+        squared_distance[i] = dx * dx + dy * dy + dz * dz;
+      }
+
+      for (uint64_t i = 0; i < size; ++i) {
+        if (squared_distance[i] < squared_radius) {
+          auto* agent = agent_cache_valid_
+                            ? rm->GetAgent(sorted_handles_[offset + i])
+                            : agents[i];
+          if (agent != query_agent) {
+            lambda(agent, squared_distance[i]);
+          }
+        }
+      }
+    }
+  }
+}
+
 // -----------------------------------------------------------------------------
 void UniformGridEnvironment::LoadBalanceInfoUG::CallHandleIteratorConsumer(
     uint64_t start, uint64_t end,
@@ -259,10 +760,12 @@ void UniformGridEnvironment::LoadBalanceInfoUG::CallHandleIteratorConsumer(
 
 // -----------------------------------------------------------------------------
 UniformGridEnvironment::LoadBalanceInfoUG::InitializeVectorFunctor::
-    InitializeVectorFunctor(UniformGridEnvironment* grid, uint64_t start,
+    InitializeVectorFunctor(UniformGridEnvironment* grid, const MortonOrder& mo,
+                            uint64_t start,
                             decltype(sorted_boxes) sorted_boxes,
                             decltype(cummulated_agents) cummulated_agents)
     : grid(grid),
+      mo(mo),
       start(start),
       sorted_boxes(sorted_boxes),
       cummulated_agents(cummulated_agents) {}
@@ -275,12 +778,7 @@ UniformGridEnvironment::LoadBalanceInfoUG::InitializeVectorFunctor::
 void UniformGridEnvironment::LoadBalanceInfoUG::InitializeVectorFunctor::
 operator()(Iterator<uint64_t>* it) {
   while (it->HasNext()) {
-    auto morton_code = it->Next();
-    uint_fast32_t x, y, z;
-    libmorton::morton3D_64_decode(morton_code, x, y, z);
-    auto* box = grid->GetBoxPointer(grid->GetBoxIndex(std::array<uint64_t, 3>{
-        static_cast<uint64_t>(x), static_cast<uint64_t>(y),
-        static_cast<uint64_t>(z)}));
+    auto* box = grid->GetBoxPointer(grid->GetBoxIndex(mo.Decode(it->Next())));
     sorted_boxes[start] = box;
     cummulated_agents[start] = box->Size(grid->timestamp_);
     start++;
@@ -309,11 +807,26 @@ void UniformGridEnvironment::ForEachNeighbor(Functor<void, Agent*>& functor,
                                              void* criteria) {
   auto idx = query.GetBoxIdx();
 
+  auto* rm = Simulation::GetActive()->GetResourceManager();
+
+  if (sorted_boxes_valid_) {
+    FixedSizeVector<uint64_t, 27> neighbor_boxes;
+    GetMooreBoxIndices(&neighbor_boxes, idx);
+    for (auto nidx : neighbor_boxes) {
+      auto end = box_start_[nidx + 1];
+      for (uint64_t i = box_start_[nidx]; i < end; ++i) {
+        auto* agent = rm->GetAgent(sorted_handles_[i]);
+        if (agent != &query) {
+          functor(agent);
+        }
+      }
+    }
+    return;
+  }
+
   FixedSizeVector<const Box*, 27> neighbor_boxes;
   GetMooreBoxes(&neighbor_boxes, idx);
 
-  auto* rm = Simulation::GetActive()->GetResourceManager();
-
   NeighborIterator ni(this, neighbor_boxes, timestamp_);
   const unsigned batch_size = 64;
   uint64_t size = 0;
@@ -342,4 +855,208 @@ void UniformGridEnvironment::ForEachNeighbor(Functor<void, Agent*>& functor,
   process_batch();
 }
 
+// -----------------------------------------------------------------------------
+void UniformGridEnvironment::ForEachNeighborPair(
+    Functor<void, Agent*, AgentHandle, Agent*, AgentHandle, real_t>& functor,
+    real_t squared_radius) {
+  CheckSearchRadius("UniformGridEnvironment::ForEachNeighborPair",
+                    squared_radius);
+
+#pragma omp parallel for schedule(dynamic, 64)
+  for (uint64_t i = 0; i < total_num_boxes_; ++i) {
+    ForEachNeighborPairOfBox(functor, squared_radius, i);
+  }
+}
+
+// -----------------------------------------------------------------------------
+void UniformGridEnvironment::ForEachNeighborPairByBoxColor(
+    Functor<void, Agent*, AgentHandle, Agent*, AgentHandle, real_t>& functor,
+    real_t squared_radius) {
+  CheckSearchRadius("UniformGridEnvironment::ForEachNeighborPairByBoxColor",
+                    squared_radius);
+
+#pragma omp parallel
+  for (uint64_t color = 0; color < 27; ++color) {
+    const uint64_t cx = color % 3;
+    const uint64_t cy = (color / 3) % 3;
+    const uint64_t cz = color / 9;
+    // The half Moore neighborhood of a box is part of its Moore
+    // neighborhood. Hence, the pairs of boxes with the same color contain
+    // disjoint sets of agents (see `ForEachAgentByBoxColor`).
+#pragma omp for collapse(3) schedule(dynamic, 16)
+    for (uint64_t z = cz; z < num_boxes_axis_[2]; z += 3) {
+      for (uint64_t y = cy; y < num_boxes_axis_[1]; y += 3) {
+        for (uint64_t x = cx; x < num_boxes_axis_[0]; x += 3) {
+          ForEachNeighborPairOfBox(
+              functor, squared_radius,
+              x + y * num_boxes_axis_[0] + z * num_boxes_xy_);
+        }
+      }
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------
+void UniformGridEnvironment::ForEachNeighborPairOfBox(
+    Functor<void, Agent*, AgentHandle, Agent*, AgentHandle, real_t>& functor,
+    real_t squared_radius, uint64_t box_idx) {
+  const auto* box = GetBoxPointer(box_idx);
+  // Non-empty boxes never lie in the padding layer of the grid. Therefore,
+  // all half Moore boxes of a non-empty box are valid.
+  if (box->IsEmpty(timestamp_)) {
+    return;
+  }
+
+  FixedSizeVector<size_t, 14> neighbor_boxes;
+  GetHalfMooreBoxIndices(&neighbor_boxes, box_idx);
+
+  if (sorted_boxes_valid_) {
+    ForEachNeighborPairSorted(functor, squared_radius, neighbor_boxes);
+    return;
+  }
+
+  auto* rm = Simulation::GetActive()->GetResourceManager();
+  for (auto it = box->begin(this); !it.IsAtEnd(); ++it) {
+    auto ah = *it;
+    auto* agent = rm->GetAgent(ah);
+    const auto& pos = agent->GetPosition();
+
+    auto visit = [&](AgentHandle nah) {
+      auto* neighbor = rm->GetAgent(nah);
+      auto squared_distance =
+          SquaredEuclideanDistance(pos, neighbor->GetPosition());
+      if (squared_distance < squared_radius) {
+        functor(agent, ah, neighbor, nah, squared_distance);
+      }
+    };
+
+    // Agents inside the same box: only pair with the remaining ones
+    auto nit = it;
+    for (++nit; !nit.IsAtEnd(); ++nit) {
+      visit(*nit);
+    }
+    // Agents inside the other half of the surrounding boxes
+    for (size_t j = 1; j < neighbor_boxes.size(); ++j) {
+      const auto* nbox = GetBoxPointer(neighbor_boxes[j]);
+      for (auto bit = nbox->begin(this); !bit.IsAtEnd(); ++bit) {
+        visit(*bit);
+      }
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------
+void UniformGridEnvironment::ForEachNeighborPairSorted(
+    Functor<void, Agent*, AgentHandle, Agent*, AgentHandle, real_t>& functor,
+    real_t squared_radius, const FixedSizeVector<size_t, 14>& neighbor_boxes) {
+  auto* rm = Simulation::GetActive()->GetResourceManager();
+  auto box_end = box_start_[neighbor_boxes[0] + 1];
+  for (uint64_t k = box_start_[neighbor_boxes[0]]; k < box_end; ++k) {
+    auto ah = sorted_handles_[k];
+    auto* agent = rm->GetAgent(ah);
+    const auto& pos = agent->GetPosition();
+
+    // Agents inside the same box: only pair with the remaining ones
+    uint64_t start = k + 1;
+    for (size_t j = 0; j < neighbor_boxes.size(); ++j) {
+      if (j != 0) {
+        start = box_start_[neighbor_boxes[j]];
+      }
+      auto end = box_start_[neighbor_boxes[j] + 1];
+      for (uint64_t l = start; l < end; ++l) {
+        real_t squared_distance;
+        Agent* neighbor = nullptr;
+        if (agent_cache_valid_) {
+          const real_t dx = sorted_x_[l] - sorted_x_[k];
+          const real_t dy = sorted_y_[l] - sorted_y_[k];
+          const real_t dz = sorted_z_[l] - sorted_z_[k];
+          squared_distance = dx * dx + dy * dy + dz * dz;
+        } else {
+          neighbor = rm->GetAgent(sorted_handles_[l]);
+          squared_distance =
+              SquaredEuclideanDistance(pos, neighbor->GetPosition());
+        }
+        if (squared_distance < squared_radius) {
+          if (neighbor == nullptr) {
+            neighbor = rm->GetAgent(sorted_handles_[l]);
+          }
+          functor(agent, ah, neighbor, sorted_handles_[l], squared_distance);
+        }
+      }
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------
+void UniformGridEnvironment::ForEachAgentByBoxColor(
+    Functor<void, Agent*, AgentHandle>& functor,
+    Functor<bool, Agent*>* filter) {
+  auto* rm = Simulation::GetActive()->GetResourceManager();
+  const auto num_agents = rm->GetNumAgents();
+  if (num_agents == 0) {
+    return;
+  }
+
+  uint64_t num_in_grid = 0;
+#pragma omp parallel reduction(+ : num_in_grid)
+  for (uint64_t color = 0; color < 27; ++color) {
+    const uint64_t cx = color % 3;
+    const uint64_t cy = (color / 3) % 3;
+    const uint64_t cz = color / 9;
+    // Boxes of the same color are at least three boxes apart along one axis.
+    // Therefore, their Moore neighborhoods are disjoint. The implicit barrier
+    // at the end of the loop separates the colors.
+#pragma omp for collapse(3) schedule(dynamic, 16)
+    for (uint64_t z = cz; z < num_boxes_axis_[2]; z += 3) {
+      for (uint64_t y = cy; y < num_boxes_axis_[1]; y += 3) {
+        for (uint64_t x = cx; x < num_boxes_axis_[0]; x += 3) {
+          const auto* box =
+              GetBoxPointer(x + y * num_boxes_axis_[0] + z * num_boxes_xy_);
+          for (auto it = box->begin(this); !it.IsAtEnd(); ++it) {
+            auto ah = *it;
+            auto* agent = rm->GetAgent(ah);
+            num_in_grid++;
+            if (!filter || (*filter)(agent)) {
+              functor(agent, ah);
+            }
+          }
+        }
+      }
+    }
+  }
+
+  if (num_in_grid < num_agents) {
+    VisitAgentsNotInGrid(functor, filter);
+  }
+}
+
+// -----------------------------------------------------------------------------
+void UniformGridEnvironment::VisitAgentsNotInGrid(
+    Functor<void, Agent*, AgentHandle>& functor,
+    Functor<bool, Agent*>* filter) {
+  auto* rm = Simulation::GetActive()->GetResourceManager();
+  auto* tinfo = ThreadInfo::GetInstance();
+  std::vector<std::vector<char>> in_grid(tinfo->GetNumaNodes());
+  for (int n = 0; n < tinfo->GetNumaNodes(); ++n) {
+    in_grid[n].assign(rm->GetAgentContainerSize(n), 0);
+  }
+  // Each agent is stored in exactly one box. Therefore, the flags can be set
+  // without synchronization.
+#pragma omp parallel for schedule(dynamic, 1024)
+  for (uint64_t i = 0; i < boxes_.size(); ++i) {
+    for (auto it = boxes_[i].begin(this); !it.IsAtEnd(); ++it) {
+      auto ah = *it;
+      in_grid[ah.GetNumaNode()][ah.GetElementIdx()] = 1;
+    }
+  }
+  // Agents that are not in the grid can be next to any other agent. Visit
+  // them one after another to keep the guarantees of the colored pass.
+  auto visit = [&](Agent* agent, AgentHandle ah) {
+    if (!in_grid[ah.GetNumaNode()][ah.GetElementIdx()]) {
+      functor(agent, ah);
+    }
+  };
+  rm->ForEachAgent(visit, filter);
+}
+
 }  // namespace bdm
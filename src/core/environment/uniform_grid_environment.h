@@ -40,11 +40,13 @@
 #include "core/container/math_array.h"
 #include "core/container/parallel_resize_vector.h"
 #include "core/environment/environment.h"
+#include "core/environment/hilbert_order.h"
 #include "core/environment/morton_order.h"
 #include "core/functor.h"
 #include "core/load_balance_info.h"
 #include "core/param/param.h"
 #include "core/resource_manager.h"
+#include "core/shape.h"
 #include "core/util/log.h"
 #include "core/util/spinlock.h"
 
@@ -91,8 +93,10 @@ class UniformGridEnvironment : public Environment {
       return *this;
     }
 
+    /// A box is empty if it has not been filled since the last full update,
+    /// or if all its agents have been removed (see `RemoveObject`)
     bool IsEmpty(uint64_t grid_timestamp) const {
-      return grid_timestamp != timestamp_;
+      return grid_timestamp != timestamp_ || length_ == 0;
     }
 
     uint16_t Size(uint64_t grid_timestamp) const {
@@ -125,6 +129,34 @@ class UniformGridEnvironment : public Environment {
       }
     }
 
+    /// @brief      Removes an agent from this box
+    ///
+    /// @param[in]  ah          The agent's handle
+    /// @param      successors  The successors
+    void RemoveObject(AgentHandle ah, AgentVector<AgentHandle>* successors) {
+      std::lock_guard<Spinlock> lock_guard(lock_);
+      if (start_ == ah) {
+        start_ = (*successors)[ah];
+      } else {
+        auto previous = start_;
+        for (uint16_t i = 1; i < length_; ++i) {
+          auto current = (*successors)[previous];
+          if (current == ah) {
+            (*successors)[previous] = (*successors)[ah];
+            break;
+          }
+          previous = current;
+        }
+      }
+      length_--;
+      if (length_ == 0) {
+        // Invalidate the box, such that the next `AddObject` starts a new
+        // list
+        timestamp_ = 0;
+        start_ = AgentHandle();
+      }
+    }
+
     /// An iterator that iterates over the cells in this box
     struct Iterator {
       Iterator(UniformGridEnvironment* grid, const Box* box)
@@ -252,6 +284,12 @@ class UniformGridEnvironment : public Environment {
     threshold_dimensions_ = {inf, -inf};
     successors_.clear();
     has_grown_ = false;
+    incremental_update_ready_ = false;
+    sorted_boxes_valid_ = false;
+    agent_cache_valid_ = false;
+    verlet_lists_valid_ = false;
+    verlet_skin_ = 0;
+    box_max_diameter_valid_ = false;
   }
 
   struct AssignToBoxesFunctor : public Functor<void, Agent*, AgentHandle> {
@@ -315,6 +353,40 @@ class UniformGridEnvironment : public Environment {
     return distance < squared_radius;
   }
 
+  /// Aborts the simulation if the neighborhood of `squared_radius` cannot be
+  /// determined completely with the current box length.
+  void CheckSearchRadius(const char* location, real_t squared_radius) const {
+    // Agents may have moved up to half the Verlet list skin since the grid
+    // was built.
+    real_t max_radius = box_length_ - verlet_skin_;
+    if (squared_radius > max_radius * max_radius) {
+      Log::Fatal(location, "The requested search radius (",
+                 std::sqrt(squared_radius), ")",
+                 " of the neighborhood search exceeds the "
+                 "maximum search radius (",
+                 max_radius, "). The resulting neighborhood would be "
+                 "incomplete.");
+    }
+  }
+
+  /// Returns the largest diameter in the Moore neighborhood of the box of
+  /// `query` (see `Param::adaptive_interaction_radius`).
+  real_t GetLargestAgentSizeInNeighborhood(const Agent& query) const override {
+    auto idx = query.GetBoxIdx();
+    // Agents that have been created after the last update are not part of the
+    // grid.
+    if (!box_max_diameter_valid_ || idx >= total_num_boxes_) {
+      return Math::kInfinity;
+    }
+    FixedSizeVector<uint64_t, 27> box_indices;
+    GetMooreBoxIndices(&box_indices, idx);
+    real_t max_diameter = 0;
+    for (auto i : box_indices) {
+      max_diameter = std::max(max_diameter, box_max_diameter_[i]);
+    }
+    return max_diameter;
+  }
+
   LoadBalanceInfo* GetLoadBalanceInfo() override {
     lbi_.Update();
     return &lbi_;
@@ -405,9 +477,33 @@ class UniformGridEnvironment : public Environment {
   ///
   void ForEachNeighbor(Functor<void, Agent*, real_t>& lambda,
                        const Agent& query, real_t squared_radius) override {
+    // The Verlet lists contain all neighbors within the largest agent size.
+    if (verlet_lists_valid_ &&
+        squared_radius <= largest_object_size_squared_ &&
+        ForEachNeighborVerlet(lambda, query, squared_radius)) {
+      return;
+    }
     ForEachNeighbor(lambda, query.GetPosition(), squared_radius, &query);
   }
 
+  /// Boxes are skipped based on the largest diameter of their own agents
+  /// (see `Param::adaptive_interaction_radius`).
+  void ForEachNeighborInInteractionRange(
+      Functor<void, Agent*, real_t>& lambda, const Agent& query,
+      real_t squared_radius, real_t sphere_interaction_margin) override {
+    if (verlet_lists_valid_ &&
+        squared_radius <= largest_object_size_squared_ &&
+        ForEachNeighborVerlet(lambda, query, squared_radius)) {
+      return;
+    }
+    real_t interaction_range = Math::kInfinity;
+    if (query.GetShape() == Shape::kSphere) {
+      interaction_range = 0.5 * query.GetDiameter() + sphere_interaction_margin;
+    }
+    ForEachNeighbor(lambda, query.GetPosition(), squared_radius, &query,
+                    interaction_range);
+  }
+
   /// @brief      Applies the given lambda to each neighbor of the specified
   ///             position within the squared radius.
   ///
@@ -421,14 +517,18 @@ class UniformGridEnvironment : public Environment {
   void ForEachNeighbor(Functor<void, Agent*, real_t>& lambda,
                        const Real3& query_position, real_t squared_radius,
                        const Agent* query_agent = nullptr) override {
-    if (squared_radius > box_length_squared_) {
-      Log::Fatal(
-          "UniformGridEnvironment::ForEachNeighbor",
-          "The requested search radius (", std::sqrt(squared_radius), ")",
-          " of the neighborhood search exceeds the "
-          "box length (",
-          box_length_, "). The resulting neighborhood would be incomplete.");
-    }
+    ForEachNeighbor(lambda, query_position, squared_radius, query_agent,
+                    Math::kInfinity);
+  }
+
+  /// Same as above, but boxes that are further away than `interaction_range`
+  /// plus half the largest diameter of their agents are skipped, if this
+  /// information is available (see `Param::adaptive_interaction_radius`).
+  void ForEachNeighbor(Functor<void, Agent*, real_t>& lambda,
+                       const Real3& query_position, real_t squared_radius,
+                       const Agent* query_agent, real_t interaction_range) {
+    CheckSearchRadius("UniformGridEnvironment::ForEachNeighbor",
+                      squared_radius);
     const auto& position = query_position;
     // Use uint32_t for compatibility with Agent::GetBoxIdx();
     uint32_t idx{std::numeric_limits<uint32_t>::max()};
@@ -466,8 +566,24 @@ class UniformGridEnvironment : public Environment {
       idx = static_cast<uint32_t>(idx_tmp);
     }
 
+    if (sorted_boxes_valid_) {
+      ForEachNeighborSorted(lambda, query_position, squared_radius, idx,
+                            query_agent, interaction_range);
+      return;
+    }
+
     FixedSizeVector<const Box*, 27> neighbor_boxes;
-    GetMooreBoxes(&neighbor_boxes, idx);
+    if (box_max_diameter_valid_) {
+      FixedSizeVector<uint64_t, 27> box_indices;
+      GetMooreBoxIndices(&box_indices, idx);
+      RemoveDistantBoxes(&box_indices, position, squared_radius,
+                         interaction_range);
+      for (auto i : box_indices) {
+        neighbor_boxes.push_back(GetBoxPointer(i));
+      }
+    } else {
+      GetMooreBoxes(&neighbor_boxes, idx);
+    }
 
     auto* rm = Simulation::GetActive()->GetResourceManager();
 
@@ -532,6 +648,59 @@ class UniformGridEnvironment : public Environment {
   void ForEachNeighbor(Functor<void, Agent*>& functor, const Agent& query,
                        void* criteria) override;
 
+  /// @brief      Applies the given functor once to each unordered pair of
+  ///             agents that are closer than sqrt(squared_radius).
+  ///
+  /// Each box is only paired with the boxes returned by
+  /// `GetHalfMooreBoxIndices`. Hence, every pair is visited exactly once
+  /// (in contrast to calling `ForEachNeighbor` for each agent, which visits
+  /// every pair twice).
+  /// Function invocations are parallelized over boxes. A pair is processed by
+  /// a single thread, but an agent can be part of pairs that are processed
+  /// concurrently by different threads.
+  ///
+  /// @param[in]  functor         Called with (agent, handle, neighbor,
+  ///                             neighbor handle, squared distance)
+  /// @param[in]  squared_radius  The squared search radius
+  ///
+  void ForEachNeighborPair(
+      Functor<void, Agent*, AgentHandle, Agent*, AgentHandle, real_t>& functor,
+      real_t squared_radius);
+
+  /// @brief      Same as `ForEachNeighborPair`, but the boxes are processed
+  ///             in 27 colors (see `ForEachAgentByBoxColor`).
+  ///
+  /// Pairs that are processed concurrently by different threads never share
+  /// an agent. Thus, the functor can update both agents of a pair (or data
+  /// indexed by them) without synchronization.
+  ///
+  /// @param[in]  functor         Called with (agent, handle, neighbor,
+  ///                             neighbor handle, squared distance)
+  /// @param[in]  squared_radius  The squared search radius
+  ///
+  void ForEachNeighborPairByBoxColor(
+      Functor<void, Agent*, AgentHandle, Agent*, AgentHandle, real_t>& functor,
+      real_t squared_radius);
+
+  /// @brief      Applies the given functor to each agent in the grid that
+  ///             passes the `filter` (if one is given).
+  ///
+  /// The boxes are divided into 27 colors according to their box coordinates
+  /// modulo three. The colors are processed one after another, and the boxes
+  /// of one color in parallel. Since the Moore neighborhoods of boxes with the
+  /// same color are disjoint, an agent can modify the agents in its
+  /// surrounding boxes without locks (see
+  /// `Param::ThreadSafetyMechanism::kBoxColoring`).
+  /// Agents that have been added since the last update are not in the grid
+  /// yet. They are visited afterwards, one after another.
+  ///
+  /// @param[in]  functor  Called with (agent, handle)
+  /// @param[in]  filter   Agents for which the filter returns false are
+  ///                      skipped
+  ///
+  void ForEachAgentByBoxColor(Functor<void, Agent*, AgentHandle>& functor,
+                              Functor<bool, Agent*>* filter = nullptr);
+
   // NeighborMutex ---------------------------------------------------------
 
   /// This class ensures thread-safety for the InPlaceExecutionContext for the
@@ -627,17 +796,20 @@ class UniformGridEnvironment : public Environment {
 
    private:
     UniformGridEnvironment* grid_;
-    MortonOrder mo_;
+    /// Space-filling curve selected by `Param::space_filling_curve`
+    std::unique_ptr<MortonOrder> mo_;
     ParallelResizeVector<Box*> sorted_boxes_;
     ParallelResizeVector<uint64_t> cummulated_agents_;
 
     struct InitializeVectorFunctor : public Functor<void, Iterator<uint64_t>*> {
       UniformGridEnvironment* grid;
+      const MortonOrder& mo;
       uint64_t start;
       ParallelResizeVector<Box*>& sorted_boxes;
       ParallelResizeVector<uint64_t>& cummulated_agents;
 
-      InitializeVectorFunctor(UniformGridEnvironment* grid, uint64_t start,
+      InitializeVectorFunctor(UniformGridEnvironment* grid,
+                              const MortonOrder& mo, uint64_t start,
                               decltype(sorted_boxes) sorted_boxes,
                               decltype(cummulated_agents) cummulated_agents);
       ~InitializeVectorFunctor() override;
@@ -689,12 +861,180 @@ class UniformGridEnvironment : public Environment {
 
   LoadBalanceInfoUG lbi_;  //!
 
+  /// True if the grid can be updated with `UpdateIncrementally`
+  bool incremental_update_ready_ = false;  //!
+  /// Uid of each agent at the time of the last full update
+  AgentVector<AgentUid> agent_uids_;  //!
+  /// Size of the agent container on each NUMA node at the time of the last
+  /// full update
+  std::vector<uint64_t> num_agents_per_numa_;  //!
+  /// Number of tombstones in the agent container at the time of the last full
+  /// update (see `Param::agent_removal_tombstones`)
+  uint64_t num_tombstones_ = 0;  //!
+  /// Per-thread buffers for agents that changed their box
+  std::vector<std::vector<AgentHandle>> moved_agents_;  //!
+
+  /// True if `box_start_` and `sorted_handles_` reflect the current state of
+  /// the grid (see `Param::uniform_grid_counting_sort` and
+  /// `Param::cache_agent_positions`).
+  bool sorted_boxes_valid_ = false;  //!
+  /// True if the structure-of-arrays agent cache below reflects the current
+  /// state of the grid (see `Param::cache_agent_positions`).
+  bool agent_cache_valid_ = false;  //!
+  /// The agents of box `i` are stored in the range
+  /// [box_start_[i], box_start_[i + 1]) of the sorted arrays below.
+  ParallelResizeVector<uint64_t> box_start_;  //!
+  /// Agent handles sorted by box
+  ParallelResizeVector<AgentHandle> sorted_handles_;  //!
+  /// Position of each agent inside its box. Only used during
+  /// `AssignToBoxesCountingSort`.
+  AgentVector<uint32_t> box_ranks_;  //!
+  /// Agent positions sorted by box. Stored as separate arrays to enable
+  /// vectorized distance calculations.
+  ParallelResizeVector<real_t> sorted_x_;  //!
+  ParallelResizeVector<real_t> sorted_y_;  //!
+  ParallelResizeVector<real_t> sorted_z_;  //!
+
+  /// True if the Verlet lists below are valid (see `Param::verlet_list_skin`)
+  bool verlet_lists_valid_ = false;  //!
+  /// Skin of the Verlet lists. Zero if Verlet lists are not used.
+  real_t verlet_skin_ = 0;  //!
+  /// The Verlet list of the agent with sorted index `k` is stored in
+  /// verlet_neighbors_[verlet_start_[k]] - verlet_neighbors_[verlet_start_[k+1]
+  /// - 1]. Entries are indices into the sorted arrays.
+  ParallelResizeVector<uint64_t> verlet_start_;     //!
+  ParallelResizeVector<uint32_t> verlet_neighbors_;  //!
+  /// Uids of the agents in `sorted_handles_` at the time the Verlet lists were
+  /// built. Used to detect added, removed or reordered agents.
+  ParallelResizeVector<AgentUid> sorted_uids_;  //!
+  /// Agent positions at the time the Verlet lists were built. Used to detect
+  /// agents that moved more than half the skin.
+  ParallelResizeVector<real_t> verlet_x_;  //!
+  ParallelResizeVector<real_t> verlet_y_;  //!
+  ParallelResizeVector<real_t> verlet_z_;  //!
+
+  /// True if `box_max_diameter_` reflects the current state of the grid
+  /// (see `Param::adaptive_interaction_radius`)
+  bool box_max_diameter_valid_ = false;  //!
+  /// Largest diameter of the agents in each box. Infinity if the box contains
+  /// non-spherical agents.
+  ParallelResizeVector<real_t> box_max_diameter_;  //!
+
   /// Holds instance of NeighborMutexBuilder.
   /// NeighborMutexBuilder is updated if `Param::thread_safety_mechanism`
   /// is set to `kAutomatic`
   std::unique_ptr<GridNeighborMutexBuilder> nb_mutex_builder_ =
       std::make_unique<GridNeighborMutexBuilder>();
 
+  /// Alternative to `AssignToBoxesFunctor` that builds the grid with a
+  /// parallel counting sort: (1) count the agents per box, (2) calculate
+  /// the start of each box with a prefix sum and (3) scatter the agent
+  /// handles into `sorted_handles_`. Afterwards, the agents of a box can be
+  /// iterated with a contiguous range scan. The linked lists of the boxes
+  /// are set up as well for code that relies on `Box::Iterator`.
+  void AssignToBoxesCountingSort();
+
+  /// Updates the grid by only relocating agents whose box has changed
+  /// (see `Param::uniform_grid_incremental_update`). Detecting the moved
+  /// agents still requires one pass over all agents; only the rebuild of the
+  /// boxes is restricted to the moved agents. Returns false without
+  /// modifying the grid if a full update is required: agents have been
+  /// added, removed or reordered, an agent left the grid, or an agent became
+  /// larger than the largest agent size.
+  bool UpdateIncrementally();
+
+  /// Builds the data structures that are derived from the box assignment
+  /// (sorted handles, agent cache, Verlet lists and largest diameter per box)
+  /// as required by `Param`.
+  void UpdateSortedAgentData();
+
+  /// Determines the largest diameter of the agents in each box.
+  void UpdateBoxMaxDiameters();
+
+  /// Serially calls `functor` for the agents that are not assigned to a box
+  /// (see `ForEachAgentByBoxColor`).
+  void VisitAgentsNotInGrid(Functor<void, Agent*, AgentHandle>& functor,
+                            Functor<bool, Agent*>* filter);
+
+  /// Removes all boxes from `box_indices` that are further away from
+  /// `position` than sqrt(squared_radius), or than `interaction_range` plus
+  /// half the largest diameter in the box. The first box (i.e. the query box)
+  /// is always kept.
+  void RemoveDistantBoxes(FixedSizeVector<uint64_t, 27>* box_indices,
+                          const Real3& position, real_t squared_radius,
+                          real_t interaction_range) const {
+    real_t search_radius = std::sqrt(squared_radius);
+    FixedSizeVector<uint64_t, 27> result;
+    result.push_back((*box_indices)[0]);
+    for (size_t i = 1; i < box_indices->size(); ++i) {
+      auto box_coord = GetBoxCoordinates((*box_indices)[i]);
+      real_t squared_distance = 0;
+      for (int d = 0; d < 3; ++d) {
+        real_t min = static_cast<real_t>(grid_dimensions_[2 * d]) +
+                     static_cast<real_t>(box_coord[d] * box_length_);
+        real_t max = min + box_length_;
+        real_t delta = std::max({min - position[d], real_t(0),
+                                 position[d] - max});
+        squared_distance += delta * delta;
+      }
+      real_t radius = std::min(
+          search_radius,
+          interaction_range + 0.5 * box_max_diameter_[(*box_indices)[i]]);
+      // Agents may have moved up to half the Verlet list skin since the grid
+      // was built.
+      radius += verlet_skin_ / 2;
+      if (squared_distance < radius * radius) {
+        result.push_back((*box_indices)[i]);
+      }
+    }
+    *box_indices = result;
+  }
+
+  /// Determines `box_start_` and `sorted_handles_` from the linked lists of
+  /// the boxes.
+  void SortHandlesByBox();
+
+  /// Copies the positions of all agents into the contiguous arrays
+  /// `sorted_*_` in box order. Requires `sorted_handles_`.
+  void UpdateAgentCache();
+
+  /// Builds a Verlet list for each agent that contains all agents within
+  /// the largest agent size plus `skin`. Requires `UpdateAgentCache`.
+  void BuildVerletLists(real_t skin);
+
+  /// Returns true if the Verlet lists are invalid, agents have been added,
+  /// removed or reordered, or if any agent has moved more than half the skin
+  /// since the lists were built.
+  bool VerletListsNeedRebuild() const;
+
+  /// Implementation of `ForEachNeighbor` that only checks the agents in the
+  /// Verlet list of `query`. Returns false if `query` is not part of the
+  /// Verlet lists (e.g. because it was created after the last rebuild).
+  bool ForEachNeighborVerlet(Functor<void, Agent*, real_t>& lambda,
+                             const Agent& query, real_t squared_radius);
+
+  /// Implementation of `ForEachNeighbor` that scans the contiguous agent
+  /// ranges of the boxes. If the structure-of-arrays agent cache is
+  /// available, agents are only accessed if they are within the search
+  /// radius.
+  void ForEachNeighborSorted(Functor<void, Agent*, real_t>& lambda,
+                             const Real3& query_position,
+                             real_t squared_radius, size_t box_idx,
+                             const Agent* query_agent,
+                             real_t interaction_range);
+
+  /// Calls `functor` for each pair of `ForEachNeighborPair` whose first
+  /// agent lies in box `box_idx`.
+  void ForEachNeighborPairOfBox(
+      Functor<void, Agent*, AgentHandle, Agent*, AgentHandle, real_t>& functor,
+      real_t squared_radius, uint64_t box_idx);
+
+  /// Implementation of `ForEachNeighborPair` for all agents in box
+  /// `neighbor_boxes[0]` that scans the contiguous agent ranges of the boxes.
+  void ForEachNeighborPairSorted(
+      Functor<void, Agent*, AgentHandle, Agent*, AgentHandle, real_t>& functor,
+      real_t squared_radius, const FixedSizeVector<size_t, 14>& neighbor_boxes);
+
   void CheckGridGrowth() {
     // Determine if the grid dimensions have changed (changed in the sense that
     // the grid has grown outwards)
@@ -13,6 +13,7 @@
 // -----------------------------------------------------------------------------
 
 #include "core/execution_context/copy_execution_context.h"
+#include <algorithm>
 #include "core/agent/agent.h"
 #include "core/resource_manager.h"
 #include "core/simulation.h"
@@ -48,6 +49,10 @@ CopyExecutionContext::CopyExecutionContext(
     Log::Fatal("CopyExecutionContext",
                "CopyExecutionContext does not support Param::execution_order = "
                "Param::ExecutionOrder::kForEachOpForEachAgent");
+  } else if (param->execution_order == Param::ExecutionOrder::kPlanned) {
+    Log::Fatal("CopyExecutionContext",
+               "CopyExecutionContext does not support Param::execution_order = "
+               "Param::ExecutionOrder::kPlanned");
   }
 }
 
@@ -62,7 +67,11 @@ void CopyExecutionContext::SetupIterationAll(
   auto* rm = Simulation::GetActive()->GetResourceManager();
   for (uint64_t n = 0; n < agents_->size(); ++n) {
     agents_->at(n).reserve(rm->GetAgentVectorCapacity(n));
-    agents_->at(n).resize(rm->GetNumAgents(n));
+    agents_->at(n).resize(rm->GetAgentContainerSize(n));
+    // Tombstones are not overwritten by a copy
+    if (rm->GetNumTombstones(n) != 0) {
+      std::fill(agents_->at(n).begin(), agents_->at(n).end(), nullptr);
+    }
   }
 
   auto* scheduler = Simulation::GetActive()->GetScheduler();
@@ -79,6 +79,16 @@ class ExecutionContext {
                                const Real3& query_position,
                                real_t squared_radius) = 0;
 
+  /// Applies the lambda `lambda` for each neighbor of the given `query`
+  /// agent within the given search radius `sqrt(squared_radius)`. Neighbors
+  /// outside the interaction range of `query` may be skipped
+  /// (see `Environment::ForEachNeighborInInteractionRange`).
+  virtual void ForEachNeighborInInteractionRange(
+      Functor<void, Agent*, real_t>& lambda, const Agent& query,
+      real_t squared_radius, real_t sphere_interaction_margin) {
+    ForEachNeighbor(lambda, query, squared_radius);
+  }
+
   /// @brief  Adds the agent to the simulation (threadsafe, takes ownership).
   ///         Note that we avoid the use of smart pointers for the agents to
   ///         avoid unnecessary overhead during construction of the agent
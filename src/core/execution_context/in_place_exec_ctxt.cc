@@ -216,7 +216,11 @@ void InPlaceExecutionContext::Execute(
       (*op)(agent);
     }
   } else if (param->thread_safety_mechanism ==
-             Param::ThreadSafetyMechanism::kNone) {
+                 Param::ThreadSafetyMechanism::kNone ||
+             param->thread_safety_mechanism ==
+                 Param::ThreadSafetyMechanism::kBoxColoring) {
+    // For kBoxColoring, the scheduler guarantees that no other thread
+    // processes an agent in the microenvironment of `agent`.
     neighbor_cache_.clear();
     cached_squared_search_radius_ = 0;
     for (auto* op : operations) {
@@ -297,6 +301,22 @@ void InPlaceExecutionContext::ForEachNeighbor(
   env->ForEachNeighbor(for_each, query_position, squared_radius);
 }
 
+void InPlaceExecutionContext::ForEachNeighborInInteractionRange(
+    Functor<void, Agent*, real_t>& lambda, const Agent& query,
+    real_t squared_radius, real_t sphere_interaction_margin) {
+  if (IsNeighborCacheValid(squared_radius)) {
+    for (auto& pair : neighbor_cache_) {
+      if (pair.second < squared_radius) {
+        lambda(pair.first, pair.second);
+      }
+    }
+    return;
+  }
+  auto* env = Simulation::GetActive()->GetEnvironment();
+  env->ForEachNeighborInInteractionRange(lambda, query, squared_radius,
+                                         sphere_interaction_margin);
+}
+
 Agent* InPlaceExecutionContext::GetAgent(const AgentUid& uid) {
   auto* sim = Simulation::GetActive();
   auto* rm = sim->GetResourceManager();
@@ -124,6 +124,12 @@ class InPlaceExecutionContext : public ExecutionContext {
                        const Real3& query_position,
                        real_t squared_radius) override;
 
+  /// Uses the neighbor cache if it is valid, but does not populate it,
+  /// because the environment might skip neighbors.
+  void ForEachNeighborInInteractionRange(
+      Functor<void, Agent*, real_t>& lambda, const Agent& query,
+      real_t squared_radius, real_t sphere_interaction_margin) override;
+
   void AddAgent(Agent* new_agent) override;
 
   void RemoveAgent(const AgentUid& uid) override;
@@ -16,6 +16,7 @@
 
 #include <algorithm>
 #include <cmath>
+#include <typeinfo>
 
 #include "core/agent/agent.h"
 #include "core/shape.h"
@@ -57,15 +58,24 @@ Real4 InteractionForce::Calculate(const Agent* lhs, const Agent* rhs) const {
   }
 }
 
+real_t InteractionForce::GetSphereInteractionMargin() const {
+  // Subclasses might override Calculate with a longer interaction range
+  if (typeid(*this) != typeid(InteractionForce)) {
+    return Math::kInfinity;
+  }
+  // ForceBetweenSpheres enlarges the radius of both spheres
+  return 2 * kSphereRadiusExtensionFactor * kSphereIofCoefficient;
+}
+
 void InteractionForce::ForceBetweenSpheres(const Agent* sphere_lhs,
                                            const Agent* sphere_rhs,
                                            Real3* result) const {
   const Real3& ref_mass_location = sphere_lhs->GetPosition();
   real_t ref_diameter = sphere_lhs->GetDiameter();
-  real_t ref_iof_coefficient = 0.15;
+  real_t ref_iof_coefficient = kSphereIofCoefficient;
   const Real3& nb_mass_location = sphere_rhs->GetPosition();
   real_t nb_diameter = sphere_rhs->GetDiameter();
-  real_t nb_iof_coefficient = 0.15;
+  real_t nb_iof_coefficient = kSphereIofCoefficient;
 
   auto c1 = ref_mass_location;
   real_t r1 = 0.5 * ref_diameter;
@@ -74,7 +84,8 @@ void InteractionForce::ForceBetweenSpheres(const Agent* sphere_lhs,
   // We take virtual bigger radii to have a distant interaction, to get a
   // desired density.
   real_t additional_radius =
-      10.0 * std::min(ref_iof_coefficient, nb_iof_coefficient);
+      kSphereRadiusExtensionFactor *
+      std::min(ref_iof_coefficient, nb_iof_coefficient);
   r1 += additional_radius;
   r2 += additional_radius;
   // the 3 components of the vector c2 -> c1
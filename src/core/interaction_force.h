@@ -33,7 +33,19 @@ class InteractionForce {
     return new InteractionForce(*this);
   }
 
+  /// Two spheres do not interact if the distance between their centers is
+  /// larger than the sum of their radii plus the returned value.
+  /// Used to reduce the search radius if `Param::adaptive_interaction_radius`
+  /// is enabled. Returns infinity for subclasses, unless they override it.
+  virtual real_t GetSphereInteractionMargin() const;
+
  private:
+  /// Inter-object force coefficient of spheres
+  static constexpr real_t kSphereIofCoefficient = 0.15;
+  /// `ForceBetweenSpheres` enlarges the radius of both spheres by this
+  /// factor times the inter-object force coefficient.
+  static constexpr real_t kSphereRadiusExtensionFactor = 10.0;
+
   void ForceBetweenSpheres(const Agent* sphere_lhs, const Agent* sphere_rhs,
                            Real3* result) const;
 
@@ -13,12 +13,15 @@
 // -----------------------------------------------------------------------------
 
 #include "core/memory/memory_manager.h"
+#include <sys/mman.h>
 #include <unistd.h>
 #include <algorithm>
 #include <cmath>
 #include <cstdlib>
+#include <iomanip>
 #include <limits>
 #include <mutex>
+#include <unordered_map>
 #include "core/util/log.h"
 #include "core/util/string.h"
 
@@ -191,23 +194,32 @@ void* NumaPoolAllocator::New(int tid) {
     assert(ret != nullptr);
     return ret;
   } else {
-    lock_.lock();
-    if (memory_blocks_.size() == 0 ||
-        memory_blocks_.back().IsFullyInitialized()) {
-      auto size =
-          std::max(total_size_ * (growth_rate_ - 1.0), size_n_pages_ * 2.0);
-      size = RoundUpTo(size, size_n_pages_);
-      AllocNewMemoryBlock(size);
-    }
     char* start_pointer;
     uint64_t size;
-    memory_blocks_.back().GetNextPageBatch(size_n_pages_, &start_pointer,
-                                           &size);
-    lock_.unlock();
+    lock_.lock();
+    if (!released_batches_.empty()) {
+      // reuse the address range of a batch that has been released by Trim
+      start_pointer = released_batches_.back();
+      released_batches_.pop_back();
+      size = size_n_pages_;
+    } else {
+      if (memory_blocks_.size() == 0 ||
+          memory_blocks_.back().IsFullyInitialized()) {
+        auto size =
+            std::max(total_size_ * (growth_rate_ - 1.0), size_n_pages_ * 2.0);
+        size = RoundUpTo(size, size_n_pages_);
+        AllocNewMemoryBlock(size);
+      }
+      memory_blocks_.back().GetNextPageBatch(size_n_pages_, &start_pointer,
+                                             &size);
+    }
     // remaining memory not enough to store one element
-    if ((size - kMetadataSize) < size_) {
+    if (size < kMetadataSize + size_) {
+      lock_.unlock();
       return New(tid);
     }
+    initialized_elements_ += (size - kMetadataSize) / size_;
+    lock_.unlock();
     InitializeNPages(&tl_list, start_pointer, size);
     auto* ret = tl_list.PopFront();
     assert(ret != nullptr);
@@ -230,8 +242,79 @@ void NumaPoolAllocator::Delete(void* p) {
   }
 }
 
+uint64_t NumaPoolAllocator::Trim() {
+  // Count the free elements of each N page batch
+  std::vector<List*> lists;
+  for (auto& list : free_lists_) {
+    lists.push_back(&list);
+  }
+  lists.push_back(&central_);
+  std::vector<std::vector<Node*>> nodes(lists.size());
+  std::unordered_map<uint64_t, uint64_t> free_elements;
+  auto get_batch = [&](Node* node) {
+    return reinterpret_cast<uint64_t>(node) & ~(size_n_pages_ - 1);
+  };
+  for (uint64_t i = 0; i < lists.size(); ++i) {
+    nodes[i].reserve(lists[i]->Size());
+    while (auto* node = lists[i]->PopFront()) {
+      nodes[i].push_back(node);
+      free_elements[get_batch(node)]++;
+    }
+  }
+
+  // Put the elements of batches that are still used back into their list.
+  // Only batches with size_n_pages_ bytes are considered; the last batch of a
+  // memory block might be smaller.
+  for (uint64_t i = 0; i < lists.size(); ++i) {
+    for (auto it = nodes[i].rbegin(); it != nodes[i].rend(); ++it) {
+      if (free_elements[get_batch(*it)] != num_elements_per_n_pages_) {
+        lists[i]->PushFront(*it);
+      }
+    }
+  }
+
+  uint64_t released = 0;
+  for (auto& el : free_elements) {
+    if (el.second == num_elements_per_n_pages_) {
+      auto* batch = reinterpret_cast<char*>(el.first);
+      madvise(batch, size_n_pages_, MADV_DONTNEED);
+      released_batches_.push_back(batch);
+      initialized_elements_ -= num_elements_per_n_pages_;
+      released += size_n_pages_;
+    }
+  }
+  return released;
+}
+
 uint64_t NumaPoolAllocator::GetSize() const { return size_; }
 
+int NumaPoolAllocator::GetNumaNode() const { return nid_; }
+
+uint64_t NumaPoolAllocator::GetNumMemoryBlocks() const {
+  return memory_blocks_.size();
+}
+
+uint64_t NumaPoolAllocator::GetReservedBytes() const {
+  return total_size_ - released_batches_.size() * size_n_pages_;
+}
+
+uint64_t NumaPoolAllocator::GetNumUsedElements() const {
+  return initialized_elements_ - GetNumThreadLocalFreeElements() -
+         GetNumCentralFreeElements();
+}
+
+uint64_t NumaPoolAllocator::GetNumThreadLocalFreeElements() const {
+  uint64_t elements = 0;
+  for (auto& list : free_lists_) {
+    elements += list.Size();
+  }
+  return elements;
+}
+
+uint64_t NumaPoolAllocator::GetNumCentralFreeElements() const {
+  return central_.Size();
+}
+
 void NumaPoolAllocator::AllocNewMemoryBlock(std::size_t size) {
   // check if size is multiple of N pages aligned
   assert((size & (size_n_pages_ - 1)) == 0 &&
@@ -264,6 +347,7 @@ void NumaPoolAllocator::InitializeNPages(List* tl_list, char* block,
     auto* head = new (pointer) Node();
     assert(head->next == nullptr);
     auto* tail = head;
+    pointer += size_;
 
     for (uint64_t i = 1; i < num_elements; ++i) {
       assert(pointer >= static_cast<char*>(block));
@@ -318,6 +402,19 @@ PoolAllocator::~PoolAllocator() {
   numa_allocators_.clear();
 }
 
+uint64_t PoolAllocator::Trim() {
+  uint64_t released = 0;
+  for (auto* el : numa_allocators_) {
+    released += el->Trim();
+  }
+  return released;
+}
+
+const std::vector<NumaPoolAllocator*>& PoolAllocator::GetNumaAllocators()
+    const {
+  return numa_allocators_;
+}
+
 void* PoolAllocator::New(std::size_t size) {
   assert(size_ == size && "Requested size does not match this PoolAllocator");
   auto tid = tinfo_->GetMyThreadId();
@@ -326,8 +423,222 @@ void* PoolAllocator::New(std::size_t size) {
   return numa_allocators_[nid]->New(tid);
 }
 
+// -----------------------------------------------------------------------------
+NumaArenaAllocator::NumaArenaAllocator(int nid, uint64_t size_n_pages,
+                                       real_t growth_rate)
+    : size_n_pages_(size_n_pages), growth_rate_(growth_rate), nid_(nid) {}
+
+NumaArenaAllocator::~NumaArenaAllocator() {
+  for (auto& block : memory_blocks_) {
+    uint64_t size = block.end_pointer_ - block.start_pointer_;
+    numa_free(block.start_pointer_, size);
+  }
+}
+
+char* NumaArenaAllocator::NewRegion() {
+  char* region = nullptr;
+  {
+    std::lock_guard<Spinlock> guard(lock_);
+    used_regions_++;
+    if (!free_regions_.empty()) {
+      region = free_regions_.back();
+      free_regions_.pop_back();
+    } else if (!released_regions_.empty()) {
+      region = released_regions_.back();
+      released_regions_.pop_back();
+    } else {
+      uint64_t size = 0;
+      while (size != size_n_pages_) {
+        if (memory_blocks_.size() == 0 ||
+            memory_blocks_.back().IsFullyInitialized()) {
+          auto block_size =
+              std::max(total_size_ * (growth_rate_ - 1.0), size_n_pages_ * 2.0);
+          AllocNewMemoryBlock(
+              NumaPoolAllocator::RoundUpTo(block_size, size_n_pages_));
+        }
+        // the last batch of a block is smaller than one region if the block
+        // is not N page aligned
+        memory_blocks_.back().GetNextPageBatch(size_n_pages_, &region, &size);
+      }
+    }
+  }
+  // The first write to a new region happens here on the calling thread,
+  // which runs on numa node `nid_`
+  *reinterpret_cast<uint64_t*>(region) =
+      reinterpret_cast<uint64_t>(this) | kTag;
+  new (GetReferences(region)) std::atomic<uint64_t>(1);
+  return region;
+}
+
+void NumaArenaAllocator::Acquire(char* region) {
+  GetReferences(region)->fetch_add(1, std::memory_order_relaxed);
+}
+
+void NumaArenaAllocator::Release(char* region) {
+  if (GetReferences(region)->fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    std::lock_guard<Spinlock> guard(lock_);
+    used_regions_--;
+    free_regions_.push_back(region);
+  }
+}
+
+uint64_t NumaArenaAllocator::Trim() {
+  for (auto* region : free_regions_) {
+    madvise(region, size_n_pages_, MADV_DONTNEED);
+    released_regions_.push_back(region);
+  }
+  uint64_t released = free_regions_.size() * size_n_pages_;
+  free_regions_.clear();
+  return released;
+}
+
+uint64_t NumaArenaAllocator::GetNumUsedRegions() const {
+  return used_regions_;
+}
+
+uint64_t NumaArenaAllocator::GetReservedBytes() const {
+  return total_size_ - released_regions_.size() * size_n_pages_;
+}
+
+std::atomic<uint64_t>* NumaArenaAllocator::GetReferences(char* region) {
+  return reinterpret_cast<std::atomic<uint64_t>*>(region + sizeof(uint64_t));
+}
+
+void NumaArenaAllocator::AllocNewMemoryBlock(std::size_t size) {
+  void* block = numa_alloc_onnode(size, nid_);
+  if (block == nullptr) {
+    Log::Fatal("NumaArenaAllocator::AllocNewMemoryBlock", "Allocation failed");
+  }
+  total_size_ += size;
+  auto n_pages_aligned =
+      NumaPoolAllocator::RoundUpTo(reinterpret_cast<uint64_t>(block),
+                                   size_n_pages_);
+  auto* start = reinterpret_cast<char*>(block);
+  memory_blocks_.push_back(
+      {start, start + size, reinterpret_cast<char*>(n_pages_aligned)});
+}
+
+// -----------------------------------------------------------------------------
+ArenaAllocator::ArenaAllocator(uint64_t size_n_pages, real_t growth_rate)
+    : size_n_pages_(size_n_pages), tinfo_(ThreadInfo::GetInstance()) {
+  thread_arenas_.resize(tinfo_->GetMaxThreads());
+  for (int nid = 0; nid < tinfo_->GetNumaNodes(); ++nid) {
+    void* ptr = numa_alloc_onnode(sizeof(NumaArenaAllocator), nid);
+    numa_allocators_.push_back(
+        new (ptr) NumaArenaAllocator(nid, size_n_pages, growth_rate));
+  }
+}
+
+ArenaAllocator::~ArenaAllocator() {
+  for (auto* el : numa_allocators_) {
+    el->~NumaArenaAllocator();
+    numa_free(el, sizeof(NumaArenaAllocator));
+  }
+  numa_allocators_.clear();
+}
+
+void* ArenaAllocator::New(std::size_t size) {
+  // same alignment as the pool allocators
+  size = NumaPoolAllocator::RoundUpTo(size, sizeof(uint64_t));
+  if (size > size_n_pages_ - NumaArenaAllocator::kMetadataSize) {
+    return nullptr;
+  }
+  auto tid = tinfo_->GetMyThreadId();
+  assert(static_cast<uint64_t>(tid) < thread_arenas_.size());
+  auto& arena = thread_arenas_[tid];
+  if (arena.region == nullptr || arena.next + size > arena.end) {
+    auto nid = tinfo_->GetNumaNode(tid);
+    auto* region = numa_allocators_[nid]->NewRegion();
+    if (arena.region != nullptr) {
+      auto header = *reinterpret_cast<uint64_t*>(arena.region);
+      reinterpret_cast<NumaArenaAllocator*>(header & ~NumaArenaAllocator::kTag)
+          ->Release(arena.region);
+    }
+    arena.region = region;
+    arena.next = region + NumaArenaAllocator::kMetadataSize;
+    arena.end = region + size_n_pages_;
+  }
+  auto* ret = arena.next;
+  arena.next += size;
+  NumaArenaAllocator::Acquire(arena.region);
+  return ret;
+}
+
+void ArenaAllocator::ReleaseRegions() {
+  for (auto& arena : thread_arenas_) {
+    if (arena.region != nullptr) {
+      auto header = *reinterpret_cast<uint64_t*>(arena.region);
+      reinterpret_cast<NumaArenaAllocator*>(header & ~NumaArenaAllocator::kTag)
+          ->Release(arena.region);
+    }
+    arena = ThreadArena();
+  }
+}
+
+uint64_t ArenaAllocator::Trim() {
+  uint64_t released = 0;
+  for (auto* el : numa_allocators_) {
+    released += el->Trim();
+  }
+  return released;
+}
+
+uint64_t ArenaAllocator::GetReservedBytes() const {
+  uint64_t bytes = 0;
+  for (auto* el : numa_allocators_) {
+    bytes += el->GetReservedBytes();
+  }
+  return bytes;
+}
+
+uint64_t ArenaAllocator::GetNumUsedRegions() const {
+  uint64_t regions = 0;
+  for (auto* el : numa_allocators_) {
+    regions += el->GetNumUsedRegions();
+  }
+  return regions;
+}
+
 }  // namespace memory_manager_detail
 
+// -----------------------------------------------------------------------------
+uint64_t MemoryStatistics::GetReservedBytes() const {
+  uint64_t bytes = arena_reserved_bytes;
+  for (auto& pool : pools) {
+    bytes += pool.reserved_bytes;
+  }
+  return bytes;
+}
+
+uint64_t MemoryStatistics::GetUsedBytes() const {
+  uint64_t bytes = 0;
+  for (auto& pool : pools) {
+    bytes += pool.used_bytes;
+  }
+  return bytes;
+}
+
+std::ostream& operator<<(std::ostream& os, const MemoryStatistics& stats) {
+  constexpr real_t kMB = 1048576.0;
+  os << "reserved (MB)\t\t\t: " << stats.GetReservedBytes() / kMB << std::endl;
+  os << "used by pools (MB)\t\t: " << stats.GetUsedBytes() / kMB << std::endl;
+  os << "arena regions\t\t\t: " << stats.arena_regions << " x "
+     << stats.arena_region_size << " bytes" << std::endl;
+  os << std::endl;
+  os << std::setw(10) << "size" << std::setw(6) << "numa" << std::setw(8)
+     << "blocks" << std::setw(16) << "reserved (MB)" << std::setw(12)
+     << "used (MB)" << std::setw(12) << "free (tl)" << std::setw(16)
+     << "free (central)" << std::endl;
+  for (auto& pool : stats.pools) {
+    os << std::setw(10) << pool.size << std::setw(6) << pool.numa_node
+       << std::setw(8) << pool.memory_blocks << std::setw(16)
+       << pool.reserved_bytes / kMB << std::setw(12) << pool.used_bytes / kMB
+       << std::setw(12) << pool.thread_local_free_elements << std::setw(16)
+       << pool.central_free_elements << std::endl;
+  }
+  return os;
+}
+
 // -----------------------------------------------------------------------------
 MemoryManager::MemoryManager(uint64_t aligned_pages_shift, real_t growth_rate,
                              uint64_t max_mem_per_thread_factor)
@@ -335,7 +646,9 @@ MemoryManager::MemoryManager(uint64_t aligned_pages_shift, real_t growth_rate,
       max_mem_per_thread_factor_(max_mem_per_thread_factor),
       page_size_(sysconf(_SC_PAGESIZE)),
       page_shift_(static_cast<uint64_t>(std::log2(page_size_))),
-      num_threads_(ThreadInfo::GetInstance()->GetMaxThreads()) {
+      num_threads_(ThreadInfo::GetInstance()->GetMaxThreads()),
+      tinfo_(ThreadInfo::GetInstance()),
+      size_class_caches_(num_threads_) {
   aligned_pages_shift_ = aligned_pages_shift;
   aligned_pages_ = (1 << aligned_pages_shift_);
   size_n_pages_ = (1 << (page_shift_ + aligned_pages_shift_));
@@ -347,43 +660,38 @@ MemoryManager::MemoryManager(uint64_t aligned_pages_shift, real_t growth_rate,
   }
 
   allocators_.reserve(num_threads_ * 2 + 100);
+  arena_ =
+      new memory_manager_detail::ArenaAllocator(size_n_pages_, growth_rate_);
 }
 
 MemoryManager::~MemoryManager() {
   for (auto& pair : allocators_) {
     delete pair.second;
   }
+  delete arena_;
 }
 
 void* MemoryManager::New(std::size_t size) {
-  if (allocators_.Capacity() > num_threads_) {
-    auto it = allocators_.find(size);
-    if (it != allocators_.end()) {
-      return it->second->New(size);
-    } else {
-      std::lock_guard<Spinlock> guard(lock_);
-      // check again, another thread might have created it in between
-      if (allocators_.find(size) == allocators_.end()) {
-        allocators_.insert(
-            std::make_pair(size, new memory_manager_detail::PoolAllocator(
-                                     size, size_n_pages_, growth_rate_,
-                                     max_mem_per_thread_factor_)));
-      }
-      return New(size);
+  if (arena_enabled_) {
+    if (auto* ret = arena_->New(size)) {
+      return ret;
     }
-  } else {
-    std::lock_guard<Spinlock> guard(lock_);
-    auto it = allocators_.find(size);
-    if (it != allocators_.end()) {
-      return it->second->New(size);
-    } else {
-      allocators_.insert(std::make_pair(
-          size,
-          new memory_manager_detail::PoolAllocator(
-              size, size_n_pages_, growth_rate_, max_mem_per_thread_factor_)));
-      return allocators_.find(size)->second;
+  }
+  // Fast path without access to shared data structures
+  auto tid = tinfo_->GetMyThreadId();
+  assert(static_cast<uint64_t>(tid) < size_class_caches_.size());
+  auto& cache = size_class_caches_[tid];
+  for (uint64_t i = 0; i < SizeClassCache::kEntries; ++i) {
+    if (cache.sizes[i] == size) {
+      return cache.allocators[i]->New(tid);
     }
   }
+
+  auto* npa = GetNumaPoolAllocator(size, tinfo_->GetNumaNode(tid));
+  cache.sizes[cache.next] = size;
+  cache.allocators[cache.next] = npa;
+  cache.next = (cache.next + 1) % SizeClassCache::kEntries;
+  return npa->New(tid);
 }
 
 void MemoryManager::Delete(void* p) {
@@ -394,11 +702,75 @@ void MemoryManager::Delete(void* p) {
   auto page_number = addr >> (page_shift_ + aligned_pages_shift_);
   auto* page_addr = reinterpret_cast<char*>(
       page_number << (page_shift_ + aligned_pages_shift_));
+  auto header = *reinterpret_cast<uint64_t*>(page_addr);
+  if (header & memory_manager_detail::NumaArenaAllocator::kTag) {
+    auto* naa = reinterpret_cast<memory_manager_detail::NumaArenaAllocator*>(
+        header & ~memory_manager_detail::NumaArenaAllocator::kTag);
+    naa->Release(page_addr);
+    return;
+  }
   auto* npa =
-      *reinterpret_cast<memory_manager_detail::NumaPoolAllocator**>(page_addr);
+      reinterpret_cast<memory_manager_detail::NumaPoolAllocator*>(header);
   npa->Delete(p);
 }
 
+memory_manager_detail::NumaPoolAllocator* MemoryManager::GetNumaPoolAllocator(
+    std::size_t size, int nid) {
+  std::lock_guard<Spinlock> guard(lock_);
+  auto it = allocators_.find(size);
+  if (it == allocators_.end()) {
+    allocators_.insert(std::make_pair(
+        size,
+        new memory_manager_detail::PoolAllocator(
+            size, size_n_pages_, growth_rate_, max_mem_per_thread_factor_)));
+    it = allocators_.find(size);
+  }
+  return it->second->GetNumaAllocators()[nid];
+}
+
 void MemoryManager::SetIgnoreDelete(bool value) { ignore_delete_ = value; }
 
+void MemoryManager::SetArenaEnabled(bool value) { arena_enabled_ = value; }
+
+void MemoryManager::ReleaseArenaRegions() { arena_->ReleaseRegions(); }
+
+uint64_t MemoryManager::GetNumArenaRegions() const {
+  return arena_->GetNumUsedRegions();
+}
+
+MemoryStatistics MemoryManager::GetStatistics() const {
+  MemoryStatistics stats;
+  for (auto& pair : allocators_) {
+    for (auto* npa : pair.second->GetNumaAllocators()) {
+      MemoryPoolStatistics pool;
+      pool.size = npa->GetSize();
+      pool.numa_node = npa->GetNumaNode();
+      pool.memory_blocks = npa->GetNumMemoryBlocks();
+      pool.reserved_bytes = npa->GetReservedBytes();
+      pool.used_bytes = npa->GetNumUsedElements() * npa->GetSize();
+      pool.thread_local_free_elements = npa->GetNumThreadLocalFreeElements();
+      pool.central_free_elements = npa->GetNumCentralFreeElements();
+      stats.pools.push_back(pool);
+    }
+  }
+  std::sort(stats.pools.begin(), stats.pools.end(),
+            [](const MemoryPoolStatistics& lhs,
+               const MemoryPoolStatistics& rhs) {
+              return lhs.size < rhs.size ||
+                     (lhs.size == rhs.size && lhs.numa_node < rhs.numa_node);
+            });
+  stats.arena_regions = arena_->GetNumUsedRegions();
+  stats.arena_region_size = size_n_pages_;
+  stats.arena_reserved_bytes = arena_->GetReservedBytes();
+  return stats;
+}
+
+uint64_t MemoryManager::Trim() {
+  uint64_t released = arena_->Trim();
+  for (auto& pair : allocators_) {
+    released += pair.second->Trim();
+  }
+  return released;
+}
+
 }  // namespace bdm
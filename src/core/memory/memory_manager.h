@@ -15,12 +15,15 @@
 #ifndef CORE_MEMORY_MEMORY_MANAGER_H_
 #define CORE_MEMORY_MEMORY_MANAGER_H_
 
+#include <atomic>
 #include <cassert>
 #include <list>
+#include <ostream>
 #include <utility>
 #include <vector>
 
 #include "core/container/flatmap.h"
+#include "core/container/shared_data.h"
 #include "core/real_t.h"
 #include "core/util/numa.h"
 #include "core/util/spinlock.h"
@@ -104,8 +107,32 @@ class NumaPoolAllocator {
 
   void Delete(void* p);
 
+  /// Returns the physical memory of N page batches in which all elements are
+  /// free to the operating system. The virtual address range is kept and
+  /// reused before a new memory block is allocated. Must not be called in
+  /// parallel with `New` or `Delete`.\n
+  /// Returns the number of released bytes.
+  uint64_t Trim();
+
   uint64_t GetSize() const;
 
+  int GetNumaNode() const;
+
+  uint64_t GetNumMemoryBlocks() const;
+
+  /// Returns the number of bytes allocated from the operating system minus
+  /// the bytes released by `Trim`.
+  uint64_t GetReservedBytes() const;
+
+  /// Returns the number of elements that are currently allocated.
+  uint64_t GetNumUsedElements() const;
+
+  /// Returns the number of elements in the thread-local free lists.
+  uint64_t GetNumThreadLocalFreeElements() const;
+
+  /// Returns the number of elements in the central free list.
+  uint64_t GetNumCentralFreeElements() const;
+
  private:
   static constexpr uint64_t kMetadataSize = 8;
   uint64_t size_n_pages_;
@@ -117,6 +144,10 @@ class NumaPoolAllocator {
   int nid_;
   ThreadInfo* tinfo_;
   std::vector<AllocatedBlock> memory_blocks_;
+  /// N page batches whose memory has been released by `Trim`
+  std::vector<char*> released_batches_;
+  /// Number of elements in all initialized N page batches
+  uint64_t initialized_elements_ = 0;
   std::vector<List> free_lists_;  // one per thread
   List central_;
   Spinlock lock_;
@@ -138,14 +169,148 @@ class PoolAllocator {
 
   void* New(std::size_t size);
 
+  /// See `NumaPoolAllocator::Trim`
+  uint64_t Trim();
+
+  const std::vector<NumaPoolAllocator*>& GetNumaAllocators() const;
+
  private:
   std::size_t size_;
   ThreadInfo* tinfo_;
   std::vector<NumaPoolAllocator*> numa_allocators_;
 };
 
+/// Manages the memory regions of one numa node that are used by
+/// `ArenaAllocator`. \n
+/// Each region is N page aligned. It starts with the tagged pointer to this
+/// allocator, such that `MemoryManager::Delete` can distinguish it from the
+/// memory of a `NumaPoolAllocator`, followed by a reference count. Each object
+/// in the region holds one reference, and so does the thread that currently
+/// allocates from it. Once the last reference has been released, the region
+/// is reused.
+class NumaArenaAllocator {
+ public:
+  static constexpr uint64_t kTag = 1;
+  static constexpr uint64_t kMetadataSize = 16;
+
+  NumaArenaAllocator(int nid, uint64_t size_n_pages, real_t growth_rate);
+
+  ~NumaArenaAllocator();
+
+  /// Returns a region with one reference.
+  char* NewRegion();
+
+  static void Acquire(char* region);
+
+  void Release(char* region);
+
+  /// Returns the physical memory of free regions to the operating system.
+  /// Must not be called in parallel with `NewRegion`.\n
+  /// Returns the number of released bytes.
+  uint64_t Trim();
+
+  /// Returns the number of regions that have been handed out and not been
+  /// released yet.
+  uint64_t GetNumUsedRegions() const;
+
+  /// Returns the number of bytes allocated from the operating system minus
+  /// the bytes released by `Trim`.
+  uint64_t GetReservedBytes() const;
+
+ private:
+  uint64_t size_n_pages_;
+  real_t growth_rate_;
+  uint64_t total_size_ = 0;
+  int nid_;
+  std::vector<AllocatedBlock> memory_blocks_;
+  std::vector<char*> free_regions_;
+  /// Free regions whose memory has been released by `Trim`
+  std::vector<char*> released_regions_;
+  uint64_t used_regions_ = 0;
+  Spinlock lock_;
+
+  static std::atomic<uint64_t>* GetReferences(char* region);
+
+  void AllocNewMemoryBlock(std::size_t size);
+};
+
+/// Per-thread bump allocator. Each thread allocates from its own region of
+/// the numa node it is running on, by incrementing a pointer. Objects are
+/// neither moved nor freed individually; a region is reused once all its
+/// objects have been deleted.
+class ArenaAllocator {
+ public:
+  ArenaAllocator(uint64_t size_n_pages, real_t growth_rate);
+
+  ArenaAllocator(const ArenaAllocator& other) = delete;
+
+  ~ArenaAllocator();
+
+  /// Returns nullptr if `size` exceeds the capacity of one region.
+  void* New(std::size_t size);
+
+  /// Releases the regions that are currently used for allocations.
+  void ReleaseRegions();
+
+  /// See `NumaArenaAllocator::Trim`
+  uint64_t Trim();
+
+  /// See `NumaArenaAllocator::GetNumUsedRegions`
+  uint64_t GetNumUsedRegions() const;
+
+  /// See `NumaArenaAllocator::GetReservedBytes`
+  uint64_t GetReservedBytes() const;
+
+ private:
+  struct alignas(hardware_destructive_interference_size) ThreadArena {
+    char* region = nullptr;
+    char* next = nullptr;
+    char* end = nullptr;
+  };
+
+  uint64_t size_n_pages_;
+  ThreadInfo* tinfo_;
+  std::vector<ThreadArena> thread_arenas_;
+  std::vector<NumaArenaAllocator*> numa_allocators_;
+};
+
 }  // namespace memory_manager_detail
 
+/// Memory usage of the pool allocator for one allocation size on one numa
+/// node.
+struct MemoryPoolStatistics {
+  /// Allocation size in bytes
+  uint64_t size = 0;
+  int numa_node = 0;
+  uint64_t memory_blocks = 0;
+  /// Bytes allocated from the operating system and not released again
+  uint64_t reserved_bytes = 0;
+  /// Bytes of the elements that are currently allocated
+  uint64_t used_bytes = 0;
+  uint64_t thread_local_free_elements = 0;
+  uint64_t central_free_elements = 0;
+};
+
+/// Memory usage of the `MemoryManager`.
+/// Obtain it with
+/// `Simulation::GetActive()->GetMemoryManager()->GetStatistics()`.
+struct MemoryStatistics {
+  std::vector<MemoryPoolStatistics> pools;
+  /// Number of arena regions that contain live objects or are used for
+  /// allocations
+  uint64_t arena_regions = 0;
+  uint64_t arena_region_size = 0;
+  /// Bytes allocated for the arena and not released again
+  uint64_t arena_reserved_bytes = 0;
+
+  uint64_t GetReservedBytes() const;
+
+  uint64_t GetUsedBytes() const;
+
+  friend std::ostream& operator<<(std::ostream& os,
+                                  const MemoryStatistics& stats);
+};
+
 class MemoryManager {
  public:
   MemoryManager(uint64_t aligned_pages_shift, real_t growth_rate,
@@ -153,12 +318,39 @@ class MemoryManager {
 
   ~MemoryManager();
 
+  /// Allocation sizes that have been used recently by the calling thread are
+  /// served without locking or accessing shared data structures.
   void* New(std::size_t size);
 
   void Delete(void* p);
 
   void SetIgnoreDelete(bool value);
 
+  /// If enabled, `New` allocates from a per-thread bump arena instead of the
+  /// pool allocators. Must not be called in parallel regions.
+  void SetArenaEnabled(bool value);
+
+  /// Releases the arena regions that are currently used for allocations,
+  /// such that they can be reused once all their objects have been deleted.
+  /// Called at the end of `Scheduler::Simulate` and
+  /// `Scheduler::SimulateUntil`. Must not be called in parallel regions.
+  void ReleaseArenaRegions();
+
+  /// Returns the number of arena regions that contain live objects or are
+  /// used for allocations.
+  uint64_t GetNumArenaRegions() const;
+
+  /// Returns the memory usage per allocation size and numa node. Must not be
+  /// called in parallel with `New` or `Delete`.
+  MemoryStatistics GetStatistics() const;
+
+  /// Returns memory that is not used anymore to the operating system (e.g.
+  /// after many agents have been removed). Only N page batches in which all
+  /// elements are free can be released, because allocated objects are not
+  /// moved. Must not be called in parallel with `New` or `Delete`.\n
+  /// Returns the number of released bytes.
+  uint64_t Trim();
+
  private:
   real_t growth_rate_;
   uint64_t max_mem_per_thread_factor_;
@@ -168,12 +360,33 @@ class MemoryManager {
   uint64_t aligned_pages_;
   uint64_t size_n_pages_;
   uint64_t num_threads_;
+  ThreadInfo* tinfo_;
   bool ignore_delete_ = false;
-
+  bool arena_enabled_ = false;
+  memory_manager_detail::ArenaAllocator* arena_ = nullptr;
+
+  /// Maps the most recently used allocation sizes of one thread to the pool
+  /// allocator of the thread's numa node. Entries are replaced in round robin
+  /// order.
+  struct alignas(hardware_destructive_interference_size) SizeClassCache {
+    static constexpr uint64_t kEntries = 8;
+    std::size_t sizes[kEntries] = {};
+    memory_manager_detail::NumaPoolAllocator* allocators[kEntries] = {};
+    uint64_t next = 0;
+  };
+  /// One per thread. Only accessed by the owning thread.
+  std::vector<SizeClassCache> size_class_caches_;
+
+  /// Only accessed while holding `lock_`
   UnorderedFlatmap<std::size_t, memory_manager_detail::PoolAllocator*>
       allocators_;
 
   Spinlock lock_;
+
+  /// Returns the pool allocator for `size` on numa node `nid` and creates it
+  /// if it does not exist yet.
+  memory_manager_detail::NumaPoolAllocator* GetNumaPoolAllocator(
+      std::size_t size, int nid);
 };
 
 }  // namespace bdm
@@ -0,0 +1,114 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN & University of Surrey for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+// See the NOTICE file distributed with this work for additional information
+// regarding copyright ownership.
+//
+// -----------------------------------------------------------------------------
+
+#include "core/operation/agent_op_planner.h"
+
+namespace bdm {
+
+// -----------------------------------------------------------------------------
+std::vector<AgentOpPlanner::Pass> AgentOpPlanner::Plan(
+    const std::vector<Operation*>& agent_ops,
+    Param::AgentOpFusion fusion) const {
+  // Split the operations into groups. Operations that modify other agents
+  // form a group on their own.
+  std::vector<std::vector<Operation*>> groups;
+  bool open_group = false;
+  for (auto* op : agent_ops) {
+    if (op->ModifiesOtherAgents()) {
+      groups.push_back({op});
+      open_group = false;
+    } else {
+      if (!open_group) {
+        groups.emplace_back();
+        open_group = true;
+      }
+      groups.back().push_back(op);
+    }
+  }
+
+  std::vector<Pass> plan;
+  for (auto& ops : groups) {
+    if (ops.size() == 1) {
+      plan.push_back({ops, ops[0]->name_, "", true});
+      continue;
+    }
+    std::string name = ops[0]->name_;
+    for (size_t i = 1; i < ops.size(); ++i) {
+      name += " + " + ops[i]->name_;
+    }
+    bool fused = fusion == Param::AgentOpFusion::kAlwaysFuse ||
+                 (fusion == Param::AgentOpFusion::kMeasureFusion &&
+                  IsFused(name));
+    if (fused) {
+      plan.push_back({ops, name, name, true});
+    } else {
+      for (auto* op : ops) {
+        plan.push_back({{op}, op->name_, name, false});
+      }
+    }
+  }
+  return plan;
+}
+
+// -----------------------------------------------------------------------------
+void AgentOpPlanner::Update(const std::vector<Pass>& plan,
+                            const std::vector<int64_t>& durations) {
+  for (size_t i = 0; i < plan.size(); ++i) {
+    const auto& group = plan[i].group;
+    if (group.empty()) {
+      continue;
+    }
+    bool fused = plan[i].fused;
+    int64_t duration = durations[i];
+    // The passes of a group are consecutive. Groups with the same operations
+    // are separated by at least one operation that modifies other agents.
+    while (i + 1 < plan.size() && plan[i + 1].group == group) {
+      duration += durations[++i];
+    }
+
+    auto& stats = stats_[group];
+    if (fused) {
+      stats.fused_time += duration;
+      stats.fused_samples++;
+    } else {
+      stats.split_time += duration;
+      stats.split_samples++;
+    }
+    stats.executions++;
+    if (stats.executions % kReevaluationInterval == 0) {
+      auto executions = stats.executions;
+      stats = GroupStats();
+      stats.executions = executions;
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------
+bool AgentOpPlanner::IsFused(const std::string& group) const {
+  auto it = stats_.find(group);
+  if (it == stats_.end()) {
+    return true;
+  }
+  const auto& stats = it->second;
+  if (stats.fused_samples < kSamples) {
+    return true;
+  } else if (stats.split_samples < kSamples) {
+    return false;
+  }
+  // Compare the average runtimes
+  return stats.fused_time * static_cast<int64_t>(stats.split_samples) <=
+         stats.split_time * static_cast<int64_t>(stats.fused_samples);
+}
+
+}  // namespace bdm
@@ -0,0 +1,87 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN & University of Surrey for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+// See the NOTICE file distributed with this work for additional information
+// regarding copyright ownership.
+//
+// -----------------------------------------------------------------------------
+
+#ifndef CORE_OPERATION_AGENT_OP_PLANNER_H_
+#define CORE_OPERATION_AGENT_OP_PLANNER_H_
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "core/operation/operation.h"
+#include "core/param/param.h"
+
+namespace bdm {
+
+/// Determines the passes over all agents for the agent operations of an
+/// iteration if `Param::execution_order` is set to `kPlanned`.\n
+/// An operation that modifies other agents (see
+/// `Operation::ModifiesOtherAgents`) is executed in a separate pass, such
+/// that all subsequent operations observe its changes. Consecutive
+/// operations that do not modify other agents form a group. A group is
+/// either executed in one fused pass, which calls all its operations for one
+/// agent before moving to the next agent, or in one pass per operation (see
+/// `Param::agent_op_fusion`). With `Param::AgentOpFusion::kMeasureFusion`,
+/// the planner measures both variants and selects the faster one.
+class AgentOpPlanner {
+ public:
+  /// A pass over all agents that executes `ops` for each agent
+  struct Pass {
+    std::vector<Operation*> ops;
+    /// Operation names joined by " + "
+    std::string name;
+    /// Operation names of the group this pass belongs to. Empty if the group
+    /// consists of a single operation.
+    std::string group;
+    /// True if all operations of the group are executed in this pass
+    bool fused;
+  };
+
+  /// Number of measurements of each variant before the faster one is
+  /// selected
+  static constexpr uint64_t kSamples = 3;
+  /// Number of executions of a group after which both variants are measured
+  /// again, because the cost of the operations changes with the simulation
+  static constexpr uint64_t kReevaluationInterval = 100;
+
+  /// Returns the passes for `agent_ops`.
+  std::vector<Pass> Plan(const std::vector<Operation*>& agent_ops,
+                         Param::AgentOpFusion fusion) const;
+
+  /// Updates the cost model with the runtime of each pass of `plan` in
+  /// nanoseconds.
+  void Update(const std::vector<Pass>& plan,
+              const std::vector<int64_t>& durations);
+
+  /// Returns true if the measurements select a fused pass for the group with
+  /// the given operation names.
+  bool IsFused(const std::string& group) const;
+
+ private:
+  /// Runtime measurements of a group
+  struct GroupStats {
+    int64_t fused_time = 0;
+    int64_t split_time = 0;
+    uint64_t fused_samples = 0;
+    uint64_t split_samples = 0;
+    uint64_t executions = 0;
+  };
+
+  std::unordered_map<std::string, GroupStats> stats_;
+};
+
+}  // namespace bdm
+
+#endif  // CORE_OPERATION_AGENT_OP_PLANNER_H_
@@ -76,6 +76,8 @@ struct BoundSpace : public AgentOperationImpl {
                        param->max_bound);
     }
   }
+
+  bool ModifiesOtherAgents() const override { return false; }
 };
 
 }  // namespace bdm
@@ -21,6 +21,7 @@
 
 #include "core/container/inline_vector.h"
 #include "core/diffusion/diffusion_grid.h"
+#include "core/diffusion/euler_grid.h"
 #include "core/environment/environment.h"
 #include "core/operation/operation.h"
 #include "core/operation/operation_registry.h"
@@ -53,7 +54,10 @@ class ContinuumOp : public StandaloneOperationImpl {
       return;
     }
 
-    rm->ForEachContinuum([this, &env, &param](Continuum* cm) {
+    // Euler grids that are integrated together (see
+    // Param::fuse_diffusion_grids)
+    std::vector<EulerGrid*> fused_grids;
+    rm->ForEachContinuum([this, &env, &param, &fused_grids](Continuum* cm) {
       // Update the diffusion grid dimension if the environment dimensions
       // have changed. If the space is bound, we do not need to update the
       // dimensions, because these should not be changing anyway
@@ -61,12 +65,26 @@ class ContinuumOp : public StandaloneOperationImpl {
           param->bound_space == Param::BoundSpaceMode::kOpen) {
         cm->Update();
       }
+      auto* egrid = dynamic_cast<EulerGrid*>(cm);
+      if (egrid && param->fuse_diffusion_grids) {
+        fused_grids.push_back(egrid);
+        return;
+      }
       cm->IntegrateTimeAsynchronously(delta_t_);
       auto* dgrid = dynamic_cast<DiffusionGrid*>(cm);
       if (dgrid && param->calculate_gradients) {
         dgrid->CalculateGradient();
       }
     });
+
+    if (!fused_grids.empty()) {
+      EulerGrid::IntegrateTimeFused(fused_grids, delta_t_);
+      if (param->calculate_gradients) {
+        for (auto* egrid : fused_grids) {
+          egrid->CalculateGradient();
+        }
+      }
+    }
   }
 
  private:
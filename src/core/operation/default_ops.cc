@@ -20,7 +20,9 @@
 #include "core/operation/mechanical_forces_op.h"
 #include "core/operation/mechanical_forces_op_cuda.h"
 #include "core/operation/mechanical_forces_op_opencl.h"
+#include "core/operation/mechanical_forces_op_symmetric.h"
 #include "core/operation/operation.h"
+#include "core/operation/trim_memory_op.h"
 #include "core/operation/visualization_op.h"
 
 namespace bdm {
@@ -35,12 +37,18 @@ BDM_REGISTER_OP_WITH_FREQ(LoadBalancingOp, "load balancing", kCpu,
 
 BDM_REGISTER_OP(MechanicalForcesOp, "mechanical forces", kCpu);
 
+BDM_REGISTER_OP(MechanicalForcesOpSymmetric, "symmetric mechanical forces",
+                kCpu);
+
 #ifdef USE_CUDA
 BDM_REGISTER_OP(MechanicalForcesOpCuda, "mechanical forces", kCuda);
 #endif
 
 BDM_REGISTER_OP(DividingCellOp, "DividingCellOp", kCpu);
 
+// The frequency is set to `Param::mem_mgr_trim_frequency` by the scheduler.
+BDM_REGISTER_OP(TrimMemoryOp, "trim memory", kCpu);
+
 #if defined(USE_OPENCL) && !defined(__ROOTCLING__)
 BDM_REGISTER_OP(MechanicalForcesOpOpenCL, "mechanical forces", kOpenCl);
 #endif
@@ -49,6 +57,8 @@ struct UpdateStaticnessOp : public AgentOperationImpl {
   BDM_OP_HEADER(UpdateStaticnessOp);
 
   void operator()(Agent* agent) override { agent->UpdateStaticness(); }
+
+  bool ModifiesOtherAgents() const override { return false; }
 };
 
 BDM_REGISTER_OP(UpdateStaticnessOp, "update staticness", kCpu);
@@ -65,6 +75,10 @@ BDM_REGISTER_OP(PropagateStaticnessAgentOp, "propagate staticness agentop",
 struct BehaviorOp : public AgentOperationImpl {
   BDM_OP_HEADER(BehaviorOp);
 
+  // Behaviors may read and modify their neighbors. Hence, the default of
+  // `ModifiesOtherAgents` is kept. Simulations whose behaviors only change
+  // the agent they are attached to can opt in with
+  // `Operation::SetModifiesOtherAgents(false)`.
   void operator()(Agent* agent) override { agent->RunBehaviors(); }
 };
 
@@ -36,6 +36,8 @@ struct DividingCellOp : public AgentOperationImpl {
       }
     }
   }
+
+  bool ModifiesOtherAgents() const override { return false; }
 };
 
 }  // namespace bdm
@@ -15,6 +15,7 @@
 #ifndef CORE_OPERATION_MECHANICAL_FORCES_OP_H_
 #define CORE_OPERATION_MECHANICAL_FORCES_OP_H_
 
+#include <algorithm>
 #include <array>
 #include <cmath>
 #include <limits>
@@ -28,6 +29,7 @@
 #include "core/operation/operation_registry.h"
 #include "core/param/param.h"
 #include "core/scheduler.h"
+#include "core/shape.h"
 #include "core/simulation.h"
 #include "core/util/math.h"
 #include "core/util/thread_info.h"
@@ -93,8 +95,21 @@ class MechanicalForcesOp : public AgentOperationImpl {
       last_time_run_[tid] = current_time;
     }
 
+    // Reduce the search radius to the interaction range of this agent
+    auto squared_radius = squared_radius_;
+    auto* env = sim->GetEnvironment();
+    bool adaptive = param->adaptive_interaction_radius &&
+                    agent->GetShape() == Shape::kSphere;
+    if (adaptive) {
+      auto margin = force_->GetSphereInteractionMargin();
+      real_t radius = 0.5 * (agent->GetDiameter() +
+                             env->GetLargestAgentSizeInNeighborhood(*agent)) +
+                      margin;
+      squared_radius = std::min(squared_radius, radius * radius);
+    }
+
     const auto& displacement =
-        agent->CalculateDisplacement(force_, squared_radius_, delta_time_[tid]);
+        agent->CalculateDisplacement(force_, squared_radius, delta_time_[tid]);
     agent->ApplyDisplacement(displacement);
     if (param->bound_space) {
       ApplyBoundingBox(agent, param->bound_space, param->min_bound,
@@ -102,6 +117,9 @@ class MechanicalForcesOp : public AgentOperationImpl {
     }
   }
 
+  /// Neighbors are only read. Only the agent itself is displaced.
+  bool ModifiesOtherAgents() const override { return false; }
+
  private:
   InteractionForce* force_ = nullptr;
   real_t squared_radius_ = 0;
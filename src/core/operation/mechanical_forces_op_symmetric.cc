@@ -0,0 +1,160 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN & University of Surrey for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+// See the NOTICE file distributed with this work for additional information
+// regarding copyright ownership.
+//
+// -----------------------------------------------------------------------------
+
+#include "core/operation/mechanical_forces_op_symmetric.h"
+
+#include "core/agent/cell.h"
+#include "core/environment/uniform_grid_environment.h"
+#include "core/operation/bound_space_op.h"
+#include "core/param/param.h"
+#include "core/resource_manager.h"
+#include "core/scheduler.h"
+#include "core/shape.h"
+#include "core/simulation.h"
+#include "core/util/log.h"
+
+namespace bdm {
+
+// -----------------------------------------------------------------------------
+MechanicalForcesOpSymmetric::MechanicalForcesOpSymmetric()
+    : force_(new InteractionForce()) {}
+
+// -----------------------------------------------------------------------------
+MechanicalForcesOpSymmetric::MechanicalForcesOpSymmetric(
+    const MechanicalForcesOpSymmetric& other)
+    : last_time_run_(other.last_time_run_) {
+  if (other.force_) {
+    force_ = other.force_->NewCopy();
+  }
+}
+
+// -----------------------------------------------------------------------------
+MechanicalForcesOpSymmetric::~MechanicalForcesOpSymmetric() {
+  if (force_) {
+    delete force_;
+  }
+}
+
+// -----------------------------------------------------------------------------
+void MechanicalForcesOpSymmetric::SetInteractionForce(InteractionForce* force) {
+  if (force == force_) {
+    return;
+  }
+  if (force_) {
+    delete force_;
+  }
+  force_ = force;
+}
+
+// -----------------------------------------------------------------------------
+void MechanicalForcesOpSymmetric::operator()() {
+  auto* sim = Simulation::GetActive();
+  auto* param = sim->GetParam();
+  auto* rm = sim->GetResourceManager();
+  auto* grid = dynamic_cast<UniformGridEnvironment*>(sim->GetEnvironment());
+  if (!grid) {
+    Log::Fatal(
+        "MechanicalForcesOpSymmetric::operator()",
+        "MechanicalForcesOpSymmetric only works with UniformGridEnvironment.");
+    return;
+  }
+
+  auto current_time = (sim->GetScheduler()->GetSimulatedSteps() + 1) *
+                      param->simulation_time_step;
+  auto delta_time = current_time - last_time_run_;
+  last_time_run_ = current_time;
+
+  auto search_radius = grid->GetLargestAgentSize();
+  auto squared_radius = search_radius * search_radius;
+
+  auto num_agents = rm->GetAgentContainerSize();
+  flat_idx_map_.Update();
+  forces_.resize(num_agents);
+  displacements_.resize(num_agents);
+
+#pragma omp parallel for
+  for (uint64_t i = 0; i < num_agents; ++i) {
+    forces_[i] = {0, 0, 0, 0};
+  }
+
+  // Calculate the force for each pair once and add it to both agents.
+  auto calculate_pair_forces =
+      L2F([&](Agent* lhs, AgentHandle lhs_ah, Agent* rhs, AgentHandle rhs_ah,
+              real_t squared_distance) {
+        if (lhs->GetShape() != Shape::kSphere ||
+            rhs->GetShape() != Shape::kSphere) {
+          Log::Fatal("MechanicalForcesOpSymmetric",
+                     "\nWe detected a non-spherical object. This is currently "
+                     "not supported.");
+          return;
+        }
+        // Static agents do not calculate the forces acting on them.
+        bool lhs_static = lhs->IsStatic();
+        bool rhs_static = rhs->IsStatic();
+        if (lhs_static && rhs_static) {
+          return;
+        }
+        auto force = force_->Calculate(lhs, rhs);
+        if (force[0] == 0 && force[1] == 0 && force[2] == 0) {
+          return;
+        }
+        if (!lhs_static) {
+          auto& f = forces_[flat_idx_map_.GetFlatIdx(lhs_ah)];
+          f[0] += force[0];
+          f[1] += force[1];
+          f[2] += force[2];
+          f[3] += 1;
+        }
+        if (!rhs_static) {
+          auto& f = forces_[flat_idx_map_.GetFlatIdx(rhs_ah)];
+          f[0] -= force[0];
+          f[1] -= force[1];
+          f[2] -= force[2];
+          f[3] += 1;
+        }
+      });
+  grid->ForEachNeighborPairByBoxColor(calculate_pair_forces, squared_radius);
+
+  // Calculate the displacements.
+  // Agents must not be moved yet, because other agents that fall back to
+  // `Agent::CalculateDisplacement` might still access their positions.
+  auto calculate_displacement = L2F([&](Agent* agent, AgentHandle ah) {
+    auto idx = flat_idx_map_.GetFlatIdx(ah);
+    auto* cell = dynamic_cast<Cell*>(agent);
+    if (cell == nullptr) {
+      displacements_[idx] =
+          agent->CalculateDisplacement(force_, squared_radius, delta_time);
+      return;
+    }
+    const auto& total = forces_[idx];
+    if (total[3] > 1) {
+      cell->SetStaticnessNextTimestep(false);
+    }
+    displacements_[idx] = cell->CalculateDisplacementFromForce(
+        {total[0], total[1], total[2]}, delta_time);
+  });
+  rm->ForEachAgentParallel(param->scheduling_batch_size,
+                           calculate_displacement);
+
+  auto apply_displacement = L2F([&](Agent* agent, AgentHandle ah) {
+    agent->ApplyDisplacement(displacements_[flat_idx_map_.GetFlatIdx(ah)]);
+    if (param->bound_space) {
+      ApplyBoundingBox(agent, param->bound_space, param->min_bound,
+                       param->max_bound);
+    }
+  });
+  rm->ForEachAgentParallel(param->scheduling_batch_size, apply_displacement);
+}
+
+}  // namespace bdm
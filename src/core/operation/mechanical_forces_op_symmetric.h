@@ -0,0 +1,74 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN & University of Surrey for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+// See the NOTICE file distributed with this work for additional information
+// regarding copyright ownership.
+//
+// -----------------------------------------------------------------------------
+
+#ifndef CORE_OPERATION_MECHANICAL_FORCES_OP_SYMMETRIC_H_
+#define CORE_OPERATION_MECHANICAL_FORCES_OP_SYMMETRIC_H_
+
+#include <vector>
+
+#include "core/container/agent_flat_idx_map.h"
+#include "core/container/math_array.h"
+#include "core/interaction_force.h"
+#include "core/operation/operation.h"
+#include "core/operation/operation_registry.h"
+
+namespace bdm {
+
+/// Standalone alternative to `MechanicalForcesOp` that exploits Newton's third
+/// law. Each pair of neighboring agents is visited only once
+/// (`UniformGridEnvironment::ForEachNeighborPairByBoxColor`) and the resulting
+/// force is added with opposite signs to both agents. Since pairs that are
+/// processed concurrently never share an agent, the forces are accumulated
+/// without synchronization in one array.\n
+/// Differences to `MechanicalForcesOp`:
+///   * All forces are calculated from the agent positions at the beginning of
+///     the operation (i.e. an agent does not see the updated position of
+///     neighbors that have already been moved in this iteration).
+///   * Only supports the `UniformGridEnvironment` and spherical agents.
+///     The interaction force must be antisymmetric
+///     (`Calculate(a, b) == -Calculate(b, a)`).
+///   * The displacement of `Cell`s is calculated with
+///     `Cell::CalculateDisplacementFromForce`. Other agents fall back to
+///     `Agent::CalculateDisplacement`.
+///
+/// This operation is scheduled instead of "mechanical forces" if
+/// `Param::symmetric_mechanical_forces` is set to true.
+class MechanicalForcesOpSymmetric : public StandaloneOperationImpl {
+  BDM_OP_HEADER(MechanicalForcesOpSymmetric);
+
+ public:
+  MechanicalForcesOpSymmetric();
+
+  MechanicalForcesOpSymmetric(const MechanicalForcesOpSymmetric& other);
+
+  ~MechanicalForcesOpSymmetric() override;
+
+  void SetInteractionForce(InteractionForce* force);
+
+  void operator()() override;
+
+ private:
+  InteractionForce* force_ = nullptr;
+  real_t last_time_run_ = 0;
+  AgentFlatIdxMap flat_idx_map_;
+  /// Force accumulator for each agent. Indexed by the flat agent index.
+  /// Element 3 counts the number of non-zero neighbor forces.
+  std::vector<Real4> forces_;
+  /// Displacement for each agent. Indexed by the flat agent index.
+  std::vector<Real3> displacements_;
+};
+
+}  // namespace bdm
+
+#endif  // CORE_OPERATION_MECHANICAL_FORCES_OP_SYMMETRIC_H_
@@ -68,6 +68,13 @@ struct OperationImpl {
   /// Returns whether or not this operations is a stand-alone operation
   virtual bool IsStandalone() = 0;
 
+  /// Returns whether or not this agent operation might modify other agents
+  /// than the one it is called for (e.g. its neighbors). Operations that only
+  /// read other agents should return false. Used by
+  /// `Param::ExecutionOrder::kPlanned` to place barriers. Defaults to true,
+  /// such that operations that are not annotated are never fused.
+  virtual bool ModifiesOtherAgents() const { return true; }
+
   /// The target that this operation implementation is supposed to run on
   OpComputeTarget target_ = kCpu;
 };
@@ -167,6 +174,24 @@ struct Operation {
     return implementations_[active_target_]->IsStandalone();
   }
 
+  /// Returns whether or not this agent operation might modify other agents
+  /// than the one it is called for. Forwards the call to the implementation
+  /// (see `OperationImpl::ModifiesOtherAgents`), unless the value has been
+  /// set with `SetModifiesOtherAgents`.
+  bool ModifiesOtherAgents() const {
+    if (modifies_other_agents_ != -1) {
+      return modifies_other_agents_ == 1;
+    }
+    return implementations_[active_target_]->ModifiesOtherAgents();
+  }
+
+  /// Overrides the value of the implementation. For example, the operation
+  /// "behavior" can be marked as not modifying other agents if none of the
+  /// behaviors in a simulation do so.
+  void SetModifiesOtherAgents(bool value) {
+    modifies_other_agents_ = value ? 1 : 0;
+  }
+
   /// Forwards call to implementation's Setup function
   void SetUp();
 
@@ -203,6 +228,10 @@ struct Operation {
 
   /// If this is an agent operation don't run it for this list of filters
   std::set<Functor<bool, Agent *> *> exclude_filters_;
+
+  /// Value set with `SetModifiesOtherAgents` (1: true, 0: false), or -1 if
+  /// the value of the implementation is used
+  int modifies_other_agents_ = -1;
 };
 
 }  // namespace bdm
@@ -0,0 +1,39 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN & University of Surrey for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+// See the NOTICE file distributed with this work for additional information
+// regarding copyright ownership.
+//
+// -----------------------------------------------------------------------------
+
+#ifndef CORE_OPERATION_TRIM_MEMORY_OP_H_
+#define CORE_OPERATION_TRIM_MEMORY_OP_H_
+
+#include "core/memory/memory_manager.h"
+#include "core/operation/operation.h"
+#include "core/simulation.h"
+
+namespace bdm {
+
+/// An operation that returns memory of the BioDynaMo memory manager, which is
+/// not used anymore, to the operating system. See `MemoryManager::Trim`.
+struct TrimMemoryOp : public StandaloneOperationImpl {
+  BDM_OP_HEADER(TrimMemoryOp);
+
+  void operator()() override {
+    auto* mem_mgr = Simulation::GetActive()->GetMemoryManager();
+    if (mem_mgr != nullptr) {
+      mem_mgr->Trim();
+    }
+  }
+};
+
+}  // namespace bdm
+
+#endif  // CORE_OPERATION_TRIM_MEMORY_OP_H_
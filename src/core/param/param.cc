@@ -162,6 +162,9 @@ void AssignThreadSafetyMechanism(const std::shared_ptr<cpptoml::table>& config,
           Param::ThreadSafetyMechanism::kUserSpecified;
     } else if (str_value == "automatic") {
       param->thread_safety_mechanism = Param::ThreadSafetyMechanism::kAutomatic;
+    } else if (str_value == "box-coloring") {
+      param->thread_safety_mechanism =
+          Param::ThreadSafetyMechanism::kBoxColoring;
     }
   }
 }
@@ -232,6 +235,9 @@ void Param::AssignFromConfig(const std::shared_ptr<cpptoml::table>& config) {
   BDM_ASSIGN_CONFIG_VALUE(backup_file, "simulation.backup_file");
   BDM_ASSIGN_CONFIG_VALUE(restore_file, "simulation.restore_file");
   BDM_ASSIGN_CONFIG_VALUE(backup_interval, "simulation.backup_interval");
+  BDM_ASSIGN_CONFIG_VALUE(backup_async, "simulation.backup_async");
+  BDM_ASSIGN_CONFIG_VALUE(backup_format, "simulation.backup_format");
+  BDM_ASSIGN_CONFIG_VALUE(backup_compression, "simulation.backup_compression");
   BDM_ASSIGN_CONFIG_VALUE(simulation_time_step, "simulation.time_step");
   BDM_ASSIGN_CONFIG_VALUE(simulation_max_displacement,
                           "simulation.max_displacement");
@@ -259,6 +265,8 @@ void Param::AssignFromConfig(const std::shared_ptr<cpptoml::table>& config) {
                           "visualization.export_generate_pvsm");
   BDM_ASSIGN_CONFIG_VALUE(visualization_compress_pv_files,
                           "visualization.compress_pv_files");
+  BDM_ASSIGN_CONFIG_VALUE(visualization_native_export,
+                          "visualization.native_export");
 
   //   visualize_agents
   auto visualize_agentstarr = config->get_table_array("visualize_agent");
@@ -338,9 +346,26 @@ void Param::AssignFromConfig(const std::shared_ptr<cpptoml::table>& config) {
   // performance group
   BDM_ASSIGN_CONFIG_VALUE(scheduling_batch_size,
                           "performance.scheduling_batch_size");
+  BDM_ASSIGN_CONFIG_VALUE(scheduling_work_stealing,
+                          "performance.scheduling_work_stealing");
   BDM_ASSIGN_CONFIG_VALUE(detect_static_agents,
                           "performance.detect_static_agents");
   BDM_ASSIGN_CONFIG_VALUE(cache_neighbors, "performance.cache_neighbors");
+  BDM_ASSIGN_CONFIG_VALUE(symmetric_mechanical_forces,
+                          "performance.symmetric_mechanical_forces");
+  BDM_ASSIGN_CONFIG_VALUE(cache_agent_positions,
+                          "performance.cache_agent_positions");
+  BDM_ASSIGN_CONFIG_VALUE(uniform_grid_counting_sort,
+                          "performance.uniform_grid_counting_sort");
+  BDM_ASSIGN_CONFIG_VALUE(verlet_list_skin, "performance.verlet_list_skin");
+  BDM_ASSIGN_CONFIG_VALUE(uniform_grid_incremental_update,
+                          "performance.uniform_grid_incremental_update");
+  BDM_ASSIGN_CONFIG_VALUE(adaptive_interaction_radius,
+                          "performance.adaptive_interaction_radius");
+  BDM_ASSIGN_CONFIG_VALUE(fuse_diffusion_grids,
+                          "performance.fuse_diffusion_grids");
+  BDM_ASSIGN_CONFIG_VALUE(diffusion_temporal_blocking,
+                          "performance.diffusion_temporal_blocking");
   BDM_ASSIGN_CONFIG_VALUE(use_bdm_mem_mgr, "performance.use_bdm_mem_mgr");
   BDM_ASSIGN_CONFIG_VALUE(mem_mgr_aligned_pages_shift,
                           "performance.mem_mgr_aligned_pages_shift");
@@ -348,8 +373,25 @@ void Param::AssignFromConfig(const std::shared_ptr<cpptoml::table>& config) {
                           "performance.mem_mgr_growth_rate");
   BDM_ASSIGN_CONFIG_VALUE(mem_mgr_max_mem_per_thread_factor,
                           "performance.mem_mgr_max_mem_per_thread_factor");
+  BDM_ASSIGN_CONFIG_VALUE(mem_mgr_arena, "performance.mem_mgr_arena");
+  BDM_ASSIGN_CONFIG_VALUE(mem_mgr_trim_frequency,
+                          "performance.mem_mgr_trim_frequency");
+  BDM_ASSIGN_CONFIG_VALUE(agent_removal_tombstones,
+                          "performance.agent_removal_tombstones");
+  BDM_ASSIGN_CONFIG_VALUE(agent_removal_tombstone_threshold,
+                          "performance.agent_removal_tombstone_threshold");
   BDM_ASSIGN_CONFIG_VALUE(minimize_memory_while_rebalancing,
                           "performance.minimize_memory_while_rebalancing");
+  BDM_ASSIGN_CONFIG_VALUE(incremental_load_balancing,
+                          "performance.incremental_load_balancing");
+  BDM_ASSIGN_CONFIG_VALUE(load_balancing_block_size,
+                          "performance.load_balancing_block_size");
+  BDM_ASSIGN_CONFIG_VALUE(load_balancing_disorder_threshold,
+                          "performance.load_balancing_disorder_threshold");
+  BDM_ASSIGN_CONFIG_VALUE(space_filling_curve,
+                          "performance.space_filling_curve");
+  BDM_ASSIGN_CONFIG_VALUE(fuse_time_series_reducers,
+                          "performance.fuse_time_series_reducers");
   AssignMappedDataArrayMode(config, this);
 
   // development group
@@ -176,6 +176,45 @@ struct Param {
   ///     backup_interval = 1800  # backup every half an hour
   uint32_t backup_interval = 1800;
 
+  /// If set to true, backups are written asynchronously. The simulation
+  /// process is forked and the child process, which operates on a
+  /// copy-on-write snapshot of the simulation, writes the backup file. The
+  /// simulation continues in the parent process in the meantime. If the
+  /// previous backup has not finished when the next one is due, the next
+  /// backup is postponed.\n
+  /// Default value: `false`\n
+  /// TOML config file:
+  ///
+  ///     [simulation]
+  ///     backup_async = false
+  bool backup_async = false;
+
+  /// File format of backups.\n
+  /// `"root"`: the simulation is written as one ROOT object.\n
+  /// `"columnar"`: agents are grouped by type and written to one ROOT TTree
+  /// per type, in which each data member is stored as a separate column.
+  /// The concentration values of diffusion grids are stored as raw
+  /// blocks. The remaining simulation state is written as one ROOT
+  /// object. Restore loads the agents in parallel.\n
+  /// Restore detects the format of the restore file automatically.\n
+  /// Default value: `"root"`\n
+  /// TOML config file:
+  ///
+  ///     [simulation]
+  ///     backup_format = "root"
+  std::string backup_format = "root";
+
+  /// ROOT compression setting of columnar backups
+  /// (`100 * algorithm + level`). E.g. `404` for LZ4 level 4, `505` for
+  /// ZSTD level 5, and `0` for no compression.
+  /// See `Param::backup_format`.\n
+  /// Default value: `404`\n
+  /// TOML config file:
+  ///
+  ///     [simulation]
+  ///     backup_compression = 404
+  int backup_compression = 404;
+
   /// Time between two simulation steps, in hours.
   /// Default value: `0.01`\n
   /// TOML config file:
@@ -244,9 +283,12 @@ struct Param {
   std::string diffusion_boundary_condition = "Neumann";
 
   /// A string for determining diffusion type within the simulation space.
-  /// Currently, only the method "euler" implementing a FTCS scheme is
-  /// supported. See for instance here:
+  /// Currently, the method "euler" implementing a FTCS scheme is supported.
+  /// See for instance here:
   /// https://en.wikipedia.org/wiki/FTCS_scheme (accessed 2023-07-17)
+  /// The method "adi" implements an implicit alternating direction scheme
+  /// (see `ADIGrid`), which is unconditionally stable and thus allows large
+  /// time steps for fast diffusing substances.
   /// Default value: `"euler"`\n TOML
   /// config file:
   ///
@@ -269,11 +311,20 @@ struct Param {
   /// `kUserSpecified`: The user has to define all agent that must
   /// not be processed in parallel. \see `Agent::CriticalRegion`.\n
   /// `kAutomatic`: The simulation automatically locks all agents
-  /// of the microenvironment.
-  enum ThreadSafetyMechanism { kNone = 0, kUserSpecified, kAutomatic };
+  /// of the microenvironment.\n
+  /// `kBoxColoring`: Same guarantees as `kAutomatic`, but without locks.
+  /// The boxes of the uniform grid are processed in 27 phases, such that
+  /// agents in the microenvironment of each other are never processed at the
+  /// same time. Requires the `UniformGridEnvironment`.
+  enum ThreadSafetyMechanism {
+    kNone = 0,
+    kUserSpecified,
+    kAutomatic,
+    kBoxColoring
+  };
 
   /// Select the thread-safety mechanism.\n
-  /// Possible values are: none, user-specified, automatic.\n
+  /// Possible values are: none, user-specified, automatic, box-coloring.\n
   /// TOML config file:
   ///
   ///     [simulation]
@@ -426,6 +477,21 @@ struct Param {
   ///
   bool visualization_compress_pv_files = true;
 
+  /// Specifies if the export visualization writes the ParaView files
+  /// directly from the agents and diffusion grids, without building VTK
+  /// objects and without using the VTK writers. Ignored for insitu
+  /// visualization.\n
+  /// Data members of unsupported types are not exported (see
+  /// `NativeVtuWriter`).\n
+  /// Default value: `false`\n
+  /// TOML config file:
+  ///
+  ///     [visualization]
+  ///     export = true
+  ///     native_export = false
+  ///
+  bool visualization_native_export = false;
+
   // performance values --------------------------------------------------------
 
   /// Batch size used by the `Scheduler` to iterate over agents\n
@@ -436,7 +502,24 @@ struct Param {
   ///     scheduling_batch_size = 1000
   uint64_t scheduling_batch_size = 1000;
 
-  enum ExecutionOrder { kForEachAgentForEachOp = 0, kForEachOpForEachAgent };
+  /// Use work stealing to distribute the agents among the threads for the
+  /// agent operations (see
+  /// `ResourceManager::ForEachAgentParallelWorkStealing`). Ranges are not split
+  /// below `scheduling_batch_size` agents. If `statistics` is enabled, the
+  /// average busy and idle time per thread and the number of steals are
+  /// recorded for each pass (see `Scheduler::GetWorkStealingStatistics`).\n
+  /// Default value: `false`\n
+  /// TOML config file:
+  ///
+  ///     [performance]
+  ///     scheduling_work_stealing = false
+  bool scheduling_work_stealing = false;
+
+  enum ExecutionOrder {
+    kForEachAgentForEachOp = 0,
+    kForEachOpForEachAgent,
+    kPlanned
+  };
 
   /// This parameter determines whether to execute  `kForEachAgentForEachOp`
   /// \code
@@ -454,8 +537,27 @@ struct Param {
   ///   }
   /// }
   /// \endcode
+  /// or `kPlanned`, which executes operations that modify other agents
+  /// (see `Operation::ModifiesOtherAgents`) in a separate pass and groups the
+  /// remaining consecutive operations. Each group is executed with
+  /// `kForEachAgentForEachOp` or `kForEachOpForEachAgent` as determined by
+  /// `Param::agent_op_fusion`.
   ExecutionOrder execution_order = ExecutionOrder::kForEachAgentForEachOp;
 
+  enum AgentOpFusion { kAlwaysFuse = 0, kNeverFuse, kMeasureFusion };
+
+  /// Determines how `Param::ExecutionOrder::kPlanned` executes a group of
+  /// consecutive agent operations that do not modify other agents.\n
+  /// `kAlwaysFuse`: all operations of the group in one pass over all agents.\n
+  /// `kNeverFuse`: one pass over all agents per operation.\n
+  /// `kMeasureFusion`: both variants are timed and the faster one is used
+  /// (see `AgentOpPlanner`). The selection depends on wall-clock time.
+  /// Hence, the order in which agents observe each other's updates, and
+  /// thus the simulation result, can differ between runs with the same
+  /// random seed.\n
+  /// Default value: `kAlwaysFuse`
+  AgentOpFusion agent_op_fusion = AgentOpFusion::kAlwaysFuse;
+
   /// Calculation of the displacement (mechanical interaction) is an
   /// expensive operation. If agents do not move or grow,
   /// displacement calculation is omitted if detect_static_agents is turned
@@ -479,6 +581,122 @@ struct Param {
   ///     cache_neighbors = false
   bool cache_neighbors = false;
 
+  /// If set to true, the agent operation "mechanical forces" is replaced by
+  /// the standalone operation "symmetric mechanical forces"
+  /// (`MechanicalForcesOpSymmetric`). It calculates the force between two
+  /// neighbors only once and applies it with opposite signs to both of them.
+  /// This halves the number of force calculations, but requires the
+  /// uniform grid environment and spherical agents. Only considered if
+  /// `Param::compute_target` is `"cpu"`.\n
+  /// Default value: `false`\n
+  /// TOML config file:
+  ///
+  ///     [performance]
+  ///     symmetric_mechanical_forces = false
+  bool symmetric_mechanical_forces = false;
+
+  /// If set to true, the `UniformGridEnvironment` keeps a contiguous
+  /// structure-of-arrays copy of the agent positions sorted by box.
+  /// It is refreshed at each environment update and used to filter
+  /// neighbor candidates without dereferencing the agents. Consequently,
+  /// distances are calculated with the positions at the time of the last
+  /// environment update, even if agents have moved since then.\n
+  /// Default value: `false`\n
+  /// TOML config file:
+  ///
+  ///     [performance]
+  ///     cache_agent_positions = false
+  bool cache_agent_positions = false;
+
+  /// If set to true, the `UniformGridEnvironment` assigns agents to boxes
+  /// with a parallel counting sort (count, prefix sum, scatter) instead of
+  /// inserting them into a linked list per box. The agents of each box are
+  /// then stored contiguously and neighbor searches scan contiguous ranges.\n
+  /// Default value: `false`\n
+  /// TOML config file:
+  ///
+  ///     [performance]
+  ///     uniform_grid_counting_sort = false
+  bool uniform_grid_counting_sort = false;
+
+  /// If larger than zero, the `UniformGridEnvironment` builds a Verlet list
+  /// for each agent that contains all agents within the largest agent size
+  /// plus this skin distance. The grid and the lists are reused in the
+  /// following iterations until an agent has moved more than half the skin,
+  /// grown larger than the largest agent at the time of the rebuild, or
+  /// agents have been added or removed. Neighbor searches with a radius of at
+  /// most the largest agent size only check the agents in the Verlet list.
+  /// A larger skin reduces the number of rebuilds, but increases the length
+  /// of the lists. Recommended for simulations in which agents move slowly.
+  /// \n
+  /// Default value: `0` (disabled)\n
+  /// TOML config file:
+  ///
+  ///     [performance]
+  ///     verlet_list_skin = 0
+  real_t verlet_list_skin = 0;
+
+  /// If set to true, the `UniformGridEnvironment` keeps the grid of the
+  /// previous iteration and only relocates agents whose box has changed.
+  /// A full update is performed if agents have been added or removed, the
+  /// agents have been reordered (e.g. by load balancing), an agent left the
+  /// grid (i.e. the grid would have to grow), or an agent became larger than
+  /// the largest agent size. Beneficial if most agents do not move (e.g. with
+  /// `Param::detect_static_agents`). Note that the update still checks the
+  /// position of every agent; it only saves the work to rebuild the
+  /// boxes.\n
+  /// Default value: `false`\n
+  /// TOML config file:
+  ///
+  ///     [performance]
+  ///     uniform_grid_incremental_update = false
+  bool uniform_grid_incremental_update = false;
+
+  /// If set to true, the operation "mechanical forces" reduces the search
+  /// radius of spherical agents from the largest agent size to their
+  /// interaction range: half the sum of their diameter and the largest
+  /// diameter in their neighborhood plus
+  /// `InteractionForce::GetSphereInteractionMargin`. The
+  /// `UniformGridEnvironment` records the largest diameter of each box and
+  /// skips boxes that are further away than the interaction range with the
+  /// largest agent of the box. This speeds
+  /// up simulations in which a few large agents are surrounded by many small
+  /// ones. Diameter changes since the last environment update are not
+  /// considered. Custom interaction forces only benefit if they override
+  /// `InteractionForce::GetSphereInteractionMargin`.\n
+  /// Default value: `false`\n
+  /// TOML config file:
+  ///
+  ///     [performance]
+  ///     adaptive_interaction_radius = false
+  bool adaptive_interaction_radius = false;
+
+  /// If set to true, the operation "continuum" advances all `EulerGrid`s
+  /// with the same resolution, boundary condition type and time step
+  /// together in a single sweep over the grid boxes
+  /// (`EulerGrid::IntegrateTimeFused`). This reduces the memory traffic and
+  /// synchronization for simulations with many substances. Subclasses of
+  /// `EulerGrid` (e.g. `EulerDepletionGrid`) are integrated separately.\n
+  /// Default value: `false`\n
+  /// TOML config file:
+  ///
+  ///     [performance]
+  ///     fuse_diffusion_grids = false
+  bool fuse_diffusion_grids = false;
+
+  /// Number of time steps that an `EulerGrid` computes in a single sweep over
+  /// the grid boxes, if the operation "continuum" has to advance it by more
+  /// than one time step (see `Continuum::SetTimeStep`). Intermediate time
+  /// steps are only kept for a few planes of the grid, which reduces the
+  /// memory traffic (`EulerGrid::MultiStep`). The value `1` disables temporal
+  /// blocking. Periodic boundary conditions are not supported.\n
+  /// Default value: `1`\n
+  /// TOML config file:
+  ///
+  ///     [performance]
+  ///     diffusion_temporal_blocking = 1
+  uint64_t diffusion_temporal_blocking = 1;
+
   /// Default value: `true`\n
   /// TOML config file:
   ///
@@ -521,6 +739,60 @@ struct Param {
   ///     mem_mgr_max_mem_per_thread_factor = 1
   uint64_t mem_mgr_max_mem_per_thread_factor = 1;
 
+  /// If true, agents and behaviors that are created during the execution of
+  /// agent operations (e.g. during cell division) are allocated from a
+  /// per-thread bump arena of the BioDynaMo memory manager. Allocation only
+  /// increments a pointer and the memory of new agents is contiguous and
+  /// local to the numa node of the creating thread. Agents stay in the arena
+  /// after they have been added to the simulation. An arena region of
+  /// `PAGE_SIZE * 2 ^ mem_mgr_aligned_pages_shift` bytes is only reused once
+  /// all its objects have been removed, which increases the memory
+  /// consumption of simulations in which many new agents are removed again.
+  /// Each thread keeps filling its current region across iterations. The
+  /// current regions are released at the end of `Scheduler::Simulate`.\n
+  /// Requires `use_bdm_mem_mgr = true`.\n
+  /// Default value: `false`\n
+  /// TOML config file:
+  ///
+  ///     [performance]
+  ///     mem_mgr_arena = false
+  bool mem_mgr_arena = false;
+
+  /// Specifies how often the BioDynaMo memory manager returns memory that is
+  /// not used anymore to the operating system (see `MemoryManager::Trim`),
+  /// e.g. after many agents have been removed. The operation "trim memory"
+  /// is executed every `mem_mgr_trim_frequency` iterations after the agents
+  /// have been removed in "tear down iteration". `0` disables it.\n
+  /// Default value: `0`\n
+  /// TOML config file:
+  ///
+  ///     [performance]
+  ///     mem_mgr_trim_frequency = 0
+  uint64_t mem_mgr_trim_frequency = 0;
+
+  /// If true, agents that are removed from the simulation leave a tombstone
+  /// (a `nullptr`) in the agent container of the `ResourceManager` instead of
+  /// being replaced by the last agent. Thus, the removal is executed in
+  /// parallel without moving agents or allocating memory. Tombstones are
+  /// removed during load balancing, before a backup is written, and once
+  /// their fraction exceeds `agent_removal_tombstone_threshold`.
+  /// Only used with the uniform grid environment on the CPU.\n
+  /// Default value: `false`\n
+  /// TOML config file:
+  ///
+  ///     [performance]
+  ///     agent_removal_tombstones = false
+  bool agent_removal_tombstones = false;
+
+  /// Fraction of tombstones in the agent container of the `ResourceManager`
+  /// above which it is compacted (see `agent_removal_tombstones`).\n
+  /// Default value: `0.1`\n
+  /// TOML config file:
+  ///
+  ///     [performance]
+  ///     agent_removal_tombstone_threshold = 0.1
+  real_t agent_removal_tombstone_threshold = 0.1;
+
   /// This parameter is used inside `ResourceManager::LoadBalance`.
   /// If it is set to true, the function will reuse existing memory to rebalance
   /// agents to NUMA nodes. (A small amount of additional memory
@@ -535,6 +807,75 @@ struct Param {
   ///     minimize_memory_while_rebalancing = true
   bool minimize_memory_while_rebalancing = true;
 
+  /// If true, `ResourceManager::LoadBalance` only copies agents that are out
+  /// of place, i.e. agents whose position in the space-filling curve order
+  /// belongs to a different NUMA node, or is at least
+  /// `load_balancing_block_size` elements away from their current position.
+  /// The remaining agents keep their memory and only their pointers are
+  /// reordered.\n
+  /// Default value: `false`\n
+  /// TOML config file:
+  ///
+  ///     [performance]
+  ///     incremental_load_balancing = false
+  bool incremental_load_balancing = false;
+
+  /// Number of elements an agent can drift from its position in the
+  /// space-filling curve order before it is considered out of place
+  /// (see `incremental_load_balancing`).\n
+  /// Default value: `1024`\n
+  /// TOML config file:
+  ///
+  ///     [performance]
+  ///     load_balancing_block_size = 1024
+  uint64_t load_balancing_block_size = 1024;
+
+  /// If larger than zero, the operation "load balancing" is executed in every
+  /// iteration, but only reorders the agents once the fraction of agents that
+  /// are out of place exceeds this value (see
+  /// `ResourceManager::GetSpatialDisorder`). Thus, load balancing is
+  /// triggered when the memory locality of neighboring agents degrades.\n
+  /// Default value: `0`\n
+  /// TOML config file:
+  ///
+  ///     [performance]
+  ///     load_balancing_disorder_threshold = 0
+  real_t load_balancing_disorder_threshold = 0;
+
+  /// Space-filling curve along which `ResourceManager::LoadBalance` sorts the
+  /// agents if the uniform grid environment is used.\n
+  /// Possible values: `morton`, `hilbert`\n
+  /// The Hilbert curve only connects neighboring boxes and avoids the jumps
+  /// of the Morton curve between octants. Thus, neighboring agents are more
+  /// likely to be stored on the same NUMA node and in nearby memory.\n
+  /// Default value: `morton`\n
+  /// TOML config file:
+  ///
+  ///     [performance]
+  ///     space_filling_curve = "morton"
+  std::string space_filling_curve = "morton";
+
+  /// If set to true, the reducer collectors of the time series (see
+  /// `experimental::TimeSeries::AddCollector`) are executed during the last
+  /// pass over all agents of the agent operations, instead of in a separate
+  /// pass over all agents in the operation "update time series".
+  /// Thus, each agent is reduced while it is still in the cache.\n
+  /// The reducers observe an agent directly after its agent operations.
+  /// Changes of other agents to this agent later in the same iteration are
+  /// not taken into account. Agents that are added during the iteration are
+  /// not counted, and agents that are removed are counted for the last time.
+  /// With `ThreadSafetyMechanism::kBoxColoring`, agents that are not in the
+  /// grid yet are reduced in the serial pass of
+  /// `UniformGridEnvironment::ForEachAgentByBoxColor`.\n
+  /// The separate pass is used with agent filters
+  /// (`Scheduler::SetAgentFilters`) and the copy execution context.\n
+  /// Default value: `false`\n
+  /// TOML config file:
+  ///
+  ///     [performance]
+  ///     fuse_time_series_reducers = false
+  bool fuse_time_series_reducers = false;
+
   /// MappedDataArrayMode options:
   ///   `kZeroCopy`: access agent data directly only if it is
   ///                requested. \n
@@ -13,16 +13,24 @@
 // -----------------------------------------------------------------------------
 
 #include "core/resource_manager.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif  // defined(__x86_64__) || defined(__i386__)
+#include <chrono>
 #include <cmath>
+#include <deque>
+#include <thread>
 #ifndef NDEBUG
 #include <set>
 #endif  // NDEBUG
 #include "core/algorithm.h"
 #include "core/container/shared_data.h"
 #include "core/environment/environment.h"
+#include "core/environment/uniform_grid_environment.h"
 #include "core/simulation.h"
 #include "core/util/partition.h"
 #include "core/util/plot_memory_layout.h"
+#include "core/util/spinlock.h"
 #include "core/util/timing.h"
 
 namespace bdm {
@@ -35,6 +43,7 @@ ResourceManager::ResourceManager() {
   }
   agents_.resize(numa_num_configured_nodes());
   agents_lb_.resize(numa_num_configured_nodes());
+  num_tombstones_.resize(numa_num_configured_nodes());
 
   auto* param = Simulation::GetActive()->GetParam();
   if (param->export_visualization || param->insitu_visualization) {
@@ -75,7 +84,7 @@ void ResourceManager::ForEachAgentParallel(
 
     for (uint64_t i = start; i < end; ++i) {
       auto* a = numa_agents[i];
-      if (!filter || (filter && (*filter)(a))) {
+      if (a != nullptr && (!filter || (filter && (*filter)(a)))) {
         function(a, AgentHandle(nid, i));
       }
     }
@@ -182,7 +191,7 @@ void ResourceManager::ForEachAgentParallel(
 
           for (uint64_t i = start; i < end; ++i) {
             auto* a = numa_agents[i];
-            if (!filter || (filter && (*filter)(a))) {
+            if (a != nullptr && (!filter || (filter && (*filter)(a)))) {
               function(a, AgentHandle(current_nid, i));
             }
           }
@@ -198,19 +207,209 @@ void ResourceManager::ForEachAgentParallel(
   }
 }
 
+namespace {
+
+/// Agents [begin, end) of NUMA domain `nid`
+struct AgentRange {
+  uint64_t nid;
+  uint64_t begin;
+  uint64_t end;
+};
+
+/// Ranges of agents that are assigned to one thread. The owner takes ranges
+/// from the back, other threads steal them from the front.
+struct alignas(hardware_destructive_interference_size) WorkStealingDeque {
+  Spinlock lock;
+  std::deque<AgentRange> ranges;
+
+  void PushBack(const AgentRange& range) {
+    std::lock_guard<Spinlock> guard(lock);
+    ranges.push_back(range);
+  }
+
+  bool PopBack(AgentRange* range) {
+    std::lock_guard<Spinlock> guard(lock);
+    if (ranges.empty()) {
+      return false;
+    }
+    *range = ranges.back();
+    ranges.pop_back();
+    return true;
+  }
+
+  bool PopFront(AgentRange* range) {
+    std::lock_guard<Spinlock> guard(lock);
+    if (ranges.empty()) {
+      return false;
+    }
+    *range = ranges.front();
+    ranges.pop_front();
+    return true;
+  }
+
+  bool Empty() {
+    std::lock_guard<Spinlock> guard(lock);
+    return ranges.empty();
+  }
+};
+
+/// Tells the CPU that the calling thread is spinning
+inline void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  _mm_pause();
+#else
+  std::this_thread::yield();
+#endif  // defined(__x86_64__) || defined(__i386__)
+}
+
+/// Maximum number of `CpuRelax` calls between two attempts to find work.
+/// Idle threads yield their CPU once this limit has been reached.
+constexpr uint64_t kMaxStealBackoff = 1024;
+
+}  // namespace
+
+void ResourceManager::ForEachAgentParallelWorkStealing(
+    uint64_t min_chunk, Functor<void, Agent*, AgentHandle>& function,
+    Functor<bool, Agent*>* filter) {
+  using Clock = std::chrono::steady_clock;
+  auto start_time = Clock::now();
+
+  min_chunk = std::max(min_chunk, uint64_t(1));
+  auto numa_nodes = thread_info_->GetNumaNodes();
+  auto max_threads = thread_info_->GetMaxThreads();
+  thread_busy_times_.assign(max_threads, 0);
+  thread_idle_times_.assign(max_threads, 0);
+  thread_steals_.assign(max_threads, 0);
+
+  // Each thread starts with a contiguous range of its NUMA domain
+  std::unique_ptr<WorkStealingDeque[]> deques(
+      new WorkStealingDeque[max_threads]);
+  for (int tid = 0; tid < max_threads; tid++) {
+    auto nid = thread_info_->GetNumaNode(tid);
+    auto threads_in_numa = thread_info_->GetThreadsInNumaNode(nid);
+    auto numa_tid = thread_info_->GetNumaThreadId(tid);
+    uint64_t size = agents_[nid].size();
+    uint64_t begin = size * numa_tid / threads_in_numa;
+    uint64_t end = size * (numa_tid + 1) / threads_in_numa;
+    if (begin < end) {
+      deques[tid].ranges.push_back({static_cast<uint64_t>(nid), begin, end});
+    }
+  }
+
+  // Victims are ordered by NUMA domain, starting with the own domain
+  std::vector<std::vector<int>> victims(max_threads);
+  for (int tid = 0; tid < max_threads; tid++) {
+    auto nid = thread_info_->GetNumaNode(tid);
+    for (int n = 0; n < numa_nodes; n++) {
+      int current_nid = (nid + n) % numa_nodes;
+      for (int i = 1; i <= max_threads; i++) {
+        int victim = (tid + i) % max_threads;
+        if (victim != tid && thread_info_->GetNumaNode(victim) == current_nid) {
+          victims[tid].push_back(victim);
+        }
+      }
+    }
+  }
+
+  // Number of agents that have not been processed yet
+  std::atomic<uint64_t> remaining(GetAgentContainerSize());
+
+#pragma omp parallel
+  {
+    auto tid = omp_get_thread_num();
+    assert(thread_info_->GetNumaNode(tid) == numa_node_of_cpu(sched_getcpu()));
+    auto& deque = deques[tid];
+    int64_t busy = 0;
+    uint64_t steals = 0;
+    uint64_t backoff = 1;
+    AgentRange range;
+
+    while (remaining.load(std::memory_order_acquire) != 0) {
+      bool found = deque.PopBack(&range);
+      for (uint64_t i = 0; !found && i < victims[tid].size(); i++) {
+        found = deques[victims[tid][i]].PopFront(&range);
+        steals += found;
+      }
+      if (!found) {
+        // Back off exponentially, such that idle threads do not keep the
+        // spinlocks of the busy threads under contention.
+        for (uint64_t i = 0; i < backoff; i++) {
+          CpuRelax();
+        }
+        if (backoff < kMaxStealBackoff) {
+          backoff *= 2;
+        } else {
+          std::this_thread::yield();
+        }
+        continue;
+      }
+      backoff = 1;
+
+      auto busy_start = Clock::now();
+      auto& numa_agents = agents_[range.nid];
+      while (range.begin < range.end) {
+        // Make the upper half available to other threads, if there is no
+        // other work left in this thread's deque
+        if (range.end - range.begin >= 2 * min_chunk && deque.Empty()) {
+          auto mid = range.begin + (range.end - range.begin) / 2;
+          deque.PushBack({range.nid, mid, range.end});
+          range.end = mid;
+        }
+        auto end = std::min(range.end, range.begin + min_chunk);
+        for (uint64_t i = range.begin; i < end; ++i) {
+          auto* a = numa_agents[i];
+          if (a != nullptr && (!filter || (*filter)(a))) {
+            function(a, AgentHandle(range.nid, i));
+          }
+        }
+        remaining.fetch_sub(end - range.begin, std::memory_order_release);
+        range.begin = end;
+      }
+      busy += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                  Clock::now() - busy_start)
+                  .count();
+    }
+    thread_busy_times_[tid] = busy;
+    thread_steals_[tid] = steals;
+  }
+
+  auto total = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   Clock::now() - start_time)
+                   .count();
+  for (int tid = 0; tid < max_threads; tid++) {
+    thread_idle_times_[tid] =
+        std::max(total - thread_busy_times_[tid], int64_t(0));
+  }
+}
+
+/// Moves the agents of a range of the space-filling curve to their new
+/// position. An agent is out of place if its current position is on a
+/// different numa node or at least `block_size` elements away from the new
+/// one. All agents are copied, unless `incremental` is true, in which case
+/// only agents that are out of place are copied. If `count_only` is true,
+/// the agents that are out of place are only counted.
 struct LoadBalanceFunctor : public Functor<void, Iterator<AgentHandle>*> {
   bool minimize_memory;
+  bool incremental;
+  bool count_only;
+  uint64_t block_size;
   uint64_t offset;
   uint64_t nid;
   std::vector<std::vector<Agent*>>& agents;
   std::vector<Agent*>& dest;
   AgentUidMap<AgentHandle>& uid_ah_map;
   TypeIndex* type_index;
+  /// Number of agents that are out of place
+  uint64_t num_moved = 0;
 
-  LoadBalanceFunctor(bool minimize_memory, uint64_t offset, uint64_t nid,
+  LoadBalanceFunctor(bool minimize_memory, bool incremental, bool count_only,
+                     uint64_t block_size, uint64_t offset, uint64_t nid,
                      decltype(agents) agents, decltype(dest) dest,
                      decltype(uid_ah_map) uid_ah_map, TypeIndex* type_index)
       : minimize_memory(minimize_memory),
+        incremental(incremental),
+        count_only(count_only),
+        block_size(block_size),
         offset(offset),
         nid(nid),
         agents(agents),
@@ -218,12 +417,37 @@ struct LoadBalanceFunctor : public Functor<void, Iterator<AgentHandle>*> {
         uid_ah_map(uid_ah_map),
         type_index(type_index) {}
 
+  bool IsInPlace(const AgentHandle& handle, uint64_t el_idx) const {
+    if (handle.GetNumaNode() != nid) {
+      return false;
+    }
+    uint64_t idx = handle.GetElementIdx();
+    return (idx > el_idx ? idx - el_idx : el_idx - idx) < block_size;
+  }
+
   void operator()(Iterator<AgentHandle>* it) override {
     while (it->HasNext()) {
       auto handle = it->Next();
-      auto* agent = agents[handle.GetNumaNode()][handle.GetElementIdx()];
-      auto* copy = agent->NewCopy();
       auto el_idx = offset++;
+      bool in_place = IsInPlace(handle, el_idx);
+      if (!in_place) {
+        num_moved++;
+      }
+      if (count_only) {
+        continue;
+      }
+      auto*& slot = agents[handle.GetNumaNode()][handle.GetElementIdx()];
+      auto* agent = slot;
+      if (incremental && in_place) {
+        dest[el_idx] = agent;
+        if (el_idx != handle.GetElementIdx()) {
+          uid_ah_map.Insert(agent->GetUid(), AgentHandle(nid, el_idx));
+        }
+        // Agents that remain in the old container are deleted afterwards
+        slot = nullptr;
+        continue;
+      }
+      auto* copy = agent->NewCopy();
       dest[el_idx] = copy;
       uid_ah_map.Insert(copy->GetUid(), AgentHandle(nid, el_idx));
       if (type_index) {
@@ -231,20 +455,22 @@ struct LoadBalanceFunctor : public Functor<void, Iterator<AgentHandle>*> {
       }
       if (minimize_memory) {
         delete agent;
+        slot = nullptr;
       }
     }
   }
 };
 
+/// If `Param::load_balancing_disorder_threshold` is set, the spatial
+/// disorder of large simulations is estimated from every n-th block of
+/// `Param::load_balancing_block_size` agents along the space-filling curve,
+/// with n at most `kMaxDisorderSampleStride`. At least
+/// `kMinDisorderSamples` agents are checked.
+static constexpr uint64_t kMaxDisorderSampleStride = 8;
+static constexpr uint64_t kMinDisorderSamples = 1 << 16;
+
 void ResourceManager::LoadBalance() {
-  // Load balancing destroys the synchronization between the simulation and the
-  // environment. We mark the environment aus OutOfSync such that we can update
-  // the environment before accessing it again.
-  MarkEnvironmentOutOfSync();
   auto* param = Simulation::GetActive()->GetParam();
-  if (param->plot_memory_layout) {
-    PlotNeighborMemoryHistogram(true);
-  }
 
   // balance agents per numa node according to the number of
   // threads associated with each numa domain
@@ -277,39 +503,118 @@ void ResourceManager::LoadBalance() {
   auto lbi = env->GetLoadBalanceInfo();
 
   const bool minimize_memory = param->minimize_memory_while_rebalancing;
-
-// create new agents
-#pragma omp parallel
-  {
-    auto tid = thread_info_->GetMyThreadId();
+  const bool incremental = param->incremental_load_balancing;
+  const uint64_t block_size =
+      std::max(param->load_balancing_block_size, uint64_t{1});
+
+  // Range of the space-filling curve that is processed by thread `tid`. Each
+  // thread processes a contiguous range of the destination container of its
+  // numa node.
+  auto thread_range = [&](int tid, uint64_t* start, uint64_t* end) {
     auto nid = thread_info_->GetNumaNode(tid);
-
-    auto& dest = agents_lb_[nid];
-    if (thread_info_->GetNumaThreadId(tid) == 0) {
-      if (dest.capacity() < agent_per_numa[nid]) {
-        dest.reserve(agent_per_numa[nid] * 1.5);
-      }
-      dest.resize(agent_per_numa[nid]);
-    }
-
-#pragma omp barrier
-
     auto threads_in_numa = thread_info_->GetThreadsInNumaNode(nid);
-    assert(thread_info_->GetNumaNode(tid) == numa_node_of_cpu(sched_getcpu()));
-
     // use static scheduling
     auto correction = agent_per_numa[nid] % threads_in_numa == 0 ? 0 : 1;
     auto chunk = agent_per_numa[nid] / threads_in_numa + correction;
-    auto start =
+    *start =
         thread_info_->GetNumaThreadId(tid) * chunk + agent_per_numa_cumm[nid];
-    auto end =
-        std::min(agent_per_numa_cumm[nid] + agent_per_numa[nid], start + chunk);
+    *end = std::min(agent_per_numa_cumm[nid] + agent_per_numa[nid],
+                    *start + chunk);
+  };
+
+  // Iterates over the agents in the order of the space-filling curve.
+  // Returns the number of agents that are out of place.
+  auto balance = [&]() {
+    std::atomic<uint64_t> num_moved(0);
+#pragma omp parallel
+    {
+      auto tid = thread_info_->GetMyThreadId();
+      auto nid = thread_info_->GetNumaNode(tid);
+
+      auto& dest = agents_lb_[nid];
+      if (thread_info_->GetNumaThreadId(tid) == 0) {
+        if (dest.capacity() < agent_per_numa[nid]) {
+          dest.reserve(agent_per_numa[nid] * 1.5);
+        }
+        dest.resize(agent_per_numa[nid]);
+      }
+#pragma omp barrier
+      assert(thread_info_->GetNumaNode(tid) ==
+             numa_node_of_cpu(sched_getcpu()));
 
-    LoadBalanceFunctor f(minimize_memory, start - agent_per_numa_cumm[nid], nid,
-                         agents_, dest, uid_ah_map_, type_index_);
-    lbi->CallHandleIteratorConsumer(start, end, f);
+      uint64_t start = 0;
+      uint64_t end = 0;
+      thread_range(tid, &start, &end);
+      LoadBalanceFunctor f(minimize_memory, incremental, false, block_size,
+                           start - agent_per_numa_cumm[nid], nid, agents_,
+                           dest, uid_ah_map_, type_index_);
+      lbi->CallHandleIteratorConsumer(start, end, f);
+      num_moved += f.num_moved;
+    }
+    return num_moved.load();
+  };
+
+  // Estimates the fraction of agents that are out of place from every
+  // `stride`-th block of the space-filling curve.
+  auto estimate_disorder = [&](uint64_t stride) {
+    std::atomic<uint64_t> num_moved(0);
+    std::atomic<uint64_t> num_sampled(0);
+#pragma omp parallel
+    {
+      auto tid = thread_info_->GetMyThreadId();
+      auto nid = thread_info_->GetNumaNode(tid);
+      auto& dest = agents_lb_[nid];
+      uint64_t start = 0;
+      uint64_t end = 0;
+      thread_range(tid, &start, &end);
+      uint64_t moved = 0;
+      uint64_t sampled = 0;
+      for (auto s = start; s < end; s += stride * block_size) {
+        auto e = std::min(end, s + block_size);
+        LoadBalanceFunctor f(minimize_memory, incremental, true, block_size,
+                             s - agent_per_numa_cumm[nid], nid, agents_, dest,
+                             uid_ah_map_, type_index_);
+        lbi->CallHandleIteratorConsumer(s, e, f);
+        moved += f.num_moved;
+        sampled += e - s;
+      }
+      num_moved += moved;
+      num_sampled += sampled;
+    }
+    return num_sampled != 0 ? static_cast<real_t>(num_moved) / num_sampled
+                            : real_t(0);
+  };
+
+  auto num_agents = GetNumAgents();
+  // Estimate how many agents drifted out of their numa segment or block
+  // since the last call. Skip load balancing if the agents are still ordered.
+  if (param->load_balancing_disorder_threshold > 0 && num_agents != 0) {
+    auto stride = std::min(kMaxDisorderSampleStride,
+                           std::max(num_agents / kMinDisorderSamples,
+                                    uint64_t{1}));
+    spatial_disorder_ = estimate_disorder(stride);
+    if (spatial_disorder_ < param->load_balancing_disorder_threshold) {
+      // Load balancing would have removed the tombstones
+      if (GetNumTombstones() != 0) {
+        Compact();
+      }
+      return;
+    }
   }
 
+  // Load balancing destroys the synchronization between the simulation and the
+  // environment. We mark the environment aus OutOfSync such that we can update
+  // the environment before accessing it again.
+  MarkEnvironmentOutOfSync();
+  if (param->plot_memory_layout) {
+    PlotNeighborMemoryHistogram(true);
+  }
+
+  // create new agents
+  auto num_moved = balance();
+  spatial_disorder_ =
+      num_agents != 0 ? static_cast<real_t>(num_moved) / num_agents : 0;
+
   // delete old objects. This approach has a high chance that a thread
   // in the right numa node will delete the object, thus minimizing thread
   // synchronization overheads. The bdm memory allocator does not have this
@@ -321,6 +626,7 @@ void ResourceManager::LoadBalance() {
 
   for (int n = 0; n < numa_nodes; n++) {
     agents_[n].swap(agents_lb_[n]);
+    num_tombstones_[n] = 0;
     if (param->plot_memory_layout) {
       PlotMemoryLayout(agents_[n], n);
       PlotMemoryHistogram(agents_[n], n);
@@ -338,6 +644,15 @@ void ResourceManager::LoadBalance() {
 // -----------------------------------------------------------------------------
 void ResourceManager::RemoveAgents(
     const std::vector<std::vector<AgentUid>*>& uids) {
+  if (KeepTombstones()) {
+    RemoveAgentsWithTombstones(uids);
+    return;
+  }
+  // The swaps below must not move tombstones
+  if (GetNumTombstones() != 0) {
+    Compact();
+  }
+
   // initialization
   auto numa_nodes = thread_info_->GetNumaNodes();
   // cumulative numbers of to be removed agents
@@ -575,6 +890,112 @@ void ResourceManager::RemoveAgents(
   MarkEnvironmentOutOfSync();
 }
 
+// -----------------------------------------------------------------------------
+void ResourceManager::RemoveAgentsWithTombstones(
+    const std::vector<std::vector<AgentUid>*>& uids) {
+  auto numa_nodes = thread_info_->GetNumaNodes();
+  auto* uid_generator = Simulation::GetActive()->GetAgentUidGenerator();
+
+#pragma omp parallel
+  {
+    // number of removed agents per numa node
+    std::vector<uint64_t> removed(numa_nodes);
+#pragma omp for schedule(static, 1)
+    for (uint64_t i = 0; i < uids.size(); ++i) {
+      for (auto& uid : *uids[i]) {
+        assert(ContainsAgent(uid));
+        auto ah = uid_ah_map_[uid];
+        auto nid = ah.GetNumaNode();
+        Agent* agent = agents_[nid][ah.GetElementIdx()];
+        agents_[nid][ah.GetElementIdx()] = nullptr;
+        uid_ah_map_.Remove(uid);
+        uid_generator->ReuseAgentUid(uid);
+        if (type_index_) {
+#pragma omp critical
+          type_index_->Remove(agent);
+        }
+        delete agent;
+        removed[nid]++;
+      }
+    }
+    for (int n = 0; n < numa_nodes; ++n) {
+      if (removed[n] != 0) {
+#pragma omp atomic
+        num_tombstones_[n] += removed[n];
+      }
+    }
+  }
+
+  auto* param = Simulation::GetActive()->GetParam();
+  if (GetNumTombstones() >
+      param->agent_removal_tombstone_threshold * GetAgentContainerSize()) {
+    Compact();
+  }
+  MarkEnvironmentOutOfSync();
+}
+
+// -----------------------------------------------------------------------------
+void ResourceManager::Compact() {
+  // number of agents in each thread's partition, later its destination offset
+  std::vector<uint64_t> offsets(thread_info_->GetMaxThreads() + 1);
+  for (uint64_t n = 0; n < agents_.size(); ++n) {
+    if (num_tombstones_[n] == 0) {
+      continue;
+    }
+    auto& src = agents_[n];
+    auto& dest = agents_lb_[n];
+    dest.resize(src.size() - num_tombstones_[n]);
+
+#pragma omp parallel
+    {
+      auto tid = thread_info_->GetMyThreadId();
+      auto num_threads = static_cast<uint64_t>(omp_get_num_threads());
+      uint64_t start = 0;
+      uint64_t end = 0;
+      Partition(src.size(), num_threads, tid, &start, &end);
+      uint64_t count = 0;
+      for (uint64_t i = start; i < end; ++i) {
+        count += src[i] != nullptr;
+      }
+      offsets[tid + 1] = count;
+#pragma omp barrier
+#pragma omp single
+      {
+        offsets[0] = 0;
+        for (uint64_t t = 1; t <= num_threads; ++t) {
+          offsets[t] += offsets[t - 1];
+        }
+      }
+      auto idx = offsets[tid];
+      for (uint64_t i = start; i < end; ++i) {
+        auto* agent = src[i];
+        if (agent != nullptr) {
+          dest[idx] = agent;
+          if (idx != i) {
+            uid_ah_map_.Insert(
+                agent->GetUid(),
+                AgentHandle(static_cast<AgentHandle::NumaNode_t>(n),
+                            static_cast<AgentHandle::ElementIdx_t>(idx)));
+          }
+          idx++;
+        }
+      }
+    }
+    src.swap(dest);
+    num_tombstones_[n] = 0;
+  }
+  MarkEnvironmentOutOfSync();
+}
+
+// -----------------------------------------------------------------------------
+bool ResourceManager::KeepTombstones() const {
+  auto* sim = Simulation::GetActive();
+  auto* param = sim->GetParam();
+  return param->agent_removal_tombstones && param->compute_target == "cpu" &&
+         dynamic_cast<UniformGridEnvironment*>(sim->GetEnvironment()) !=
+             nullptr;
+}
+
 // -----------------------------------------------------------------------------
 size_t ResourceManager::GetAgentVectorCapacity(int numa_node) {
   return agents_[numa_node].capacity();
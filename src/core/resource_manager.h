@@ -67,35 +67,39 @@ class ResourceManager {
       delete el.second;
     }
     for (auto& numa_agents : agents_) {
-      for (auto* agent : numa_agents) {
-        delete agent;
+#pragma omp parallel for
+      for (uint64_t i = 0; i < numa_agents.size(); ++i) {
+        delete numa_agents[i];
       }
     }
     agents_ = std::move(other.agents_);
     agents_lb_.resize(agents_.size());
+    num_tombstones_.assign(agents_.size(), 0);
     continuum_models_ = std::move(other.continuum_models_);
 
     RebuildAgentUidMap();
     // restore type_index_
     if (type_index_) {
-      for (auto& numa_agents : agents_) {
-        for (auto* agent : numa_agents) {
-          type_index_->Add(agent);
-        }
-      }
+      type_index_->Rebuild(agents_);
     }
     return *this;
   }
 
   void RebuildAgentUidMap() {
     // rebuild uid_ah_map_
-    uid_ah_map_.clear();
     auto* agent_uid_generator = Simulation::GetActive()->GetAgentUidGenerator();
     uid_ah_map_.resize(agent_uid_generator->GetHighestIndex() + 1);
+    uid_ah_map_.ParallelClear();
+    // Each uid has its own slot. Therefore, agents can be inserted in
+    // parallel.
     for (AgentHandle::NumaNode_t n = 0; n < agents_.size(); ++n) {
-      for (AgentHandle::ElementIdx_t i = 0; i < agents_[n].size(); ++i) {
-        auto* agent = agents_[n][i];
-        this->uid_ah_map_.Insert(agent->GetUid(), AgentHandle(n, i));
+      auto& numa_agents = agents_[n];
+#pragma omp parallel for
+      for (AgentHandle::ElementIdx_t i = 0; i < numa_agents.size(); ++i) {
+        auto* agent = numa_agents[i];
+        if (agent != nullptr) {
+          this->uid_ah_map_.Insert(agent->GetUid(), AgentHandle(n, i));
+        }
       }
     }
   }
@@ -108,6 +112,8 @@ class ResourceManager {
     return agents_[ah.GetNumaNode()][ah.GetElementIdx()];
   }
 
+  /// Returns nullptr if the agent at `ah` has been replaced by a tombstone
+  /// (see `Param::agent_removal_tombstones`).
   Agent* GetAgent(AgentHandle ah) {
     return agents_[ah.GetNumaNode()][ah.GetElementIdx()];
   }
@@ -254,17 +260,39 @@ class ResourceManager {
   /// Returns the total number of agents if numa_node == -1
   /// Otherwise the number of agents in the specific numa node
   size_t GetNumAgents(int numa_node = -1) const {
+    return GetAgentContainerSize(numa_node) - GetNumTombstones(numa_node);
+  }
+
+  /// Returns the number of agents including tombstones (see
+  /// `Param::agent_removal_tombstones`), i.e. an upper bound for the element
+  /// indices of AgentHandles, for all numa nodes if numa_node == -1.
+  size_t GetAgentContainerSize(int numa_node = -1) const {
     if (numa_node == -1) {
-      size_t num_agents = 0;
+      size_t size = 0;
       for (auto& numa_agents : agents_) {
-        num_agents += numa_agents.size();
+        size += numa_agents.size();
       }
-      return num_agents;
+      return size;
     } else {
       return agents_[numa_node].size();
     }
   }
 
+  /// Returns the number of removed agents that have not been compacted yet
+  /// (see `Param::agent_removal_tombstones`) for all numa nodes if
+  /// numa_node == -1.
+  size_t GetNumTombstones(int numa_node = -1) const {
+    if (numa_node == -1) {
+      size_t num_tombstones = 0;
+      for (auto n : num_tombstones_) {
+        num_tombstones += n;
+      }
+      return num_tombstones;
+    } else {
+      return num_tombstones_[numa_node];
+    }
+  }
+
   size_t GetAgentVectorCapacity(int numa_node);
 
   /// Call a function for all or a subset of agents in the simulation.
@@ -281,7 +309,7 @@ class ResourceManager {
                             Functor<bool, Agent*>* filter = nullptr) {
     for (auto& numa_agents : agents_) {
       for (auto* agent : numa_agents) {
-        if (!filter || (filter && (*filter)(agent))) {
+        if (agent != nullptr && (!filter || (filter && (*filter)(agent)))) {
           function(agent);
         }
       }
@@ -295,7 +323,7 @@ class ResourceManager {
       auto& numa_agents = agents_[n];
       for (AgentHandle::ElementIdx_t i = 0; i < numa_agents.size(); ++i) {
         auto* a = numa_agents[i];
-        if (!filter || (filter && (*filter)(a))) {
+        if (a != nullptr && (!filter || (filter && (*filter)(a)))) {
           function(a, AgentHandle(n, i));
         }
       }
@@ -334,6 +362,41 @@ class ResourceManager {
       uint64_t chunk, Functor<void, Agent*, AgentHandle>& function,
       Functor<bool, Agent*>* filter = nullptr);
 
+  /// Call a function for all or a subset of agents in the simulation.
+  /// Function invocations are parallelized with work stealing. Each thread
+  /// starts with a contiguous range of the agents in its NUMA domain, which
+  /// preserves the space-filling curve order established by `LoadBalance`.
+  /// A thread splits its current range in halves only if its deque is empty,
+  /// and keeps the upper half in the deque. Idle threads steal the oldest
+  /// (i.e. largest) range of another thread, preferably from the same NUMA
+  /// domain. Threads that find no work back off before they try again. The
+  /// busy and idle time and the number of steals of each thread can be
+  /// obtained with `GetThreadBusyTimes`, `GetThreadIdleTimes` and
+  /// `GetThreadSteals` afterwards.
+  /// \param min_chunk ranges with fewer agents are not split
+  /// \see ForEachAgent
+  virtual void ForEachAgentParallelWorkStealing(
+      uint64_t min_chunk, Functor<void, Agent*, AgentHandle>& function,
+      Functor<bool, Agent*>* filter = nullptr);
+
+  /// Returns the time in nanoseconds each thread spent processing agents
+  /// during the last call of `ForEachAgentParallelWorkStealing`.
+  const std::vector<int64_t>& GetThreadBusyTimes() const {
+    return thread_busy_times_;
+  }
+
+  /// Returns the time in nanoseconds each thread waited for work during the
+  /// last call of `ForEachAgentParallelWorkStealing`.
+  const std::vector<int64_t>& GetThreadIdleTimes() const {
+    return thread_idle_times_;
+  }
+
+  /// Returns the number of ranges each thread stole from other threads
+  /// during the last call of `ForEachAgentParallelWorkStealing`.
+  const std::vector<uint64_t>& GetThreadSteals() const {
+    return thread_steals_;
+  }
+
   /// Reserves enough memory to hold `capacity` number of agents for
   /// each numa domain.
   void Reserve(size_t capacity) {
@@ -378,6 +441,7 @@ class ResourceManager {
       }
       numa_agents.clear();
     }
+    num_tombstones_.assign(agents_.size(), 0);
     if (type_index_) {
       type_index_->Clear();
     }
@@ -385,8 +449,30 @@ class ResourceManager {
 
   /// Reorder agents such that, agents are distributed to NUMA
   /// nodes. Nearby agents will be moved to the same NUMA node.
+  /// Removes all tombstones.\n
+  /// If `Param::incremental_load_balancing` is set, only agents that are out
+  /// of place are copied (see `GetSpatialDisorder`). If
+  /// `Param::load_balancing_disorder_threshold` is set, the agents are not
+  /// reordered as long as the fraction of agents that are out of place is
+  /// below the threshold. This fraction is estimated from a sample of the
+  /// agents. The tombstones are removed in this case as well.
   virtual void LoadBalance();
 
+  /// Returns the fraction of agents that were out of place in the last call
+  /// to `LoadBalance`, or its estimate if the agents were not reordered. An
+  /// agent is out of place if its position in the space-filling curve order
+  /// belongs to a different NUMA node, or is at least
+  /// `Param::load_balancing_block_size` elements away from its position in
+  /// the agent container.
+  real_t GetSpatialDisorder() const { return spatial_disorder_; }
+
+  /// Removes all tombstones (see `Param::agent_removal_tombstones`) while
+  /// preserving the order of the remaining agents.\n
+  /// NB: This method is not thread-safe! This function invalidates
+  /// agent references pointing into the ResourceManager. AgentPointer are
+  /// not affected.
+  void Compact();
+
   void DebugNuma() const;
 
   /// @brief Add an agent to the ResourceManager (not thread-safe). This
@@ -465,7 +551,12 @@ class ResourceManager {
       // remove from vector
       auto& numa_agents = agents_[ah.GetNumaNode()];
       Agent* agent = nullptr;
-      if (ah.GetElementIdx() == numa_agents.size() - 1) {
+      if (num_tombstones_[ah.GetNumaNode()] != 0 || KeepTombstones()) {
+        // the last element might be a tombstone
+        agent = numa_agents[ah.GetElementIdx()];
+        numa_agents[ah.GetElementIdx()] = nullptr;
+        num_tombstones_[ah.GetNumaNode()]++;
+      } else if (ah.GetElementIdx() == numa_agents.size() - 1) {
         agent = numa_agents.back();
         numa_agents.pop_back();
       } else {
@@ -489,6 +580,13 @@ class ResourceManager {
   //              node
   void RemoveAgents(const std::vector<std::vector<AgentUid>*>& uids);
 
+  /// Returns true if removed agents are replaced by tombstones instead of
+  /// compacting the agent containers immediately. Requires
+  /// `Param::agent_removal_tombstones`, the uniform grid environment and the
+  /// cpu as compute target, because other environments and the GPU
+  /// operations index agents by their position in the containers.
+  bool KeepTombstones() const;
+
   const TypeIndex* GetTypeIndex() const { return type_index_; }
 
  protected:
@@ -501,8 +599,13 @@ class ResourceManager {
   AgentUidMap<AgentHandle> uid_ah_map_ = AgentUidMap<AgentHandle>(100u);  //!
   /// Pointer container for all agents
   std::vector<std::vector<Agent*>> agents_;
+  /// Number of tombstones in each numa node. The ResourceManager is compacted
+  /// before a backup. Therefore, tombstones are never serialized.
+  std::vector<uint64_t> num_tombstones_;  //!
   /// Container used during load balancing
   std::vector<std::vector<Agent*>> agents_lb_;  //!
+  /// Result of the last measurement in `LoadBalance`
+  real_t spatial_disorder_ = 0;  //!
 
   ThreadInfo* thread_info_ = ThreadInfo::GetInstance();  //!
 
@@ -516,6 +619,20 @@ class ResourceManager {
   /// auxiliary data required for parallel agent removal
   ParallelRemovalAuxData parallel_remove_;  //!
 
+  /// Replaces the agents with the given uids by tombstones and compacts the
+  /// agent containers if the fraction of tombstones exceeds
+  /// `Param::agent_removal_tombstone_threshold`.
+  void RemoveAgentsWithTombstones(
+      const std::vector<std::vector<AgentUid>*>& uids);
+
+  /// Busy and idle time of each thread in nanoseconds during the last call of
+  /// `ForEachAgentParallelWorkStealing`
+  std::vector<int64_t> thread_busy_times_;  //!
+  std::vector<int64_t> thread_idle_times_;  //!
+  /// Number of ranges each thread stole during the last call of
+  /// `ForEachAgentParallelWorkStealing`
+  std::vector<uint64_t> thread_steals_;  //!
+
   friend class SimulationBackup;
   friend std::ostream& operator<<(std::ostream& os, const ResourceManager& rm);
 
@@ -529,8 +646,8 @@ class ResourceManager {
 inline std::ostream& operator<<(std::ostream& os, const ResourceManager& rm) {
   os << "\033[1mAgents per numa node\033[0m" << std::endl;
   uint64_t cnt = 0;
-  for (auto& numa_agents : rm.agents_) {
-    os << "numa node " << cnt++ << " -> size: " << numa_agents.size()
+  for (uint64_t n = 0; n < rm.agents_.size(); ++n) {
+    os << "numa node " << cnt++ << " -> size: " << rm.GetNumAgents(n)
        << std::endl;
   }
   return os;
@@ -15,9 +15,14 @@
 #include "core/scheduler.h"
 #include <chrono>
 #include <iomanip>
+#include <numeric>
 #include <string>
 #include <utility>
+#include "core/analysis/time_series.h"
+#include "core/environment/uniform_grid_environment.h"
+#include "core/execution_context/copy_execution_context.h"
 #include "core/execution_context/in_place_exec_ctxt.h"
+#include "core/memory/memory_manager.h"
 #include "core/operation/bound_space_op.h"
 #include "core/operation/continuum_op.h"
 #include "core/operation/mechanical_forces_op.h"
@@ -99,6 +104,23 @@ Scheduler::Scheduler() {
     }
   }
 
+  // Replace the agent operation "mechanical forces" with its standalone
+  // counterpart that exploits Newton's third law
+  if (param->symmetric_mechanical_forces && param->compute_target == "cpu") {
+    std::replace(default_op_names.begin(), default_op_names.end(),
+                 std::string("mechanical forces"),
+                 std::string("symmetric mechanical forces"));
+  }
+
+  // Return unused memory to the operating system after the agents have been
+  // removed
+  if (param->use_bdm_mem_mgr && param->mem_mgr_trim_frequency != 0) {
+    auto it = std::find(post_scheduled_ops_names.begin(),
+                        post_scheduled_ops_names.end(),
+                        std::string("tear down iteration"));
+    post_scheduled_ops_names.insert(it + 1, "trim memory");
+  }
+
   // Schedule the default operations
   for (auto& def_op : default_op_names) {
     ScheduleOp(NewOperation(def_op), OpType::kSchedule);
@@ -109,7 +131,14 @@ Scheduler::Scheduler() {
   }
 
   for (auto& def_op : post_scheduled_ops_names) {
-    ScheduleOp(NewOperation(def_op), OpType::kPostSchedule);
+    auto* op = NewOperation(def_op);
+    if (def_op == "trim memory") {
+      op->frequency_ = param->mem_mgr_trim_frequency;
+    } else if (def_op == "load balancing" &&
+               param->load_balancing_disorder_threshold > 0) {
+      op->frequency_ = 1;
+    }
+    ScheduleOp(op, OpType::kPostSchedule);
   }
 
   if (!GetOps("visualize").empty()) {
@@ -139,6 +168,7 @@ void Scheduler::Simulate(uint64_t steps) {
     UpdateSimulatedTime();
     Backup();
   }
+  ReleaseArenaRegions();
 }
 
 void Scheduler::SimulateUntil(const std::function<bool()>& exit_condition) {
@@ -148,6 +178,15 @@ void Scheduler::SimulateUntil(const std::function<bool()>& exit_condition) {
     total_steps_++;
     UpdateSimulatedTime();
   }
+  ReleaseArenaRegions();
+}
+
+void Scheduler::ReleaseArenaRegions() const {
+  auto* sim = Simulation::GetActive();
+  auto* mem_mgr = sim->GetMemoryManager();
+  if (mem_mgr != nullptr && sim->GetParam()->mem_mgr_arena) {
+    mem_mgr->ReleaseArenaRegions();
+  }
 }
 
 void Scheduler::FinalizeInitialization() const {
@@ -161,6 +200,10 @@ real_t Scheduler::GetSimulatedTime() const { return simulated_time_; }
 
 TimingAggregator* Scheduler::GetOpTimes() { return &op_times_; }
 
+const WorkStealingStatistics& Scheduler::GetWorkStealingStatistics() const {
+  return work_stealing_stats_;
+}
+
 void Scheduler::ScheduleOp(Operation* op, OpType op_type) {
   // Check if operation is already in all_ops_ (could be the case when
   // trying to reschedule a previously unscheduled operation)
@@ -247,17 +290,26 @@ const std::vector<Functor<bool, Agent*>*>& Scheduler::GetAgentFilters() const {
 }
 
 struct RunAllScheduledOps : Functor<void, Agent*, AgentHandle> {
-  explicit RunAllScheduledOps(std::vector<Operation*>& scheduled_ops)
-      : scheduled_ops_(scheduled_ops) {
+  explicit RunAllScheduledOps(
+      std::vector<Operation*>& scheduled_ops,
+      const std::vector<experimental::Reducer<real_t>*>* reducers = nullptr)
+      : scheduled_ops_(scheduled_ops), reducers_(reducers) {
     sim_ = Simulation::GetActive();
   }
 
   void operator()(Agent* agent, AgentHandle ah) override {
     sim_->GetExecutionContext()->Execute(agent, ah, scheduled_ops_);
+    if (reducers_ != nullptr) {
+      for (auto* reducer : *reducers_) {
+        (*reducer)(agent);
+      }
+    }
   }
 
   Simulation* sim_;
   std::vector<Operation*>& scheduled_ops_;
+  /// Time series reducers that are executed after the operations
+  const std::vector<experimental::Reducer<real_t>*>* reducers_;
 };
 
 void Scheduler::SetUpOps() {
@@ -285,7 +337,7 @@ void Scheduler::RunPreScheduledOps() const {
 }
 
 // -----------------------------------------------------------------------------
-void Scheduler::RunAgentOps(Functor<bool, Agent*>* filter) const {
+void Scheduler::RunAgentOps(Functor<bool, Agent*>* filter) {
   auto* sim = Simulation::GetActive();
   auto* rm = sim->GetResourceManager();
   auto* param = sim->GetParam();
@@ -299,27 +351,128 @@ void Scheduler::RunAgentOps(Functor<bool, Agent*>* filter) const {
     }
   }
 
+  // With kBoxColoring, the agents are processed in box colors to guarantee
+  // exclusive access to their microenvironment
+  UniformGridEnvironment* grid = nullptr;
+  if (param->thread_safety_mechanism ==
+      Param::ThreadSafetyMechanism::kBoxColoring) {
+    grid = dynamic_cast<UniformGridEnvironment*>(sim->GetEnvironment());
+    if (grid == nullptr) {
+      Log::Fatal("Scheduler::RunAgentOps",
+                 "The thread-safety mechanism box-coloring requires the "
+                 "uniform grid environment.");
+    }
+  }
+  auto for_each_agent = [&](RunAllScheduledOps& functor,
+                            const std::string& name) {
+    if (grid != nullptr) {
+      grid->ForEachAgentByBoxColor(functor, filter);
+    } else if (param->scheduling_work_stealing) {
+      rm->ForEachAgentParallelWorkStealing(batch_size, functor, filter);
+      if (param->statistics) {
+        // Average busy and idle time per thread
+        const auto& busy = rm->GetThreadBusyTimes();
+        const auto& idle = rm->GetThreadIdleTimes();
+        const auto& steals = rm->GetThreadSteals();
+        int64_t num_threads = std::max(busy.size(), size_t(1));
+        auto busy_sum = std::accumulate(busy.begin(), busy.end(), int64_t(0));
+        auto idle_sum = std::accumulate(idle.begin(), idle.end(), int64_t(0));
+        work_stealing_stats_.AddEntry(
+            name, busy_sum / num_threads, idle_sum / num_threads,
+            std::accumulate(steals.begin(), steals.end(), int64_t(0)));
+      }
+    } else {
+      rm->ForEachAgentParallel(batch_size, functor, filter);
+    }
+  };
+
   const auto& all_exec_ctxts = sim->GetAllExecCtxts();
   all_exec_ctxts[0]->SetupAgentOpsAll(all_exec_ctxts);
 
+  // The time series reducers are executed during the last pass over all
+  // agents (see `Param::fuse_time_series_reducers`)
+  std::vector<experimental::Reducer<real_t>*> reducers;
+  const std::vector<experimental::Reducer<real_t>*>* last_pass_reducers =
+      nullptr;
+  if (FuseTimeSeriesReducers(filter)) {
+    reducers = sim->GetTimeSeries()->StartFusedReduction();
+    last_pass_reducers = &reducers;
+  }
+
+  // New agents and behaviors are allocated from the arena
+  auto* mem_mgr = sim->GetMemoryManager();
+  if (mem_mgr != nullptr && param->mem_mgr_arena) {
+    mem_mgr->SetArenaEnabled(true);
+  }
+
   if (param->execution_order == Param::ExecutionOrder::kForEachAgentForEachOp) {
-    RunAllScheduledOps functor(agent_ops);
-    Timing::Time("agent ops", [&]() {
-      rm->ForEachAgentParallel(batch_size, functor, filter);
-    });
-  } else {
-    for (auto* op : agent_ops) {
+    RunAllScheduledOps functor(agent_ops, last_pass_reducers);
+    Timing::Time("agent ops", [&]() { for_each_agent(functor, "agent ops"); });
+  } else if (param->execution_order ==
+             Param::ExecutionOrder::kForEachOpForEachAgent) {
+    for (size_t i = 0; i < agent_ops.size(); ++i) {
+      auto* op = agent_ops[i];
       decltype(agent_ops) ops = {op};
-      RunAllScheduledOps functor(ops);
-      Timing::Time(op->name_, [&]() {
-        rm->ForEachAgentParallel(batch_size, functor, filter);
-      });
+      RunAllScheduledOps functor(
+          ops, i + 1 == agent_ops.size() ? last_pass_reducers : nullptr);
+      Timing::Time(op->name_, [&]() { for_each_agent(functor, op->name_); });
     }
+  } else {
+    auto plan = op_planner_.Plan(agent_ops, param->agent_op_fusion);
+    std::vector<int64_t> durations(plan.size());
+    for (size_t i = 0; i < plan.size(); ++i) {
+      RunAllScheduledOps functor(
+          plan[i].ops, i + 1 == plan.size() ? last_pass_reducers : nullptr);
+      auto start = Clock::now();
+      Timing::Time(plan[i].name,
+                   [&]() { for_each_agent(functor, plan[i].name); });
+      durations[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         Clock::now() - start)
+                         .count();
+    }
+    if (param->agent_op_fusion == Param::AgentOpFusion::kMeasureFusion) {
+      op_planner_.Update(plan, durations);
+    }
+  }
+  if (last_pass_reducers != nullptr && agent_ops.empty() &&
+      param->execution_order !=
+          Param::ExecutionOrder::kForEachAgentForEachOp) {
+    // There was no pass over all agents
+    decltype(agent_ops) no_ops;
+    RunAllScheduledOps functor(no_ops, last_pass_reducers);
+    Timing::Time("update time series",
+                 [&]() { for_each_agent(functor, "update time series"); });
   }
 
+  if (mem_mgr != nullptr) {
+    mem_mgr->SetArenaEnabled(false);
+  }
   all_exec_ctxts[0]->TearDownAgentOpsAll(all_exec_ctxts);
 }
 
+// -----------------------------------------------------------------------------
+bool Scheduler::FuseTimeSeriesReducers(Functor<bool, Agent*>* filter) const {
+  auto* sim = Simulation::GetActive();
+  if (!sim->GetParam()->fuse_time_series_reducers || filter != nullptr ||
+      !agent_filters_.empty()) {
+    return false;
+  }
+  // With the copy execution context the operations modify a copy of the
+  // agent, which the reducers can't access
+  auto* ctxt = sim->GetExecutionContext();
+  if (dynamic_cast<experimental::CopyExecutionContext*>(ctxt) != nullptr) {
+    return false;
+  }
+  // The reducers are only executed if "update time series" runs in this
+  // iteration
+  for (auto* op : post_scheduled_ops_) {
+    if (op->name_ == "update time series") {
+      return op->frequency_ != 0 && total_steps_ % op->frequency_ == 0;
+    }
+  }
+  return false;
+}
+
 // -----------------------------------------------------------------------------
 void Scheduler::RunScheduledOps() {
   SetUpOps();
@@ -424,8 +577,24 @@ void Scheduler::Backup() {
   if (backup_->BackupEnabled() &&
       duration_cast<seconds>(Clock::now() - last_backup_).count() >=
           param->backup_interval) {
+    // The previous asynchronous backup is still being written. Try again
+    // after the next iteration.
+    if (param->backup_async && backup_->BackupInProgress()) {
+      return;
+    }
     last_backup_ = Clock::now();
-    backup_->Backup(total_steps_);
+    // Tombstones are not persisted
+    auto* sim = Simulation::GetActive();
+    auto* rm = sim->GetResourceManager();
+    if (rm->GetNumTombstones() != 0) {
+      rm->Compact();
+      sim->GetEnvironment()->Update();
+    }
+    if (param->backup_async) {
+      backup_->BackupAsync(total_steps_);
+    } else {
+      backup_->Backup(total_steps_);
+    }
   }
 }
 
@@ -24,10 +24,12 @@
 #include <vector>
 
 #include "core/functor.h"
+#include "core/operation/agent_op_planner.h"
 #include "core/operation/operation.h"
 #include "core/param/param.h"
 #include "core/util/progress_bar.h"
 #include "core/util/timing_aggregator.h"
+#include "core/util/work_stealing_statistics.h"
 
 namespace bdm {
 
@@ -103,6 +105,10 @@ class Scheduler {
 
   TimingAggregator* GetOpTimes();
 
+  /// Load balance of the passes over all agents if
+  /// `Param::scheduling_work_stealing` and `Param::statistics` are enabled
+  const WorkStealingStatistics& GetWorkStealingStatistics() const;
+
   /// Prints an overview of all pre-scheduled, agent, standalone, and
   /// post-scheduled operations. For each iteration, the scheduler executes
   /// these operations in the order that they appear in the output.
@@ -152,12 +158,22 @@ class Scheduler {
   std::vector<Operation*> post_scheduled_ops_;
   /// Tracks operations' execution times
   TimingAggregator op_times_;
+  /// Tracks the load balance of work stealing
+  WorkStealingStatistics work_stealing_stats_;  //!
+  /// Groups the agent operations into passes for
+  /// `Param::ExecutionOrder::kPlanned`
+  AgentOpPlanner op_planner_;  //!
 
   /// Agent operations are executed for each filter in agent_filters_.\n
   /// By default no filter is specified which means that all
   /// agent operations will be executed for each agents in the simulation.
   std::vector<Functor<bool, Agent*>*> agent_filters_;  //!
 
+  /// Returns true if the reducer collectors of the time series should be
+  /// executed in the agent operations of this iteration (see
+  /// `Param::fuse_time_series_reducers`).
+  bool FuseTimeSeriesReducers(Functor<bool, Agent*>* filter) const;
+
   /// Backup the simulation. Backup interval based on `Param::backup_interval`
   void Backup();
 
@@ -168,6 +184,10 @@ class Scheduler {
 
   void UpdateSimulatedTime();
 
+  /// Releases the partially filled arena regions of all threads at the end
+  /// of `Simulate` and `SimulateUntil` (see `Param::mem_mgr_arena`).
+  void ReleaseArenaRegions() const;
+
   // TODO(lukas, ahmad) After https://trello.com/c/0D6sHCK4 has been resolved
   // think about a better solution, because some operations are executed twice
   // if Simulate is called with one timestep.
@@ -214,7 +234,7 @@ class Scheduler {
   // Run the operations in pre_scheduled_ops_ (executed before RunScheduledOps)
   void RunPreScheduledOps() const;
 
-  void RunAgentOps(Functor<bool, Agent*>* filter) const;
+  void RunAgentOps(Functor<bool, Agent*>* filter);
 
   // Run the operations in post_scheduled_ops_ (executed after RunScheduledOps)
   void RunPostScheduledOps() const;
@@ -168,6 +168,9 @@ std::ostream& operator<<(std::ostream& os, Simulation& sim) {
   os << std::endl;
   os << "***********************************************" << std::endl;
   os << *(sim.scheduler_->GetOpTimes()) << std::endl;
+  if (!sim.scheduler_->GetWorkStealingStatistics().Empty()) {
+    os << sim.scheduler_->GetWorkStealingStatistics() << std::endl;
+  }
   os << "***********************************************" << std::endl;
   os << std::endl;
   os << "\033[1mThread Info\033[0m" << std::endl;
@@ -178,6 +181,13 @@ std::ostream& operator<<(std::ostream& os, Simulation& sim) {
   os << *(sim.rm_);
   os << std::endl;
   os << "***********************************************" << std::endl;
+  if (sim.mem_mgr_) {
+    os << std::endl;
+    os << "\033[1mMemory Manager\033[0m" << std::endl;
+    os << sim.mem_mgr_->GetStatistics();
+    os << std::endl;
+    os << "***********************************************" << std::endl;
+  }
   os << std::endl;
   os << "\033[1mParameters\033[0m" << std::endl;
   os << sim.param_->ToJsonString();
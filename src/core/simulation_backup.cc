@@ -14,6 +14,30 @@
 
 #include "core/simulation_backup.h"
 
+#include <TClass.h>
+#include <TMemFile.h>
+#include <TTree.h>
+#include <fcntl.h>
+#include <omp.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <utility>
+
+#include "core/agent/agent.h"
+#include "core/agent/agent_handle.h"
+#include "core/diffusion/diffusion_grid.h"
+#include "core/resource_manager.h"
+#include "core/type_index.h"
+#include "core/util/partition.h"
+#include "core/util/thread_info.h"
+
 namespace bdm {
 
 SimulationBackup::SimulationBackup(const std::string& backup_file,
@@ -39,6 +63,355 @@ SimulationBackup::SimulationBackup(const std::string& backup_file,
   }
 }
 
+SimulationBackup::~SimulationBackup() { WaitForBackup(); }
+
+bool SimulationBackup::BackupAsync(size_t completed_simulation_steps) {
+  if (!backup_) {
+    Log::Fatal("SimulationBackup",
+               "Requested to backup data, but no backup file given.");
+  }
+  if (BackupInProgress()) {
+    return false;
+  }
+
+  // Otherwise buffered output would be written by both processes
+  std::cout.flush();
+  std::cerr.flush();
+  fflush(nullptr);
+
+  auto pid = fork();
+  if (pid == 0) {
+    // Child process. Only the calling thread exists in the child. Therefore,
+    // OpenMP must not start a parallel region.
+    omp_set_num_threads(1);
+    Backup(completed_simulation_steps);
+    // Skip atexit handlers and destructors of the parent's objects.
+    _exit(0);
+  } else if (pid < 0) {
+    Log::Warning("SimulationBackup", "Could not fork backup process (",
+                 strerror(errno), "). Writing the backup synchronously.");
+    Backup(completed_simulation_steps);
+    return true;
+  }
+  backup_pid_ = pid;
+  return true;
+}
+
+bool SimulationBackup::BackupInProgress() { return !FinishBackup(false); }
+
+void SimulationBackup::WaitForBackup() { FinishBackup(true); }
+
+bool SimulationBackup::FinishBackup(bool block) {
+  if (backup_pid_ == -1) {
+    return true;
+  }
+  int status = 0;
+  auto ret = waitpid(backup_pid_, &status, block ? 0 : WNOHANG);
+  if (ret == 0) {
+    return false;
+  }
+  if (ret == -1) {
+    Log::Warning("SimulationBackup", "Could not wait for backup process ",
+                 backup_pid_, " (", strerror(errno), ").");
+  } else if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    Log::Warning("SimulationBackup", "Asynchronous backup to ", backup_file,
+                 " failed.");
+  }
+  backup_pid_ = -1;
+  return true;
+}
+
+namespace {
+
+/// Number of boxes of a diffusion grid that are stored in one tree entry
+constexpr uint32_t kGridBlockSize = 1 << 16;
+
+/// Leaf type of real_t values in a TTree
+const char* RealLeafType() { return sizeof(real_t) == 4 ? "F" : "D"; }
+
+std::string GetAgentTreeName(uint64_t type) {
+  return "agents_" + std::to_string(type);
+}
+
+std::string GetGridTreeName(int continuum_id) {
+  return "diffusion_grid_" + std::to_string(continuum_id);
+}
+
+}  // namespace
+
+// -----------------------------------------------------------------------------
+void SimulationBackup::WriteColumnar(TFile* file) const {
+  auto* sim = Simulation::GetActive();
+  auto* rm = sim->GetResourceManager();
+  file->SetCompressionSettings(sim->GetParam()->backup_compression);
+
+  // Write the remaining simulation state without the agents and the grid
+  // data, which are detached for the duration of the write. The type index
+  // references the agents as well and would otherwise serialize them a
+  // second time. It is rebuilt from the restored agents.
+  std::vector<std::vector<Agent*>> agents(
+      ThreadInfo::GetInstance()->GetNumaNodes());
+  TypeIndex* type_index_detached = nullptr;
+  std::vector<DiffusionGrid*> grids;
+  rm->ForEachDiffusionGrid([&](DiffusionGrid* grid) { grids.push_back(grid); });
+  std::vector<ParallelResizeVector<real_t>> c1(grids.size());
+  std::vector<ParallelResizeVector<real_t>> c2(grids.size());
+  std::vector<ParallelResizeVector<Real3>> gradients(grids.size());
+  auto detach = [&]() {
+    rm->SwapAgents(&agents);
+    std::swap(rm->type_index_, type_index_detached);
+    for (size_t i = 0; i < grids.size(); ++i) {
+      c1[i].swap(grids[i]->c1_);
+      c2[i].swap(grids[i]->c2_);
+      gradients[i].swap(grids[i]->gradients_);
+    }
+  };
+  detach();
+  file->WriteObject(sim, kSimulationName.c_str());
+  // reattach
+  detach();
+  IntegralTypeWrapper<size_t> version(1);
+  file->WriteObject(&version, kColumnarFormatName.c_str());
+
+  // Agents: one tree per type. With split level 99, ROOT stores each data
+  // member in a separate branch, which is compressed on its own.
+  const TypeIndex* type_index = rm->GetTypeIndex();
+  TypeIndex tmp_index;
+  if (type_index == nullptr) {
+    tmp_index.Reserve(sim->GetAgentUidGenerator()->GetHighestIndex() + 1);
+    rm->ForEachAgent([&](Agent* agent) { tmp_index.Add(agent); });
+    type_index = &tmp_index;
+  }
+  uint64_t num_trees = 0;
+  for (auto* tclass : type_index->GetTypes()) {
+    const auto& type_agents = type_index->GetType(tclass);
+    if (type_agents.empty()) {
+      continue;
+    }
+    file->cd();
+    auto* tree =
+        new TTree(GetAgentTreeName(num_trees++).c_str(), tclass->GetName());
+    AgentHandle::NumaNode_t numa_node = 0;
+    AgentHandle::ElementIdx_t element_idx = 0;
+    void* agent = nullptr;
+    tree->Branch("numa_node", &numa_node, "numa_node/s");
+    tree->Branch("element_idx", &element_idx, "element_idx/i");
+    tree->Branch("agent", tclass->GetName(), &agent, 32000, 99);
+    for (auto* a : type_agents) {
+      auto ah = rm->GetAgentHandle(a->GetUid());
+      numa_node = ah.GetNumaNode();
+      element_idx = ah.GetElementIdx();
+      agent = tclass->DynamicCast(Agent::Class(), a, false);
+      tree->Fill();
+    }
+    tree->Write();
+  }
+
+  // Diffusion grids: raw blocks of concentrations and gradients
+  for (auto* grid : grids) {
+    file->cd();
+    auto* tree = new TTree(GetGridTreeName(grid->GetContinuumId()).c_str(),
+                           grid->GetContinuumName().c_str());
+    uint32_t size = 0;
+    uint32_t gradient_size = 0;
+    std::vector<real_t> c1_block(kGridBlockSize);
+    std::vector<real_t> gradient_block(3 * kGridBlockSize);
+    tree->Branch("size", &size, "size/i");
+    tree->Branch("gradient_size", &gradient_size, "gradient_size/i");
+    tree->Branch("c1", c1_block.data(),
+                 (std::string("c1[size]/") + RealLeafType()).c_str());
+    tree->Branch("gradients", gradient_block.data(),
+                 (std::string("gradients[gradient_size]/") + RealLeafType())
+                     .c_str());
+    const auto& grid_c1 = grid->c1_;
+    const auto& grid_gradients = grid->gradients_;
+    for (size_t offset = 0; offset < grid_c1.size(); offset += size) {
+      size = std::min<size_t>(kGridBlockSize, grid_c1.size() - offset);
+      std::copy(grid_c1.data() + offset, grid_c1.data() + offset + size,
+                c1_block.begin());
+      gradient_size = 0;
+      if (offset + size <= grid_gradients.size()) {
+        gradient_size = 3 * size;
+        auto* g = grid_gradients.data()->data() + 3 * offset;
+        std::copy(g, g + gradient_size, gradient_block.begin());
+      }
+      tree->Fill();
+    }
+    tree->Write();
+  }
+}
+
+// -----------------------------------------------------------------------------
+void SimulationBackup::ReadColumnar(TFile* file, Simulation* restored) const {
+  auto* rm = restored->GetResourceManager();
+
+  auto* tinfo = ThreadInfo::GetInstance();
+  const auto numa_nodes = tinfo->GetNumaNodes();
+
+  // Determine the position of each agent in ResourceManager, and group the
+  // entries of each tree by the NUMA node of the agent.
+  std::vector<std::vector<AgentHandle>> handles;
+  std::vector<std::vector<std::vector<Long64_t>>> numa_entries;
+  std::vector<uint64_t> sizes(numa_nodes);
+  for (uint64_t t = 0;; ++t) {
+    TTree* tree = nullptr;
+    file->GetObject(GetAgentTreeName(t).c_str(), tree);
+    if (tree == nullptr) {
+      break;
+    }
+    AgentHandle::NumaNode_t numa_node = 0;
+    AgentHandle::ElementIdx_t element_idx = 0;
+    tree->SetBranchAddress("numa_node", &numa_node);
+    tree->SetBranchAddress("element_idx", &element_idx);
+    auto* numa_node_branch = tree->GetBranch("numa_node");
+    auto* element_idx_branch = tree->GetBranch("element_idx");
+    handles.emplace_back(tree->GetEntries());
+    numa_entries.emplace_back(numa_nodes);
+    for (Long64_t e = 0; e < tree->GetEntries(); ++e) {
+      numa_node_branch->GetEntry(e);
+      element_idx_branch->GetEntry(e);
+      if (numa_node >= sizes.size()) {
+        Log::Fatal("SimulationBackup",
+                   "Restored ResourceManager has different number of NUMA "
+                   "nodes.");
+      }
+      handles.back()[e] = AgentHandle(numa_node, element_idx);
+      numa_entries.back()[numa_node].push_back(e);
+      sizes[numa_node] = std::max<uint64_t>(sizes[numa_node], element_idx + 1);
+    }
+  }
+
+  // Map the restore file into memory once. Threads read from the mapping
+  // through in-memory files that do not copy the data.
+  struct stat file_stat;
+  void* mapping = MAP_FAILED;
+  int fd = open(restore_file.c_str(), O_RDONLY);
+  if (fd != -1 && fstat(fd, &file_stat) == 0 && file_stat.st_size > 0) {
+    mapping = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  if (fd != -1) {
+    close(fd);
+  }
+  auto open_file = [&]() -> TFile* {
+    if (mapping == MAP_FAILED) {
+      return TFile::Open(restore_file.c_str());
+    }
+    TMemFile::ZeroCopyView_t view(static_cast<const char*>(mapping),
+                                  file_stat.st_size);
+    return new TMemFile(restore_file.c_str(), view);
+  };
+
+  // Construct the agents in parallel. The threads of a NUMA node construct
+  // the agents of this node, such that the memory of the agents is
+  // allocated on this node. The restoring run might use fewer threads than
+  // the run that created the backup. The agents of NUMA nodes without a
+  // thread are therefore constructed by all threads.
+  std::vector<std::vector<Agent*>> agents(sizes.size());
+  for (size_t n = 0; n < sizes.size(); ++n) {
+    agents[n].resize(sizes[n], nullptr);
+  }
+#pragma omp parallel
+  {
+    auto tid = omp_get_thread_num();
+    auto num_threads = omp_get_num_threads();
+    // Threads of the current team in each NUMA node
+    std::vector<int> threads_in_numa(sizes.size(), 0);
+    int ntid = 0;
+    for (int i = 0; i < num_threads; ++i) {
+      auto n = tinfo->GetNumaNode(i);
+      if (i == tid) {
+        ntid = threads_in_numa[n];
+      }
+      threads_in_numa[n]++;
+    }
+    auto nid = tinfo->GetNumaNode(tid);
+
+    TFileRaii f(open_file());
+    for (uint64_t t = 0; t < handles.size(); ++t) {
+      TTree* tree = nullptr;
+      TClass* tclass = nullptr;
+      void* agent = nullptr;
+      for (size_t n = 0; n < sizes.size(); ++n) {
+        if (n != static_cast<size_t>(nid) && threads_in_numa[n] != 0) {
+          continue;
+        }
+        const auto& entries = numa_entries[t][n];
+        uint64_t start = 0;
+        uint64_t end = 0;
+        if (threads_in_numa[n] != 0) {
+          Partition(entries.size(), threads_in_numa[n], ntid, &start, &end);
+        } else {
+          Partition(entries.size(), num_threads, tid, &start, &end);
+        }
+        if (start >= end) {
+          continue;
+        }
+        if (tree == nullptr) {
+          f.Get()->GetObject(GetAgentTreeName(t).c_str(), tree);
+          tclass = TClass::GetClass(tree->GetTitle());
+          tree->SetBranchStatus("numa_node", false);
+          tree->SetBranchStatus("element_idx", false);
+          tree->SetBranchAddress("agent", static_cast<void*>(&agent));
+        }
+        for (uint64_t i = start; i < end; ++i) {
+          auto e = entries[i];
+          agent = tclass->New();
+          tree->GetEntry(e);
+          auto ah = handles[t][e];
+          agents[ah.GetNumaNode()][ah.GetElementIdx()] =
+              static_cast<Agent*>(tclass->DynamicCast(Agent::Class(), agent));
+        }
+      }
+    }
+  }
+  if (mapping != MAP_FAILED) {
+    munmap(mapping, file_stat.st_size);
+  }
+  rm->SwapAgents(&agents);
+
+  // Load the diffusion grid data
+  rm->ForEachDiffusionGrid([&](DiffusionGrid* grid) {
+    TTree* tree = nullptr;
+    file->GetObject(GetGridTreeName(grid->GetContinuumId()).c_str(), tree);
+    if (tree == nullptr) {
+      Log::Fatal("SimulationBackup", "Data of diffusion grid ",
+                 grid->GetContinuumName(), " is missing in ", restore_file);
+    }
+    uint32_t size = 0;
+    uint32_t gradient_size = 0;
+    std::vector<real_t> c1_block(kGridBlockSize);
+    std::vector<real_t> gradient_block(3 * kGridBlockSize);
+    tree->SetBranchAddress("size", &size);
+    tree->SetBranchAddress("gradient_size", &gradient_size);
+    tree->SetBranchAddress("c1", c1_block.data());
+    tree->SetBranchAddress("gradients", gradient_block.data());
+    const size_t num_boxes = grid->total_num_boxes_;
+    grid->c1_.resize(num_boxes);
+    grid->c2_.resize(num_boxes);
+    grid->gradients_.resize(num_boxes);
+    size_t offset = 0;
+    for (Long64_t e = 0; e < tree->GetEntries(); ++e) {
+      tree->GetEntry(e);
+      if (offset + size > num_boxes) {
+        Log::Fatal("SimulationBackup", "Data of diffusion grid ",
+                   grid->GetContinuumName(), " does not match its size.");
+      }
+      std::copy(c1_block.begin(), c1_block.begin() + size,
+                grid->c1_.data() + offset);
+      if (gradient_size != 0) {
+        std::copy(gradient_block.begin(),
+                  gradient_block.begin() + gradient_size,
+                  &grid->gradients_[offset][0]);
+      }
+      offset += size;
+    }
+    // c2_ is a scratch buffer, but boundary boxes are not always written
+    std::copy(grid->c1_.data(), grid->c1_.data() + num_boxes,
+              grid->c2_.data());
+  });
+}
+
+// -----------------------------------------------------------------------------
 size_t SimulationBackup::GetSimulationStepsFromBackup() const {
   if (restore_) {
     IntegralTypeWrapper<size_t>* wrapper = nullptr;
@@ -65,6 +438,7 @@ const std::string SimulationBackup::kSimulationName = "simulation";
 const std::string SimulationBackup::kSimulationStepName =
     "completed_simulation_steps";
 const std::string SimulationBackup::kRuntimeVariableName = "runtime_variable";
+const std::string SimulationBackup::kColumnarFormatName = "columnar_format";
 
 std::vector<std::function<void()>> SimulationBackup::after_restore_event_ = {};
 
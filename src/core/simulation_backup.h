@@ -15,12 +15,14 @@
 #ifndef CORE_SIMULATION_BACKUP_H_
 #define CORE_SIMULATION_BACKUP_H_
 
+#include <sys/types.h>
 #include <functional>
 #include <sstream>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include "core/param/param.h"
 #include "core/simulation.h"
 
 #include "core/util/io.h"
@@ -36,6 +38,7 @@ class SimulationBackup {
   static const std::string kSimulationName;
   static const std::string kSimulationStepName;
   static const std::string kRuntimeVariableName;
+  static const std::string kColumnarFormatName;
 
   /// If a whole simulation is restored from a ROOT file, the new
   /// ResourceManager is not updated before the end. Consequently, during
@@ -51,6 +54,9 @@ class SimulationBackup {
   SimulationBackup(const std::string& backup_file,
                    const std::string& restore_file);
 
+  /// Waits until an asynchronous backup has finished
+  ~SimulationBackup();
+
   void Backup(size_t completed_simulation_steps) const {
     if (!backup_) {
       Log::Fatal("SimulationBackup",
@@ -66,7 +72,11 @@ class SimulationBackup {
     {
       TFileRaii f(tmp_file.str(), "UPDATE");
       auto* simulation = Simulation::GetActive();
-      f.Get()->WriteObject(simulation, kSimulationName.c_str());
+      if (simulation->GetParam()->backup_format == "columnar") {
+        WriteColumnar(f.Get());
+      } else {
+        f.Get()->WriteObject(simulation, kSimulationName.c_str());
+      }
       IntegralTypeWrapper<size_t> wrapper(completed_simulation_steps);
       f.Get()->WriteObject(&wrapper, kSimulationStepName.c_str());
       RuntimeVariables rv;
@@ -80,6 +90,18 @@ class SimulationBackup {
     rename(tmp_file.str().c_str(), backup_file.c_str());
   }
 
+  /// Writes the backup in a forked child process, which operates on a
+  /// copy-on-write snapshot of the simulation, and returns immediately.
+  /// Returns false if the previous asynchronous backup is still in progress.
+  /// In this case no backup is made.
+  bool BackupAsync(size_t completed_simulation_steps);
+
+  /// Returns true if an asynchronous backup is still being written.
+  bool BackupInProgress();
+
+  /// Blocks until the asynchronous backup (if any) has finished.
+  void WaitForBackup();
+
   void Restore() {
     if (!restore_) {
       Log::Fatal("SimulationBackup",
@@ -97,6 +119,9 @@ class SimulationBackup {
     }
     Simulation* restored_simulation = nullptr;
     file.Get()->GetObject(kSimulationName.c_str(), restored_simulation);
+    if (file.Get()->GetKey(kColumnarFormatName.c_str()) != nullptr) {
+      ReadColumnar(file.Get(), restored_simulation);
+    }
     Simulation::GetActive()->Restore(std::move(*restored_simulation));
     Log::Info("Scheduler", "Restored simulation from ", restore_file);
     delete restored_simulation;
@@ -117,8 +142,23 @@ class SimulationBackup {
  private:
   bool backup_ = false;
   bool restore_ = true;
+  /// Process id of the child process that writes the asynchronous backup.
+  /// -1 if no backup is in progress.
+  pid_t backup_pid_ = -1;
   std::string backup_file;
   std::string restore_file;
+
+  /// Writes the simulation to `file` in the columnar format (see
+  /// `Param::backup_format`).
+  void WriteColumnar(TFile* file) const;
+
+  /// Loads the agents and diffusion grid data of a columnar backup into
+  /// `restored`, which has been read from the same `file`.
+  void ReadColumnar(TFile* file, Simulation* restored) const;
+
+  /// Reaps the child process of the asynchronous backup.
+  /// If `block` is false, returns false if the child is still running.
+  bool FinishBackup(bool block);
 };
 
 }  // namespace bdm
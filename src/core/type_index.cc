@@ -15,6 +15,11 @@
 #include "core/type_index.h"
 
 #include <TClass.h>
+#include <omp.h>
+#include <algorithm>
+#include <unordered_map>
+
+#include "core/util/partition.h"
 
 namespace bdm {
 
@@ -59,6 +64,85 @@ void TypeIndex::Clear() {
   }
 }
 
+// -----------------------------------------------------------------------------
+void TypeIndex::Rebuild(const std::vector<std::vector<Agent*>>& agents) {
+  for (auto& pair : data_) {
+    pair.second.clear();
+  }
+  std::vector<uint64_t> offsets(agents.size() + 1, 0);
+  for (uint64_t n = 0; n < agents.size(); ++n) {
+    offsets[n + 1] = offsets[n] + agents[n].size();
+  }
+  const uint64_t num_agents = offsets.back();
+
+  // Agents of each thread grouped by type
+  using TypeMap = std::unordered_map<TClass*, std::vector<Agent*>>;
+  std::vector<TypeMap> thread_types(omp_get_max_threads());
+  // Destination and offset in `data_` of each group of a thread
+  std::vector<std::vector<std::pair<std::vector<Agent*>*, uint64_t>>>
+      thread_dest(thread_types.size());
+  uint64_t max_uid_index = 0;
+
+#pragma omp parallel
+  {
+    auto tid = omp_get_thread_num();
+    uint64_t start = 0;
+    uint64_t end = 0;
+    Partition(num_agents, omp_get_num_threads(), tid, &start, &end);
+    uint64_t my_max_uid_index = 0;
+    auto& types = thread_types[tid];
+    if (start < end) {
+      uint64_t n = std::upper_bound(offsets.begin(), offsets.end(), start) -
+                   offsets.begin() - 1;
+      for (uint64_t i = start; i < end; ++i) {
+        while (i >= offsets[n + 1]) {
+          n++;
+        }
+        auto* agent = agents[n][i - offsets[n]];
+        if (agent != nullptr) {
+          types[agent->IsA()].push_back(agent);
+          my_max_uid_index =
+              std::max<uint64_t>(my_max_uid_index, agent->GetUid().GetIndex());
+        }
+      }
+    }
+#pragma omp critical
+    max_uid_index = std::max(max_uid_index, my_max_uid_index);
+  }
+
+  Reserve(max_uid_index + 1);
+  index_.ParallelClear();
+  // Create all types first. Otherwise inserting a type could invalidate the
+  // destination of another one.
+  for (auto& types : thread_types) {
+    for (auto& pair : types) {
+      data_[pair.first];
+    }
+  }
+  for (uint64_t t = 0; t < thread_types.size(); ++t) {
+    for (auto& pair : thread_types[t]) {
+      auto& type_vector = data_[pair.first];
+      thread_dest[t].push_back({&type_vector, type_vector.size()});
+      type_vector.resize(type_vector.size() + pair.second.size());
+    }
+  }
+
+#pragma omp parallel for schedule(static, 1)
+  for (uint64_t t = 0; t < thread_types.size(); ++t) {
+    uint64_t i = 0;
+    for (auto& pair : thread_types[t]) {
+      auto* type_vector = thread_dest[t][i].first;
+      auto offset = thread_dest[t][i].second;
+      for (uint64_t j = 0; j < pair.second.size(); ++j) {
+        auto* agent = pair.second[j];
+        (*type_vector)[offset + j] = agent;
+        index_.Insert(agent->GetUid(), offset + j);
+      }
+      i++;
+    }
+  }
+}
+
 // -----------------------------------------------------------------------------
 void TypeIndex::Reserve(uint64_t capacity) {
   if (index_.size() < capacity) {
@@ -71,4 +155,13 @@ const std::vector<Agent*>& TypeIndex::GetType(TClass* tclass) const {
   return data_[tclass];
 }
 
+// -----------------------------------------------------------------------------
+std::vector<TClass*> TypeIndex::GetTypes() const {
+  std::vector<TClass*> types;
+  for (auto& pair : data_) {
+    types.push_back(pair.first);
+  }
+  return types;
+}
+
 }  // namespace bdm
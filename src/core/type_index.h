@@ -34,10 +34,18 @@ class TypeIndex {
 
   void Clear();
 
+  /// Replaces the content of this index with all agents in `agents`
+  /// (`agents[numa_node][element_idx]`). Null entries are skipped.
+  /// Executed in parallel.
+  void Rebuild(const std::vector<std::vector<Agent*>>& agents);
+
   void Reserve(uint64_t capacity);
 
   const std::vector<Agent*>& GetType(TClass* tclass) const;
 
+  /// Returns all agent types that have been added to this index.
+  std::vector<TClass*> GetTypes() const;
+
  private:
   UnorderedFlatmap<TClass*, std::vector<Agent*>> data_;
   AgentUidMap<uint64_t> index_;
@@ -18,6 +18,7 @@
 #ifdef USE_NUMA
 
 #include <numa.h>
+#include <numaif.h>
 
 #else
 
@@ -28,6 +29,8 @@ inline int numa_num_configured_nodes() { return 1; }
 inline int numa_num_configured_cpus() { return omp_get_max_threads(); }
 inline int numa_run_on_node(int) { return 0; }
 inline int numa_node_of_cpu(int) { return 0; }
+#define MPOL_MF_MOVE (1 << 1)
+
 inline int numa_move_pages(int pid, unsigned long count, void **pages,
                            const int *nodes, int *status, int flags) {
   *status = 0;
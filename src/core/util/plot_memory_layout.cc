@@ -15,6 +15,7 @@
 #include "core/util/plot_memory_layout.h"
 
 #include <algorithm>
+#include <cstdlib>
 #include <limits>
 #include <string>
 // ROOT
@@ -33,11 +34,19 @@
 // BioDynaMo
 #include "core/agent/agent.h"
 #include "core/environment/environment.h"
+#include "core/param/param.h"
 #include "core/scheduler.h"
 #include "core/simulation.h"
 
 namespace bdm {
 
+// -----------------------------------------------------------------------------
+/// The file names contain the space-filling curve that was used to sort the
+/// agents, such that the layouts of different curves can be compared.
+static std::string GetCurve() {
+  return Simulation::GetActive()->GetParam()->space_filling_curve;
+}
+
 // -----------------------------------------------------------------------------
 void PlotMemoryLayout(const std::vector<Agent*>& agents, int numa_node) {
   TCanvas c;
@@ -67,7 +76,9 @@ void PlotMemoryLayout(const std::vector<Agent*>& agents, int numa_node) {
   c.cd(0);
   auto steps = Simulation::GetActive()->GetScheduler()->GetSimulatedSteps();
   auto dir = Simulation::GetActive()->GetOutputDir();
-  c.SaveAs(Concat(dir, "/mem-layout-", steps, "-", numa_node, ".png").c_str());
+  c.SaveAs(Concat(dir, "/mem-layout-", GetCurve(), "-", steps, "-", numa_node,
+                  ".png")
+               .c_str());
 }
 
 // -----------------------------------------------------------------------------
@@ -99,8 +110,9 @@ void PlotMemoryHistogram(const std::vector<Agent*>& agents, int numa_node) {
   c.cd(0);
   auto steps = Simulation::GetActive()->GetScheduler()->GetSimulatedSteps();
   auto dir = Simulation::GetActive()->GetOutputDir();
-  c.SaveAs(
-      Concat(dir, "/mem-layout-hist-", steps, "-", numa_node, ".png").c_str());
+  c.SaveAs(Concat(dir, "/mem-layout-hist-", GetCurve(), "-", steps, "-",
+                  numa_node, ".png")
+               .c_str());
 }
 
 // -----------------------------------------------------------------------------
@@ -163,10 +175,23 @@ void PlotNeighborMemoryHistogram(bool before) {
   uint64_t nbins = std::max(static_cast<uint64_t>(100u),
                             static_cast<uint64_t>((max - min) / 20000));
   TH1F hist("", "", nbins, min, max);
-  hist.SetTitle(";#Delta bytes; Count");
   for (uint64_t i = 0; i < diffs.size(); ++i) {
     hist.Fill(diffs[i]);
   }
+  // The median distance summarizes the locality of the curve
+  std::vector<uint64_t> distances(diffs.size());
+  for (uint64_t i = 0; i < diffs.size(); ++i) {
+    distances[i] = static_cast<uint64_t>(std::abs(diffs[i]));
+  }
+  uint64_t median = 0;
+  if (!distances.empty()) {
+    auto mid = distances.begin() + distances.size() / 2;
+    std::nth_element(distances.begin(), mid, distances.end());
+    median = *mid;
+  }
+  hist.SetTitle(Concat(GetCurve(), ": median |#Delta| = ", median,
+                       " bytes;#Delta bytes; Count")
+                    .c_str());
   hist.Draw();
 
   c.Update();
@@ -181,10 +206,12 @@ void PlotNeighborMemoryHistogram(bool before) {
   if (before) {
     suffix = "-begin";
   }
-  c.SaveAs(
-      Concat(dir, "/mem-layout-neighbor-hist-", steps, suffix, ".png").c_str());
-  c.SaveAs(
-      Concat(dir, "/mem-layout-neighbor-hist-", steps, suffix, ".C").c_str());
+  c.SaveAs(Concat(dir, "/mem-layout-neighbor-hist-", GetCurve(), "-", steps,
+                  suffix, ".png")
+               .c_str());
+  c.SaveAs(Concat(dir, "/mem-layout-neighbor-hist-", GetCurve(), "-", steps,
+                  suffix, ".C")
+               .c_str());
 }
 
 }  // namespace bdm
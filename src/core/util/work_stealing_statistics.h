@@ -0,0 +1,77 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN & University of Surrey for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+// See the NOTICE file distributed with this work for additional information
+// regarding copyright ownership.
+//
+// -----------------------------------------------------------------------------
+
+#ifndef CORE_UTIL_WORK_STEALING_STATISTICS_H_
+#define CORE_UTIL_WORK_STEALING_STATISTICS_H_
+
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+
+namespace bdm {
+
+/// Aggregates the load balance of the passes over all agents that use work
+/// stealing (see `Param::scheduling_work_stealing`). Kept separate from the
+/// operation timings, because the values are neither durations of an
+/// operation nor measured in milliseconds.
+class WorkStealingStatistics {
+ public:
+  struct Entry {
+    /// Sum of the average busy time per thread in nanoseconds
+    int64_t busy_ns = 0;
+    /// Sum of the average idle time per thread in nanoseconds
+    int64_t idle_ns = 0;
+    /// Total number of stolen ranges
+    int64_t steals = 0;
+    /// Number of passes
+    uint64_t passes = 0;
+  };
+
+  /// Adds the statistics of one pass over all agents with the given name.
+  void AddEntry(const std::string& name, int64_t busy_ns, int64_t idle_ns,
+                int64_t steals) {
+    auto& entry = entries_[name];
+    entry.busy_ns += busy_ns;
+    entry.idle_ns += idle_ns;
+    entry.steals += steals;
+    entry.passes++;
+  }
+
+  const std::map<std::string, Entry>& GetEntries() const { return entries_; }
+
+  bool Empty() const { return entries_.empty(); }
+
+ private:
+  std::map<std::string, Entry> entries_;
+
+  friend std::ostream& operator<<(std::ostream& os,
+                                  const WorkStealingStatistics& s);
+};
+
+inline std::ostream& operator<<(std::ostream& os,
+                                const WorkStealingStatistics& s) {
+  os << "\033[1mWork stealing per pass over all agents\033[0m" << std::endl;
+  for (auto& el : s.entries_) {
+    const auto& e = el.second;
+    os << el.first << ": busy " << e.busy_ns / 1000 << " us, idle "
+       << e.idle_ns / 1000 << " us (average per thread), " << e.steals
+       << " steals, " << e.passes << " passes" << std::endl;
+  }
+  return os;
+}
+
+}  // namespace bdm
+
+#endif  // CORE_UTIL_WORK_STEALING_STATISTICS_H_
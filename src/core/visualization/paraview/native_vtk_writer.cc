@@ -0,0 +1,465 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN & University of Surrey for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+// See the NOTICE file distributed with this work for additional information
+// regarding copyright ownership.
+//
+// -----------------------------------------------------------------------------
+
+#include "core/visualization/paraview/native_vtk_writer.h"
+// std
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <list>
+#include <sstream>
+#include <utility>
+// zlib
+#include <zlib.h>
+// ROOT
+#include <TClass.h>
+#include <TDataMember.h>
+// BioDynaMo
+#include "core/agent/agent_pointer.h"
+#include "core/agent/agent_uid.h"
+#include "core/param/param.h"
+#include "core/simulation.h"
+#include "core/util/jit.h"
+#include "core/util/log.h"
+#include "core/util/string.h"
+#include "core/util/thread_info.h"
+
+namespace bdm {
+
+// -----------------------------------------------------------------------------
+/// Collects the arrays of the appended data section of a VTK XML file.\n
+/// Each array starts with a header of UInt64 values. Without compression the
+/// header only contains the number of bytes and the array data is written
+/// from its original memory location. With compression the data is split
+/// into blocks that are compressed separately (see `vtkZLibDataCompressor`):
+/// `[#blocks, block size, last block size, compressed size of each block]`.
+class AppendedData {
+ public:
+  static constexpr uint64_t kBlockSize = 1 << 15;
+
+  explicit AppendedData(bool compress) : compress_(compress) {}
+
+  /// Adds an array of `size` bytes and returns its offset in the appended
+  /// data section. `data` must be valid until `Write` has been called.
+  uint64_t Add(const void* data, uint64_t size) {
+    auto offset = size_;
+    auto* bytes = static_cast<const Bytef*>(data);
+    if (!compress_) {
+      AddBuffer(std::vector<uint64_t>{size});
+      segments_.emplace_back(reinterpret_cast<const char*>(bytes), size);
+      size_ += size;
+      return offset;
+    }
+
+    uint64_t num_blocks = (size + kBlockSize - 1) / kBlockSize;
+    std::vector<uint64_t> header(3 + num_blocks);
+    header[0] = num_blocks;
+    header[1] = kBlockSize;
+    header[2] = size % kBlockSize;
+    std::vector<char> compressed(num_blocks * compressBound(kBlockSize));
+    uint64_t compressed_size = 0;
+    for (uint64_t i = 0; i < num_blocks; ++i) {
+      auto block_size = std::min(kBlockSize, size - i * kBlockSize);
+      auto dest_size = compressBound(block_size);
+      compress2(reinterpret_cast<Bytef*>(&compressed[compressed_size]),
+                &dest_size, bytes + i * kBlockSize, block_size, Z_BEST_SPEED);
+      header[3 + i] = dest_size;
+      compressed_size += dest_size;
+    }
+    compressed.resize(compressed_size);
+    AddBuffer(std::move(header));
+    buffers_.emplace_back(std::move(compressed));
+    segments_.emplace_back(buffers_.back().data(), compressed_size);
+    size_ += compressed_size;
+    return offset;
+  }
+
+  void Write(std::ostream& os) const {
+    os << "  <AppendedData encoding=\"raw\">\n   _";
+    for (auto& segment : segments_) {
+      os.write(segment.first, segment.second);
+    }
+    os << "\n  </AppendedData>\n";
+  }
+
+ private:
+  bool compress_;
+  uint64_t size_ = 0;
+  /// Memory regions in the order in which they are written
+  std::vector<std::pair<const char*, uint64_t>> segments_;
+  /// Headers and compressed data
+  std::list<std::vector<char>> buffers_;
+
+  void AddBuffer(std::vector<uint64_t>&& header) {
+    auto bytes = header.size() * sizeof(uint64_t);
+    buffers_.emplace_back(bytes);
+    std::memcpy(buffers_.back().data(), header.data(), bytes);
+    segments_.emplace_back(buffers_.back().data(), bytes);
+    size_ += bytes;
+  }
+};
+
+// -----------------------------------------------------------------------------
+std::string VtkFileHeader(const std::string& type, bool compress) {
+  uint16_t one = 1;
+  bool little_endian = *reinterpret_cast<uint8_t*>(&one) == 1;
+  std::stringstream str;
+  str << "<?xml version=\"1.0\"?>\n"
+      << "<VTKFile type=\"" << type << "\" version=\"1.0\" byte_order=\""
+      << (little_endian ? "LittleEndian" : "BigEndian")
+      << "\" header_type=\"UInt64\"";
+  if (compress) {
+    str << " compressor=\"vtkZLibDataCompressor\"";
+  }
+  str << ">\n";
+  return str.str();
+}
+
+// -----------------------------------------------------------------------------
+std::string DataArray(const std::string& type, const std::string& name,
+                      uint64_t components, uint64_t offset) {
+  return Concat("        <DataArray type=\"", type, "\" Name=\"", name,
+                "\" NumberOfComponents=\"", components,
+                "\" format=\"appended\" offset=\"", offset, "\"/>\n");
+}
+
+// -----------------------------------------------------------------------------
+/// Returns the VTK type name and size of a scalar C++ type or an empty
+/// string if the type is not supported.
+std::pair<std::string, uint64_t> GetVtkScalarType(const std::string& type) {
+  if (type == "double") {
+    return {"Float64", 8};
+  } else if (type == "float") {
+    return {"Float32", 4};
+  } else if (type == "int") {
+    return {"Int32", 4};
+  } else if (type == "unsigned int") {
+    return {"UInt32", 4};
+  } else if (type == "long" || type == "long long") {
+    return {"Int64", 8};
+  } else if (type == "unsigned long" || type == "unsigned long long") {
+    return {"UInt64", 8};
+  } else if (type == "bool") {
+    return {"UInt8", 1};
+  }
+  return {"", 0};
+}
+
+// -----------------------------------------------------------------------------
+NativeVtuWriter::NativeVtuWriter(TClass* tclass,
+                                 const std::vector<std::string>& data_members) {
+  int position_idx = -1;
+  int mass_location_idx = -1;
+  for (auto& dm_name : data_members) {
+    auto tdata_members = FindDataMemberSlow(tclass, dm_name);
+    if (tdata_members.size() != 1) {
+      Log::Fatal("NativeVtuWriter::NativeVtuWriter",
+                 "Data member ", dm_name, " of class ", tclass->GetName(),
+                 " could not be found or is ambiguous.");
+    }
+    auto* tdm = tdata_members[0];
+    Array array;
+    array.name = dm_name;
+    array.offset = tclass->GetBaseClassOffset(tdm->GetClass()) +
+                   static_cast<uint64_t>(tdm->GetOffset());
+    array.kind = ValueKind::kRaw;
+    array.components = 1;
+
+    std::string type = tdm->GetTrueTypeName();
+    if (StartsWith(type, "bdm::")) {
+      type = type.substr(5);
+    }
+    if (type == "AgentUid") {
+      array.kind = ValueKind::kAgentUid;
+      type = "unsigned long long";
+    } else if (StartsWith(type, "AgentPointer<")) {
+      array.kind = ValueKind::kAgentPointer;
+      type = "unsigned long long";
+    } else if (StartsWith(type, "MathArray<") ||
+               StartsWith(type, "std::array<")) {
+      // e.g. MathArray<double,3>
+      auto open = type.find('<');
+      auto comma = type.rfind(',');
+      auto close = type.rfind('>');
+      array.components = std::stoull(type.substr(comma + 1, close - comma - 1));
+      type = type.substr(open + 1, comma - open - 1);
+    }
+    auto vtk_type = GetVtkScalarType(type);
+    if (vtk_type.second == 0) {
+      Log::Warning("NativeVtuWriter::NativeVtuWriter", "Data member ", dm_name,
+                   " has type ", tdm->GetTrueTypeName(),
+                   ", which is not supported by the native export. It will "
+                   "not be exported.");
+      continue;
+    }
+    array.type = vtk_type.first;
+    array.element_size = vtk_type.second;
+
+    if (dm_name == "position_") {
+      position_idx = arrays_.size();
+    } else if (dm_name == "mass_location_") {
+      mass_location_idx = arrays_.size();
+    }
+    arrays_.push_back(array);
+  }
+
+  // Same precedence as `CreateVtkDataArray`
+  if (position_idx != -1) {
+    points_idx_ = position_idx;
+  } else if (mass_location_idx != -1) {
+    points_idx_ = mass_location_idx;
+    points_in_point_data_ = true;
+  } else {
+    Log::Fatal("NativeVtuWriter::NativeVtuWriter", "Class ",
+               tclass->GetName(),
+               " has neither a data member position_ nor mass_location_.");
+  }
+  if (arrays_[points_idx_].components != 3) {
+    Log::Fatal("NativeVtuWriter::NativeVtuWriter", "Data member ",
+               arrays_[points_idx_].name, " must have three components.");
+  }
+}
+
+// -----------------------------------------------------------------------------
+void NativeVtuWriter::operator()(const std::string& folder,
+                                 const std::string& file_prefix,
+                                 const std::vector<Agent*>& agents) const {
+  auto max_threads = ThreadInfo::GetInstance()->GetMaxThreads();
+
+#pragma omp parallel for schedule(static, 1)
+  for (int i = 0; i < max_threads; ++i) {
+    // use static scheduling as in `VtkAgents::Update`
+    auto correction = agents.size() % max_threads == 0 ? 0 : 1;
+    auto chunk = agents.size() / max_threads + correction;
+    auto start = std::min(agents.size(), i * chunk);
+    auto end = std::min(agents.size(), start + chunk);
+    WritePiece(Concat(folder, "/", file_prefix, "_", i, ".vtu"), agents, start,
+               end);
+    if (i == 0) {
+      WritePvtu(Concat(folder, "/", file_prefix, ".pvtu"), file_prefix,
+                max_threads);
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------
+void NativeVtuWriter::WritePiece(const std::string& filename,
+                                 const std::vector<Agent*>& agents,
+                                 uint64_t start, uint64_t end) const {
+  auto* param = Simulation::GetActive()->GetParam();
+  bool compress = param->visualization_compress_pv_files;
+  uint64_t num_agents = end - start;
+
+  // Gather the data members of all agents in this piece
+  std::vector<std::vector<char>> buffers(arrays_.size());
+  for (uint64_t a = 0; a < arrays_.size(); ++a) {
+    auto& array = arrays_[a];
+    auto value_size = array.element_size * array.components;
+    auto& buffer = buffers[a];
+    buffer.resize(num_agents * value_size);
+    for (uint64_t i = 0; i < num_agents; ++i) {
+      auto* agent = agents[start + i];
+      auto* dm = static_cast<const char*>(dynamic_cast<const void*>(agent)) +
+                 array.offset;
+      auto* dest = &buffer[i * value_size];
+      if (array.kind == ValueKind::kRaw) {
+        std::memcpy(dest, dm, value_size);
+      } else {
+        uint64_t uid;
+        if (array.kind == ValueKind::kAgentUid) {
+          uid = *reinterpret_cast<const AgentUid*>(dm);
+        } else {
+          // The memory layout of AgentPointer does not depend on the template
+          // argument
+          uid = reinterpret_cast<const AgentPointer<Agent>*>(dm)
+                    ->GetUidAsUint64();
+        }
+        std::memcpy(dest, &uid, sizeof(uint64_t));
+      }
+    }
+  }
+
+  AppendedData appended(compress);
+  std::stringstream point_data;
+  for (uint64_t a = 0; a < arrays_.size(); ++a) {
+    if (a == points_idx_ && !points_in_point_data_) {
+      continue;
+    }
+    auto offset = appended.Add(buffers[a].data(), buffers[a].size());
+    point_data << DataArray(arrays_[a].type, arrays_[a].name,
+                            arrays_[a].components, offset);
+  }
+  auto& points = arrays_[points_idx_];
+  auto points_offset =
+      appended.Add(buffers[points_idx_].data(), buffers[points_idx_].size());
+  // The agents are exported as points without cells
+  auto connectivity_offset = appended.Add(nullptr, 0);
+  auto offsets_offset = appended.Add(nullptr, 0);
+  auto types_offset = appended.Add(nullptr, 0);
+
+  std::ofstream ofs(filename, std::ios::binary);
+  ofs << VtkFileHeader("UnstructuredGrid", compress) << "  <UnstructuredGrid>\n"
+      << "    <Piece NumberOfPoints=\"" << num_agents
+      << "\" NumberOfCells=\"0\">\n"
+      << "      <PointData>\n"
+      << point_data.str() << "      </PointData>\n"
+      << "      <CellData>\n      </CellData>\n"
+      << "      <Points>\n"
+      << DataArray(points.type, points.name, 3, points_offset)
+      << "      </Points>\n"
+      << "      <Cells>\n"
+      << DataArray("Int64", "connectivity", 1, connectivity_offset)
+      << DataArray("Int64", "offsets", 1, offsets_offset)
+      << DataArray("UInt8", "types", 1, types_offset) << "      </Cells>\n"
+      << "    </Piece>\n"
+      << "  </UnstructuredGrid>\n";
+  appended.Write(ofs);
+  ofs << "</VTKFile>\n";
+}
+
+// -----------------------------------------------------------------------------
+void NativeVtuWriter::WritePvtu(const std::string& filename,
+                                const std::string& file_prefix,
+                                uint64_t num_pieces) const {
+  auto* param = Simulation::GetActive()->GetParam();
+  std::ofstream ofs(filename);
+  ofs << VtkFileHeader("PUnstructuredGrid",
+                       param->visualization_compress_pv_files)
+      << "  <PUnstructuredGrid GhostLevel=\"0\">\n"
+      << "    <PPointData>\n";
+  for (uint64_t a = 0; a < arrays_.size(); ++a) {
+    if (a == points_idx_ && !points_in_point_data_) {
+      continue;
+    }
+    ofs << "      <PDataArray type=\"" << arrays_[a].type << "\" Name=\""
+        << arrays_[a].name << "\" NumberOfComponents=\""
+        << arrays_[a].components << "\"/>\n";
+  }
+  ofs << "    </PPointData>\n"
+      << "    <PCellData>\n    </PCellData>\n"
+      << "    <PPoints>\n"
+      << "      <PDataArray type=\"" << arrays_[points_idx_].type
+      << "\" Name=\"" << arrays_[points_idx_].name
+      << "\" NumberOfComponents=\"3\"/>\n"
+      << "    </PPoints>\n";
+  for (uint64_t i = 0; i < num_pieces; ++i) {
+    ofs << "    <Piece Source=\"" << file_prefix << "_" << i << ".vtu\"/>\n";
+  }
+  ofs << "  </PUnstructuredGrid>\n"
+      << "</VTKFile>\n";
+}
+
+// -----------------------------------------------------------------------------
+void NativeVtiWriter::operator()(const std::string& folder,
+                                 const std::string& file_prefix,
+                                 const DiffusionGrid* grid, bool concentration,
+                                 bool gradient) const {
+  auto* param = Simulation::GetActive()->GetParam();
+  bool compress = param->visualization_compress_pv_files;
+  auto real_type = sizeof(real_t) == 8 ? "Float64" : "Float32";
+
+  if (grid->GetNumBoxes() == 0) {
+    return;
+  }
+  auto num_boxes = grid->GetNumBoxesArray();
+  auto grid_dimensions = grid->GetDimensions();
+  auto box_length = grid->GetBoxLength();
+  uint64_t xy_num_boxes = num_boxes[0] * num_boxes[1];
+  auto extent = [&](uint64_t z_start, uint64_t z_end) {
+    return Concat(0, " ", std::max<int64_t>(num_boxes[0] - 1, 0), " ", 0, " ",
+                  std::max<int64_t>(num_boxes[1] - 1, 0), " ", z_start, " ",
+                  z_end);
+  };
+  auto whole_extent =
+      extent(0, std::max<int64_t>(static_cast<int64_t>(num_boxes[2]) - 1, 0));
+  auto origin = Concat(grid_dimensions[0] + box_length / 2, " ",
+                       grid_dimensions[2] + box_length / 2, " ",
+                       grid_dimensions[4] + box_length / 2);
+  auto spacing = Concat(box_length, " ", box_length, " ", box_length);
+
+  // Each piece covers a range of box layers along the z-axis. The last layer
+  // of a piece is also the first layer of the next one.
+  uint64_t layers = num_boxes[2] > 1 ? num_boxes[2] - 1 : 1;
+  uint64_t num_pieces = std::min<uint64_t>(
+      layers, ThreadInfo::GetInstance()->GetMaxThreads());
+  std::vector<std::pair<uint64_t, uint64_t>> z_ranges(num_pieces);
+  for (uint64_t i = 0; i < num_pieces; ++i) {
+    z_ranges[i] = {i * layers / num_pieces,
+                   std::min<uint64_t>((i + 1) * layers / num_pieces,
+                                      num_boxes[2] - 1)};
+  }
+
+  std::stringstream point_data_header;
+  if (concentration) {
+    point_data_header << "      <PDataArray type=\"" << real_type
+                      << "\" Name=\"Substance Concentration\" "
+                         "NumberOfComponents=\"1\"/>\n";
+  }
+  if (gradient) {
+    point_data_header << "      <PDataArray type=\"" << real_type
+                      << "\" Name=\"Diffusion Gradient\" "
+                         "NumberOfComponents=\"3\"/>\n";
+  }
+
+#pragma omp parallel for schedule(static, 1)
+  for (uint64_t i = 0; i < num_pieces; ++i) {
+    auto z_start = z_ranges[i].first;
+    auto z_end = z_ranges[i].second;
+    auto first_box = z_start * xy_num_boxes;
+    auto boxes = (z_end - z_start + 1) * xy_num_boxes;
+
+    AppendedData appended(compress);
+    std::stringstream point_data;
+    if (concentration) {
+      auto offset = appended.Add(grid->GetAllConcentrations() + first_box,
+                                 boxes * sizeof(real_t));
+      point_data << DataArray(real_type, "Substance Concentration", 1, offset);
+    }
+    if (gradient) {
+      auto offset = appended.Add(grid->GetAllGradients() + 3 * first_box,
+                                 3 * boxes * sizeof(real_t));
+      point_data << DataArray(real_type, "Diffusion Gradient", 3, offset);
+    }
+
+    auto filename = Concat(folder, "/", file_prefix, "_", i, ".vti");
+    std::ofstream ofs(filename, std::ios::binary);
+    ofs << VtkFileHeader("ImageData", compress) << "  <ImageData WholeExtent=\""
+        << whole_extent << "\" Origin=\"" << origin << "\" Spacing=\""
+        << spacing << "\">\n"
+        << "    <Piece Extent=\"" << extent(z_start, z_end) << "\">\n"
+        << "      <PointData>\n"
+        << point_data.str() << "      </PointData>\n"
+        << "      <CellData>\n      </CellData>\n"
+        << "    </Piece>\n"
+        << "  </ImageData>\n";
+    appended.Write(ofs);
+    ofs << "</VTKFile>\n";
+  }
+
+  std::ofstream ofs(Concat(folder, "/", file_prefix, ".pvti"));
+  ofs << VtkFileHeader("PImageData", compress) << "  <PImageData WholeExtent=\""
+      << whole_extent << "\" GhostLevel=\"0\" Origin=\"" << origin
+      << "\" Spacing=\"" << spacing << "\">\n"
+      << "    <PPointData>\n"
+      << point_data_header.str() << "    </PPointData>\n";
+  for (uint64_t i = 0; i < num_pieces; ++i) {
+    ofs << "    <Piece Extent=\""
+        << extent(z_ranges[i].first, z_ranges[i].second) << "\" Source=\""
+        << file_prefix << "_" << i << ".vti\"/>\n";
+  }
+  ofs << "  </PImageData>\n"
+      << "</VTKFile>\n";
+}
+
+}  // namespace bdm
@@ -0,0 +1,85 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN & University of Surrey for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+// See the NOTICE file distributed with this work for additional information
+// regarding copyright ownership.
+//
+// -----------------------------------------------------------------------------
+
+#ifndef CORE_VISUALIZATION_PARAVIEW_NATIVE_VTK_WRITER_H_
+#define CORE_VISUALIZATION_PARAVIEW_NATIVE_VTK_WRITER_H_
+
+// std
+#include <array>
+#include <string>
+#include <vector>
+// BioDynaMo
+#include "core/agent/agent.h"
+#include "core/diffusion/diffusion_grid.h"
+
+class TClass;
+
+namespace bdm {
+
+/// Writes agents into a parallel VTK unstructured grid file (`.pvtu`) with
+/// one `.vtu` piece per thread, without constructing VTK objects.\n
+/// The data members are gathered directly from the agents and stored as
+/// appended binary data. If `Param::visualization_compress_pv_files` is
+/// set, each thread compresses its own piece.
+class NativeVtuWriter {
+ public:
+  NativeVtuWriter(TClass* tclass, const std::vector<std::string>& data_members);
+
+  void operator()(const std::string& folder, const std::string& file_prefix,
+                  const std::vector<Agent*>& agents) const;
+
+ private:
+  enum class ValueKind { kRaw, kAgentUid, kAgentPointer };
+
+  struct Array {
+    std::string name;
+    /// VTK type name (e.g. `Float64`)
+    std::string type;
+    /// Offset of the data member from the start of the concrete agent
+    uint64_t offset;
+    ValueKind kind;
+    uint64_t element_size;
+    uint64_t components;
+  };
+
+  std::vector<Array> arrays_;
+  /// Index of the array that contains the point coordinates
+  uint64_t points_idx_;
+  /// Cylinders use the mass location as points and as point data
+  bool points_in_point_data_ = false;
+
+  void WritePiece(const std::string& filename,
+                  const std::vector<Agent*>& agents, uint64_t start,
+                  uint64_t end) const;
+
+  void WritePvtu(const std::string& filename, const std::string& file_prefix,
+                 uint64_t num_pieces) const;
+};
+
+/// Writes a diffusion grid into a parallel VTK image data file (`.pvti`)
+/// without constructing VTK objects.\n
+/// The grid is split into slabs along the z-axis. Neighboring slabs share
+/// one layer of boxes, such that there are no gaps between the pieces.
+/// The data of each slab is written (and compressed) by its own thread
+/// directly from `DiffusionGrid::GetAllConcentrations()` and
+/// `DiffusionGrid::GetAllGradients()`.
+struct NativeVtiWriter {
+  void operator()(const std::string& folder, const std::string& file_prefix,
+                  const DiffusionGrid* grid, bool concentration,
+                  bool gradient) const;
+};
+
+}  // namespace bdm
+
+#endif  // CORE_VISUALIZATION_PARAVIEW_NATIVE_VTK_WRITER_H_
@@ -30,10 +30,12 @@
 // BioDynaMo
 #include "core/agent/agent.h"
 #include "core/param/param.h"
+#include "core/resource_manager.h"
 #include "core/shape.h"
 #include "core/simulation.h"
 #include "core/util/jit.h"
 #include "core/visualization/paraview/jit_helper.h"
+#include "core/visualization/paraview/native_vtk_writer.h"
 #include "core/visualization/paraview/parallel_vtu_writer.h"
 
 #include "core/agent/cell.h"
@@ -44,6 +46,19 @@ namespace bdm {
 VtkAgents::VtkAgents(const char* type_name,
                      vtkCPDataDescription* data_description) {
   auto* param = Simulation::GetActive()->GetParam();
+  name_ = type_name;
+  tclass_ = FindTClass();
+  auto* tmp_instance = static_cast<Agent*>(tclass_->New());
+  shape_ = tmp_instance->GetShape();
+  std::vector<std::string> data_members;
+  InitializeDataMembers(tmp_instance, &data_members);
+
+  // The native writer reads the agents directly. No VTK objects are needed.
+  if (param->export_visualization && param->visualization_native_export) {
+    native_writer_ = std::make_unique<NativeVtuWriter>(tclass_, data_members);
+    return;
+  }
+
   auto* tinfo = ThreadInfo::GetInstance();
   if (param->export_visualization) {
     data_.resize(tinfo->GetMaxThreads());
@@ -54,19 +69,12 @@ VtkAgents::VtkAgents(const char* type_name,
   for (uint64_t i = 0; i < data_.size(); ++i) {
     data_[i] = vtkUnstructuredGrid::New();
   }
-  name_ = type_name;
 
   if (!param->export_visualization) {
     data_description->AddInput(type_name);
     data_description->GetInputDescriptionByName(type_name)->SetGrid(data_[0]);
   }
 
-  tclass_ = FindTClass();
-  auto* tmp_instance = static_cast<Agent*>(tclass_->New());
-  shape_ = tmp_instance->GetShape();
-  std::vector<std::string> data_members;
-  InitializeDataMembers(tmp_instance, &data_members);
-
   JitForEachDataMemberFunctor jitcreate(
       tclass_, data_members, "CreateVtkDataArrays",
       [](const std::string& functor_name,
@@ -121,6 +129,9 @@ TClass* VtkAgents::GetTClass() { return tclass_; }
 
 // -----------------------------------------------------------------------------
 void VtkAgents::Update(const std::vector<Agent*>* agents) {
+  if (native_writer_) {
+    return;
+  }
   auto* param = Simulation::GetActive()->GetParam();
   if (param->export_visualization) {
 #pragma omp parallel
@@ -147,6 +158,13 @@ void VtkAgents::WriteToFile(uint64_t step) const {
   auto* sim = Simulation::GetActive();
   auto filename_prefix = Concat(name_, "-", step);
 
+  if (native_writer_) {
+    auto* rm = sim->GetResourceManager();
+    const auto& agents = rm->GetTypeIndex()->GetType(tclass_);
+    (*native_writer_)(sim->GetOutputDir(), filename_prefix, agents);
+    return;
+  }
+
   ParallelVtuWriter writer;
   writer(sim->GetOutputDir(), filename_prefix, data_);
 }
@@ -16,6 +16,7 @@
 #define CORE_VISUALIZATION_PARAVIEW_VTK_AGENTS_H_
 
 // std
+#include <memory>
 #include <string>
 #include <vector>
 // Paraview
@@ -24,6 +25,7 @@
 // BioDynaMo
 #include "core/agent/agent.h"
 #include "core/shape.h"
+#include "core/visualization/paraview/native_vtk_writer.h"
 
 class TClass;
 
@@ -50,6 +52,8 @@ class VtkAgents {
   TClass* tclass_;
   std::vector<vtkUnstructuredGrid*> data_;
   Shape shape_;
+  /// Replaces `data_` if `Param::visualization_native_export` is set
+  std::unique_ptr<NativeVtuWriter> native_writer_;
 
   TClass* FindTClass();
   void InitializeDataMembers(const Agent* agent,
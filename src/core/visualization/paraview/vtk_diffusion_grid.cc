@@ -27,6 +27,7 @@
 #include "core/simulation.h"
 #include "core/util/log.h"
 #include "core/util/thread_info.h"
+#include "core/visualization/paraview/native_vtk_writer.h"
 #include "core/visualization/paraview/parallel_vti_writer.h"
 
 namespace bdm {
@@ -39,6 +40,27 @@ using vtkRealArray =
 VtkDiffusionGrid::VtkDiffusionGrid(const std::string& name,
                                    vtkCPDataDescription* data_description) {
   auto* param = Simulation::GetActive()->GetParam();
+  name_ = name;
+
+  // get visualization config
+  const Param::VisualizeDiffusion* vd = nullptr;
+  for (auto& entry : param->visualize_diffusion) {
+    if (entry.name == name) {
+      vd = &entry;
+      break;
+    }
+  }
+
+  // The native writer reads the diffusion grid directly. No VTK objects are
+  // needed.
+  if (vd && param->export_visualization &&
+      param->visualization_native_export) {
+    native_export_ = true;
+    export_concentration_ = vd->concentration;
+    export_gradient_ = vd->gradient;
+    return;
+  }
+
   if (param->export_visualization) {
     auto* tinfo = ThreadInfo::GetInstance();
     data_.resize(tinfo->GetMaxThreads());
@@ -50,16 +72,6 @@ VtkDiffusionGrid::VtkDiffusionGrid(const std::string& name,
   for (uint64_t i = 0; i < data_.size(); ++i) {
     data_[i] = vtkImageData::New();
   }
-  name_ = name;
-
-  // get visualization config
-  const Param::VisualizeDiffusion* vd = nullptr;
-  for (auto& entry : param->visualize_diffusion) {
-    if (entry.name == name) {
-      vd = &entry;
-      break;
-    }
-  }
 
   // If statement to prevent possible dereferencing of nullptr
   if (vd) {
@@ -106,6 +118,10 @@ bool VtkDiffusionGrid::IsUsed() const { return used_; }
 // -----------------------------------------------------------------------------
 void VtkDiffusionGrid::Update(const DiffusionGrid* grid) {
   used_ = true;
+  if (native_export_) {
+    grid_ = grid;
+    return;
+  }
 
   auto num_boxes = grid->GetNumBoxesArray();
   auto grid_dimensions = grid->GetDimensions();
@@ -195,6 +211,15 @@ void VtkDiffusionGrid::WriteToFile(uint64_t step) const {
   auto* sim = Simulation::GetActive();
   auto filename_prefix = Concat(name_, "-", step);
 
+  if (native_export_) {
+    if (grid_ != nullptr) {
+      NativeVtiWriter writer;
+      writer(sim->GetOutputDir(), filename_prefix, grid_,
+             export_concentration_, export_gradient_);
+    }
+    return;
+  }
+
   ParallelVtiWriter writer;
   writer(sim->GetOutputDir(), filename_prefix, data_, num_pieces_,
          whole_extent_, piece_extents_);
@@ -50,6 +50,13 @@ class VtkDiffusionGrid {
   int concentration_array_idx_ = -1;
   int gradient_array_idx_ = -1;
 
+  /// If `Param::visualization_native_export` is set, `grid_` is written with
+  /// `NativeVtiWriter` instead of using `data_`
+  bool native_export_ = false;
+  bool export_concentration_ = false;
+  bool export_gradient_ = false;
+  const DiffusionGrid* grid_ = nullptr;
+
   // The following data members are needed to partition a diffusion grid into
   // multiple
   // vtkImageData objects for parallel processing.
@@ -15,6 +15,8 @@
 #include "core/analysis/time_series.h"
 #include <TMath.h>
 #include <gtest/gtest.h>
+#include <atomic>
+#include <fstream>
 #include "core/agent/cell.h"
 #include "core/behavior/behavior.h"
 #include "core/behavior/stateless_behavior.h"
@@ -301,6 +303,151 @@ TEST(TimeSeries, ReuseAddCollectorReducerResult) {
   EXPECT_NEAR(3.0, yvals[0], abs_error<double>::value);
 }
 
+// -----------------------------------------------------------------------------
+namespace fused_reducers_test {
+
+/// Agent that has been processed most recently by each thread
+std::vector<Agent*> last_agent;
+std::atomic<uint64_t> num_reducer_calls;
+/// Number of reducer calls that did not directly follow the agent operations
+/// of the same agent
+std::atomic<uint64_t> num_separate_calls;
+
+bool DiamGt10(Agent* agent) {
+  auto tid = ThreadInfo::GetInstance()->GetMyThreadId();
+  num_reducer_calls++;
+  if (last_agent[tid] != agent) {
+    num_separate_calls++;
+  }
+  return agent->GetDiameter() > 10.;
+}
+
+void RunFusedReducersTest(const char* test_name,
+                          Param::ThreadSafetyMechanism mechanism) {
+  auto set_param = [&](Param* param) {
+    param->fuse_time_series_reducers = true;
+    param->thread_safety_mechanism = mechanism;
+  };
+  Simulation sim(test_name, set_param);
+
+  last_agent.assign(ThreadInfo::GetInstance()->GetMaxThreads(), nullptr);
+  num_reducer_calls = 0;
+  num_separate_calls = 0;
+
+  // cells grow in every step
+  StatelessBehavior grow([](Agent* agent) {
+    agent->SetDiameter(agent->GetDiameter() + 1);
+    last_agent[ThreadInfo::GetInstance()->GetMyThreadId()] = agent;
+  });
+  for (int i = 0; i < 10; ++i) {
+    auto* cell = new Cell(static_cast<real_t>(i));
+    cell->SetPosition({static_cast<real_t>(i * 20), 0, 0});
+    cell->AddBehavior(grow.NewCopy());
+    sim.GetResourceManager()->AddAgent(cell);
+  }
+
+  auto* ts = sim.GetTimeSeries();
+  ts->AddCollector("agents-diam-gt-10", new Counter<real_t>(DiamGt10));
+
+  sim.GetScheduler()->Simulate(3);
+
+  // The reducer is executed once per agent and iteration, directly after the
+  // agent operations of the same agent, i.e. without a separate pass
+  EXPECT_EQ(30u, num_reducer_calls);
+  EXPECT_EQ(0u, num_separate_calls);
+
+  // The reducer sees the agents after the agent operations have been
+  // executed
+  const auto& yvals = ts->GetYValues("agents-diam-gt-10");
+  ASSERT_EQ(3u, yvals.size());
+  EXPECT_NEAR(0.0, yvals[0], abs_error<real_t>::value);
+  EXPECT_NEAR(1.0, yvals[1], abs_error<real_t>::value);
+  EXPECT_NEAR(2.0, yvals[2], abs_error<real_t>::value);
+}
+
+}  // namespace fused_reducers_test
+
+TEST(TimeSeries, FusedReducers) {
+  fused_reducers_test::RunFusedReducersTest(
+      TEST_NAME, Param::ThreadSafetyMechanism::kUserSpecified);
+}
+
+TEST(TimeSeries, FusedReducersBoxColoring) {
+  fused_reducers_test::RunFusedReducersTest(
+      TEST_NAME, Param::ThreadSafetyMechanism::kBoxColoring);
+}
+
+// -----------------------------------------------------------------------------
+TEST(TimeSeries, StreamToDisk) {
+  Simulation sim(TEST_NAME);
+  sim.GetResourceManager()->AddAgent(new Cell());
+  sim.GetResourceManager()->AddAgent(new Cell());
+
+  auto* ts = sim.GetTimeSeries();
+  auto xcollector = [](Simulation* sim) {
+    return static_cast<real_t>(sim->GetScheduler()->GetSimulatedSteps());
+  };
+  ts->AddCollector("agents", new Counter<real_t>([](Agent*) { return true; }),
+                   xcollector);
+  ts->StreamToDisk(sim.GetOutputDir(), 2);
+
+  sim.GetScheduler()->Simulate(4);
+
+  // Full chunks are written to disk, the last data point stays in memory
+  EXPECT_EQ(1u, ts->GetYValues("agents").size());
+  ts->Flush();
+  EXPECT_EQ(0u, ts->GetYValues("agents").size());
+
+  std::ifstream ifs(Concat(sim.GetOutputDir(), "/agents.csv"));
+  ASSERT_TRUE(ifs.good());
+  std::vector<std::string> lines;
+  std::string line;
+  while (std::getline(ifs, line)) {
+    lines.push_back(line);
+  }
+  std::vector<std::string> expected = {"x,y", "0,2", "1,2", "2,2", "3,2"};
+  EXPECT_EQ(expected, lines);
+}
+
+// -----------------------------------------------------------------------------
+TEST(TimeSeries, StreamToDiskAfterMove) {
+  Simulation sim(TEST_NAME);
+  sim.GetResourceManager()->AddAgent(new Cell());
+  sim.GetResourceManager()->AddAgent(new Cell());
+
+  auto* ts = sim.GetTimeSeries();
+  auto xcollector = [](Simulation* sim) {
+    return static_cast<real_t>(sim->GetScheduler()->GetSimulatedSteps());
+  };
+  ts->AddCollector("agents", new Counter<real_t>([](Agent*) { return true; }),
+                   xcollector);
+  ts->StreamToDisk(sim.GetOutputDir(), 2);
+
+  sim.GetScheduler()->Simulate(3);
+  EXPECT_EQ(1u, ts->GetYValues("agents").size());
+
+  {
+    // The streaming state moves with the data
+    TimeSeries moved(std::move(*ts));
+    EXPECT_EQ(1u, moved.GetYValues("agents").size());
+    *ts = std::move(moved);
+    // The moved-from object does not write anything when it is destroyed
+  }
+
+  sim.GetScheduler()->Simulate(1);
+  ts->Flush();
+
+  std::ifstream ifs(Concat(sim.GetOutputDir(), "/agents.csv"));
+  ASSERT_TRUE(ifs.good());
+  std::vector<std::string> lines;
+  std::string line;
+  while (std::getline(ifs, line)) {
+    lines.push_back(line);
+  }
+  std::vector<std::string> expected = {"x,y", "0,2", "1,2", "2,2", "3,2"};
+  EXPECT_EQ(expected, lines);
+}
+
 // -----------------------------------------------------------------------------
 TEST(TimeSeries, StoreAndLoad) {
   Simulation sim(TEST_NAME);
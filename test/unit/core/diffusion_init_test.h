@@ -15,7 +15,11 @@
 #ifndef UNIT_CORE_DIFFUSION_INIT_TEST_H_
 #define UNIT_CORE_DIFFUSION_INIT_TEST_H_
 
+#include <utility>
+#include <vector>
+
 #include "core/diffusion/diffusion_grid.h"
+#include "core/util/thread_info.h"
 
 namespace bdm {
 
@@ -35,6 +39,34 @@ class TestGrid : public DiffusionGrid {
 
   void Swap() { c1_.swap(c2_); }
 
+  // Returns how often each row is assigned to a thread.
+  std::vector<int> CountThreadRows() {
+    std::vector<int> counts(GetNumBoxesArray()[1] * GetNumBoxesArray()[2]);
+#pragma omp parallel
+    {
+      size_t start = 0;
+      size_t end = 0;
+      GetThreadRows(&start, &end);
+      for (size_t row = start; row < end; row++) {
+#pragma omp atomic
+        counts[row]++;
+      }
+    }
+    return counts;
+  }
+
+  // Returns the slab of each NUMA node.
+  std::vector<std::pair<size_t, size_t>> GetNumaSlabs() {
+    std::vector<std::pair<size_t, size_t>> slabs;
+    for (int n = 0; n < ThreadInfo::GetInstance()->GetNumaNodes(); n++) {
+      size_t start = 0;
+      size_t end = 0;
+      GetNumaSlab(n, &start, &end);
+      slabs.push_back({start, end});
+    }
+    return slabs;
+  }
+
   // Check if the entries of c1_ and c2_ are equal for each position.
   bool CompareArrays() {
     for (size_t i = 0; i < c1_.size(); i++) {
@@ -57,9 +89,9 @@ class TestGrid : public DiffusionGrid {
 
   // Compares all inner values of the array c1_ with a specific value.
   bool ComapareInnerArrayWithValue(real_t value) {
-    auto nx = GetResolution();
-    auto ny = GetResolution();
-    auto nz = GetResolution();
+    auto nx = GetNumBoxesArray()[0];
+    auto ny = GetNumBoxesArray()[1];
+    auto nz = GetNumBoxesArray()[2];
 
     for (uint32_t x = 1; x < nx - 1; x++) {
       for (uint32_t y = 1; y < ny - 1; y++) {
@@ -77,9 +109,9 @@ class TestGrid : public DiffusionGrid {
 
   // Compare all boundary values of the array c1_ with a specific value.
   bool CompareBoundaryValues(real_t value) {
-    auto nx = GetResolution();
-    auto ny = GetResolution();
-    auto nz = GetResolution();
+    auto nx = GetNumBoxesArray()[0];
+    auto ny = GetNumBoxesArray()[1];
+    auto nz = GetNumBoxesArray()[2];
 
     for (uint32_t x = 0; x < nx; x++) {
       for (uint32_t y = 0; y < ny; y++) {
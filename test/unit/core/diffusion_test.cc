@@ -13,8 +13,10 @@
 // -----------------------------------------------------------------------------
 
 #include <fstream>
+#include <numeric>
 
 #include "core/agent/cell.h"
+#include "core/diffusion/adi_grid.h"
 #include "core/diffusion/diffusion_grid.h"
 #include "core/diffusion/euler_depletion_grid.h"
 #include "core/diffusion/euler_grid.h"
@@ -22,7 +24,9 @@
 #include "core/model_initializer.h"
 #include "core/substance_initializers.h"
 #include "core/util/io.h"
+#include "core/util/thread_info.h"
 #include "gtest/gtest.h"
+#include "unit/core/diffusion_init_test.h"
 #include "unit/test_util/test_util.h"
 
 #ifdef USE_PARAVIEW
@@ -349,6 +353,48 @@ TEST(DiffusionTest, GetBoxCoordinates) {
   delete dgrid;
 }
 
+TEST(DiffusionTest, NumaSlabs) {
+  Simulation simulation(TEST_NAME);
+  auto* env = simulation.GetEnvironment();
+
+  std::vector<Real3> positions;
+  positions.push_back({-10, -10, -10});
+  positions.push_back({90, 90, 90});
+  CellFactory(positions);
+
+  TestGrid grid(0, "Kalium", 0.4, 0, 13);
+  env->ForcedUpdate();
+  grid.Initialize();
+  auto num_boxes = grid.GetNumBoxesArray();
+  size_t num_rows = num_boxes[1] * num_boxes[2];
+
+  // The slabs are contiguous and cover all rows
+  auto slabs = grid.GetNumaSlabs();
+  size_t expected_start = 0;
+  for (auto& slab : slabs) {
+    EXPECT_EQ(expected_start, slab.first);
+    EXPECT_LE(slab.first, slab.second);
+    expected_start = slab.second;
+  }
+  EXPECT_EQ(num_rows, expected_start);
+
+  // Each row is processed by exactly one thread
+  auto counts = grid.CountThreadRows();
+  ASSERT_EQ(num_rows, counts.size());
+  for (size_t row = 0; row < num_rows; row++) {
+    EXPECT_EQ(1, counts[row]) << "row " << row;
+  }
+
+  // Also if fewer threads participate in the parallel region
+  auto max_threads = ThreadInfo::GetInstance()->GetMaxThreads();
+  omp_set_num_threads(std::max(1, max_threads / 2));
+  counts = grid.CountThreadRows();
+  omp_set_num_threads(max_threads);
+  for (size_t row = 0; row < num_rows; row++) {
+    EXPECT_EQ(1, counts[row]) << "row " << row;
+  }
+}
+
 TEST(DiffusionTest, GetNeighboringBoxes) {
   Simulation simulation(TEST_NAME);
   auto* env = simulation.GetEnvironment();
@@ -406,6 +452,84 @@ TEST(DiffusionTest, GetNeighboringBoxes) {
 
 // Create a 5x5x5 diffusion grid, with a substance being
 // added at center box 2,2,2, causing a symmetrical diffusion
+// Test a flat diffusion grid with a custom domain
+TEST(DiffusionTest, AnisotropicDomain) {
+  auto set_param = [](Param* param) {
+    param->bound_space = Param::BoundSpaceMode::kClosed;
+    param->min_bound = -100;
+    param->max_bound = 100;
+  };
+  Simulation simulation(TEST_NAME, set_param);
+  simulation.GetEnvironment()->Update();
+
+  std::array<int32_t, 6> domain = {-100, 100, -100, 100, -10, 10};
+  auto* dgrid = new EulerGrid(0, "Substance", 0.4, 0, 20);
+  dgrid->SetDomain(domain);
+  dgrid->SetBoundaryConditionType(BoundaryConditionType::kNeumann);
+  dgrid->SetBoundaryCondition(std::make_unique<ConstantBoundaryCondition>(0));
+  dgrid->SetLowerThreshold(-1e15);
+  dgrid->AddInitializer([](real_t x, real_t y, real_t z) {
+    return 1000 + x + 2 * y + 3 * z;
+  });
+  dgrid->Initialize();
+  dgrid->RunInitializers();
+
+  // The boxes are cubic, only the z axis has fewer boxes
+  auto num_boxes = dgrid->GetNumBoxesArray();
+  EXPECT_EQ(20u, num_boxes[0]);
+  EXPECT_EQ(20u, num_boxes[1]);
+  EXPECT_EQ(2u, num_boxes[2]);
+  EXPECT_EQ(800u, dgrid->GetNumBoxes());
+  EXPECT_EQ(20u, dgrid->GetResolution());
+  EXPECT_REAL_EQ(10, dgrid->GetBoxLength());
+  EXPECT_EQ(domain, dgrid->GetDimensions());
+  auto grid_size = dgrid->GetGridSize();
+  EXPECT_EQ(200, grid_size[0]);
+  EXPECT_EQ(200, grid_size[1]);
+  EXPECT_EQ(20, grid_size[2]);
+
+  auto box_coord = dgrid->GetBoxCoordinates({95, -95, 5});
+  EXPECT_EQ(19u, box_coord[0]);
+  EXPECT_EQ(0u, box_coord[1]);
+  EXPECT_EQ(1u, box_coord[2]);
+  for (uint32_t x = 0; x < num_boxes[0]; x++) {
+    for (uint32_t y = 0; y < num_boxes[1]; y++) {
+      for (uint32_t z = 0; z < num_boxes[2]; z++) {
+        std::array<uint32_t, 3> box_coordinates_true{x, y, z};
+        auto box_index = dgrid->GetBoxIndex(box_coordinates_true);
+        EXPECT_EQ(box_coordinates_true, dgrid->GetBoxCoordinates(box_index));
+      }
+    }
+  }
+
+  // The initializers are evaluated at the box centers of each axis, such that
+  // the gradient of the linear field is exact
+  EXPECT_REAL_EQ(1000 + 95 - 2 * 95 + 3 * 5,
+                 dgrid->GetValue({95, -95, 5}));
+  dgrid->CalculateGradient();
+  for (const auto& pos : std::vector<Real3>{
+           {0, 0, 0}, {-95, 95, -5}, {95, -95, 5}, {33, 47, 9}}) {
+    Real3 gradient;
+    dgrid->GetGradient(pos, &gradient, false);
+    EXPECT_NEAR(1, gradient[0], 1e-4);
+    EXPECT_NEAR(2, gradient[1], 1e-4);
+    EXPECT_NEAR(3, gradient[2], 1e-4);
+  }
+
+  // Zero flux through the boundary conserves the total amount
+  auto sum = [&]() {
+    const auto* c = dgrid->GetAllConcentrations();
+    return std::accumulate(c, c + dgrid->GetNumBoxes(), 0.0);
+  };
+  auto initial_sum = sum();
+  for (int t = 0; t < 10; t++) {
+    dgrid->Diffuse(1);
+  }
+  EXPECT_NEAR(initial_sum, sum(), 1e-6 * initial_sum);
+
+  delete dgrid;
+}
+
 TEST(DiffusionTest, Thresholds) {
   auto set_param = [](auto* param) {
     param->bound_space = Param::BoundSpaceMode::kClosed;
@@ -1199,6 +1323,202 @@ TEST(DiffusionTest, EulerPeriodicBoundaries) {
   }
 }
 
+// Tests if advancing several grids together yields the same result as
+// advancing them one by one.
+TEST(DiffusionTest, FusedDiffusionGrids) {
+  auto set_param = [](Param* param) {
+    param->bound_space = Param::BoundSpaceMode::kClosed;
+    param->min_bound = -50;
+    param->max_bound = 50;
+  };
+  Simulation simulation(TEST_NAME, set_param);
+  simulation.GetEnvironment()->Update();
+
+  std::vector<BoundaryConditionType> bc_types = {
+      BoundaryConditionType::kClosedBoundaries,
+      BoundaryConditionType::kOpenBoundaries,
+      BoundaryConditionType::kDirichlet, BoundaryConditionType::kNeumann,
+      BoundaryConditionType::kPeriodic};
+  std::vector<real_t> diff_coefs = {100, 50, 10};
+  int res = 20;
+
+  for (auto bc_type : bc_types) {
+    std::vector<std::unique_ptr<EulerGrid>> fused;
+    std::vector<std::unique_ptr<EulerGrid>> separate;
+    for (size_t i = 0; i < diff_coefs.size(); i++) {
+      for (auto* grids : {&fused, &separate}) {
+        auto* dgrid = new EulerGrid(i, "Substance", diff_coefs[i], 0.1, res);
+        dgrid->Initialize();
+        dgrid->SetBoundaryConditionType(bc_type);
+        dgrid->SetBoundaryCondition(
+            std::make_unique<ConstantBoundaryCondition>(1.0));
+        dgrid->ChangeConcentrationBy({5, 5, 5}, 1e5);
+        dgrid->ChangeConcentrationBy({-45, 15, 45}, 1e4);
+        grids->emplace_back(dgrid);
+      }
+    }
+
+    std::vector<EulerGrid*> fused_ptrs;
+    for (auto& dgrid : fused) {
+      fused_ptrs.push_back(dgrid.get());
+    }
+    for (int t = 0; t < 10; t++) {
+      EulerGrid::DiffuseFused(fused_ptrs, 0.01);
+      for (auto& dgrid : separate) {
+        dgrid->Diffuse(0.01);
+      }
+    }
+
+    for (size_t i = 0; i < diff_coefs.size(); i++) {
+      EXPECT_REAL_EQ(0.01, fused[i]->GetLastTimestep());
+      const auto* expected = separate[i]->GetAllConcentrations();
+      const auto* actual = fused[i]->GetAllConcentrations();
+      for (size_t j = 0; j < separate[i]->GetNumBoxes(); j++) {
+        EXPECT_REAL_EQ(expected[j], actual[j]);
+      }
+    }
+  }
+}
+
+TEST(DiffusionTest, TemporalBlocking) {
+  auto set_param = [](Param* param) {
+    param->bound_space = Param::BoundSpaceMode::kClosed;
+    param->min_bound = -50;
+    param->max_bound = 50;
+    param->diffusion_temporal_blocking = 3;
+  };
+  Simulation simulation(TEST_NAME, set_param);
+  simulation.GetEnvironment()->Update();
+
+  std::vector<BoundaryConditionType> bc_types = {
+      BoundaryConditionType::kClosedBoundaries,
+      BoundaryConditionType::kOpenBoundaries,
+      BoundaryConditionType::kDirichlet, BoundaryConditionType::kNeumann,
+      BoundaryConditionType::kPeriodic};
+  int res = 20;
+
+  for (auto bc_type : bc_types) {
+    std::vector<std::unique_ptr<EulerGrid>> grids;
+    for (int i = 0; i < 2; i++) {
+      auto* dgrid = new EulerGrid(0, "Substance", 0.4, 0.1, res);
+      dgrid->Initialize();
+      dgrid->SetBoundaryConditionType(bc_type);
+      dgrid->SetBoundaryCondition(
+          std::make_unique<ConstantBoundaryCondition>(1.0));
+      dgrid->ChangeConcentrationBy({5, 5, 5}, 1e5);
+      dgrid->ChangeConcentrationBy({-45, 15, 45}, 1e4);
+      grids.emplace_back(dgrid);
+    }
+
+    // Eight time steps are computed in blocks of three, three and two steps
+    for (int t = 0; t < 2; t++) {
+      grids[0]->MultiStep(0.01, 8);
+      for (int i = 0; i < 8; i++) {
+        grids[1]->Diffuse(0.01);
+      }
+    }
+
+    EXPECT_REAL_EQ(0.01, grids[0]->GetLastTimestep());
+    const auto* expected = grids[1]->GetAllConcentrations();
+    const auto* actual = grids[0]->GetAllConcentrations();
+    for (size_t j = 0; j < grids[1]->GetNumBoxes(); j++) {
+      EXPECT_REAL_EQ(expected[j], actual[j]);
+    }
+  }
+}
+
+TEST(DiffusionTest, ADIConvergence) {
+  auto set_param = [](Param* param) {
+    param->bound_space = Param::BoundSpaceMode::kClosed;
+    param->min_bound = -50;
+    param->max_bound = 50;
+  };
+  Simulation simulation(TEST_NAME, set_param);
+  simulation.GetEnvironment()->Update();
+
+  // Open boundaries are not compared, because the implicit scheme assumes zero
+  // concentration outside of the grid
+  std::vector<BoundaryConditionType> bc_types = {
+      BoundaryConditionType::kClosedBoundaries,
+      BoundaryConditionType::kDirichlet, BoundaryConditionType::kNeumann,
+      BoundaryConditionType::kPeriodic};
+  int res = 20;
+
+  for (auto bc_type : bc_types) {
+    auto init = [&](DiffusionGrid* dgrid) {
+      dgrid->SetDomain({-50, 50, -30, 40, 0, 25});
+      dgrid->Initialize();
+      dgrid->SetBoundaryConditionType(bc_type);
+      dgrid->SetBoundaryCondition(std::make_unique<ConstantBoundaryCondition>(
+          bc_type == BoundaryConditionType::kNeumann ? 0.0 : 0.5));
+      dgrid->AddInitializer([](real_t x, real_t y, real_t z) {
+        return 10 * std::exp(-x * x / 450);
+      });
+      dgrid->RunInitializers();
+    };
+    EulerGrid euler(0, "Substance", 10, 0.1, res);
+    ADIGrid adi(0, "Substance", 10, 0.1, res);
+    init(&euler);
+    init(&adi);
+
+    // The Euler grid serves as reference with a much smaller time step
+    for (int t = 0; t < 1000; t++) {
+      euler.Diffuse(0.0001);
+    }
+    for (int t = 0; t < 20; t++) {
+      adi.Diffuse(0.005);
+    }
+
+    EXPECT_REAL_EQ(0.005, adi.GetLastTimestep());
+    const auto* expected = euler.GetAllConcentrations();
+    const auto* actual = adi.GetAllConcentrations();
+    for (size_t j = 0; j < euler.GetNumBoxes(); j++) {
+      EXPECT_NEAR(expected[j], actual[j], 1e-2);
+    }
+  }
+}
+
+TEST(DiffusionTest, ADILargeTimeStep) {
+  auto set_param = [](Param* param) {
+    param->bound_space = Param::BoundSpaceMode::kClosed;
+    param->min_bound = -50;
+    param->max_bound = 50;
+  };
+  Simulation simulation(TEST_NAME, set_param);
+  simulation.GetEnvironment()->Update();
+
+  std::vector<BoundaryConditionType> bc_types = {
+      BoundaryConditionType::kNeumann, BoundaryConditionType::kPeriodic};
+  int res = 20;
+
+  for (auto bc_type : bc_types) {
+    // The time step is far beyond the stability limit of the Euler method
+    ADIGrid dgrid(0, "Substance", 1000, 0, res);
+    dgrid.Initialize();
+    dgrid.SetBoundaryConditionType(bc_type);
+    dgrid.SetBoundaryCondition(std::make_unique<ConstantBoundaryCondition>(0));
+    dgrid.ChangeConcentrationBy({5, 5, 5}, 1e5);
+    dgrid.ChangeConcentrationBy({-45, 15, 45}, 1e4);
+
+    auto sum = [&]() {
+      const auto* c = dgrid.GetAllConcentrations();
+      return std::accumulate(c, c + dgrid.GetNumBoxes(), 0.0);
+    };
+    auto initial_sum = sum();
+    for (int t = 0; t < 10; t++) {
+      dgrid.Diffuse(1);
+    }
+
+    // The total amount is conserved and spreads evenly over the grid
+    EXPECT_NEAR(initial_sum, sum(), 1e-6 * initial_sum);
+    real_t mean = initial_sum / dgrid.GetNumBoxes();
+    const auto* c = dgrid.GetAllConcentrations();
+    for (size_t j = 0; j < dgrid.GetNumBoxes(); j++) {
+      EXPECT_NEAR(mean, c[j], 1e-2 * mean);
+    }
+  }
+}
+
 TEST(DiffusionTest, DynamicTimeStepping) {
   auto set_param = [](auto* param) {
     param->bound_space = Param::BoundSpaceMode::kClosed;
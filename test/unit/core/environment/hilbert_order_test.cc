@@ -0,0 +1,141 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN & University of Surrey for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+// See the NOTICE file distributed with this work for additional information
+// regarding copyright ownership.
+//
+// -----------------------------------------------------------------------------
+
+#include "core/environment/hilbert_order.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+
+namespace bdm {
+namespace hilbert_order_test_internal {
+
+struct VerifyIteratorFunctor : public Functor<void, Iterator<uint64_t>*> {
+  std::vector<uint64_t>& actual;
+  explicit VerifyIteratorFunctor(std::vector<uint64_t>& actual)
+      : actual(actual) {}
+
+  void operator()(Iterator<uint64_t>* it) override {
+    while (it->HasNext()) {
+      actual.push_back(it->Next());
+    }
+  }
+};
+
+// -----------------------------------------------------------------------------
+void VerifyHilbertOrder(const HilbertOrder& ho,
+                        const std::array<uint64_t, 3>& num_boxes_axis) {
+  auto num_elements = num_boxes_axis[0] * num_boxes_axis[1] * num_boxes_axis[2];
+  auto max_dim = std::max(num_boxes_axis[0],
+                          std::max(num_boxes_axis[1], num_boxes_axis[2]));
+  auto bits =
+      static_cast<uint64_t>(std::ceil(std::log(max_dim) / std::log(2)));
+
+  // all
+  std::vector<uint64_t> expected(num_elements);
+  uint64_t cnt = 0;
+  for (uint64_t z = 0; z < num_boxes_axis[2]; ++z) {
+    for (uint64_t y = 0; y < num_boxes_axis[1]; ++y) {
+      for (uint64_t x = 0; x < num_boxes_axis[0]; ++x) {
+        auto code = HilbertOrder::Encode({x, y, z}, bits);
+        std::array<uint64_t, 3> expected_pos = {x, y, z};
+        EXPECT_EQ(expected_pos, ho.Decode(code));
+        expected[cnt++] = code;
+      }
+    }
+  }
+  std::sort(expected.begin(), expected.end());
+
+  {
+    std::vector<uint64_t> actual(num_elements);
+    for (uint64_t i = 0; i < num_elements; ++i) {
+      actual[i] = ho.GetMortonCode(i);
+    }
+    EXPECT_EQ(expected, actual);
+  }
+
+  // using iterator
+  if (num_elements <= 5) {
+    return;
+  }
+  {
+    std::vector<uint64_t> actual;
+    auto start = num_elements / 2;
+    auto end = num_elements - 2;
+    VerifyIteratorFunctor f{actual};
+    ho.CallMortonIteratorConsumer(start, end, f);
+    for (uint64_t i = start; i <= end; ++i) {
+      EXPECT_EQ(expected[i], actual[i - start]);
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------
+/// Consecutive boxes of the curve are face neighbors
+TEST(HilbertOrder, Adjacency) {
+  for (uint64_t bits = 1; bits <= 4; ++bits) {
+    auto num_elements = uint64_t{1} << (3 * bits);
+    auto previous = HilbertOrder::Decode(0, bits);
+    EXPECT_EQ(0u, previous[0] + previous[1] + previous[2]);
+    for (uint64_t code = 1; code < num_elements; ++code) {
+      auto pos = HilbertOrder::Decode(code, bits);
+      uint64_t distance = 0;
+      for (int i = 0; i < 3; ++i) {
+        distance += pos[i] > previous[i] ? pos[i] - previous[i]
+                                         : previous[i] - pos[i];
+      }
+      ASSERT_EQ(1u, distance);
+      ASSERT_EQ(code, HilbertOrder::Encode(pos, bits));
+      previous = pos;
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------
+TEST(HilbertOrder, Cube1) {
+  HilbertOrder ho;
+  ho.Update({1, 1, 1});
+  VerifyHilbertOrder(ho, {1, 1, 1});
+}
+
+// -----------------------------------------------------------------------------
+TEST(HilbertOrder, Cube8) {
+  HilbertOrder ho;
+  ho.Update({8, 8, 8});
+  VerifyHilbertOrder(ho, {8, 8, 8});
+}
+
+// -----------------------------------------------------------------------------
+/// Not power of 2
+TEST(HilbertOrder, Cube12) {
+  HilbertOrder ho;
+  ho.Update({12, 12, 12});
+  VerifyHilbertOrder(ho, {12, 12, 12});
+}
+
+// -----------------------------------------------------------------------------
+TEST(HilbertOrder, 537) {
+  HilbertOrder ho;
+  ho.Update({5, 3, 7});
+  VerifyHilbertOrder(ho, {5, 3, 7});
+}
+
+// -----------------------------------------------------------------------------
+TEST(HilbertOrder, 1_17_6) {
+  HilbertOrder ho;
+  ho.Update({1, 17, 6});
+  VerifyHilbertOrder(ho, {1, 17, 6});
+}
+
+}  // namespace hilbert_order_test_internal
+}  // namespace bdm
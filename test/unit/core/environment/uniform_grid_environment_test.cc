@@ -13,11 +13,17 @@
 // -----------------------------------------------------------------------------
 
 #include "core/environment/uniform_grid_environment.h"
+#include <map>
+#include <set>
 #include <sstream>
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 #include "core/agent/cell.h"
 #include "core/environment/environment.h"
 #include "core/functor.h"
+#include "core/interaction_force.h"
 #include "gtest/gtest.h"
 #include "unit/core/count_neighbor_functor.h"
 #include "unit/test_util/test_util.h"
@@ -221,6 +227,46 @@ TEST(UniformGridEnvironmentTest, UpdateGrid) {
   RunUpdateGridTest(&simulation);
 }
 
+TEST(UniformGridEnvironmentTest, UpdateGridCachedAgentPositions) {
+  auto set_param = [](Param* param) { param->cache_agent_positions = true; };
+  Simulation simulation(TEST_NAME, set_param);
+  auto* rm = simulation.GetResourceManager();
+  auto* env = simulation.GetEnvironment();
+
+  CellFactory(rm, 4);
+
+  env->ForcedUpdate();
+
+  // Remove cells 1 and 42
+  rm->RemoveAgent(AgentUid(1));
+  rm->RemoveAgent(AgentUid(42));
+
+  EXPECT_EQ(62u, rm->GetNumAgents());
+
+  RunUpdateGridTest(&simulation);
+}
+
+TEST(UniformGridEnvironmentTest, UpdateGridCountingSort) {
+  auto set_param = [](Param* param) {
+    param->uniform_grid_counting_sort = true;
+  };
+  Simulation simulation(TEST_NAME, set_param);
+  auto* rm = simulation.GetResourceManager();
+  auto* env = simulation.GetEnvironment();
+
+  CellFactory(rm, 4);
+
+  env->ForcedUpdate();
+
+  // Remove cells 1 and 42
+  rm->RemoveAgent(AgentUid(1));
+  rm->RemoveAgent(AgentUid(42));
+
+  EXPECT_EQ(62u, rm->GetNumAgents());
+
+  RunUpdateGridTest(&simulation);
+}
+
 TEST(UniformGridEnvironmentTest, NoRaceConditionDuringUpdate) {
   Simulation simulation(TEST_NAME);
   auto* rm = simulation.GetResourceManager();
@@ -479,4 +525,547 @@ TEST(UniformGridEnvironmentTest, FindAllNeighborsLoadBalanced) {
   TestNeighborSearch(simulation);
 }
 
+// Same as FindAllNeighbors, but the neighbor candidates are filtered with the
+// structure-of-arrays agent cache.
+TEST(UniformGridEnvironmentTest, FindAllNeighborsCachedAgentPositions) {
+  auto set_param = [](auto* param) {
+    param->environment = "uniform_grid";
+    param->cache_agent_positions = true;
+    param->unschedule_default_operations = {"load balancing",
+                                            "mechanical forces"};
+  };
+  Simulation simulation(TEST_NAME, set_param);
+
+  TestNeighborSearch(simulation);
+}
+
+// Same as FindAllNeighbors, but the grid is built with a counting sort.
+TEST(UniformGridEnvironmentTest, FindAllNeighborsCountingSort) {
+  auto set_param = [](auto* param) {
+    param->environment = "uniform_grid";
+    param->uniform_grid_counting_sort = true;
+    param->unschedule_default_operations = {"load balancing",
+                                            "mechanical forces"};
+  };
+  Simulation simulation(TEST_NAME, set_param);
+
+  TestNeighborSearch(simulation);
+}
+
+// Compares the neighbors found by the environment with a brute-force search.
+void CompareWithBruteForceNeighborSearch(Simulation* simulation,
+                                         real_t squared_radius) {
+  auto* rm = simulation->GetResourceManager();
+  auto* env = simulation->GetEnvironment();
+  rm->ForEachAgent([&](Agent* agent) {
+    // Use multisets such that neighbors that are reported twice are detected
+    std::multiset<AgentUid> expected;
+    rm->ForEachAgent([&](Agent* neighbor) {
+      auto distance = agent->GetPosition() - neighbor->GetPosition();
+      if (agent != neighbor && distance * distance < squared_radius) {
+        expected.insert(neighbor->GetUid());
+      }
+    });
+    std::multiset<AgentUid> actual;
+    auto fill_neighbor_list = L2F([&](Agent* neighbor, real_t) {
+      actual.insert(neighbor->GetUid());
+    });
+    env->ForEachNeighbor(fill_neighbor_list, *agent, squared_radius);
+    EXPECT_EQ(expected, actual);
+  });
+}
+
+TEST(UniformGridEnvironmentTest, VerletLists) {
+  auto set_param = [](Param* param) { param->verlet_list_skin = 6; };
+  Simulation simulation(TEST_NAME, set_param);
+  auto* rm = simulation.GetResourceManager();
+  auto* env = simulation.GetEnvironment();
+
+  CellFactory(rm, 4);
+  env->ForcedUpdate();
+  CompareWithBruteForceNeighborSearch(&simulation, 900);
+  CompareWithBruteForceNeighborSearch(&simulation, 100);
+
+  // Move agents less than half the skin. The Verlet lists are reused.
+  rm->ForEachAgent([](Agent* agent) {
+    agent->SetPosition(agent->GetPosition() + Real3{1.5, -1.5, 1.5});
+  });
+  env->ForcedUpdate();
+  CompareWithBruteForceNeighborSearch(&simulation, 900);
+
+  // Move an agent more than half the skin. The Verlet lists are rebuilt.
+  rm->GetAgent(AgentUid(42))->SetPosition({1, 1, 1});
+  env->ForcedUpdate();
+  CompareWithBruteForceNeighborSearch(&simulation, 900);
+
+  // Remove an agent. The Verlet lists are rebuilt.
+  rm->RemoveAgent(AgentUid(0));
+  env->ForcedUpdate();
+  CompareWithBruteForceNeighborSearch(&simulation, 900);
+}
+
+TEST(UniformGridEnvironmentTest, VerletListsWithAgentCache) {
+  auto set_param = [](Param* param) {
+    param->verlet_list_skin = 6;
+    param->cache_agent_positions = true;
+  };
+  Simulation simulation(TEST_NAME, set_param);
+  auto* rm = simulation.GetResourceManager();
+  auto* grid =
+      static_cast<UniformGridEnvironment*>(simulation.GetEnvironment());
+  const real_t squared_radius = 900;
+
+  // Compares the neighbors and their squared distances with a brute-force
+  // search
+  auto compare = [&]() {
+    std::map<std::pair<AgentUid, AgentUid>, real_t> expected;
+    rm->ForEachAgent([&](Agent* agent) {
+      rm->ForEachAgent([&](Agent* neighbor) {
+        auto distance = agent->GetPosition() - neighbor->GetPosition();
+        auto squared_distance = distance * distance;
+        if (agent->GetUid() < neighbor->GetUid() &&
+            squared_distance < squared_radius) {
+          expected[{agent->GetUid(), neighbor->GetUid()}] = squared_distance;
+        }
+      });
+    });
+
+    std::map<std::pair<AgentUid, AgentUid>, real_t> actual;
+    rm->ForEachAgent([&](Agent* agent) {
+      auto fill = L2F([&](Agent* neighbor, real_t squared_distance) {
+        if (agent->GetUid() < neighbor->GetUid()) {
+          actual[{agent->GetUid(), neighbor->GetUid()}] = squared_distance;
+        }
+      });
+      grid->ForEachNeighbor(fill, agent->GetPosition(), squared_radius, agent);
+    });
+    ASSERT_EQ(expected.size(), actual.size());
+    for (auto& el : expected) {
+      ASSERT_TRUE(actual.find(el.first) != actual.end());
+      EXPECT_NEAR(el.second, actual[el.first], abs_error<real_t>::value);
+    }
+
+    std::map<std::pair<AgentUid, AgentUid>, real_t> pairs;
+    Spinlock lock;
+    auto fill_pairs = L2F([&](Agent* agent, AgentHandle, Agent* neighbor,
+                              AgentHandle, real_t squared_distance) {
+      auto uid = agent->GetUid();
+      auto nuid = neighbor->GetUid();
+      std::lock_guard<Spinlock> guard(lock);
+      pairs[{std::min(uid, nuid), std::max(uid, nuid)}] = squared_distance;
+    });
+    grid->ForEachNeighborPair(fill_pairs, squared_radius);
+    ASSERT_EQ(expected.size(), pairs.size());
+    for (auto& el : expected) {
+      ASSERT_TRUE(pairs.find(el.first) != pairs.end());
+      EXPECT_NEAR(el.second, pairs[el.first], abs_error<real_t>::value);
+    }
+  };
+
+  CellFactory(rm, 4);
+  grid->ForcedUpdate();
+  compare();
+
+  // Move agents less than half the skin in different directions. The Verlet
+  // lists are reused, but the distances between the agents change.
+  std::vector<Real3> moves = {{1.4, 1.4, 1.4}, {-1.4, 0, -1.4}};
+  for (auto& move : moves) {
+    rm->ForEachAgent([&](Agent* agent) {
+      real_t sign = agent->GetUid().GetIndex() % 2 == 0 ? 1 : -1;
+      agent->SetPosition(agent->GetPosition() + move * sign);
+    });
+    grid->ForcedUpdate();
+    compare();
+  }
+}
+
+TEST(UniformGridEnvironmentTest, IncrementalUpdate) {
+  auto set_param = [](Param* param) {
+    param->uniform_grid_incremental_update = true;
+  };
+  Simulation simulation(TEST_NAME, set_param);
+  auto* rm = simulation.GetResourceManager();
+  auto* grid =
+      static_cast<UniformGridEnvironment*>(simulation.GetEnvironment());
+
+  auto check_box_indices = [&]() {
+    rm->ForEachAgent([&](Agent* agent) {
+      EXPECT_EQ(grid->GetBoxIndex(agent->GetPosition()), agent->GetBoxIdx());
+    });
+  };
+
+  CellFactory(rm, 4);
+  grid->ForcedUpdate();
+  auto dimensions = grid->GetDimensions();
+
+  // Move agents to different boxes inside the grid
+  rm->GetAgent(AgentUid(0))->SetPosition({25, 35, 5});
+  rm->GetAgent(AgentUid(21))->SetPosition({50, 10, 70});
+  rm->GetAgent(AgentUid(63))->SetPosition({1, 1, 1});
+  grid->ForcedUpdate();
+  EXPECT_EQ(dimensions, grid->GetDimensions());
+  check_box_indices();
+  CompareWithBruteForceNeighborSearch(&simulation, 900);
+
+  // Move an agent outside of the grid. Requires a full update.
+  rm->GetAgent(AgentUid(5))->SetPosition({200, 10, 10});
+  grid->ForcedUpdate();
+  EXPECT_NE(dimensions, grid->GetDimensions());
+  check_box_indices();
+  CompareWithBruteForceNeighborSearch(&simulation, 900);
+
+  // Remove and add agents. Requires a full update.
+  rm->RemoveAgent(AgentUid(1));
+  auto* cell = new Cell({30, 30, 30});
+  cell->SetDiameter(30);
+  rm->AddAgent(cell);
+  grid->ForcedUpdate();
+  check_box_indices();
+  CompareWithBruteForceNeighborSearch(&simulation, 900);
+}
+
+TEST(UniformGridEnvironmentTest, IncrementalUpdateEmptiedBox) {
+  auto set_param = [](Param* param) {
+    param->uniform_grid_incremental_update = true;
+  };
+  Simulation simulation(TEST_NAME, set_param);
+  auto* rm = simulation.GetResourceManager();
+  auto* grid =
+      static_cast<UniformGridEnvironment*>(simulation.GetEnvironment());
+
+  // The box length is 10
+  for (auto& pos : std::vector<Real3>{
+           {0, 0, 0}, {200, 200, 200}, {105, 5, 5}, {112, 5, 5}}) {
+    auto* cell = new Cell(pos);
+    cell->SetDiameter(10);
+    rm->AddAgent(cell);
+  }
+  grid->ForcedUpdate();
+  auto dimensions = grid->GetDimensions();
+
+  // The agent at {105, 5, 5} leaves its box, which becomes empty. The old box
+  // is in the Moore neighborhood of the agent at {112, 5, 5}.
+  rm->GetAgent(AgentUid(2))->SetPosition({115, 5, 5});
+  grid->ForcedUpdate();
+  EXPECT_EQ(dimensions, grid->GetDimensions());
+
+  std::vector<AgentUid> neighbors;
+  auto collect = L2F([&](Agent* neighbor, real_t) {
+    neighbors.push_back(neighbor->GetUid());
+  });
+  grid->ForEachNeighbor(collect, *rm->GetAgent(AgentUid(3)), 100);
+  ASSERT_EQ(1u, neighbors.size());
+  EXPECT_EQ(AgentUid(2), neighbors[0]);
+  CompareWithBruteForceNeighborSearch(&simulation, 900);
+
+  // The emptied box can be filled again
+  rm->GetAgent(AgentUid(2))->SetPosition({105, 5, 5});
+  grid->ForcedUpdate();
+  neighbors.clear();
+  grid->ForEachNeighbor(collect, *rm->GetAgent(AgentUid(3)), 100);
+  ASSERT_EQ(1u, neighbors.size());
+  EXPECT_EQ(AgentUid(2), neighbors[0]);
+  CompareWithBruteForceNeighborSearch(&simulation, 900);
+}
+
+TEST(UniformGridEnvironmentTest, AdaptiveInteractionRadius) {
+  auto set_param = [](Param* param) {
+    param->adaptive_interaction_radius = true;
+  };
+  Simulation simulation(TEST_NAME, set_param);
+  auto* rm = simulation.GetResourceManager();
+  auto* env = simulation.GetEnvironment();
+
+  CellFactory(rm, 4);
+  auto* large_cell = new Cell({150, 150, 150});
+  large_cell->SetDiameter(50);
+  rm->AddAgent(large_cell);
+  env->ForcedUpdate();
+
+  // The box length is 50. Agent 0 is not in the Moore neighborhood of the
+  // large cell.
+  EXPECT_REAL_EQ(50, env->GetLargestAgentSizeInNeighborhood(*large_cell));
+  auto* agent0 = rm->GetAgent(AgentUid(0));
+  EXPECT_REAL_EQ(30, env->GetLargestAgentSizeInNeighborhood(*agent0));
+
+  // Boxes outside of the search radius are skipped
+  CompareWithBruteForceNeighborSearch(&simulation, 2500);
+  CompareWithBruteForceNeighborSearch(&simulation, 400);
+  CompareWithBruteForceNeighborSearch(&simulation, 100);
+
+  // Agents that are not part of the grid yet
+  Cell new_cell({10, 10, 10});
+  EXPECT_EQ(Math::kInfinity, env->GetLargestAgentSizeInNeighborhood(new_cell));
+}
+
+TEST(UniformGridEnvironmentTest, AdaptiveInteractionRadiusPerBox) {
+  auto set_param = [](Param* param) {
+    param->adaptive_interaction_radius = true;
+  };
+  Simulation simulation(TEST_NAME, set_param);
+  auto* rm = simulation.GetResourceManager();
+  auto* env = simulation.GetEnvironment();
+
+  auto add_cell = [&](const Real3& position, real_t diameter) {
+    auto* cell = new Cell(position);
+    cell->SetDiameter(diameter);
+    rm->AddAgent(cell);
+    return cell;
+  };
+  // The box length is 50. The boxes start at multiples of 50.
+  add_cell({0, 0, 0}, 2);
+  auto* query = add_cell({40, 25, 25}, 2);
+  auto* near = add_cell({43, 25, 25}, 2);
+  auto* distant = add_cell({55, 25, 25}, 2);
+  add_cell({25, 75, 25}, 40);
+  add_cell({200, 200, 200}, 50);
+  env->ForcedUpdate();
+  EXPECT_REAL_EQ(40, env->GetLargestAgentSizeInNeighborhood(*query));
+
+  std::set<AgentUid> neighbors;
+  auto fill_neighbor_list = L2F([&](Agent* neighbor, real_t) {
+    neighbors.insert(neighbor->GetUid());
+  });
+  env->ForEachNeighbor(fill_neighbor_list, *query, 2500);
+  EXPECT_EQ(1u, neighbors.count(distant->GetUid()));
+
+  // The box of `distant` is further away than the interaction range with
+  // the agents of this box (1 + 3 + 1), but not further away than the
+  // interaction range with the largest agent in the neighborhood
+  // (1 + 3 + 20).
+  neighbors.clear();
+  env->ForEachNeighborInInteractionRange(fill_neighbor_list, *query, 2500, 3);
+  EXPECT_EQ(1u, neighbors.count(near->GetUid()));
+  EXPECT_EQ(0u, neighbors.count(distant->GetUid()));
+
+  // The margin only applies to the query it has been passed to
+  neighbors.clear();
+  env->ForEachNeighbor(fill_neighbor_list, *query, 2500);
+  EXPECT_EQ(1u, neighbors.count(distant->GetUid()));
+
+  // Custom interaction forces might have a longer range. Unless they
+  // override the margin, no boxes are skipped.
+  struct CustomForce : public InteractionForce {
+    InteractionForce* NewCopy() const override {
+      return new CustomForce(*this);
+    }
+  };
+  EXPECT_EQ(Math::kInfinity, CustomForce().GetSphereInteractionMargin());
+  EXPECT_LT(InteractionForce().GetSphereInteractionMargin(), Math::kInfinity);
+  neighbors.clear();
+  env->ForEachNeighborInInteractionRange(
+      fill_neighbor_list, *query, 2500,
+      CustomForce().GetSphereInteractionMargin());
+  EXPECT_EQ(1u, neighbors.count(distant->GetUid()));
+}
+
+// Tests if ForEachNeighborPair visits each pair of neighbors exactly once and
+// finds the same neighbors as ForEachNeighbor.
+void RunForEachNeighborPairTest(Simulation* simulation) {
+  auto* rm = simulation->GetResourceManager();
+  auto* grid =
+      static_cast<UniformGridEnvironment*>(simulation->GetEnvironment());
+
+  CellFactory(rm, 4);
+
+  grid->Update();
+
+  std::set<std::pair<AgentUid, AgentUid>> expected;
+  rm->ForEachAgent([&](Agent* agent) {
+    auto uid = agent->GetUid();
+    auto fill_pairs = L2F([&](Agent* neighbor, real_t) {
+      auto nuid = neighbor->GetUid();
+      expected.insert({std::min(uid, nuid), std::max(uid, nuid)});
+    });
+    grid->ForEachNeighbor(fill_pairs, *agent, 900);
+  });
+
+  std::vector<std::pair<AgentUid, AgentUid>> pairs;
+  Spinlock lock;
+  auto fill_pairs = L2F([&](Agent* agent, AgentHandle, Agent* neighbor,
+                            AgentHandle, real_t squared_distance) {
+    EXPECT_LT(squared_distance, 900);
+    auto uid = agent->GetUid();
+    auto nuid = neighbor->GetUid();
+    std::lock_guard<Spinlock> guard(lock);
+    pairs.push_back({std::min(uid, nuid), std::max(uid, nuid)});
+  });
+  grid->ForEachNeighborPair(fill_pairs, 900);
+
+  std::set<std::pair<AgentUid, AgentUid>> unique_pairs(pairs.begin(),
+                                                       pairs.end());
+  EXPECT_EQ(pairs.size(), unique_pairs.size());
+  EXPECT_EQ(expected, unique_pairs);
+}
+
+TEST(UniformGridEnvironmentTest, ForEachNeighborPair) {
+  Simulation simulation(TEST_NAME);
+  RunForEachNeighborPairTest(&simulation);
+}
+
+TEST(UniformGridEnvironmentTest, ForEachNeighborPairCountingSort) {
+  auto set_param = [](Param* param) {
+    param->uniform_grid_counting_sort = true;
+    param->cache_agent_positions = true;
+  };
+  Simulation simulation(TEST_NAME, set_param);
+  RunForEachNeighborPairTest(&simulation);
+}
+
+TEST(UniformGridEnvironmentTest, ForEachNeighborPairByBoxColor) {
+  Simulation simulation(TEST_NAME);
+  auto* rm = simulation.GetResourceManager();
+  auto* grid =
+      static_cast<UniformGridEnvironment*>(simulation.GetEnvironment());
+
+  CellFactory(rm, 8);
+  grid->Update();
+
+  std::set<std::pair<AgentUid, AgentUid>> expected;
+  Spinlock lock;
+  auto fill_expected = L2F([&](Agent* agent, AgentHandle, Agent* neighbor,
+                               AgentHandle, real_t) {
+    auto uid = agent->GetUid();
+    auto nuid = neighbor->GetUid();
+    std::lock_guard<Spinlock> guard(lock);
+    expected.insert({std::min(uid, nuid), std::max(uid, nuid)});
+  });
+  grid->ForEachNeighborPair(fill_expected, 900);
+
+  // Agents that are part of a pair that is currently processed
+  std::set<Agent*> active;
+  std::vector<std::pair<AgentUid, AgentUid>> pairs;
+  uint64_t conflicts = 0;
+  auto check = L2F([&](Agent* agent, AgentHandle, Agent* neighbor,
+                       AgentHandle, real_t) {
+    auto uid = agent->GetUid();
+    auto nuid = neighbor->GetUid();
+    {
+      std::lock_guard<Spinlock> guard(lock);
+      pairs.push_back({std::min(uid, nuid), std::max(uid, nuid)});
+      conflicts += active.insert(agent).second ? 0 : 1;
+      conflicts += active.insert(neighbor).second ? 0 : 1;
+    }
+    // Give other threads the chance to run at the same time
+    std::this_thread::yield();
+    std::lock_guard<Spinlock> guard(lock);
+    active.erase(agent);
+    active.erase(neighbor);
+  });
+  grid->ForEachNeighborPairByBoxColor(check, 900);
+
+  EXPECT_EQ(0u, conflicts);
+  std::set<std::pair<AgentUid, AgentUid>> unique_pairs(pairs.begin(),
+                                                       pairs.end());
+  EXPECT_EQ(pairs.size(), unique_pairs.size());
+  EXPECT_EQ(expected, unique_pairs);
+}
+
+TEST(UniformGridEnvironmentTest, ForEachAgentByBoxColor) {
+  Simulation simulation(TEST_NAME);
+  auto* rm = simulation.GetResourceManager();
+  auto* grid =
+      static_cast<UniformGridEnvironment*>(simulation.GetEnvironment());
+
+  CellFactory(rm, 8);
+
+  grid->Update();
+
+  // Box that is currently processed by each thread
+  std::vector<int64_t> active_box(ThreadInfo::GetInstance()->GetMaxThreads(),
+                                  -1);
+  std::unordered_map<AgentUid, uint64_t> visits;
+  uint64_t conflicts = 0;
+  Spinlock lock;
+  auto check = L2F([&](Agent* agent, AgentHandle ah) {
+    EXPECT_EQ(agent, rm->GetAgent(ah));
+    auto tid = ThreadInfo::GetInstance()->GetMyThreadId();
+    auto box = grid->GetBoxCoordinates(agent->GetBoxIdx());
+    {
+      std::lock_guard<Spinlock> guard(lock);
+      visits[agent->GetUid()]++;
+      // The Moore neighborhoods of boxes that are processed at the same time
+      // must be disjoint
+      for (size_t t = 0; t < active_box.size(); ++t) {
+        if (t == static_cast<size_t>(tid) || active_box[t] == -1) {
+          continue;
+        }
+        auto other = grid->GetBoxCoordinates(active_box[t]);
+        bool disjoint = false;
+        for (int d = 0; d < 3; ++d) {
+          auto diff = std::max(box[d], other[d]) - std::min(box[d], other[d]);
+          disjoint |= diff >= 3;
+        }
+        conflicts += disjoint ? 0 : 1;
+      }
+      active_box[tid] = agent->GetBoxIdx();
+    }
+    // Give other threads the chance to run at the same time
+    std::this_thread::yield();
+    std::lock_guard<Spinlock> guard(lock);
+    active_box[tid] = -1;
+  });
+  grid->ForEachAgentByBoxColor(check);
+
+  EXPECT_EQ(0u, conflicts);
+  EXPECT_EQ(rm->GetNumAgents(), visits.size());
+  for (auto& el : visits) {
+    EXPECT_EQ(1u, el.second);
+  }
+
+  // Agents for which the filter returns false are skipped
+  uint64_t num_visited = 0;
+  auto count = L2F([&](Agent*, AgentHandle) {
+#pragma omp atomic
+    num_visited++;
+  });
+  auto filter =
+      L2F([](Agent* agent) { return agent->GetUid().GetIndex() % 2 == 0; });
+  grid->ForEachAgentByBoxColor(count, &filter);
+  EXPECT_EQ(rm->GetNumAgents() / 2, num_visited);
+}
+
+TEST(UniformGridEnvironmentTest, ForEachAgentByBoxColorVisitsNewAgents) {
+  Simulation simulation(TEST_NAME);
+  auto* rm = simulation.GetResourceManager();
+  auto* grid =
+      static_cast<UniformGridEnvironment*>(simulation.GetEnvironment());
+
+  CellFactory(rm, 4);
+  grid->Update();
+
+  // Agents that have been added after the update are not in the grid
+  for (int i = 0; i < 10; ++i) {
+    auto* cell = new Cell(10);
+    cell->SetPosition({real_t(i * 5), 0, 0});
+    rm->AddAgent(cell);
+  }
+
+  std::unordered_map<AgentUid, uint64_t> visits;
+  Spinlock lock;
+  auto record = L2F([&](Agent* agent, AgentHandle ah) {
+    EXPECT_EQ(agent, rm->GetAgent(ah));
+    std::lock_guard<Spinlock> guard(lock);
+    visits[agent->GetUid()]++;
+  });
+  grid->ForEachAgentByBoxColor(record);
+
+  EXPECT_EQ(74u, rm->GetNumAgents());
+  EXPECT_EQ(rm->GetNumAgents(), visits.size());
+  for (auto& el : visits) {
+    EXPECT_EQ(1u, el.second);
+  }
+
+  // The filter also applies to the agents that are not in the grid
+  uint64_t num_visited = 0;
+  auto count = L2F([&](Agent*, AgentHandle) {
+#pragma omp atomic
+    num_visited++;
+  });
+  auto filter =
+      L2F([](Agent* agent) { return agent->GetUid().GetIndex() >= 64; });
+  grid->ForEachAgentByBoxColor(count, &filter);
+  EXPECT_EQ(10u, num_visited);
+}
+
 }  // namespace bdm
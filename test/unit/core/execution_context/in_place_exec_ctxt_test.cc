@@ -356,6 +356,56 @@ TEST(InPlaceExecutionContext, ExecuteThreadSafetyTestAutomaticThreadSafety) {
       Param::ThreadSafetyMechanism::kAutomatic);
 }
 
+struct IncrementNeighborData : public AgentOperationImpl {
+  BDM_OP_HEADER(IncrementNeighborData);
+
+  void operator()(Agent* agent) override {
+    // Modifies the neighbors without any synchronization
+    auto increment = L2F([](Agent* neighbor, real_t) {
+      auto* tagent = static_cast<TestAgent*>(neighbor);
+      tagent->SetData(tagent->GetData() + 1);
+    });
+    auto* ctxt = Simulation::GetActive()->GetExecutionContext();
+    ctxt->ForEachNeighbor(increment, *agent, 900);
+  }
+};
+
+BDM_REGISTER_OP(IncrementNeighborData, "IncrementNeighborData", kCpu);
+
+TEST(InPlaceExecutionContext, ExecuteThreadSafetyTestBoxColoring) {
+  auto set_param = [](Param* param) {
+    param->thread_safety_mechanism =
+        Param::ThreadSafetyMechanism::kBoxColoring;
+    param->unschedule_default_operations = {"mechanical forces"};
+  };
+  Simulation sim(TEST_NAME, set_param);
+  auto* rm = sim.GetResourceManager();
+  auto* env = sim.GetEnvironment();
+
+  auto construct = [](const Real3& position) {
+    auto* agent = new TestAgent(position);
+    agent->SetDiameter(30);
+    return agent;
+  };
+  ModelInitializer::Grid3D(16, 20, construct);
+
+  // Each agent is incremented once by each of its neighbors
+  env->Update();
+  std::unordered_map<AgentUid, int> expected;
+  rm->ForEachAgent([&](Agent* agent) {
+    auto count = L2F([&](Agent*, real_t) { expected[agent->GetUid()]++; });
+    env->ForEachNeighbor(count, *agent, 900);
+  });
+
+  sim.GetScheduler()->ScheduleOp(NewOperation("IncrementNeighborData"));
+  sim.GetScheduler()->Simulate(1);
+
+  rm->ForEachAgent([&](Agent* agent) {
+    auto* tagent = static_cast<TestAgent*>(agent);
+    EXPECT_EQ(expected[agent->GetUid()], tagent->GetData());
+  });
+}
+
 TEST(InPlaceExecutionContext, PushBackMultithreadingTest) {
   Simulation simulation(TEST_NAME);
 
@@ -15,6 +15,9 @@
 #include "core/memory/memory_manager.h"
 #include <gtest/gtest.h>
 #include "core/agent/cell.h"
+#include "core/behavior/growth_division.h"
+#include "core/resource_manager.h"
+#include "core/scheduler.h"
 #include "unit/test_util/test_util.h"
 
 namespace bdm {
@@ -285,5 +288,199 @@ TEST(MemoryManagerTest, New) {
   }
 }
 
+// -----------------------------------------------------------------------------
+TEST(MemoryManagerTest, Arena) {
+  Simulation simulation(TEST_NAME);
+  auto* param = simulation.GetParam();
+  auto* mem_mgr = simulation.GetMemoryManager();
+  ASSERT_TRUE(mem_mgr != nullptr);
+
+  uint64_t page_shift = static_cast<uint64_t>(std::log2(sysconf(_SC_PAGESIZE)));
+  uint64_t size_n_pages =
+      1 << (page_shift + param->mem_mgr_aligned_pages_shift);
+  uint64_t cells_per_region =
+      (size_n_pages - NumaArenaAllocator::kMetadataSize) /
+      NumaPoolAllocator::RoundUpTo(sizeof(Cell), sizeof(uint64_t));
+
+  mem_mgr->SetArenaEnabled(true);
+  std::vector<Cell*> cells;
+  for (uint64_t i = 0; i < 2 * cells_per_region; ++i) {
+    cells.push_back(new Cell());
+  }
+  mem_mgr->SetArenaEnabled(false);
+
+  // the cells are allocated contiguously
+  for (uint64_t i = 1; i < cells_per_region; ++i) {
+    EXPECT_EQ(reinterpret_cast<char*>(cells[i - 1]) +
+                  NumaPoolAllocator::RoundUpTo(sizeof(Cell), sizeof(uint64_t)),
+              reinterpret_cast<char*>(cells[i]));
+  }
+  EXPECT_EQ(2u, mem_mgr->GetNumArenaRegions());
+
+  // allocations outside the arena use the pool allocators
+  auto* pool_cell = new Cell();
+  auto addr = reinterpret_cast<uint64_t>(pool_cell);
+  auto page_number = addr >> (page_shift + param->mem_mgr_aligned_pages_shift);
+  auto* page_addr = reinterpret_cast<char*>(
+      page_number << (page_shift + param->mem_mgr_aligned_pages_shift));
+  auto* npa = *reinterpret_cast<NumaPoolAllocator**>(page_addr);
+  EXPECT_EQ(sizeof(Cell), npa->GetSize());
+  delete pool_cell;
+
+  auto* first_region = reinterpret_cast<char*>(cells[0]) -
+                       NumaArenaAllocator::kMetadataSize;
+  auto* second_region = reinterpret_cast<char*>(cells[cells_per_region]) -
+                        NumaArenaAllocator::kMetadataSize;
+
+  // the first region is released once all its objects have been deleted
+  for (uint64_t i = 0; i < cells_per_region; ++i) {
+    delete cells[i];
+  }
+  EXPECT_EQ(1u, mem_mgr->GetNumArenaRegions());
+
+  // the second region is still used for allocations
+  for (uint64_t i = cells_per_region; i < cells.size(); ++i) {
+    delete cells[i];
+  }
+  EXPECT_EQ(1u, mem_mgr->GetNumArenaRegions());
+  mem_mgr->ReleaseArenaRegions();
+  EXPECT_EQ(0u, mem_mgr->GetNumArenaRegions());
+
+  mem_mgr->SetArenaEnabled(true);
+  auto* cell = new Cell();
+  mem_mgr->SetArenaEnabled(false);
+  auto* region = reinterpret_cast<char*>(cell) -
+                 NumaArenaAllocator::kMetadataSize;
+  // released regions are reused
+  EXPECT_TRUE(region == first_region || region == second_region);
+  EXPECT_EQ(1u, mem_mgr->GetNumArenaRegions());
+  delete cell;
+}
+
+// -----------------------------------------------------------------------------
+TEST(MemoryManagerTest, ArenaReleasedAfterSimulate) {
+  auto set_param = [](Param* param) { param->mem_mgr_arena = true; };
+  Simulation simulation(TEST_NAME, set_param);
+  auto* mem_mgr = simulation.GetMemoryManager();
+  ASSERT_TRUE(mem_mgr != nullptr);
+  auto* rm = simulation.GetResourceManager();
+
+  // The cells divide in every iteration
+  for (int i = 0; i < 10; ++i) {
+    auto* cell = new Cell({i * 20.0, 0, 0});
+    cell->SetDiameter(10);
+    cell->AddBehavior(new GrowthDivision(5, 0));
+    rm->AddAgent(cell);
+  }
+  simulation.GetScheduler()->Simulate(2);
+  EXPECT_LT(10u, rm->GetNumAgents());
+  EXPECT_LT(0u, mem_mgr->GetNumArenaRegions());
+
+  // The threads do not allocate from the regions anymore. Hence, they can be
+  // reused once their agents have been removed.
+  rm->ClearAgents();
+  EXPECT_EQ(0u, mem_mgr->GetNumArenaRegions());
+}
+
+// -----------------------------------------------------------------------------
+TEST(MemoryManagerTest, StatisticsAndTrim) {
+  Simulation simulation(TEST_NAME);
+  auto* mem_mgr = simulation.GetMemoryManager();
+  ASSERT_TRUE(mem_mgr != nullptr);
+
+  auto get_cell_pool = [&]() {
+    MemoryPoolStatistics pool;
+    for (auto& el : mem_mgr->GetStatistics().pools) {
+      if (el.size == sizeof(Cell)) {
+        pool.memory_blocks += el.memory_blocks;
+        pool.reserved_bytes += el.reserved_bytes;
+        pool.used_bytes += el.used_bytes;
+      }
+    }
+    return pool;
+  };
+
+  std::vector<Cell*> cells;
+  for (uint64_t i = 0; i < 100000; ++i) {
+    cells.push_back(new Cell());
+  }
+  auto pool = get_cell_pool();
+  EXPECT_EQ(100000 * sizeof(Cell), pool.used_bytes);
+  EXPECT_LE(pool.used_bytes, pool.reserved_bytes);
+  EXPECT_LT(0u, pool.memory_blocks);
+  auto reserved = pool.reserved_bytes;
+
+  // remove 90% of the cells
+  for (uint64_t i = 0; i < 90000; ++i) {
+    delete cells[i];
+  }
+  cells.erase(cells.begin(), cells.begin() + 90000);
+  pool = get_cell_pool();
+  EXPECT_EQ(10000 * sizeof(Cell), pool.used_bytes);
+  EXPECT_EQ(reserved, pool.reserved_bytes);
+
+  auto released = mem_mgr->Trim();
+  pool = get_cell_pool();
+  EXPECT_LT(0u, released);
+  EXPECT_EQ(reserved - released, pool.reserved_bytes);
+  EXPECT_EQ(10000 * sizeof(Cell), pool.used_bytes);
+  EXPECT_LT(pool.reserved_bytes, reserved / 2);
+
+  // released memory is reused
+  for (uint64_t i = 0; i < 90000; ++i) {
+    auto* cell = new Cell();
+    cell->SetDiameter(i);
+    cells.push_back(cell);
+  }
+  pool = get_cell_pool();
+  EXPECT_EQ(100000 * sizeof(Cell), pool.used_bytes);
+  EXPECT_GE(reserved, pool.reserved_bytes);
+  for (auto* cell : cells) {
+    delete cell;
+  }
+  EXPECT_EQ(0u, get_cell_pool().used_bytes);
+}
+
+// -----------------------------------------------------------------------------
+TEST(MemoryManagerTest, SizeClassCache) {
+  MemoryManager mem_mgr(5, 1.1, 1);
+  auto* tinfo = ThreadInfo::GetInstance();
+  uint64_t page_shift = static_cast<uint64_t>(std::log2(sysconf(_SC_PAGESIZE)));
+
+  // more sizes than cache entries
+  std::vector<uint64_t> sizes;
+  for (uint64_t i = 1; i <= 20; ++i) {
+    sizes.push_back(i * 24);
+  }
+
+  std::atomic<uint64_t> errors(0);
+#pragma omp parallel
+  {
+    std::vector<std::pair<void*, uint64_t>> allocations;
+    for (uint64_t i = 0; i < 1000; ++i) {
+      for (auto size : sizes) {
+        allocations.push_back({mem_mgr.New(size), size});
+      }
+    }
+    for (auto& el : allocations) {
+      auto addr = reinterpret_cast<uint64_t>(el.first);
+      auto page_number = addr >> (page_shift + 5);
+      auto* page_addr =
+          reinterpret_cast<char*>(page_number << (page_shift + 5));
+      auto* npa = *reinterpret_cast<NumaPoolAllocator**>(page_addr);
+      if (npa->GetSize() != el.second ||
+          npa->GetNumaNode() != tinfo->GetMyNumaNode()) {
+        errors++;
+      }
+      mem_mgr.Delete(el.first);
+    }
+  }
+  EXPECT_EQ(0u, errors);
+
+  for (auto& pool : mem_mgr.GetStatistics().pools) {
+    EXPECT_EQ(0u, pool.used_bytes);
+  }
+}
+
 }  // namespace memory_manager_detail
 }  // namespace bdm
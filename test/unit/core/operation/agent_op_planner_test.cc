@@ -0,0 +1,218 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN & University of Surrey for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+// See the NOTICE file distributed with this work for additional information
+// regarding copyright ownership.
+//
+// -----------------------------------------------------------------------------
+
+#include "core/operation/agent_op_planner.h"
+#include <omp.h>
+#include <map>
+#include <memory>
+#include "core/agent/cell.h"
+#include "core/behavior/stateless_behavior.h"
+#include "core/operation/operation_registry.h"
+#include "core/resource_manager.h"
+#include "core/scheduler.h"
+#include "core/simulation.h"
+#include "core/util/thread_info.h"
+#include "gtest/gtest.h"
+#include "unit/test_util/test_util.h"
+
+namespace bdm {
+
+struct PlannerTestOp : public AgentOperationImpl {
+  explicit PlannerTestOp(bool modifies_other_agents)
+      : modifies_other_agents_(modifies_other_agents) {}
+
+  void operator()(Agent* agent) override {}
+
+  PlannerTestOp* Clone() override { return new PlannerTestOp(*this); }
+
+  bool ModifiesOtherAgents() const override { return modifies_other_agents_; }
+
+  bool modifies_other_agents_;
+};
+
+Operation* NewPlannerTestOp(const std::string& name,
+                            bool modifies_other_agents) {
+  auto* op = new Operation(name);
+  op->AddOperationImpl(kCpu, new PlannerTestOp(modifies_other_agents));
+  return op;
+}
+
+std::vector<std::string> PassNames(
+    const std::vector<AgentOpPlanner::Pass>& plan) {
+  std::vector<std::string> names;
+  for (auto& pass : plan) {
+    names.push_back(pass.name);
+  }
+  return names;
+}
+
+TEST(AgentOpPlannerTest, Groups) {
+  std::unique_ptr<Operation> a(NewPlannerTestOp("a", true));
+  std::unique_ptr<Operation> b(NewPlannerTestOp("b", false));
+  std::unique_ptr<Operation> c(NewPlannerTestOp("c", false));
+  std::unique_ptr<Operation> d(NewPlannerTestOp("d", true));
+  std::unique_ptr<Operation> e(NewPlannerTestOp("e", false));
+
+  AgentOpPlanner planner;
+  auto plan = planner.Plan({a.get(), b.get(), c.get(), d.get(), e.get()},
+                           Param::AgentOpFusion::kAlwaysFuse);
+  std::vector<std::string> expected = {"a", "b + c", "d", "e"};
+  EXPECT_EQ(expected, PassNames(plan));
+  ASSERT_EQ(2u, plan[1].ops.size());
+  EXPECT_EQ(b.get(), plan[1].ops[0]);
+  EXPECT_EQ(c.get(), plan[1].ops[1]);
+  EXPECT_EQ("b + c", plan[1].group);
+  EXPECT_TRUE(plan[1].fused);
+  EXPECT_EQ("", plan[3].group);
+
+  // The value of the implementation can be overridden
+  d->SetModifiesOtherAgents(false);
+  a->SetModifiesOtherAgents(false);
+  b->SetModifiesOtherAgents(true);
+  plan = planner.Plan({a.get(), b.get(), c.get(), d.get(), e.get()},
+                      Param::AgentOpFusion::kAlwaysFuse);
+  expected = {"a", "b", "c + d + e"};
+  EXPECT_EQ(expected, PassNames(plan));
+
+  // Groups are split independent of any measurements
+  plan = planner.Plan({a.get(), b.get(), c.get(), d.get(), e.get()},
+                      Param::AgentOpFusion::kNeverFuse);
+  expected = {"a", "b", "c", "d", "e"};
+  EXPECT_EQ(expected, PassNames(plan));
+  EXPECT_FALSE(plan[2].fused);
+  EXPECT_EQ("c + d + e", plan[2].group);
+}
+
+TEST(AgentOpPlannerTest, DefaultOps) {
+  Simulation simulation(TEST_NAME);
+  std::unique_ptr<Operation> behavior(NewOperation("behavior"));
+  std::unique_ptr<Operation> forces(NewOperation("mechanical forces"));
+  std::unique_ptr<Operation> discretization(NewOperation("discretization"));
+
+  // Behaviors might modify their neighbors. Mechanical forces only modify
+  // the agent itself.
+  AgentOpPlanner planner;
+  auto plan =
+      planner.Plan({behavior.get(), forces.get(), discretization.get()},
+                   Param::AgentOpFusion::kAlwaysFuse);
+  std::vector<std::string> expected = {"behavior", "mechanical forces",
+                                       "discretization"};
+  EXPECT_EQ(expected, PassNames(plan));
+
+  // Users can declare that their behaviors only modify the agent itself
+  behavior->SetModifiesOtherAgents(false);
+  plan = planner.Plan({behavior.get(), forces.get(), discretization.get()},
+                      Param::AgentOpFusion::kAlwaysFuse);
+  expected = {"behavior + mechanical forces", "discretization"};
+  EXPECT_EQ(expected, PassNames(plan));
+}
+
+/// Records the diameter of each agent it is executed for
+struct RecordDiameterOp : public AgentOperationImpl {
+  void operator()(Agent* agent) override {
+    diameters[agent->GetUid()] = agent->GetDiameter();
+  }
+
+  RecordDiameterOp* Clone() override { return new RecordDiameterOp(*this); }
+
+  bool ModifiesOtherAgents() const override { return false; }
+
+  std::map<AgentUid, real_t> diameters;
+};
+
+TEST(AgentOpPlannerTest, BehaviorModifiesNeighbor) {
+  auto set_param = [](Param* param) {
+    param->execution_order = Param::ExecutionOrder::kPlanned;
+  };
+  Simulation simulation(TEST_NAME, set_param);
+  auto* rm = simulation.GetResourceManager();
+  auto* scheduler = simulation.GetScheduler();
+
+  // Process the agents one after another in the order they were added
+  omp_set_num_threads(1);
+  ThreadInfo::GetInstance()->Renew();
+  scheduler->UnscheduleOp(scheduler->GetOps("load balancing")[0]);
+
+  // The behavior of the second agent modifies the first agent
+  StatelessBehavior grow_neighbor([](Agent* agent) {
+    if (agent->GetUid() == AgentUid(1)) {
+      auto* rm = Simulation::GetActive()->GetResourceManager();
+      rm->GetAgent(AgentUid(0))->SetDiameter(42);
+    }
+  });
+  for (int i = 0; i < 2; ++i) {
+    auto* cell = new Cell(10);
+    cell->AddBehavior(grow_neighbor.NewCopy());
+    rm->AddAgent(cell);
+  }
+
+  auto* record = new Operation("record diameter");
+  record->AddOperationImpl(kCpu, new RecordDiameterOp());
+  scheduler->ScheduleOp(record);
+  // All other agent operations could be fused with the behaviors
+  for (auto* name : {"update staticness", "bound space", "mechanical forces",
+                     "discretization", "propagate staticness agentop"}) {
+    for (auto* op : scheduler->GetOps(name)) {
+      op->SetModifiesOtherAgents(false);
+    }
+  }
+
+  scheduler->Simulate(1);
+
+  // The behaviors are executed in a separate pass. Therefore, the subsequent
+  // operations observe the modification of the first agent.
+  auto* record_impl = record->GetImplementation<RecordDiameterOp>();
+  EXPECT_REAL_EQ(42, record_impl->diameters[AgentUid(0)]);
+
+  omp_set_num_threads(omp_get_max_threads());
+  ThreadInfo::GetInstance()->Renew();
+}
+
+TEST(AgentOpPlannerTest, CostModel) {
+  std::unique_ptr<Operation> a(NewPlannerTestOp("a", false));
+  std::unique_ptr<Operation> b(NewPlannerTestOp("b", false));
+  std::unique_ptr<Operation> c(NewPlannerTestOp("c", true));
+  std::vector<Operation*> ops = {a.get(), b.get(), c.get()};
+
+  AgentOpPlanner planner;
+  // Both variants are measured first
+  for (uint64_t i = 0; i < AgentOpPlanner::kSamples; i++) {
+    auto plan = planner.Plan(ops, Param::AgentOpFusion::kMeasureFusion);
+    std::vector<std::string> expected = {"a + b", "c"};
+    ASSERT_EQ(expected, PassNames(plan));
+    planner.Update(plan, {100, 1});
+  }
+  for (uint64_t i = 0; i < AgentOpPlanner::kSamples; i++) {
+    auto plan = planner.Plan(ops, Param::AgentOpFusion::kMeasureFusion);
+    std::vector<std::string> expected = {"a", "b", "c"};
+    ASSERT_EQ(expected, PassNames(plan));
+    EXPECT_FALSE(plan[0].fused);
+    EXPECT_EQ("a + b", plan[1].group);
+    planner.Update(plan, {30, 30, 1});
+  }
+
+  // Executing the operations separately was faster
+  EXPECT_FALSE(planner.IsFused("a + b"));
+  uint64_t executions = 2 * AgentOpPlanner::kSamples;
+  for (; executions < AgentOpPlanner::kReevaluationInterval; executions++) {
+    auto plan = planner.Plan(ops, Param::AgentOpFusion::kMeasureFusion);
+    ASSERT_EQ(3u, plan.size());
+    planner.Update(plan, {30, 30, 1});
+  }
+
+  // Both variants are measured again
+  EXPECT_TRUE(planner.IsFused("a + b"));
+}
+
+}  // namespace bdm
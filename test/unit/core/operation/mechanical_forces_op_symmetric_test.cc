@@ -0,0 +1,88 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN & University of Surrey for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+// See the NOTICE file distributed with this work for additional information
+// regarding copyright ownership.
+//
+// -----------------------------------------------------------------------------
+
+#include "core/operation/mechanical_forces_op_symmetric.h"
+#include <gtest/gtest.h>
+#include <sstream>
+#include <unordered_map>
+#include "core/agent/cell.h"
+#include "core/environment/environment.h"
+#include "core/interaction_force.h"
+#include "unit/test_util/test_util.h"
+
+namespace bdm {
+
+// -----------------------------------------------------------------------------
+// Compares the result of the symmetric operation with displacements that are
+// calculated with `Cell::CalculateDisplacement` before any agent is moved.
+TEST(MechanicalForcesOpSymmetricTest, SameResultAsPerAgentCalculation) {
+  Simulation simulation(TEST_NAME);
+  auto* rm = simulation.GetResourceManager();
+  auto* env = simulation.GetEnvironment();
+  auto* param = simulation.GetParam();
+
+  real_t space = 20;
+  for (size_t i = 0; i < 3; i++) {
+    for (size_t j = 0; j < 3; j++) {
+      for (size_t k = 0; k < 3; k++) {
+        Cell* cell = new Cell({k * space + i, j * space + k, i * space + j});
+        cell->SetDiameter(30);
+        cell->SetAdherence(0.4);
+        cell->SetMass(1.0);
+        rm->AddAgent(cell);
+      }
+    }
+  }
+
+  env->Update();
+
+  InteractionForce force;
+  auto squared_radius =
+      env->GetLargestAgentSize() * env->GetLargestAgentSize();
+  std::unordered_map<AgentUid, Real3> expected;
+  rm->ForEachAgent([&](Agent* agent) {
+    expected[agent->GetUid()] =
+        agent->GetPosition() +
+        agent->CalculateDisplacement(&force, squared_radius,
+                                     param->simulation_time_step);
+  });
+
+  auto* op = NewOperation("symmetric mechanical forces");
+  (*op)();
+
+  rm->ForEachAgent([&](Agent* agent) {
+    EXPECT_ARR_NEAR(agent->GetPosition(), expected[agent->GetUid()]);
+  });
+
+  delete op;
+}
+
+// -----------------------------------------------------------------------------
+TEST(MechanicalForcesOpSymmetricTest, ReplacesDefaultOperation) {
+  auto set_param = [](Param* param) {
+    param->symmetric_mechanical_forces = true;
+  };
+  Simulation simulation(TEST_NAME, set_param);
+
+  std::stringstream buffer;
+  simulation.GetScheduler()->PrintInfo(buffer);
+  EXPECT_TRUE(buffer.str().find("symmetric mechanical forces") !=
+              std::string::npos);
+  EXPECT_TRUE(
+      simulation.GetScheduler()->GetOps("symmetric mechanical forces").size() ==
+      1);
+  EXPECT_TRUE(simulation.GetScheduler()->GetOps("mechanical forces").empty());
+}
+
+}  // namespace bdm
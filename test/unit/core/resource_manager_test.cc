@@ -14,6 +14,7 @@
 
 // I/O related code must be in header file
 #include "unit/core/resource_manager_test.h"
+#include <numeric>
 #include "core/model_initializer.h"
 #include "unit/test_util/io_test.h"
 #include "unit/test_util/test_agent.h"
@@ -138,6 +139,81 @@ TEST(ResourceManagerTest, ForEachAgentParallelFilter) {
 }
 // #endif  // APPLE ARM64 CLANG==13
 
+TEST(ResourceManagerTest, ForEachAgentParallelWorkStealing) {
+  Simulation simulation(TEST_NAME);
+  auto* rm = simulation.GetResourceManager();
+  auto max_threads = ThreadInfo::GetInstance()->GetMaxThreads();
+
+  // No agents
+  auto never = L2F([](Agent*, AgentHandle) { FAIL(); });
+  rm->ForEachAgentParallelWorkStealing(10, never);
+  EXPECT_EQ(static_cast<size_t>(max_threads), rm->GetThreadBusyTimes().size());
+
+  for (uint64_t i = 0; i < 10000; i++) {
+    rm->AddAgent(new TestAgent(i));
+  }
+
+  auto evenf = L2F([](Agent* a) {
+    return bdm_static_cast<TestAgent*>(a)->GetData() % 2 == 0;
+  });
+
+  for (uint64_t min_chunk : {0, 1, 7, 100, 20000}) {
+    std::vector<std::atomic<int>> visits(10000);
+    auto functor = L2F([&](Agent* a, AgentHandle ah) {
+      EXPECT_EQ(a, rm->GetAgent(ah));
+      auto data = bdm_static_cast<TestAgent*>(a)->GetData();
+      // The first agents are much more expensive than the remaining ones
+      if (data < 100) {
+        volatile real_t x = 0;
+        for (int i = 0; i < 100000; i++) {
+          x = x + std::sqrt(static_cast<real_t>(i));
+        }
+      }
+      visits[data]++;
+    });
+    rm->ForEachAgentParallelWorkStealing(min_chunk, functor);
+    for (auto& v : visits) {
+      EXPECT_EQ(1, v.load());
+    }
+    EXPECT_EQ(static_cast<size_t>(max_threads),
+              rm->GetThreadBusyTimes().size());
+    EXPECT_EQ(static_cast<size_t>(max_threads),
+              rm->GetThreadIdleTimes().size());
+    int64_t busy = 0;
+    for (int t = 0; t < max_threads; t++) {
+      EXPECT_LE(0, rm->GetThreadBusyTimes()[t]);
+      EXPECT_LE(0, rm->GetThreadIdleTimes()[t]);
+      busy += rm->GetThreadBusyTimes()[t];
+    }
+    EXPECT_LT(0, busy);
+
+    for (auto& v : visits) {
+      v = 0;
+    }
+    rm->ForEachAgentParallelWorkStealing(min_chunk, functor, &evenf);
+    for (uint64_t i = 0; i < visits.size(); i++) {
+      EXPECT_EQ(i % 2 == 0 ? 1 : 0, visits[i].load());
+    }
+  }
+
+  // All expensive agents are in the initial range of the first thread. The
+  // other threads run out of work and steal parts of this range.
+  if (max_threads > 1) {
+    auto skewed = L2F([&](Agent* a, AgentHandle) {
+      if (bdm_static_cast<TestAgent*>(a)->GetData() < 10) {
+        volatile real_t x = 0;
+        for (int i = 0; i < 1000000; i++) {
+          x = x + std::sqrt(static_cast<real_t>(i));
+        }
+      }
+    });
+    rm->ForEachAgentParallelWorkStealing(1, skewed);
+    const auto& steals = rm->GetThreadSteals();
+    ASSERT_EQ(static_cast<size_t>(max_threads), steals.size());
+    EXPECT_LT(0u, std::accumulate(steals.begin(), steals.end(), uint64_t(0)));
+  }
+}
+
 TEST(ResourceManagerTest, GetNumAgents) { RunGetNumAgents(); }
 
 TEST(ResourceManagerTest, ForEachAgentParallel) {
@@ -146,6 +222,48 @@ TEST(ResourceManagerTest, ForEachAgentParallel) {
 
 #ifdef USE_DICT
 TEST(ResourceManagerTest, IO) { RunIOTest(); }
+
+TEST(ResourceManagerTest, TypeIndexRebuild) {
+  Simulation simulation(TEST_NAME);
+
+  std::vector<std::vector<Agent*>> agents(3);
+  for (int i = 0; i < 1000; ++i) {
+    Agent* agent = i % 3 == 0 ? static_cast<Agent*>(new A(i)) : new B(i);
+    agents[i % 3].push_back(agent);
+  }
+  // Null entries are skipped
+  delete agents[1][5];
+  agents[1][5] = nullptr;
+
+  TypeIndex type_index;
+  type_index.Rebuild(agents);
+  auto& a_agents = type_index.GetType(A::Class());
+  auto& b_agents = type_index.GetType(B::Class());
+  EXPECT_EQ(334u, a_agents.size());
+  EXPECT_EQ(665u, b_agents.size());
+  for (auto* agent : a_agents) {
+    EXPECT_EQ(A::Class(), agent->IsA());
+  }
+  for (auto* agent : b_agents) {
+    EXPECT_EQ(B::Class(), agent->IsA());
+  }
+
+  // Removal uses the rebuilt index
+  auto* removed = b_agents[10];
+  type_index.Remove(removed);
+  EXPECT_EQ(664u, b_agents.size());
+  EXPECT_EQ(b_agents.end(),
+            std::find(b_agents.begin(), b_agents.end(), removed));
+  delete removed;
+
+  for (auto& numa_agents : agents) {
+    for (auto* agent : numa_agents) {
+      if (agent != removed) {
+        delete agent;
+      }
+    }
+  }
+}
 #endif  // USE_DICT
 
 TEST(ResourceManagerTest, PushBackAndGetAgentTest) {
@@ -214,8 +332,14 @@ struct DeleteFunctor : public Functor<void, Agent*, AgentHandle> {
 // -----------------------------------------------------------------------------
 void RunParallelAgentRemovalTest(
     uint64_t agents_per_dim,
-    const std::function<bool(uint64_t index)>& remove_functor) {
-  Simulation simulation("RunForEachAgentTest_ParallelAgentRemoval");
+    const std::function<bool(uint64_t index)>& remove_functor,
+    bool tombstones = false) {
+  auto set_param = [&](Param* param) {
+    param->agent_removal_tombstones = tombstones;
+    // never compact automatically
+    param->agent_removal_tombstone_threshold = 1;
+  };
+  Simulation simulation("RunForEachAgentTest_ParallelAgentRemoval", set_param);
 
   auto construct = [](const Real3& pos) {
     auto* agent = new TestAgent(pos);
@@ -237,14 +361,27 @@ void RunParallelAgentRemovalTest(
 
   simulation.GetScheduler()->Simulate(1);
 
-  for (uint64_t i = 0; i < remove.size(); ++i) {
-    auto uid = AgentUid(i);
-    EXPECT_EQ(!remove[i], rm->ContainsAgent(uid));
-    if (!remove[i]) {
-      // access data member to check that remaining agents
-      // are still valid and haven't been deleted erroneously.
-      EXPECT_EQ(uid, rm->GetAgent(uid)->GetUid());
+  uint64_t num_removed = std::count(remove.begin(), remove.end(), true);
+  EXPECT_EQ(tombstones ? num_removed : 0u, rm->GetNumTombstones());
+  EXPECT_EQ(remove.size() - num_removed, rm->GetNumAgents());
+  uint64_t counter = 0;
+  rm->ForEachAgent([&](Agent* agent) { counter++; });
+  EXPECT_EQ(remove.size() - num_removed, counter);
+
+  for (int compact = 0; compact < 2; ++compact) {
+    for (uint64_t i = 0; i < remove.size(); ++i) {
+      auto uid = AgentUid(i);
+      EXPECT_EQ(!remove[i], rm->ContainsAgent(uid));
+      if (!remove[i]) {
+        // access data member to check that remaining agents
+        // are still valid and haven't been deleted erroneously.
+        EXPECT_EQ(uid, rm->GetAgent(uid)->GetUid());
+        EXPECT_EQ(uid, rm->GetAgent(rm->GetAgentHandle(uid))->GetUid());
+      }
     }
+    rm->Compact();
+    EXPECT_EQ(0u, rm->GetNumTombstones());
+    EXPECT_EQ(remove.size() - num_removed, rm->GetAgentContainerSize());
   }
 }
 
@@ -293,4 +430,154 @@ TEST(ResourceManagerTest, ParallelAgentRemoval_LargeScale75) {
   });
 }
 
+// -----------------------------------------------------------------------------
+TEST(ResourceManagerTest, ParallelAgentRemoval_SmallScale_Tombstones) {
+  RunParallelAgentRemovalTest(
+      2, [](uint64_t i) { return i == 0 || i == 3 || i == 6 || i == 7; },
+      true);
+}
+
+// -----------------------------------------------------------------------------
+TEST(ResourceManagerTest, ParallelAgentRemoval_SmallScale_All_Tombstones) {
+  RunParallelAgentRemovalTest(2, [](uint64_t i) { return true; }, true);
+}
+
+// -----------------------------------------------------------------------------
+TEST(ResourceManagerTest, ParallelAgentRemoval_LargeScale50_Tombstones) {
+  RunParallelAgentRemovalTest(
+      32,
+      [](uint64_t i) {
+        return Simulation::GetActive()->GetRandom()->Uniform() > 0.5;
+      },
+      true);
+}
+
+// -----------------------------------------------------------------------------
+TEST(ResourceManagerTest, TombstoneThreshold) {
+  auto set_param = [](Param* param) {
+    param->agent_removal_tombstones = true;
+    param->agent_removal_tombstone_threshold = 0.1;
+  };
+  Simulation simulation(TEST_NAME, set_param);
+  auto* rm = simulation.GetResourceManager();
+
+  for (uint64_t i = 0; i < 100; ++i) {
+    rm->AddAgent(new TestAgent({i * real_t(10), 0, 0}));
+  }
+
+  // below the threshold
+  std::vector<AgentUid> uids = {AgentUid(3), AgentUid(50), AgentUid(99)};
+  rm->RemoveAgents({&uids});
+  EXPECT_EQ(3u, rm->GetNumTombstones());
+  EXPECT_EQ(97u, rm->GetNumAgents());
+  EXPECT_EQ(100u, rm->GetAgentContainerSize());
+  EXPECT_FALSE(rm->ContainsAgent(AgentUid(50)));
+
+  // above the threshold
+  uids.clear();
+  for (uint64_t i = 10; i < 20; ++i) {
+    uids.push_back(AgentUid(i));
+  }
+  rm->RemoveAgents({&uids});
+  EXPECT_EQ(0u, rm->GetNumTombstones());
+  EXPECT_EQ(87u, rm->GetNumAgents());
+  EXPECT_EQ(87u, rm->GetAgentContainerSize());
+
+  // the order of the remaining agents is preserved
+  uint64_t idx = 0;
+  AgentUid last;
+  rm->ForEachAgent([&](Agent* agent, AgentHandle ah) {
+    EXPECT_EQ(idx++, ah.GetElementIdx());
+    EXPECT_EQ(ah, rm->GetAgentHandle(agent->GetUid()));
+    if (idx > 1) {
+      EXPECT_LT(last, agent->GetUid());
+    }
+    last = agent->GetUid();
+  });
+  EXPECT_EQ(87u, idx);
+}
+
+// -----------------------------------------------------------------------------
+TEST(ResourceManagerTest, IncrementalLoadBalancing) {
+  for (bool minimize_memory : {true, false}) {
+    auto set_param = [&](Param* param) {
+      param->minimize_memory_while_rebalancing = minimize_memory;
+      param->incremental_load_balancing = true;
+      param->load_balancing_block_size = 4;
+      param->load_balancing_disorder_threshold = 0.05;
+      param->agent_removal_tombstones = true;
+      // never compact automatically
+      param->agent_removal_tombstone_threshold = 1;
+    };
+    Simulation simulation(TEST_NAME, set_param);
+    auto* rm = simulation.GetResourceManager();
+    auto* env = simulation.GetEnvironment();
+
+    // add the agents in reverse order of their position
+    for (uint64_t i = 0; i < 100; ++i) {
+      auto* agent = new TestAgent({(99 - i) * real_t(20), 0, 0});
+      agent->SetDiameter(10);
+      rm->AddAgent(agent);
+    }
+    env->ForcedUpdate();
+    rm->LoadBalance();
+    EXPECT_LT(0.05, rm->GetSpatialDisorder());
+
+    std::vector<Agent*> agents(100);
+    for (uint64_t i = 0; i < 100; ++i) {
+      agents[i] = rm->GetAgent(AgentUid(i));
+    }
+    auto swap_positions = [&](uint64_t uid1, uint64_t uid2) {
+      auto* agent1 = rm->GetAgent(AgentUid(uid1));
+      auto* agent2 = rm->GetAgent(AgentUid(uid2));
+      auto pos = agent1->GetPosition();
+      agent1->SetPosition(agent2->GetPosition());
+      agent2->SetPosition(pos);
+    };
+
+    // below the threshold: the agents are not reordered
+    swap_positions(0, 99);
+    env->ForcedUpdate();
+    auto ah = rm->GetAgentHandle(AgentUid(0));
+    rm->LoadBalance();
+    EXPECT_NEAR(0.02, rm->GetSpatialDisorder(), abs_error<real_t>::value);
+    EXPECT_EQ(ah, rm->GetAgentHandle(AgentUid(0)));
+
+    // above the threshold: only the agents that are out of place are moved
+    for (uint64_t i = 1; i < 5; ++i) {
+      swap_positions(i, 99 - i);
+    }
+    env->ForcedUpdate();
+    rm->LoadBalance();
+    EXPECT_NEAR(0.1, rm->GetSpatialDisorder(), abs_error<real_t>::value);
+    EXPECT_EQ(100u, rm->GetNumAgents());
+    for (uint64_t i = 0; i < 100; ++i) {
+      auto* agent = rm->GetAgent(AgentUid(i));
+      EXPECT_EQ(AgentUid(i), agent->GetUid());
+      EXPECT_EQ(agent, rm->GetAgent(rm->GetAgentHandle(AgentUid(i))));
+      if (i >= 5 && i < 95) {
+        EXPECT_EQ(agents[i], agent);
+      }
+    }
+    // the agents are ordered again
+    env->ForcedUpdate();
+    rm->LoadBalance();
+    EXPECT_EQ(0, rm->GetSpatialDisorder());
+
+    // tombstones are removed, although the agents are not reordered
+    std::vector<AgentUid> uids = {AgentUid(50)};
+    rm->RemoveAgents({&uids});
+    EXPECT_EQ(1u, rm->GetNumTombstones());
+    env->ForcedUpdate();
+    rm->LoadBalance();
+    EXPECT_GT(0.05, rm->GetSpatialDisorder());
+    EXPECT_EQ(0u, rm->GetNumTombstones());
+    EXPECT_EQ(99u, rm->GetNumAgents());
+    EXPECT_EQ(99u, rm->GetAgentContainerSize());
+    rm->ForEachAgent([&](Agent* agent, AgentHandle ah) {
+      EXPECT_EQ(ah, rm->GetAgentHandle(agent->GetUid()));
+    });
+  }
+}
+
 }  // namespace bdm
@@ -13,6 +13,7 @@
 // -----------------------------------------------------------------------------
 
 #include "unit/core/scheduler_test.h"
+#include <sstream>
 #include "core/environment/uniform_grid_environment.h"
 #include "core/model_initializer.h"
 #include "core/operation/operation_registry.h"
@@ -593,8 +594,13 @@ BDM_REGISTER_OP(ExecutionOrderTestOp, "em_test_op", kCpu)
 // -----------------------------------------------------------------------------
 void RunExecutionOrderTest(
     const char* test_name, Param::ExecutionOrder eo,
-    std::vector<std::pair<uint64_t, AgentUid>>* execution_order) {
-  auto set_param = [&](Param* param) { param->execution_order = eo; };
+    std::vector<std::pair<uint64_t, AgentUid>>* execution_order,
+    bool modifies_other_agents = true,
+    Param::AgentOpFusion fusion = Param::AgentOpFusion::kAlwaysFuse) {
+  auto set_param = [&](Param* param) {
+    param->execution_order = eo;
+    param->agent_op_fusion = fusion;
+  };
   Simulation simulation(test_name, set_param);
 
   // Turn off load balancing and multi-threading to avoid any interference
@@ -611,6 +617,8 @@ void RunExecutionOrderTest(
 
   scheduler->ScheduleOp(op1);
   scheduler->ScheduleOp(op2);
+  op1->SetModifiesOtherAgents(modifies_other_agents);
+  op2->SetModifiesOtherAgents(modifies_other_agents);
 
   auto* op1_impl = op1->GetImplementation<ExecutionOrderTestOp>();
   auto* op2_impl = op2->GetImplementation<ExecutionOrderTestOp>();
@@ -667,4 +675,82 @@ TEST(Scheduler, ForEachOpForEachAgent_ExecutionOrder) {
   EXPECT_EQ(AgentUid(1), execution_order[3].second);
 }
 
+// -----------------------------------------------------------------------------
+TEST(Scheduler, Planned_ExecutionOrder) {
+  // Operations that modify other agents are executed in separate passes
+  std::vector<std::pair<uint64_t, AgentUid>> execution_order;
+  RunExecutionOrderTest(TEST_NAME, Param::ExecutionOrder::kPlanned,
+                        &execution_order, true);
+
+  ASSERT_EQ(4u, execution_order.size());
+
+  EXPECT_EQ(0u, execution_order[0].first);
+  EXPECT_EQ(0u, execution_order[1].first);
+  EXPECT_EQ(1u, execution_order[2].first);
+  EXPECT_EQ(1u, execution_order[3].first);
+
+  EXPECT_EQ(AgentUid(0), execution_order[0].second);
+  EXPECT_EQ(AgentUid(1), execution_order[1].second);
+  EXPECT_EQ(AgentUid(0), execution_order[2].second);
+  EXPECT_EQ(AgentUid(1), execution_order[3].second);
+
+  // Other operations are fused
+  execution_order.clear();
+  RunExecutionOrderTest(TEST_NAME, Param::ExecutionOrder::kPlanned,
+                        &execution_order, false);
+
+  ASSERT_EQ(4u, execution_order.size());
+
+  EXPECT_EQ(0u, execution_order[0].first);
+  EXPECT_EQ(1u, execution_order[1].first);
+  EXPECT_EQ(0u, execution_order[2].first);
+  EXPECT_EQ(1u, execution_order[3].first);
+
+  EXPECT_EQ(AgentUid(0), execution_order[0].second);
+  EXPECT_EQ(AgentUid(0), execution_order[1].second);
+  EXPECT_EQ(AgentUid(1), execution_order[2].second);
+  EXPECT_EQ(AgentUid(1), execution_order[3].second);
+
+  // unless fusion is disabled
+  execution_order.clear();
+  RunExecutionOrderTest(TEST_NAME, Param::ExecutionOrder::kPlanned,
+                        &execution_order, false,
+                        Param::AgentOpFusion::kNeverFuse);
+
+  ASSERT_EQ(4u, execution_order.size());
+
+  EXPECT_EQ(0u, execution_order[0].first);
+  EXPECT_EQ(0u, execution_order[1].first);
+  EXPECT_EQ(1u, execution_order[2].first);
+  EXPECT_EQ(1u, execution_order[3].first);
+}
+
+// -----------------------------------------------------------------------------
+TEST(Scheduler, WorkStealingStatistics) {
+  auto set_param = [](Param* param) {
+    param->scheduling_work_stealing = true;
+    param->statistics = true;
+  };
+  Simulation simulation(TEST_NAME, set_param);
+  for (int i = 0; i < 10; ++i) {
+    simulation.GetResourceManager()->AddAgent(new Cell(10));
+  }
+  auto* scheduler = simulation.GetScheduler();
+  scheduler->Simulate(2);
+
+  // The statistics are recorded for each pass over all agents
+  const auto& entries = scheduler->GetWorkStealingStatistics().GetEntries();
+  ASSERT_EQ(1u, entries.count("agent ops"));
+  const auto& entry = entries.at("agent ops");
+  EXPECT_EQ(2u, entry.passes);
+  EXPECT_LE(0, entry.busy_ns);
+  EXPECT_LE(0, entry.idle_ns);
+  EXPECT_LE(0, entry.steals);
+
+  // They are not mixed with the operation timings
+  std::stringstream timings;
+  timings << *scheduler->GetOpTimes();
+  EXPECT_EQ(std::string::npos, timings.str().find("agent ops ("));
+}
+
 }  // namespace bdm
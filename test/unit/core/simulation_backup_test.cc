@@ -14,10 +14,19 @@
 
 #include "core/simulation_backup.h"
 
+#include <omp.h>
+#include <algorithm>
 #include <string>
+#include <vector>
 #include "core/agent/cell.h"
+#include "core/agent/spherical_agent.h"
+#include "core/behavior/growth_division.h"
+#include "core/diffusion/diffusion_grid.h"
+#include "core/model_initializer.h"
 #include "core/resource_manager.h"
+#include "core/type_index.h"
 #include "core/util/io.h"
+#include "core/util/thread_info.h"
 #include "gtest/gtest.h"
 #include "unit/test_util/test_util.h"
 
@@ -101,6 +110,29 @@ TEST(SimulationBackupTest, Backup) {
   remove(ROOTFILE);
 }
 
+TEST(SimulationBackupTest, BackupAsync) {
+  remove(ROOTFILE);
+  Simulation simulation(TEST_NAME);
+  auto* rm = simulation.GetResourceManager();
+
+  rm->AddAgent(new Cell());
+
+  SimulationBackup backup(ROOTFILE, "");
+  EXPECT_TRUE(backup.BackupAsync(26));
+  // Changes after the snapshot must not be part of the backup
+  rm->AddAgent(new Cell());
+  backup.WaitForBackup();
+  EXPECT_FALSE(backup.BackupInProgress());
+
+  ASSERT_TRUE(FileExists(ROOTFILE));
+  SimulationBackup restore("", ROOTFILE);
+  EXPECT_EQ(26u, restore.GetSimulationStepsFromBackup());
+  restore.Restore();
+  EXPECT_EQ(1u, simulation.GetResourceManager()->GetNumAgents());
+
+  remove(ROOTFILE);
+}
+
 TEST(SimulationBackupDeathTest, RestoreNoRestoreFileSpecified) {
   ASSERT_DEATH(
       {
@@ -143,6 +175,125 @@ TEST(SimulationBackupTest, BackupAndRestore) {
   remove(ROOTFILE);
 }
 
+TEST(SimulationBackupTest, BackupAndRestoreColumnar) {
+  remove(ROOTFILE);
+  auto set_param = [](Param* param) {
+    param->backup_format = "columnar";
+    // creates ResourceManager::type_index_
+    param->export_visualization = true;
+  };
+  Simulation simulation(TEST_NAME, set_param);
+  auto* rm = simulation.GetResourceManager();
+  ASSERT_NE(nullptr, rm->GetTypeIndex());
+
+  for (int i = 0; i < 100; i++) {
+    Agent* agent = nullptr;
+    if (i % 2 == 0) {
+      agent = new Cell({i * 1.0, i * 2.0, i * 3.0});
+      agent->AddBehavior(new GrowthDivision(i + 10, i));
+    } else {
+      agent = new SphericalAgent({i * 1.0, i * 2.0, i * 3.0});
+    }
+    agent->SetDiameter(i + 1);
+    rm->AddAgent(agent);
+  }
+  ModelInitializer::DefineSubstance(0, "Substance", 0.5, 0.1, 10);
+  simulation.GetEnvironment()->Update();
+  auto* dgrid = rm->GetDiffusionGrid(0);
+  dgrid->Initialize();
+  auto num_boxes = dgrid->GetNumBoxes();
+  for (size_t i = 0; i < num_boxes; i++) {
+    dgrid->ChangeConcentrationBy(i, i);
+  }
+  std::vector<real_t> concentrations(
+      dgrid->GetAllConcentrations(),
+      dgrid->GetAllConcentrations() + num_boxes);
+
+  std::vector<AgentHandle> handles;
+  rm->ForEachAgent([&](Agent* agent) {
+    handles.push_back(rm->GetAgentHandle(agent->GetUid()));
+  });
+
+  SimulationBackup backup(ROOTFILE, "");
+  backup.Backup(26);
+
+  SimulationBackup restore("", ROOTFILE);
+  EXPECT_EQ(26u, restore.GetSimulationStepsFromBackup());
+  restore.Restore();
+
+  rm = simulation.GetResourceManager();
+  ASSERT_EQ(100u, rm->GetNumAgents());
+  // Agents are restored at the same position inside ResourceManager
+  uint64_t cnt = 0;
+  rm->ForEachAgent([&](Agent* agent) {
+    auto ah = rm->GetAgentHandle(agent->GetUid());
+    EXPECT_EQ(handles[cnt], ah);
+    auto i = static_cast<int>(agent->GetDiameter()) - 1;
+    EXPECT_REAL_EQ(i * 2.0, agent->GetPosition()[1]);
+    if (i % 2 == 0) {
+      EXPECT_TRUE(dynamic_cast<Cell*>(agent) != nullptr);
+      const auto& behaviors = agent->GetAllBehaviors();
+      ASSERT_EQ(1u, behaviors.size());
+      EXPECT_TRUE(dynamic_cast<GrowthDivision*>(behaviors[0]) != nullptr);
+    } else {
+      EXPECT_TRUE(dynamic_cast<SphericalAgent*>(agent) != nullptr);
+      EXPECT_EQ(0u, agent->GetAllBehaviors().size());
+    }
+    cnt++;
+  });
+  // The type index references the restored agents, and only those
+  auto* type_index = rm->GetTypeIndex();
+  ASSERT_NE(nullptr, type_index);
+  EXPECT_EQ(50u, type_index->GetType(Cell::Class()).size());
+  EXPECT_EQ(50u, type_index->GetType(SphericalAgent::Class()).size());
+
+  dgrid = rm->GetDiffusionGrid(0);
+  ASSERT_EQ(num_boxes, dgrid->GetNumBoxes());
+  for (size_t i = 0; i < num_boxes; i++) {
+    EXPECT_REAL_EQ(concentrations[i], dgrid->GetAllConcentrations()[i]);
+  }
+
+  remove(ROOTFILE);
+}
+
+TEST(SimulationBackupTest, RestoreColumnarWithFewerThreads) {
+  remove(ROOTFILE);
+  auto set_param = [](Param* param) { param->backup_format = "columnar"; };
+  Simulation simulation(TEST_NAME, set_param);
+  auto* rm = simulation.GetResourceManager();
+
+  for (int i = 0; i < 1000; i++) {
+    auto* cell = new Cell({i * 1.0, i * 2.0, i * 3.0});
+    cell->SetDiameter(i + 1);
+    rm->AddAgent(cell);
+  }
+  SimulationBackup backup(ROOTFILE, "");
+  backup.Backup(1);
+
+  // Restore with a single thread, such that all but one NUMA node and all
+  // but one thread of the backup run are missing.
+  auto max_threads = omp_get_max_threads();
+  omp_set_num_threads(1);
+  ThreadInfo::GetInstance()->Renew();
+  SimulationBackup restore("", ROOTFILE);
+  restore.Restore();
+  omp_set_num_threads(max_threads);
+  ThreadInfo::GetInstance()->Renew();
+
+  rm = simulation.GetResourceManager();
+  ASSERT_EQ(1000u, rm->GetNumAgents());
+  std::vector<bool> found(1000, false);
+  rm->ForEachAgent([&](Agent* agent) {
+    ASSERT_TRUE(agent != nullptr);
+    auto i = static_cast<int>(agent->GetDiameter()) - 1;
+    EXPECT_REAL_EQ(i * 3.0, agent->GetPosition()[2]);
+    found[i] = true;
+  });
+  EXPECT_EQ(1000, std::count(found.begin(), found.end(), true));
+
+  remove(ROOTFILE);
+}
+
 }  // namespace bdm
 
 #endif  // USE_DICT
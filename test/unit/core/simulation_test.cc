@@ -57,6 +57,7 @@ class SimulationTest : public ::testing::Test {
       "interval = 100\n"
       "export_generate_pvsm = false\n"
       "compress_pv_files = false\n"
+      "native_export = true\n"
       "\n"
       "  [[visualize_agent]]\n"
       "  name = \"Cell\"\n"
@@ -135,6 +136,7 @@ class SimulationTest : public ::testing::Test {
     EXPECT_EQ(100u, param->visualization_interval);
     EXPECT_FALSE(param->visualization_export_generate_pvsm);
     EXPECT_FALSE(param->visualization_compress_pv_files);
+    EXPECT_TRUE(param->visualization_native_export);
 
     // visualize_agent
     EXPECT_EQ(2u, param->visualize_agents.size());
@@ -54,7 +54,7 @@ void Validate(const std::string& python_script, const std::string& sim_name,
 /// to false, thus failing the test also in the insitu case
 void RunDiffusionGridTest(uint64_t max_bound, uint64_t resolution,
                           bool export_visualization = true,
-                          bool use_pvsm = true) {
+                          bool use_pvsm = true, bool native_export = false) {
   auto num_diffusion_boxes = std::pow(resolution, 3);
   auto set_param = [&](Param* param) {
     param->remove_output_dir_contents = true;
@@ -70,9 +70,10 @@ void RunDiffusionGridTest(uint64_t max_bound, uint64_t resolution,
           "--sim_name=", sim_name, " --num_elements=", num_diffusion_boxes);
     }
     param->visualize_diffusion.push_back({"Substance", true});
+    param->visualization_native_export = native_export;
   };
-  auto sim_name =
-      Concat("ExportDiffusionGridTest_", max_bound, "_", resolution);
+  auto sim_name = Concat("ExportDiffusionGridTest_", max_bound, "_",
+                         resolution, native_export ? "_native" : "");
   auto* sim = new Simulation(sim_name, set_param);
   auto output_dir = sim->GetOutputDir();
 
@@ -141,6 +142,16 @@ TEST(FLAKY_ParaviewIntegrationTest, ExportDiffusionGridLoadWithoutPVSM) {
       std::max(max_threads - 1, 1), std::max(max_threads - 1, 1), true, false));
 }
 
+// -----------------------------------------------------------------------------
+TEST(FLAKY_ParaviewIntegrationTest, ExportDiffusionGrid_Native) {
+  auto max_threads = ThreadInfo::GetInstance()->GetMaxThreads();
+  LAUNCH_IN_NEW_PROCESS(RunDiffusionGridTest(std::max(max_threads - 1, 1),
+                                             std::max(max_threads - 1, 1), true,
+                                             true, true));
+  LAUNCH_IN_NEW_PROCESS(RunDiffusionGridTest(3 * max_threads + 1, max_threads,
+                                             true, true, true));
+}
+
 // Insitu-visualization not supported on macOS. Thus, we do not run these test
 // on macOS.
 #ifndef __APPLE__
@@ -162,7 +173,8 @@ TEST(FLAKY_ParaviewIntegrationTest, InsituDiffusionGrid_SlicesGtNumThreads) {
 // -----------------------------------------------------------------------------
 // -----------------------------------------------------------------------------
 void RunAgentsTest(Param::MappedDataArrayMode mode, uint64_t num_agents,
-                   bool export_visualization = true, bool use_pvsm = true) {
+                   bool export_visualization = true, bool use_pvsm = true,
+                   bool native_export = false) {
   auto set_param = [&](Param* param) {
     param->remove_output_dir_contents = true;
     param->export_visualization = export_visualization;
@@ -178,9 +190,11 @@ void RunAgentsTest(Param::MappedDataArrayMode mode, uint64_t num_agents,
     param->visualize_agents.insert(
         {"NeuriteElement", {"uid_", "daughter_right_"}});
     param->mapped_data_array_mode = mode;
+    param->visualization_native_export = native_export;
   };
   neuroscience::InitModule();
-  auto sim_name = Concat("ExportAgentsTest_", num_agents, "_", mode);
+  auto sim_name = Concat("ExportAgentsTest_", num_agents, "_", mode,
+                         native_export ? "_native" : "");
   auto* sim = new Simulation(sim_name, set_param);
 
   auto output_dir = sim->GetOutputDir();
@@ -256,6 +270,16 @@ TEST(FLAKY_ParaviewIntegrationTest, ExportAgentsLoadWithoutPVSM) {
       RunAgentsTest(mode, std::max(1, max_threads - 1), true, false));
 }
 
+// -----------------------------------------------------------------------------
+TEST(FLAKY_ParaviewIntegrationTest, ExportAgents_Native) {
+  auto max_threads = ThreadInfo::GetInstance()->GetMaxThreads();
+  auto mode = Param::MappedDataArrayMode::kZeroCopy;
+  LAUNCH_IN_NEW_PROCESS(
+      RunAgentsTest(mode, std::max(1, max_threads - 1), true, true, true));
+  LAUNCH_IN_NEW_PROCESS(
+      RunAgentsTest(mode, 10 * max_threads + 1, true, true, true));
+}
+
 // Disable insitu tests until ROOT cling crash on MacOS has been resolved
 #ifndef __APPLE__
 // -----------------------------------------------------------------------------